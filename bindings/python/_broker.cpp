@@ -47,10 +47,29 @@ extern void init_data(py::module& m);
 extern void init_enums(py::module& m);
 extern void init_store(py::module& m);
 
+extern py::object data_to_py(const broker::data& x);
+
 PYBIND11_MAKE_OPAQUE(broker::set)
 PYBIND11_MAKE_OPAQUE(broker::table)
 PYBIND11_MAKE_OPAQUE(broker::vector)
 
+namespace {
+
+using message = broker::subscriber::value_type;
+
+py::object message_to_py(const message& x) {
+  return py::make_tuple(x.first.string(), data_to_py(x.second));
+}
+
+py::list messages_to_py(const std::vector<message>& xs) {
+  py::list result(xs.size());
+  for ( size_t i = 0; i < xs.size(); ++i )
+    result[i] = message_to_py(xs[i]);
+  return result;
+}
+
+} // namespace <anonymous>
+
 PYBIND11_MODULE(_broker, m) {
   m.doc() = "Broker python bindings";
   py::module mb = m.def_submodule("bro", "Bro-specific bindings");
@@ -123,9 +142,11 @@ PYBIND11_MODULE(_broker, m) {
     .def("send_rate", &broker::publisher::send_rate)
     .def("fd", &broker::publisher::fd)
     .def("drop_all_on_destruction", &broker::publisher::drop_all_on_destruction)
-    .def("publish", (void (broker::publisher::*)(broker::data d)) &broker::publisher::publish)
+    .def("publish", (void (broker::publisher::*)(broker::data d)) &broker::publisher::publish,
+         py::call_guard<py::gil_scoped_release>())
     .def("publish_batch",
-       [](broker::publisher& p, std::vector<broker::data> xs) { p.publish(xs); });
+       [](broker::publisher& p, std::vector<broker::data> xs) { p.publish(xs); },
+       py::call_guard<py::gil_scoped_release>());
 
   using subscriber_base = broker::subscriber_base<broker::subscriber::value_type>;
 
@@ -138,40 +159,95 @@ PYBIND11_MODULE(_broker, m) {
          [](broker::optional<subscriber_base::value_type>& i) { return *i; })
     .def("__repr__", [](const broker::optional<subscriber_base::value_type>& i) { return to_string(i); });
 
+  // All variants of get() may block and therefore release the GIL. The
+  // *_py variants convert the messages to native Python objects in one go.
   py::class_<subscriber_base>(m, "SubscriberBase")
-    .def("get", (subscriber_base::value_type (subscriber_base::*)()) &subscriber_base::get)
+    .def("get", (subscriber_base::value_type (subscriber_base::*)()) &subscriber_base::get,
+         py::call_guard<py::gil_scoped_release>())
     .def("get",
          [](subscriber_base& ep, double secs) -> broker::optional<subscriber_base::value_type> {
-	  return ep.get(broker::to_duration(secs)); })
+	  return ep.get(broker::to_duration(secs)); },
+         py::call_guard<py::gil_scoped_release>())
     .def("get",
          [](subscriber_base& ep, size_t num) -> std::vector<subscriber_base::value_type> {
-	   return ep.get(num); })
+	   return ep.get(num); },
+         py::call_guard<py::gil_scoped_release>())
     .def("get",
          [](subscriber_base& ep, size_t num, double secs) -> std::vector<subscriber_base::value_type> {
-	   return ep.get(num, broker::to_duration(secs)); })
+	   return ep.get(num, broker::to_duration(secs)); },
+         py::call_guard<py::gil_scoped_release>())
+    .def("get_py",
+         [](subscriber_base& ep) -> py::object {
+           std::vector<message> xs;
+           {
+             py::gil_scoped_release release;
+             xs = ep.get(1);
+           }
+           // A closed subscriber runs out of messages.
+           return xs.empty() ? py::none() : message_to_py(xs.front());
+         })
+    .def("get_py",
+         [](subscriber_base& ep, double secs) -> py::object {
+           broker::optional<message> x;
+           {
+             py::gil_scoped_release release;
+             x = ep.get(broker::to_duration(secs));
+           }
+           return x ? message_to_py(*x) : py::none();
+         })
+    .def("get_py",
+         [](subscriber_base& ep, size_t num) -> py::list {
+           std::vector<message> xs;
+           {
+             py::gil_scoped_release release;
+             xs = ep.get(num);
+           }
+           return messages_to_py(xs);
+         })
+    .def("get_py",
+         [](subscriber_base& ep, size_t num, double secs) -> py::list {
+           std::vector<message> xs;
+           {
+             py::gil_scoped_release release;
+             xs = ep.get(num, broker::to_duration(secs));
+           }
+           return messages_to_py(xs);
+         })
     .def("poll", &subscriber_base::poll)
+    .def("poll_py",
+         [](subscriber_base& ep) -> py::list {
+           return messages_to_py(ep.poll());
+         })
     .def("available", &subscriber_base::available)
+    .def("closed", &subscriber_base::closed)
     .def("fd", &subscriber_base::fd);
 
   py::class_<broker::subscriber, subscriber_base>(m, "Subscriber")
-    .def("add_topic", &broker::subscriber::add_topic)
-    .def("remove_topic", &broker::subscriber::remove_topic);
+    .def("dropped", &broker::subscriber::dropped)
+    .def("add_topic", &broker::subscriber::add_topic,
+         py::call_guard<py::gil_scoped_release>())
+    .def("remove_topic", &broker::subscriber::remove_topic,
+         py::call_guard<py::gil_scoped_release>());
 
   using status_subscriber_base = broker::subscriber_base<broker::status_subscriber::value_type>;
 
   py::bind_vector<std::vector<status_subscriber_base::value_type>>(m, "VectorStatusSubscriberValueType");
 
   py::class_<status_subscriber_base>(m, "StatusSubscriberBase")
-    .def("get", (status_subscriber_base::value_type (status_subscriber_base::*)()) &status_subscriber_base::get)
+    .def("get", (status_subscriber_base::value_type (status_subscriber_base::*)()) &status_subscriber_base::get,
+         py::call_guard<py::gil_scoped_release>())
     .def("get",
          [](status_subscriber_base& ep, double secs) -> broker::optional<status_subscriber_base::value_type> {
-	   return ep.get(broker::to_duration(secs)); })
+	   return ep.get(broker::to_duration(secs)); },
+         py::call_guard<py::gil_scoped_release>())
     .def("get",
          [](status_subscriber_base& ep, size_t num) -> std::vector<status_subscriber_base::value_type> {
-	   return ep.get(num); })
+	   return ep.get(num); },
+         py::call_guard<py::gil_scoped_release>())
     .def("get",
          [](status_subscriber_base& ep, size_t num, double secs) -> std::vector<status_subscriber_base::value_type> {
-	   return ep.get(num, broker::to_duration(secs)); })
+	   return ep.get(num, broker::to_duration(secs)); },
+         py::call_guard<py::gil_scoped_release>())
     .def("poll",
          [](status_subscriber_base& ep) -> std::vector<status_subscriber_base::value_type> {
 	   return ep.poll(); })
@@ -209,7 +285,17 @@ PYBIND11_MODULE(_broker, m) {
     .def_readwrite("disable_ssl", &broker::broker_options::disable_ssl)
     .def_readwrite("ttl", &broker::broker_options::ttl)
     .def_readwrite("forward", &broker::broker_options::forward)
-    .def_readwrite("use_real_time", &broker::broker_options::use_real_time);
+    .def_readwrite("use_real_time", &broker::broker_options::use_real_time)
+    .def_readwrite("subscriber_sample_interval",
+                   &broker::broker_options::subscriber_sample_interval)
+    .def_readwrite("subscriber_disconnect_lag",
+                   &broker::broker_options::subscriber_disconnect_lag)
+    .def_readwrite("control_lane_weight",
+                   &broker::broker_options::control_lane_weight)
+    .def_readwrite("store_lane_weight",
+                   &broker::broker_options::store_lane_weight)
+    .def_readwrite("bulk_lane_weight",
+                   &broker::broker_options::bulk_lane_weight);
 
   // We need a configuration class here that's separate from
   // broker::configuration. When creating an endpoint one has to instantiate
@@ -252,39 +338,62 @@ PYBIND11_MODULE(_broker, m) {
         }))
     .def("__repr__", [](const broker::endpoint& e) { return to_string(e.node_id()); })
     .def("node_id", [](const broker::endpoint& e) { return to_string(e.node_id()); })
-    .def("listen", &broker::endpoint::listen, py::arg("address"), py::arg("port") = 0)
+    .def("listen", &broker::endpoint::listen, py::arg("address"), py::arg("port") = 0,
+         py::call_guard<py::gil_scoped_release>())
+    .def("listen_unix", &broker::endpoint::listen_unix, py::arg("path"),
+         py::call_guard<py::gil_scoped_release>())
     .def("peer",
          [](broker::endpoint& ep, std::string& addr, uint16_t port, double retry) -> bool {
 	 return ep.peer(addr, port, std::chrono::seconds((int)retry));},
-         py::arg("addr"), py::arg("port"), py::arg("retry") = 10.0
+         py::arg("addr"), py::arg("port"), py::arg("retry") = 10.0,
+         py::call_guard<py::gil_scoped_release>()
          )
     .def("peer_nosync",
          [](broker::endpoint& ep, std::string& addr, uint16_t port, double retry) {
 	 ep.peer_nosync(addr, port, std::chrono::seconds((int)retry));},
          py::arg("addr"), py::arg("port"), py::arg("retry") = 10.0
          )
-    .def("unpeer", &broker::endpoint::unpeer)
+    .def("peer_unix",
+         [](broker::endpoint& ep, std::string& path, double retry) -> bool {
+	 return ep.peer_unix(path, std::chrono::seconds((int)retry));},
+         py::arg("path"), py::arg("retry") = 10.0,
+         py::call_guard<py::gil_scoped_release>()
+         )
+    .def("unpeer", &broker::endpoint::unpeer,
+         py::call_guard<py::gil_scoped_release>())
+    .def("unpeer_unix", &broker::endpoint::unpeer_unix,
+         py::call_guard<py::gil_scoped_release>())
     .def("unpeer_nosync", &broker::endpoint::unpeer_nosync)
-    .def("peers", &broker::endpoint::peers)
-    .def("peer_subscriptions", &broker::endpoint::peer_subscriptions)
+    .def("peers", &broker::endpoint::peers,
+         py::call_guard<py::gil_scoped_release>())
+    .def("peer_subscriptions", &broker::endpoint::peer_subscriptions,
+         py::call_guard<py::gil_scoped_release>())
     .def("forward", &broker::endpoint::forward)
     .def("publish", (void (broker::endpoint::*)(broker::topic t, broker::data d)) &broker::endpoint::publish)
     .def("publish", (void (broker::endpoint::*)(const broker::endpoint_info& dst, broker::topic t, broker::data d)) &broker::endpoint::publish)
     .def("publish_batch",
        [](broker::endpoint& ep, std::vector<broker::endpoint::value_type> xs) { ep.publish(xs); })
     .def("make_publisher", &broker::endpoint::make_publisher)
-    .def("make_subscriber", &broker::endpoint::make_subscriber, py::arg("topics"), py::arg("max_qsize") = 20)
+    .def("make_subscriber", &broker::endpoint::make_subscriber, py::arg("topics"), py::arg("max_qsize") = 20,
+         py::arg("policy") = broker::overflow_policy::block)
     .def("make_status_subscriber", &broker::endpoint::make_status_subscriber, py::arg("receive_statuses") = false)
-    .def("shutdown", &broker::endpoint::shutdown)
+    .def("shutdown", &broker::endpoint::shutdown,
+         py::call_guard<py::gil_scoped_release>())
     .def("attach_master",
          [](broker::endpoint& ep, const std::string& name, broker::backend type,
             const broker::backend_options& opts) -> broker::expected<broker::store> {
 	        return ep.attach_master(name, type, opts);
-	    })
+	    },
+         py::call_guard<py::gil_scoped_release>())
     .def("attach_clone",
-         [](broker::endpoint& ep, const std::string& name) -> broker::expected<broker::store> {
-	        return ep.attach_clone(name);
-	    })
+         [](broker::endpoint& ep, const std::string& name, double write_coalesce_interval,
+            size_t write_coalesce_size) -> broker::expected<broker::store> {
+	        return ep.attach_clone(name, 10.0, 300.0, 120.0, write_coalesce_interval,
+	                               write_coalesce_size);
+	    },
+         py::arg("name"), py::arg("write_coalesce_interval") = 0.0,
+         py::arg("write_coalesce_size") = 1000,
+         py::call_guard<py::gil_scoped_release>())
    ;
 }
 
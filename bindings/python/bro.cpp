@@ -1,6 +1,8 @@
 
 #include <utility>
 #include <string>
+#include <stdexcept>
+#include <vector>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic"
@@ -30,5 +32,47 @@ void init_bro(py::module& m) {
     .def("args",
          static_cast<const broker::vector& (broker::bro::Event::*)() const>
          (&broker::bro::Event::args));
+
+  py::class_<broker::bro::LogBatch, broker::bro::Message>(m, "LogBatch")
+    .def(py::init([](broker::data data) {
+       return broker::bro::LogBatch(std::move(data));
+       }))
+    .def("valid", &broker::bro::LogBatch::valid)
+    .def("stream_id", &broker::bro::LogBatch::stream_id)
+    .def("writer_id", &broker::bro::LogBatch::writer_id)
+    .def("path", &broker::bro::LogBatch::path)
+    .def("num_records", &broker::bro::LogBatch::num_records)
+    .def("column", [](const broker::bro::LogBatch& b, size_t i) {
+       broker::vector result;
+       if ( ! b.column(i, result) )
+         throw std::invalid_argument("malformed column");
+       return result;
+       })
+    .def("records", [](const broker::bro::LogBatch& b) {
+       std::vector<broker::vector> records;
+       if ( ! b.records(records) )
+         throw std::invalid_argument("malformed column");
+       py::list result;
+       for ( auto& x : records )
+         result.append(py::cast(std::move(x)));
+       return result;
+       });
+
+  py::class_<broker::bro::LogBatchBuilder>(m, "LogBatchBuilder")
+    .def(py::init([](broker::enum_value stream_id, broker::enum_value writer_id,
+                     broker::data path, py::list types) {
+       std::vector<broker::data::type> schema;
+       for ( auto x : types )
+         schema.emplace_back(x.cast<broker::data::type>());
+       return broker::bro::LogBatchBuilder(std::move(stream_id),
+                                           std::move(writer_id),
+                                           std::move(path), schema);
+       }))
+    .def("add", [](broker::bro::LogBatchBuilder& b, broker::data record) {
+       auto vp = caf::get_if<broker::vector>(&record);
+       return vp != nullptr && b.add(*vp);
+       })
+    .def("num_records", &broker::bro::LogBatchBuilder::num_records)
+    .def("build", &broker::bro::LogBatchBuilder::build);
 }
 
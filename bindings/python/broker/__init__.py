@@ -26,6 +26,7 @@ now = _broker.now
 APIFlags = _broker.APIFlags
 EC = _broker.EC
 SC = _broker.SC
+OverflowPolicy = _broker.OverflowPolicy
 PeerStatus = _broker.PeerStatus
 PeerFlags = _broker.PeerFlags
 Frontend = _broker.Frontend
@@ -85,32 +86,22 @@ class Subscriber:
         self._subscriber = internal_subscriber
 
     def get(self, *args, **kwargs):
-        msg = self._subscriber.get(*args, **kwargs)
-
-        if msg is None:
-            return None
-
-        if isinstance(msg, _broker.OptionalSubscriberBaseValueType):
-            if not msg.is_set():
-                return None
-
-            msg = msg.get();
-
-        if isinstance(msg, tuple):
-            return (msg[0].string(), Data.to_py(msg[1]))
-
-        if isinstance(msg, _broker.VectorPairTopicData):
-            return [(d[0].string(), Data.to_py(d[1])) for d in msg]
-
-        assert False
+        # Converts messages in C++ to avoid creating intermediate wrappers
+        # for each element.
+        return self._subscriber.get_py(*args, **kwargs)
 
     def poll(self):
-        msgs = self._subscriber.poll()
-        return [(d[0].string(), Data.to_py(d[1])) for d in msgs]
+        return self._subscriber.poll_py()
 
     def available(self):
         return self._subscriber.available()
 
+    def dropped(self):
+        return self._subscriber.dropped()
+
+    def closed(self):
+        return self._subscriber.closed()
+
     def fd(self):
         return self._subscriber.fd()
 
@@ -292,9 +283,9 @@ class Store:
         return (_broker.OptionalTimespan(_broker.Timespan(float(e))) if e is not None else _broker.OptionalTimespan())
 
 class Endpoint(_broker.Endpoint):
-    def make_subscriber(self, topics, qsize = 20):
+    def make_subscriber(self, topics, qsize = 20, policy = OverflowPolicy.Block):
         topics = _make_topics(topics)
-        s = _broker.Endpoint.make_subscriber(self, topics, qsize)
+        s = _broker.Endpoint.make_subscriber(self, topics, qsize, policy)
         return Subscriber(s)
 
     def make_status_subscriber(self, receive_statuses=False):
@@ -327,8 +318,9 @@ class Endpoint(_broker.Endpoint):
         s = _broker.Endpoint.attach_master(self, name, type, bopts)
         return Store(s.get()) if s.is_valid() else None
 
-    def attach_clone(self, name):
-        s = _broker.Endpoint.attach_clone(self, name)
+    def attach_clone(self, name, write_coalesce_interval=0.0, write_coalesce_size=1000):
+        s = _broker.Endpoint.attach_clone(self, name, write_coalesce_interval,
+                                          write_coalesce_size)
         return Store(s.get()) if s.is_valid() else None
 
 class Message:
@@ -342,7 +334,7 @@ class Data(_broker.Data):
         if x is None:
             _broker.Data.__init__(self)
 
-        elif isinstance(x, bro.Event):
+        elif isinstance(x, (bro.Event, bro.LogBatch)):
             _broker.Data.__init__(self, x.as_data())
 
         elif isinstance(x, _broker.Data):
@@ -405,57 +397,7 @@ class Data(_broker.Data):
 
     @staticmethod
     def to_py(d):
-        def to_ipaddress(a):
-            if a.is_v4():
-                return ipaddress.IPv4Address(a.bytes()[-4:])
-            else:
-                return ipaddress.IPv6Address(a.bytes())
-
-        def to_subnet(s):
-            # Python < 3.5 does not have a nicer way of setting the prefixlen
-            # when creating from packed data.
-            if s.network().is_v4():
-                return ipaddress.IPv4Network(to_ipaddress(s.network())).supernet(new_prefix=s.length())
-            else:
-                return ipaddress.IPv6Network(to_ipaddress(s.network())).supernet(new_prefix=s.length())
-
-        def to_set(s):
-            return set([Data.to_py(i) for i in s])
-
-        def to_table(t):
-            return {Data.to_py(k): Data.to_py(v) for (k, v) in t.items()}
-
-        def to_vector(v):
-            return [Data.to_py(i) for i in v]
-
-        def _try_bytes_decode(b):
-            try:
-                return b.decode('utf-8')
-            except:
-                return b
-
-        converters = {
-            Data.Type.Nil: lambda: None,
-            Data.Type.Address: lambda: to_ipaddress(d.as_address()),
-            Data.Type.Boolean: lambda: d.as_boolean(),
-            Data.Type.Count: lambda: Count(d.as_count()),
-            Data.Type.EnumValue: lambda: d.as_enum_value(),
-            Data.Type.Integer: lambda: d.as_integer(),
-            Data.Type.Port: lambda: d.as_port(),
-            Data.Type.Real: lambda: d.as_real(),
-            Data.Type.Set: lambda: to_set(d.as_set()),
-            Data.Type.String: lambda: _try_bytes_decode(d.as_string()),
-            Data.Type.Subnet: lambda: to_subnet(d.as_subnet()),
-            Data.Type.Table: lambda: to_table(d.as_table()),
-            Data.Type.Timespan: lambda: datetime.timedelta(seconds=d.as_timespan()),
-            Data.Type.Timestamp: lambda: datetime.datetime.fromtimestamp(d.as_timestamp()),
-            Data.Type.Vector: lambda: to_vector(d.as_vector())
-            }
-
-        try:
-            return converters[d.get_type()]()
-        except KeyError:
-            raise TypeError("unsupported data type: " + str(d.get_type()))
+        return _broker.data_to_py(d)
 
 ####### TODO: Updated to new Broker API until here.
 
@@ -0,0 +1,177 @@
+"""asyncio integration for Broker.
+
+The classes in this module wrap the regular Broker objects and suspend
+coroutines on the file descriptors that Broker already provides for select
+loops. They register these descriptors with the event loop via
+``loop.add_reader`` and never spawn helper threads or poll.
+
+Requires Python 3.5.2 or newer.
+"""
+
+import asyncio
+import collections
+
+try:
+    from . import _broker
+except ImportError:
+    import _broker
+
+import broker
+
+def _wake(fut):
+    if not fut.done():
+        fut.set_result(None)
+
+async def _readable(loop, fd):
+    # Suspends until `fd` becomes readable. Broker signals pending messages
+    # and free capacity by making a descriptor readable, and keeps it readable
+    # as long as the condition holds.
+    fut = loop.create_future()
+    loop.add_reader(fd, _wake, fut)
+    try:
+        await fut
+    finally:
+        loop.remove_reader(fd)
+
+class _Receiver:
+    def __init__(self, subscriber, loop):
+        self._subscriber = subscriber
+        self._loop = loop if loop else asyncio.get_event_loop()
+        self._buffer = collections.deque()
+
+    async def _fill(self):
+        while not self._buffer:
+            if not self._subscriber.available():
+                await _readable(self._loop, self._subscriber.fd())
+            self._buffer.extend(self._subscriber.poll())
+
+    async def get(self, num=None):
+        """Returns the next message. If `num` is given, returns a list with
+        between one and `num` messages, depending on how many are available."""
+        await self._fill()
+
+        if num is None:
+            return self._buffer.popleft()
+
+        n = min(num, len(self._buffer))
+        return [self._buffer.popleft() for i in range(n)]
+
+    def poll(self):
+        """Returns all currently available messages without suspending."""
+        result = list(self._buffer)
+        self._buffer.clear()
+        result.extend(self._subscriber.poll())
+        return result
+
+    def available(self):
+        return len(self._buffer) + self._subscriber.available()
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self):
+        return await self.get()
+
+class Subscriber(_Receiver):
+    """Wraps a `broker.Subscriber`. Iterating over it with ``async for``
+    yields ``(topic, data)`` pairs."""
+    def __init__(self, subscriber, loop=None):
+        _Receiver.__init__(self, subscriber, loop)
+
+    def __getattr__(self, name):
+        return getattr(self._subscriber, name)
+
+class StatusSubscriber(_Receiver):
+    """Wraps a `broker.StatusSubscriber`. Iterating over it with
+    ``async for`` yields `broker.Status` and `broker.Error` instances."""
+    def __init__(self, subscriber, loop=None):
+        _Receiver.__init__(self, subscriber, loop)
+
+class Publisher:
+    """Wraps a `broker.Publisher` with flow control."""
+    def __init__(self, publisher, loop=None):
+        self._publisher = publisher
+        self._loop = loop if loop else asyncio.get_event_loop()
+
+    async def drain(self):
+        """Suspends until the publisher's queue has free capacity."""
+        while self._publisher.free_capacity() == 0:
+            await _readable(self._loop, self._publisher.fd())
+
+    async def publish(self, x):
+        """Waits for free capacity and then publishes `x`."""
+        await self.drain()
+        self._publisher.publish(x)
+
+    def __getattr__(self, name):
+        return getattr(self._publisher, name)
+
+class Store:
+    """Wraps a `broker.Store`. Lookups return awaitables, everything else
+    forwards to the wrapped store. Issues all lookups through a single
+    `store::proxy` and dispatches responses by request ID."""
+    def __init__(self, store, loop=None):
+        self._store = store
+        self._loop = loop if loop else asyncio.get_event_loop()
+        self._proxy = _broker.Store.Proxy(store._store)
+        self._mailbox = self._proxy.mailbox()
+        self._pending = {}
+
+    def exists(self, key):
+        return self._request(self._proxy.exists(broker.Data.from_py(key)))
+
+    def get(self, key):
+        return self._request(self._proxy.get(broker.Data.from_py(key)))
+
+    def put_unique(self, key, value, expiry=None):
+        key = broker.Data.from_py(key)
+        value = broker.Data.from_py(value)
+        expiry = self._store._to_expiry(expiry)
+        return self._request(self._proxy.put_unique(key, value, expiry))
+
+    def get_index_from_value(self, key, index):
+        key = broker.Data.from_py(key)
+        index = broker.Data.from_py(index)
+        return self._request(self._proxy.get_index_from_value(key, index))
+
+    def keys(self):
+        return self._request(self._proxy.keys())
+
+    def close(self):
+        """Stops waiting for responses and cancels pending lookups."""
+        if self._pending:
+            self._loop.remove_reader(self._mailbox.descriptor())
+
+        for fut in self._pending.values():
+            fut.cancel()
+
+        self._pending.clear()
+
+    def __getattr__(self, name):
+        return getattr(self._store, name)
+
+    def _request(self, id):
+        fut = self._loop.create_future()
+
+        if id == 0:
+            # The proxy has no store attached.
+            fut.set_result(None)
+            return fut
+
+        if not self._pending:
+            self._loop.add_reader(self._mailbox.descriptor(), self._dispatch)
+
+        self._pending[id] = fut
+        return fut
+
+    def _dispatch(self):
+        while not self._mailbox.empty():
+            resp = self._proxy.receive()
+            fut = self._pending.pop(resp.id, None)
+
+            if fut and not fut.done():
+                answer = resp.answer
+                fut.set_result(broker.Data.to_py(answer.get()) if answer.is_valid() else None)
+
+        if not self._pending:
+            self._loop.remove_reader(self._mailbox.descriptor())
@@ -17,3 +17,34 @@ class Event(_broker.bro.Event):
 
     def args(self):
         return [broker.Data.to_py(a) for a in _broker.bro.Event.args(self)]
+
+class LogBatch(_broker.bro.LogBatch):
+    def __init__(self, msg):
+        if isinstance(msg, _broker.bro.LogBatch):
+            msg = msg.as_data()
+        _broker.bro.LogBatch.__init__(self, broker.Data.from_py(msg))
+
+    def path(self):
+        return broker.Data.to_py(_broker.bro.LogBatch.path(self))
+
+    def column(self, i):
+        return [broker.Data.to_py(x) for x in _broker.bro.LogBatch.column(self, i)]
+
+    def records(self):
+        return [[broker.Data.to_py(x) for x in r]
+                for r in _broker.bro.LogBatch.records(self)]
+
+class LogBatchBuilder(_broker.bro.LogBatchBuilder):
+    def __init__(self, stream_id, writer_id, path, schema):
+        def to_enum(x):
+            return x if isinstance(x, broker.Enum) else broker.Enum(x)
+
+        _broker.bro.LogBatchBuilder.__init__(self, to_enum(stream_id),
+                                             to_enum(writer_id),
+                                             broker.Data.from_py(path), schema)
+
+    def add(self, record):
+        return _broker.bro.LogBatchBuilder.add(self, broker.Data.from_py(record))
+
+    def build(self):
+        return LogBatch(_broker.bro.LogBatchBuilder.build(self))
@@ -18,6 +18,118 @@
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+namespace {
+
+// Python callables for converting data to native objects. Looked up once when
+// loading the module and never released, since they must outlive the module.
+struct py_types {
+  py::object count;
+  py::object ipv4_address;
+  py::object ipv6_address;
+  py::object ipv4_network;
+  py::object ipv6_network;
+  py::object timedelta;
+  py::object fromtimestamp;
+};
+
+py_types* types = nullptr;
+
+// Mirrors Data.to_py in the Python wrapper, but converts entire data trees
+// without calling back into Python for each element.
+struct to_py_visitor {
+  using result_type = py::object;
+
+  py::object operator()(broker::none) const {
+    return py::none();
+  }
+
+  py::object operator()(broker::boolean x) const {
+    return py::bool_(x);
+  }
+
+  py::object operator()(broker::count x) const {
+    return types->count(py::int_(x));
+  }
+
+  py::object operator()(broker::integer x) const {
+    return py::int_(x);
+  }
+
+  py::object operator()(broker::real x) const {
+    return py::float_(x);
+  }
+
+  py::object operator()(const std::string& x) const {
+    auto ptr = PyUnicode_DecodeUTF8(x.data(), x.size(), nullptr);
+    if ( ptr )
+      return py::reinterpret_steal<py::object>(ptr);
+    PyErr_Clear();
+    return py::bytes(x);
+  }
+
+  py::object operator()(const broker::address& x) const {
+    auto& bytes = x.bytes();
+    auto first = reinterpret_cast<const char*>(bytes.data());
+    if ( x.is_v4() )
+      return types->ipv4_address(py::bytes(first + 12, 4));
+    return types->ipv6_address(py::bytes(first, 16));
+  }
+
+  py::object operator()(const broker::subnet& x) const {
+    auto net = (*this)(x.network());
+    auto& cls = x.network().is_v4() ? types->ipv4_network : types->ipv6_network;
+    return cls(net).attr("supernet")("new_prefix"_a = x.length());
+  }
+
+  py::object operator()(const broker::port& x) const {
+    return py::cast(x);
+  }
+
+  py::object operator()(broker::timestamp x) const {
+    double secs;
+    broker::convert(x, secs);
+    return types->fromtimestamp(secs);
+  }
+
+  py::object operator()(broker::timespan x) const {
+    double secs;
+    broker::convert(x, secs);
+    return types->timedelta("seconds"_a = secs);
+  }
+
+  py::object operator()(const broker::enum_value& x) const {
+    return py::cast(x);
+  }
+
+  py::object operator()(const broker::set& xs) const {
+    py::set result;
+    for ( auto& x : xs )
+      result.add(caf::visit(*this, x.get_data()));
+    return std::move(result);
+  }
+
+  py::object operator()(const broker::table& xs) const {
+    py::dict result;
+    for ( auto& x : xs )
+      result[caf::visit(*this, x.first.get_data())]
+        = caf::visit(*this, x.second.get_data());
+    return std::move(result);
+  }
+
+  py::object operator()(const broker::vector& xs) const {
+    py::list result(xs.size());
+    for ( size_t i = 0; i < xs.size(); ++i )
+      result[i] = caf::visit(*this, xs[i].get_data());
+    return std::move(result);
+  }
+};
+
+} // namespace <anonymous>
+
+py::object data_to_py(const broker::data& x) {
+  return caf::visit(to_py_visitor{}, x.get_data());
+}
+
 void init_data(py::module& m) {
 
   py::class_<broker::address> address_type{m, "Address"};
@@ -239,5 +351,18 @@ void init_data(py::module& m) {
     .value("Timespan", broker::data::type::timespan)
     .value("Timestamp", broker::data::type::timestamp)
     .value("Vector", broker::data::type::vector);
+
+  auto ipaddress = py::module::import("ipaddress");
+  auto datetime = py::module::import("datetime");
+  types = new py_types{m.attr("Count"),
+                       ipaddress.attr("IPv4Address"),
+                       ipaddress.attr("IPv6Address"),
+                       ipaddress.attr("IPv4Network"),
+                       ipaddress.attr("IPv6Network"),
+                       datetime.attr("timedelta"),
+                       datetime.attr("datetime").attr("fromtimestamp")};
+
+  m.def("data_to_py", &data_to_py,
+        "Converts a Data instance into native Python objects");
 }
 
@@ -10,6 +10,7 @@
 #include "broker/backend.hh"
 #include "broker/error.hh"
 #include "broker/frontend.hh"
+#include "broker/overflow_policy.hh"
 #include "broker/peer_flags.hh"
 #include "broker/peer_status.hh"
 #include "broker/status.hh"
@@ -36,7 +37,15 @@ void init_enums(py::module& m) {
     .value("Unspecified", broker::sc::unspecified)
     .value("PeerAdded", broker::sc::peer_added)
     .value("PeerRemoved", broker::sc::peer_removed)
-    .value("PeerLost", broker::sc::peer_lost);
+    .value("PeerLost", broker::sc::peer_lost)
+    .value("SubscriberOverflow", broker::sc::subscriber_overflow);
+
+  py::enum_<broker::overflow_policy>(m, "OverflowPolicy")
+    .value("Block", broker::overflow_policy::block)
+    .value("DropOldest", broker::overflow_policy::drop_oldest)
+    .value("DropNewest", broker::overflow_policy::drop_newest)
+    .value("Sample", broker::overflow_policy::sample)
+    .value("Disconnect", broker::overflow_policy::disconnect);
 
   py::enum_<broker::peer_status>(m, "PeerStatus")
     .value("Initialized", broker::peer_status::initialized)
@@ -67,5 +76,6 @@ void init_enums(py::module& m) {
     .value("Memory", broker::memory)
     .value("SQLite", broker::sqlite)
     .value("RocksDB", broker::rocksdb)
+    .value("AppendLog", broker::append_log)
     .export_values();
 }
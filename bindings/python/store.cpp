@@ -8,6 +8,7 @@
 #pragma GCC diagnostic pop
 
 #include "broker/data.hh"
+#include "broker/mailbox.hh"
 #include "broker/store.hh"
 
 namespace py = pybind11;
@@ -37,12 +38,17 @@ void init_store(py::module& m) {
   py::class_<broker::store> store(m, "Store");
   store
     .def("name", &broker::store::name)
-    .def("exists", (broker::expected<broker::data> (broker::store::*)(broker::data d) const) &broker::store::exists)
-    .def("get", (broker::expected<broker::data> (broker::store::*)(broker::data d) const) &broker::store::get)
-    .def("get_index_from_value", (broker::expected<broker::data> (broker::store::*)(broker::data d, broker::data index) const) &broker::store::get_index_from_value)
-    .def("keys", &broker::store::keys)
+    .def("exists", (broker::expected<broker::data> (broker::store::*)(broker::data d) const) &broker::store::exists,
+         py::call_guard<py::gil_scoped_release>())
+    .def("get", (broker::expected<broker::data> (broker::store::*)(broker::data d) const) &broker::store::get,
+         py::call_guard<py::gil_scoped_release>())
+    .def("get_index_from_value", (broker::expected<broker::data> (broker::store::*)(broker::data d, broker::data index) const) &broker::store::get_index_from_value,
+         py::call_guard<py::gil_scoped_release>())
+    .def("keys", &broker::store::keys,
+         py::call_guard<py::gil_scoped_release>())
     .def("put", &broker::store::put)
-    .def("put_unique", &broker::store::put_unique)
+    .def("put_unique", &broker::store::put_unique,
+         py::call_guard<py::gil_scoped_release>())
     .def("erase", &broker::store::erase)
     .def("clear", &broker::store::clear)
     .def("increment", &broker::store::increment)
@@ -54,10 +60,27 @@ void init_store(py::module& m) {
     .def("push", &broker::store::push)
     .def("pop", &broker::store::pop);
 
-// Don't need.
-//  py::class_<broker::store::response>(store, "Response")
-//    .def_readwrite("answer", &broker::store::response::answer)
-//    .def_readwrite("id", &broker::store::response::id);
+  py::class_<broker::mailbox>(m, "Mailbox")
+    .def("descriptor", &broker::mailbox::descriptor)
+    .def("empty", &broker::mailbox::empty)
+    .def("size", &broker::mailbox::size);
+
+  py::class_<broker::store::response>(store, "Response")
+    .def_readwrite("answer", &broker::store::response::answer)
+    .def_readwrite("id", &broker::store::response::id);
+
+  // Lookups return a request ID right away. The response becomes available
+  // once the descriptor of the proxy's mailbox signals readability.
+  py::class_<broker::store::proxy>(store, "Proxy")
+    .def(py::init<broker::store&>())
+    .def("exists", &broker::store::proxy::exists)
+    .def("get", &broker::store::proxy::get)
+    .def("put_unique", &broker::store::proxy::put_unique)
+    .def("get_index_from_value", &broker::store::proxy::get_index_from_value)
+    .def("keys", &broker::store::proxy::keys)
+    .def("mailbox", &broker::store::proxy::mailbox)
+    .def("receive", &broker::store::proxy::receive,
+         py::call_guard<py::gil_scoped_release>());
 
 }
 
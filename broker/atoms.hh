@@ -51,7 +51,9 @@ using resume = caf::atom_constant<caf::atom("resume")>;
 /// --- communication with stores ----------------------------------------------
 
 using attach = caf::atom_constant<caf::atom("attach")>;
+using changes = caf::atom_constant<caf::atom("changes")>;
 using clear = caf::atom_constant<caf::atom("clear")>;
+using coalesce = caf::atom_constant<caf::atom("coalesce")>;
 using clone = caf::atom_constant<caf::atom("clone")>;
 using decrement = caf::atom_constant<caf::atom("decrement")>;
 using erase = caf::atom_constant<caf::atom("erase")>;
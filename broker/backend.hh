@@ -5,9 +5,10 @@ namespace broker {
 
 /// Describes the supported data store backend.
 enum backend {
-  memory,   ///< An in-memory backend based on a simple hash table.
-  sqlite,   ///< A SQLite3 backend.
-  rocksdb,  ///< A RocksDB backend.
+  memory,     ///< An in-memory backend based on a simple hash table.
+  sqlite,     ///< A SQLite3 backend.
+  rocksdb,    ///< A RocksDB backend.
+  append_log, ///< An append-only log file with an in-memory index.
 };
 
 } // namespace broker
@@ -1,8 +1,15 @@
 #ifndef BROKER_BRO_HH
 #define BROKER_BRO_HH
 
+#include <string>
+#include <vector>
+
 #include "broker/data.hh"
 
+#include "broker/detail/blob.hh"
+#include "broker/detail/columnar.hh"
+#include "broker/detail/lazy_vector.hh"
+
 namespace broker {
 namespace bro {
 
@@ -18,7 +25,8 @@ public:
     LogWrite = 3,
     IdentifierUpdate = 4,
     Batch = 5,
-    MAX = Batch,
+    LogBatch = 6,
+    MAX = LogBatch,
   };
 
   Type type() const {
@@ -298,6 +306,166 @@ public:
   }
 };
 
+/// A batch of Bro log writes for the same stream and writer in columnar
+/// form. Each column holds the values of one log field across all records,
+/// typed by the schema of the stream, so that the values need no type tags.
+class LogBatch : public Message {
+public:
+  LogBatch(enum_value stream_id, enum_value writer_id, data path,
+           count num_records, vector columns)
+    : Message(Message::Type::LogBatch,
+              {std::move(stream_id), std::move(writer_id), std::move(path),
+               num_records, std::move(columns)}) {
+  }
+
+  LogBatch(data msg) : Message(std::move(msg)) {
+  }
+
+  const enum_value& stream_id() const {
+    return caf::get<enum_value>(caf::get<vector>(msg_[2])[0]);
+  }
+
+  const enum_value& writer_id() const {
+    return caf::get<enum_value>(caf::get<vector>(msg_[2])[1]);
+  }
+
+  const data& path() const {
+    return caf::get<vector>(msg_[2])[2];
+  }
+
+  count num_records() const {
+    return caf::get<count>(caf::get<vector>(msg_[2])[3]);
+  }
+
+  const vector& columns() const {
+    return caf::get<vector>(caf::get<vector>(msg_[2])[4]);
+  }
+
+  /// Decodes the values of the field at position `i` across all records,
+  /// using `nil` for unset fields.
+  /// @returns `false` if the column is malformed.
+  bool column(size_t i, vector& out) const {
+    auto& xs = columns();
+
+    if ( i >= xs.size() )
+      return false;
+
+    auto vp = caf::get_if<vector>(&xs[i]);
+
+    if ( ! vp )
+      return false;
+
+    return detail::column_decode(*vp, num_records(), out);
+  }
+
+  /// Decodes all records in row form.
+  /// @returns `false` if a column is malformed.
+  bool records(std::vector<vector>& out) const {
+    auto n = num_records();
+    out.assign(n, vector(columns().size()));
+    vector values;
+
+    for ( size_t i = 0; i < columns().size(); ++i ) {
+      if ( ! column(i, values) )
+        return false;
+
+      for ( size_t j = 0; j < n; ++j )
+        out[j][i] = std::move(values[j]);
+    }
+
+    return true;
+  }
+
+  bool valid() const {
+    if ( msg_.size() < 3 )
+      return false;
+
+    auto vp = caf::get_if<vector>(&(msg_[2]));
+
+    if ( ! vp )
+      return false;
+
+    auto& v = *vp;
+
+    if ( v.size() < 5 )
+      return false;
+
+    if ( ! caf::get_if<enum_value>(&v[0]) )
+      return false;
+
+    if ( ! caf::get_if<enum_value>(&v[1]) )
+      return false;
+
+    if ( ! caf::get_if<count>(&v[3]) )
+      return false;
+
+    if ( ! caf::get_if<vector>(&v[4]) )
+      return false;
+
+    return true;
+  }
+};
+
+/// Collects Bro log records for one stream and writer into a `LogBatch`.
+/// The schema lists the type of each field as announced by the `LogCreate`
+/// message of the stream.
+class LogBatchBuilder {
+public:
+  LogBatchBuilder(enum_value stream_id, enum_value writer_id, data path,
+                  const std::vector<data::type>& schema)
+    : stream_id_(std::move(stream_id)),
+      writer_id_(std::move(writer_id)),
+      path_(std::move(path)) {
+    for ( auto t : schema )
+      columns_.emplace_back(t);
+  }
+
+  /// Appends a record with one value per field. Unset fields are `nil`.
+  /// @returns `false` if the record does not match the schema, in which
+  ///          case the batch remains unchanged.
+  bool add(const vector& record) {
+    if ( record.size() != columns_.size() )
+      return false;
+
+    for ( size_t i = 0; i < record.size(); ++i ) {
+      auto t = record[i].get_type();
+
+      if ( t != columns_[i].type() && t != data::type::none )
+        return false;
+    }
+
+    for ( size_t i = 0; i < record.size(); ++i )
+      columns_[i].add(record[i]);
+
+    ++num_records_;
+    return true;
+  }
+
+  size_t num_records() const {
+    return num_records_;
+  }
+
+  /// Returns the batch of all records added so far and starts a new one.
+  LogBatch build() {
+    vector columns;
+    columns.reserve(columns_.size());
+
+    for ( auto& x : columns_ )
+      columns.emplace_back(x.finish());
+
+    auto n = num_records_;
+    num_records_ = 0;
+    return LogBatch(stream_id_, writer_id_, path_, n, std::move(columns));
+  }
+
+private:
+  enum_value stream_id_;
+  enum_value writer_id_;
+  data path_;
+  std::vector<detail::column_encoder> columns_;
+  count num_records_ = 0;
+};
+
 class IdentifierUpdate : public Message {
 public:
   IdentifierUpdate(std::string id_name, data id_value)
@@ -345,6 +513,231 @@ public:
   }
 };
 
+
+/// A read-only view on a Bro message in serialized form, as produced by
+/// `detail::to_blob`. Unlike `Message`, a view decodes fields only when
+/// accessing them. The view does not own the buffer, which must outlive it.
+class MessageView {
+public:
+  MessageView(const char* buf, size_t size) : buf_(buf), size_(size) {
+    top_.open(buf, size);
+  }
+
+  explicit MessageView(const std::string& blob)
+    : MessageView(blob.data(), blob.size()) {
+  }
+
+  count version() const {
+    count x = 0;
+    top_.get(0, x);
+    return x;
+  }
+
+  Message::Type type() const {
+    count x;
+
+    if ( ! top_.get(1, x) || x > Message::Type::MAX )
+      return Message::Type::Invalid;
+
+    return Message::Type(x);
+  }
+
+  /// Decodes the entire message.
+  data as_data() const {
+    return detail::from_blob<data>(buf_, size_);
+  }
+
+  const char* buf() const {
+    return buf_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+protected:
+  /// Opens the content of the message, i.e., its third field.
+  bool open_content(detail::lazy_vector& x) const {
+    auto offset = top_.offset(2);
+    return offset != detail::lazy_vector::npos && x.open(buf_, size_, offset);
+  }
+
+  const char* buf_;
+  size_t size_;
+  mutable detail::lazy_vector top_;
+};
+
+/// A view on a serialized Bro event. Dispatching on `name()` leaves the
+/// arguments untouched.
+class EventView : public MessageView {
+public:
+  EventView(const char* buf, size_t size) : MessageView(buf, size) {
+    open_content(content_);
+  }
+
+  explicit EventView(const std::string& blob)
+    : EventView(blob.data(), blob.size()) {
+  }
+
+  explicit EventView(const MessageView& msg)
+    : EventView(msg.buf(), msg.size()) {
+  }
+
+  std::string name() const {
+    std::string x;
+    content_.get(0, x);
+    return x;
+  }
+
+  size_t num_args() const {
+    return arg_vector().size();
+  }
+
+  /// Decodes the argument at position `i`.
+  data arg(size_t i) const {
+    data x;
+    arg_vector().get(i, x);
+    return x;
+  }
+
+  /// Decodes all arguments.
+  vector args() const {
+    vector xs;
+    auto& v = arg_vector();
+    xs.resize(v.size());
+
+    for ( size_t i = 0; i < xs.size(); ++i )
+      v.get(i, xs[i]);
+
+    return xs;
+  }
+
+  Event materialize() const {
+    return Event(as_data());
+  }
+
+  bool valid() const {
+    if ( type() != Message::Type::Event || content_.size() < 2 )
+      return false;
+
+    std::string x;
+
+    if ( ! content_.get(0, x) )
+      return false;
+
+    arg_vector();
+    return args_open_;
+  }
+
+private:
+  const detail::lazy_vector& arg_vector() const {
+    if ( ! args_open_ ) {
+      auto offset = content_.offset(1);
+      args_open_ = offset != detail::lazy_vector::npos
+                   && args_.open(buf_, size_, offset);
+    }
+
+    return args_;
+  }
+
+  mutable detail::lazy_vector content_;
+  mutable detail::lazy_vector args_;
+  mutable bool args_open_ = false;
+};
+
+/// A view on a serialized batch of Bro messages. Reaching the message at
+/// position `i` requires skipping over all messages before it once.
+class BatchView : public MessageView {
+public:
+  BatchView(const char* buf, size_t size) : MessageView(buf, size) {
+    content_open_ = open_content(content_);
+  }
+
+  explicit BatchView(const std::string& blob)
+    : BatchView(blob.data(), blob.size()) {
+  }
+
+  explicit BatchView(const MessageView& msg)
+    : BatchView(msg.buf(), msg.size()) {
+  }
+
+  size_t batch_size() const {
+    return content_.size();
+  }
+
+  /// Returns a view on the message at position `i`.
+  /// @pre `i < batch_size()`
+  MessageView message(size_t i) const {
+    auto offset = content_.offset(i);
+
+    if ( offset == detail::lazy_vector::npos )
+      return MessageView(nullptr, 0);
+
+    return MessageView(buf_ + offset, size_ - offset);
+  }
+
+  bool valid() const {
+    return type() == Message::Type::Batch && content_open_;
+  }
+
+private:
+  mutable detail::lazy_vector content_;
+  bool content_open_;
+};
+
+/// A view on a serialized Bro log-write message.
+class LogWriteView : public MessageView {
+public:
+  LogWriteView(const char* buf, size_t size) : MessageView(buf, size) {
+    open_content(content_);
+  }
+
+  explicit LogWriteView(const std::string& blob)
+    : LogWriteView(blob.data(), blob.size()) {
+  }
+
+  explicit LogWriteView(const MessageView& msg)
+    : LogWriteView(msg.buf(), msg.size()) {
+  }
+
+  enum_value stream_id() const {
+    enum_value x;
+    content_.get(0, x);
+    return x;
+  }
+
+  enum_value writer_id() const {
+    enum_value x;
+    content_.get(1, x);
+    return x;
+  }
+
+  data path() const {
+    data x;
+    content_.get(2, x);
+    return x;
+  }
+
+  data serial_data() const {
+    data x;
+    content_.get(3, x);
+    return x;
+  }
+
+  LogWrite materialize() const {
+    return LogWrite(as_data());
+  }
+
+  bool valid() const {
+    enum_value x;
+    return type() == Message::Type::LogWrite && content_.size() >= 4
+           && content_.get(0, x) && content_.get(1, x);
+  }
+
+private:
+  mutable detail::lazy_vector content_;
+};
+
 } // namespace broker
 } // namespace bro
 
@@ -12,6 +12,7 @@
 #include "broker/publisher.hh"
 #include "broker/status.hh"
 #include "broker/store.hh"
+#include "broker/store_event.hh"
 #include "broker/subnet.hh"
 #include "broker/subscriber.hh"
 #include "broker/time.hh"
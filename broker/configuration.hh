@@ -19,9 +19,26 @@ struct broker_options {
   /// receiver inserts the TTL (not the sender!). The 1st receiver does
   /// already count against the TTL.
   unsigned int ttl = 20;
+  /// If true, endpoints propagate subscriptions hop by hop and forward
+  /// messages only towards subscribers, sending each message at most once
+  /// per peering. Requires `forward` and must be set on all peers alike.
+  bool routing = false;
   /// Whether to use real/wall clock time for data store time-keeping
   /// tasks or whether the application will simulate time on its own.
   bool use_real_time = true;
+  /// Subscribers with the `sample` overflow policy admit every n-th message
+  /// that arrives while their queue is full.
+  size_t subscriber_sample_interval = 10;
+  /// Number of messages a subscriber with the `disconnect` overflow policy
+  /// may drop in a row before the endpoint disconnects it.
+  size_t subscriber_disconnect_lag = 0;
+  /// Share of each round on a congested peering for control messages, i.e.,
+  /// Broker-internal topics and the snapshot handshake of data stores.
+  size_t control_lane_weight = 8;
+  /// Share of each round on a congested peering for data store updates.
+  size_t store_lane_weight = 4;
+  /// Share of each round on a congested peering for all other data.
+  size_t bulk_lane_weight = 1;
 
   broker_options() {}
 };
@@ -23,8 +23,10 @@
 #include "broker/status.hh"
 
 #include "broker/detail/core_policy.hh"
+#include "broker/detail/filter_delta.hh"
 #include "broker/detail/network_cache.hh"
 #include "broker/detail/radix_tree.hh"
+#include "broker/detail/routing_table.hh"
 
 namespace broker {
 
@@ -56,12 +58,38 @@ struct core_state {
 
   // --- filter management -----------------------------------------------------
 
-  /// Sends the current filter to all peers.
-  void update_filter_on_peers();
+  /// Sends a change of our filter to all peers.
+  void update_filter_on_peers(const detail::filter_delta& x);
+
+  /// Sends our full filter to `hdl`.
+  void send_filter(const caf::actor& hdl);
+
+  /// Completes the handshake with `hdl` by announcing the version of our
+  /// filter. Sends the full filter only if it changed after the handshake.
+  void send_filter_version(const caf::actor& hdl);
 
   /// Adds `xs` to our filter and update all peers on changes.
   void add_to_filter(filter_type xs);
 
+  // --- subscription routing --------------------------------------------------
+
+  /// Sends our own subscriptions and all known routes to `hdl`.
+  void send_routes(const caf::actor& hdl);
+
+  /// Sends `x` to all peers.
+  void broadcast(const detail::subscription_announcement& x);
+
+  /// Updates the routing table with an announcement from peer `hdl`.
+  void handle_announcement(const caf::actor& hdl,
+                           detail::subscription_announcement x);
+
+  /// Drops all routes over `hdl` after losing the peer.
+  void remove_routes(const caf::actor& hdl);
+
+  /// Sets the filter of each peer whose routes changed to the subscriptions
+  /// routed over it.
+  void update_routed_filters();
+
   // --- convenience functions for querying state ------------------------------
 
   /// Returns whether `x` is either a pending peer or a connected peer.
@@ -135,8 +163,18 @@ struct core_state {
     emit_status<StatusCode>(caf::actor_cast<caf::actor>(std::move(hdl)), msg);
   }
 
+  /// Unblocks `new_peer` after all status subscribers have received its
+  /// `peer_added` status. Batches peerings that complete at the same time
+  /// into rounds that send one `sync_point` request per status subscriber.
   void sync_with_status_subscribers(caf::actor new_peer);
 
+  /// Synchronizes all peers in `peers_awaiting_status_sync` with the status
+  /// subscribers.
+  void start_status_sync_round();
+
+  /// Unblocks all `peers` after their round completed.
+  void finish_status_sync_round(const std::vector<caf::actor>& peers);
+
   // --- member variables ------------------------------------------------------
 
   /// A copy of the current Broker configuration options.
@@ -148,9 +186,26 @@ struct core_state {
   /// Stores all clone actors created by this core.
   std::unordered_multimap<std::string, caf::actor> clones;
 
-  /// Requested topics on this core.
+  /// Requested topics on this core, sorted and without redundant entries.
   filter_type filter;
 
+  /// Version of `filter`. Increases with each change.
+  uint64_t filter_version = 0;
+
+  /// Version of `filter` at the time we sent it to a pending peer as part of
+  /// the handshake.
+  std::unordered_map<caf::actor, uint64_t> handshake_filter_versions;
+
+  /// Routes to subscribers on remote endpoints if `options.routing` is set.
+  detail::routing_table<caf::actor> routes;
+
+  /// Drops messages that reach this core on more than one path if
+  /// `options.routing` is set.
+  detail::duplicate_filter duplicates;
+
+  /// Sequence number of the last message published by this core.
+  uint64_t last_seq = 0;
+
   /// Multiplexes local streams and streams for peers.
   governor_ptr governor;
 
@@ -183,7 +238,10 @@ struct core_state {
   endpoint::clock* clock;
 
   std::unordered_set<caf::actor> status_subscribers;
-  std::unordered_map<caf::actor, size_t> peers_awaiting_status_sync;
+
+  /// Blocked peers that wait for the next round of synchronizing with all
+  /// status subscribers.
+  std::vector<caf::actor> peers_awaiting_status_sync;
 };
 
 caf::behavior core_actor(caf::stateful_actor<core_state>* self,
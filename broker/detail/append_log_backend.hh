@@ -0,0 +1,74 @@
+#ifndef BROKER_DETAIL_APPEND_LOG_BACKEND_HH
+#define BROKER_DETAIL_APPEND_LOG_BACKEND_HH
+
+#include <memory>
+
+#include "broker/backend_options.hh"
+
+#include "broker/detail/abstract_backend.hh"
+
+namespace broker {
+namespace detail {
+
+/// A storage backend that appends every modification to a log file and keeps
+/// an in-memory index from keys to file offsets. Writes reach the disk in
+/// groups, and a background thread compacts the log once it consists mostly of
+/// overwritten or erased entries.
+class append_log_backend : public abstract_backend {
+public:
+  /// Constructs an append-only log backend.
+  /// @param opts The options to create/open a database.
+  ///
+  /// Required:
+  ///   - `path`: a `std::string` representing the directory that holds the
+  ///             log file and its index checkpoint.
+  ///
+  /// Optional:
+  ///   - `sync-interval`: a `timespan` denoting how often the log gets flushed
+  ///                      to disk. A zero interval flushes on every write.
+  ///                      (default = 50ms)
+  ///   - `buffer-size`: a `count` with the number of bytes to buffer before
+  ///                    writing to the log file. (default = 64 KiB)
+  ///   - `compaction-ratio`: a `real` with the fraction of stale bytes in the
+  ///                         log that triggers a compaction. (default = 0.5)
+  ///   - `compaction-min-size`: a `count` with the minimum size of the log in
+  ///                            bytes before compacting. (default = 16 MiB)
+  append_log_backend(backend_options opts = backend_options{});
+
+  ~append_log_backend();
+
+  expected<void> put(const data& key, data value,
+                     optional<timestamp> expiry) override;
+
+  expected<void> erase(const data& key) override;
+
+  expected<void> clear() override;
+
+  expected<bool> expire(const data& key, timestamp current_time) override;
+
+  expected<data> get(const data& key) const override;
+
+  expected<bool> exists(const data& key) const override;
+
+  expected<uint64_t> size() const override;
+
+  expected<data> keys() const override;
+
+  expected<broker::snapshot> snapshot() const override;
+
+  expected<expirables> expiries() const override;
+
+  /// Rewrites the log to contain only live entries, regardless of the
+  /// configured compaction thresholds.
+  /// @returns `false` if the compaction failed, `true` otherwise.
+  bool compact();
+
+private:
+  struct impl;
+  std::unique_ptr<impl> impl_;
+};
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_APPEND_LOG_BACKEND_HH
@@ -27,11 +27,19 @@ public:
 
   /// Initializes the object.
   void init(caf::event_based_actor* ptr, std::string&& nm,
-            caf::actor&& parent, endpoint::clock* ep_clock);
+            caf::actor&& parent, endpoint::clock* ep_clock,
+            double write_coalesce_interval, size_t write_coalesce_size);
 
   /// Sends `x` to the master.
   void forward(internal_command&& x);
 
+  /// Holds back `x` for at most `write_coalesce_interval`, merging it with
+  /// the pending command for the same key if possible.
+  void coalesce(internal_command&& x);
+
+  /// Sends all pending local mutations to the master in one batch.
+  void flush();
+
   /// Wraps `x` into a `data` object and forwards it to the master.
   template <class T>
   void forward_from(T& x) {
@@ -60,6 +68,8 @@ public:
 
   void operator()(clear_command&);
 
+  void operator()(batch_command&);
+
   data keys() const;
 
   caf::event_based_actor* self;
@@ -89,12 +99,38 @@ public:
   bool awaiting_snapshot_sync;
 
   endpoint::clock* clock;
+
+  /// Local subscribers for change events, which the clone passes on to each
+  /// master it resolves.
+  std::unordered_map<caf::actor_addr, caf::actor> change_subscribers;
+
+  /// Maximum time (seconds) that local mutations wait in
+  /// `coalesce_buffer`. A zero value forwards each mutation right away.
+  double write_coalesce_interval;
+
+  /// Number of pending local mutations that triggers an early flush.
+  size_t write_coalesce_size;
+
+  /// Local mutations waiting for the next flush, in order of arrival.
+  std::vector<internal_command> coalesce_buffer;
+
+  /// Time of the latest change to each entry of `coalesce_buffer`. Relative
+  /// expiries get shortened by the time spent waiting for the flush.
+  std::vector<timestamp> coalesce_times;
+
+  /// Maps keys to the position of their latest command in `coalesce_buffer`.
+  std::unordered_map<data, size_t> coalesce_index;
+
+  /// Stores whether a flush of `coalesce_buffer` is scheduled.
+  bool flush_scheduled;
 };
 
 caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
                           caf::actor core, std::string name,
                           double resync_interval, double stale_interval,
                           double mutation_buffer_interval,
+                          double write_coalesce_interval,
+                          size_t write_coalesce_size,
                           endpoint::clock* ep_clock);
 
 } // namespace detail
@@ -0,0 +1,65 @@
+#ifndef BROKER_DETAIL_COLUMNAR_HH
+#define BROKER_DETAIL_COLUMNAR_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "broker/data.hh"
+
+namespace broker {
+namespace detail {
+
+/// Encodes the values of one column in a columnar log batch. All values share
+/// the type of the column, hence the encoder packs them into a single string
+/// without type tags. Counts, integers, and durations use variable-length
+/// integers, and timestamps store the difference to their predecessor. Values
+/// of container types and `none` keep their regular representation.
+///
+/// An encoded column is a `vector` with three elements: the type of the
+/// column as `count`, a bitmap with one bit per row that marks present values
+/// (empty if all rows have a value), and the values themselves.
+class column_encoder {
+public:
+  explicit column_encoder(data::type type);
+
+  /// Returns the type of the column.
+  data::type type() const {
+    return type_;
+  }
+
+  /// Returns the number of rows in the column.
+  size_t rows() const {
+    return rows_;
+  }
+
+  /// Appends `x` to the column. Accepts `nil` for unset fields.
+  /// @returns `false` if `x` has neither the type of the column nor is `nil`.
+  bool add(const data& x);
+
+  /// Returns the encoded column and resets the encoder.
+  vector finish();
+
+private:
+  data::type type_;
+  size_t rows_;
+  size_t missing_;
+  std::string present_;
+  std::string values_;
+  vector fallback_;
+  int64_t last_;
+};
+
+/// Returns whether a `column_encoder` packs values of type `t` without type
+/// tags.
+bool is_packed_column_type(data::type t);
+
+/// Decodes the column `x` with `rows` entries into `out`, using `nil` for
+/// unset fields.
+/// @returns `false` if `x` is malformed.
+bool column_decode(const vector& x, size_t rows, vector& out);
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_COLUMNAR_HH
@@ -0,0 +1,99 @@
+#ifndef BROKER_DETAIL_CONTAINER_ELEMENTS_HH
+#define BROKER_DETAIL_CONTAINER_ELEMENTS_HH
+
+#include <cstdint>
+#include <string>
+
+#include <caf/stream_deserializer.hpp>
+#include <caf/streambuf.hpp>
+
+#include "broker/data.hh"
+#include "broker/error.hh"
+#include "broker/expected.hh"
+
+#include "broker/detail/blob.hh"
+
+// Helpers for persistent backends that store the members of sets, tables, and
+// vectors individually instead of serializing the whole container into a
+// single value. The value under the key of such a container is a small header
+// with the container type and its number of elements. Each element lives
+// under a separate *member* key:
+//
+//   - sets: the serialized element (no value)
+//   - tables: the serialized index, mapping to the serialized value
+//   - vectors: the position as 8-byte big-endian integer, mapping to the
+//              serialized element, so that members sort by position
+
+namespace broker {
+namespace detail {
+
+/// Marks container headers. Serialized `data` never starts with this byte,
+/// because it begins with the type index of the variant.
+constexpr char container_header_tag = '\xff';
+
+/// Describes a container whose elements are stored individually.
+struct container_header {
+  data::type type;
+  count size;
+};
+
+/// Checks whether a backend stores values of type `t` element-wise.
+inline bool stores_elements(data::type t) {
+  return t == data::type::set || t == data::type::table
+         || t == data::type::vector;
+}
+
+/// Checks whether `buf` holds a container header.
+inline bool is_container_header(const char* buf, size_t size) {
+  return size > 0 && buf[0] == container_header_tag;
+}
+
+inline bool is_container_header(const std::string& buf) {
+  return is_container_header(buf.data(), buf.size());
+}
+
+inline std::string to_header_blob(const container_header& x) {
+  auto type = static_cast<uint8_t>(x.type);
+  return container_header_tag + to_blob(type, x.size);
+}
+
+/// @pre `is_container_header(buf, size)`
+inline container_header container_header_from_blob(const char* buf,
+                                                    size_t size) {
+  caf::arraybuf<char> sb{const_cast<char*>(buf) + 1, size - 1};
+  caf::stream_deserializer<caf::arraybuf<char>&> source{sb};
+  uint8_t type;
+  container_header result;
+  source(type, result.size);
+  result.type = static_cast<data::type>(type);
+  return result;
+}
+
+inline container_header container_header_from_blob(const std::string& buf) {
+  return container_header_from_blob(buf.data(), buf.size());
+}
+
+/// Returns the member key for the element at `pos` of a vector.
+inline std::string position_blob(count pos) {
+  std::string result(sizeof(count), '\0');
+  for (auto i = result.size(); i > 0; --i) {
+    result[i - 1] = static_cast<char>(pos & 0xFF);
+    pos >>= 8;
+  }
+  return result;
+}
+
+/// Converts the aspect of a vector lookup into a position.
+inline expected<count> to_position(const data& aspect) {
+  if (auto x = caf::get_if<count>(&aspect))
+    return *x;
+  auto y = caf::get_if<integer>(&aspect);
+  if (!y || *y < 0)
+    return ec::type_clash;
+  return static_cast<count>(*y);
+}
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_CONTAINER_ELEMENTS_HH
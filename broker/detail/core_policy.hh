@@ -22,6 +22,10 @@
 #include "broker/peer_filter.hh"
 #include "broker/topic.hh"
 
+#include "broker/detail/filter_delta.hh"
+#include "broker/detail/lane_downstream_manager.hh"
+#include "broker/detail/routing_table.hh"
+
 namespace broker {
 
 struct core_state;
@@ -66,9 +70,31 @@ public:
     /// Type of a full batch in the stream.
     using batch = std::vector<element>;
 
-    /// Type of the downstream_manager that broadcasts data to local actors.
-    using manager = caf::broadcast_downstream_manager<element, peer_filter,
-                                                      peer_filter_matcher>;
+    /// Assigns messages for peers to lanes. Snapshot commands that attach and
+    /// synchronize clones go to the control lane, all other store commands
+    /// go to the store lane. Data on Broker-internal topics, i.e., topics
+    /// starting with the reserved string and the master and clone topics of
+    /// stores, goes to the control lane as well. Everything else goes to the
+    /// bulk lane, including change events of stores.
+    struct classifier {
+      static constexpr size_t control_lane = 0;
+
+      static constexpr size_t store_lane = 1;
+
+      static constexpr size_t bulk_lane = 2;
+
+      static constexpr size_t lanes = 3;
+
+      /// Returns the default share of each round a lane gets on a congested
+      /// path. The core applies the weights from its `broker_options`.
+      static size_t weight(size_t lane);
+
+      size_t operator()(const element& x) const;
+    };
+
+    /// Type of the downstream_manager that broadcasts data to peers.
+    using manager = lane_downstream_manager<element, peer_filter,
+                                            peer_filter_matcher, classifier>;
   };
 
   /// Maps actor handles to path IDs.
@@ -209,6 +235,23 @@ public:
   /// Updates the filter of an existing peer.
   bool update_peer(const caf::actor& hdl, filter_type filter);
 
+  /// Applies a change to the filter of an existing peer.
+  /// @returns `false` if we lack a baseline for `x`, i.e., if we need a new
+  ///          snapshot from `hdl`. This happens if `x` does not directly
+  ///          follow the last version we have seen or if we have not seen any
+  ///          version yet. For a known peer, returns `false` only once until
+  ///          the next snapshot arrives.
+  bool update_peer(const caf::actor& hdl, filter_delta x);
+
+  /// Sets the version of the filter we received from `hdl` during the
+  /// handshake. Also marks `hdl` as a peer that understands filter deltas.
+  /// @returns `false` if `hdl` is an unknown peer, `true` otherwise.
+  bool update_peer(const caf::actor& hdl, uint64_t version);
+
+  /// Queries whether `hdl` announced a filter version, i.e., whether it
+  /// understands filter deltas. Older peers only receive full filters.
+  bool accepts_filter_deltas(const caf::actor& hdl) const;
+
   // -- management of worker and storage streams -------------------------------
 
   /// Adds the sender of the current message as worker by starting an output
@@ -295,6 +338,14 @@ public:
   }
 
 private:
+  /// Creates a message for peers, stamping it with origin and sequence number
+  /// if routing is enabled.
+  template <class T>
+  caf::message make_peer_message(topic x, T y);
+
+  /// Checks whether a message from a peer arrived already on another path.
+  bool is_duplicate(const caf::message& msg);
+
   /// Adds entries to `peer_to_ipath_` and `ipath_to_peer_`.
   void add_ipath(caf::stream_slot slot, const caf::actor& peer_hdl);
 
@@ -337,6 +388,16 @@ private:
 
   /// Messages that are currently buffered.
   std::unordered_map<caf::actor, std::vector<caf::message>> blocked_msgs;
+
+  /// Last filter version we have seen per peer. Missing entries belong to
+  /// peers that did not send us a snapshot yet.
+  std::unordered_map<caf::actor, uint64_t> filter_versions_;
+
+  /// Peers that we have asked for a new snapshot of their filter.
+  std::unordered_set<caf::actor> snapshot_requests_;
+
+  /// Peers that understand filter deltas.
+  std::unordered_set<caf::actor> delta_peers_;
 };
 
 } // namespace detail
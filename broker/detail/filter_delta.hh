@@ -0,0 +1,123 @@
+#ifndef BROKER_DETAIL_FILTER_DELTA_HH
+#define BROKER_DETAIL_FILTER_DELTA_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <caf/meta/type_name.hpp>
+
+#include "broker/filter_type.hh"
+#include "broker/topic.hh"
+
+namespace broker {
+namespace detail {
+
+/// A change to the subscriptions of an endpoint. Peers apply deltas in order
+/// and request a snapshot whenever they detect a gap in the versions.
+struct filter_delta {
+  /// Version of the filter after applying this delta. Starts at 0 for the
+  /// initial filter and increases by one with each change.
+  uint64_t version;
+
+  /// Signals that `added` contains the full filter.
+  bool snapshot;
+
+  /// Topics that became part of the filter.
+  filter_type added;
+
+  /// Topics that are no longer part of the filter.
+  filter_type removed;
+};
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f, filter_delta& x) {
+  return f(caf::meta::type_name("filter_delta"), x.version, x.snapshot,
+           x.added, x.removed);
+}
+
+/// Returns whether `x` makes `y` redundant in a filter, i.e., whether `x` is
+/// a prefix of `y`. Topics in the reserved namespace never become redundant,
+/// since the core looks them up by their exact name.
+inline bool subsumes(const topic& x, const topic& y) {
+  return x.prefix_of(y) && y.string().find(topic::reserved) == std::string::npos;
+}
+
+/// Adds `xs` to the sorted filter `f`. Skips topics that an existing entry
+/// already covers and drops entries that a new topic covers.
+/// @param added Receives all topics that became part of `f`.
+/// @param removed Receives all topics that are no longer part of `f`.
+/// @returns `true` if `f` changed, `false` otherwise.
+inline bool filter_extend(filter_type& f, filter_type xs, filter_type& added,
+                          filter_type& removed) {
+  struct string_less {
+    bool operator()(const topic& x, const std::string& y) const {
+      return x.string() < y;
+    }
+    bool operator()(const std::string& x, const topic& y) const {
+      return x < y.string();
+    }
+  };
+  auto covered = [&](const topic& x) -> bool {
+    // All entries that subsume `x` are prefixes of its string.
+    auto& str = x.string();
+    if (str.find(topic::reserved) != std::string::npos)
+      return std::binary_search(f.begin(), f.end(), x);
+    for (size_t n = 0; n <= str.size(); ++n)
+      if (std::binary_search(f.begin(), f.end(), str.substr(0, n),
+                             string_less{}))
+        return true;
+    return false;
+  };
+  // Sorting puts each prefix before the topics it covers.
+  std::sort(xs.begin(), xs.end());
+  xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+  auto changed = false;
+  for (auto& x : xs) {
+    if (covered(x))
+      continue;
+    // All entries that `x` subsumes follow `x` directly in sort order.
+    auto first = std::lower_bound(f.begin(), f.end(), x);
+    auto last = first;
+    while (last != f.end() && x.prefix_of(*last))
+      ++last;
+    auto keep = std::stable_partition(first, last, [&](const topic& y) {
+      return !subsumes(x, y);
+    });
+    for (auto i = keep; i != last; ++i) {
+      auto j = std::find(added.begin(), added.end(), *i);
+      if (j != added.end())
+        added.erase(j);
+      else
+        removed.emplace_back(std::move(*i));
+    }
+    f.erase(keep, last);
+    f.insert(std::lower_bound(f.begin(), f.end(), x), x);
+    added.emplace_back(std::move(x));
+    changed = true;
+  }
+  return changed;
+}
+
+/// Applies the delta `x` to the filter `f`.
+inline void filter_apply(filter_type& f, filter_delta x) {
+  if (x.snapshot)
+    f.clear();
+  else if (!std::is_sorted(f.begin(), f.end()))
+    std::sort(f.begin(), f.end());
+  for (auto& y : x.removed) {
+    auto i = std::lower_bound(f.begin(), f.end(), y);
+    if (i != f.end() && *i == y)
+      f.erase(i);
+  }
+  filter_type added;
+  filter_type removed;
+  filter_extend(f, std::move(x.added), added, removed);
+}
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_FILTER_DELTA_HH
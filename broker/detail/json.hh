@@ -0,0 +1,47 @@
+#ifndef BROKER_DETAIL_JSON_HH
+#define BROKER_DETAIL_JSON_HH
+
+#include <string>
+
+#include "broker/data.hh"
+
+namespace broker {
+namespace detail {
+
+/// Appends the JSON representation of `x` to `out`. Each value becomes an
+/// object that names its type, e.g., `{"@data-type":"count","data":42}`.
+/// Addresses, subnets, ports, and enum values map to their string form,
+/// timestamps and timespans to nanoseconds, and tables to arrays of objects
+/// with the fields `key` and `value`. Non-finite reals map to the strings
+/// `nan`, `inf`, and `-inf`.
+void json_encode(std::string& out, const data& x);
+
+/// Parses a JSON value in the format produced by `json_encode` from the range
+/// `[first, last)`. Advances `first` past the value on success.
+/// @returns `false` if the range does not start with a valid value.
+bool json_decode(const char*& first, const char* last, data& x);
+
+/// Appends `str` as quoted JSON string to `out`.
+void json_encode_string(std::string& out, const std::string& str);
+
+/// Parses a quoted JSON string from the range `[first, last)`. Advances
+/// `first` past the closing quote on success.
+/// @returns `false` if the range does not start with a valid string.
+bool json_decode_string(const char*& first, const char* last,
+                        std::string& str);
+
+/// Skips a JSON value of any kind in the range `[first, last)`.
+/// @returns `false` if the range does not start with a valid value.
+bool json_skip(const char*& first, const char* last);
+
+/// Skips whitespace and then consumes `c`.
+/// @returns `false` if the next non-whitespace character is not `c`.
+bool json_consume(const char*& first, const char* last, char c);
+
+/// Skips whitespace.
+void json_skip_whitespace(const char*& first, const char* last);
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_JSON_HH
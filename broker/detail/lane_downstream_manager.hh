@@ -0,0 +1,172 @@
+#ifndef BROKER_DETAIL_LANE_DOWNSTREAM_MANAGER_HH
+#define BROKER_DETAIL_LANE_DOWNSTREAM_MANAGER_HH
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <caf/broadcast_downstream_manager.hpp>
+#include <caf/outbound_path.hpp>
+#include <caf/stream_manager.hpp>
+
+#include "broker/detail/weighted_interleave.hh"
+
+namespace broker {
+namespace detail {
+
+/// A broadcast downstream manager that splits the traffic on each path into
+/// logical lanes. As long as a path has the credit for all of its buffered
+/// elements, the manager sends them in arrival order. Otherwise, it moves new
+/// elements into one queue per lane and fills the next batches by weighted
+/// round-robin over the queues. This keeps the latency of low-volume lanes
+/// bounded while a high-volume lane saturates the path.
+/// @tparam Classifier Provides `lanes`, the number of lanes, a static member
+///                    function `weight(size_t lane)`, and maps elements to
+///                    lanes via its call operator.
+template <class T, class Filter, class Select, class Classifier>
+class lane_downstream_manager
+  : public caf::broadcast_downstream_manager<T, Filter, Select> {
+public:
+  // -- member types -----------------------------------------------------------
+
+  using super = caf::broadcast_downstream_manager<T, Filter, Select>;
+
+  using weights_type = std::array<size_t, Classifier::lanes>;
+
+  // -- constructors, destructors, and assignment operators --------------------
+
+  lane_downstream_manager(caf::stream_manager* parent) : super(parent) {
+    for (size_t i = 0; i < Classifier::lanes; ++i)
+      weights_[i] = Classifier::weight(i);
+  }
+
+  // -- properties -------------------------------------------------------------
+
+  /// Returns the scheduling weight per lane.
+  const weights_type& weights() const noexcept {
+    return weights_;
+  }
+
+  /// Sets the scheduling weight per lane.
+  void weights(weights_type xs) {
+    weights_ = xs;
+  }
+
+  // -- overridden member functions --------------------------------------------
+
+  bool clean() const noexcept override {
+    return super::clean() && queued() == 0;
+  }
+
+  bool clean(caf::stream_slot slot) const noexcept override {
+    return super::clean(slot) && queued(slot) == 0;
+  }
+
+  size_t buffered() const noexcept override {
+    size_t max_path_buf = 0;
+    for (auto& kvp : this->states())
+      max_path_buf = std::max(max_path_buf,
+                              kvp.second.buf.size() + queued(kvp.first));
+    return this->buf_.size() + max_path_buf;
+  }
+
+  size_t buffered(caf::stream_slot slot) const noexcept override {
+    return super::buffered(slot) + queued(slot);
+  }
+
+  void emit_batches() override {
+    emit_batches_impl(false);
+  }
+
+  void force_emit_batches() override {
+    emit_batches_impl(true);
+  }
+
+protected:
+  void about_to_erase(caf::outbound_path* ptr, bool silent,
+                      caf::error* reason) override {
+    lanes_.erase(ptr->slots.sender);
+    super::about_to_erase(ptr, silent, reason);
+  }
+
+private:
+  /// Per-path queues for elements that did not fit into the credit.
+  struct lane_state {
+    std::array<std::deque<T>, Classifier::lanes> queues;
+
+    /// Number of elements in all queues.
+    size_t size = 0;
+
+    /// Number of elements at the front of the path buffer that left the
+    /// queues already, i.e., whatever `emit_batches` left behind.
+    size_t scheduled = 0;
+  };
+
+  size_t queued() const noexcept {
+    size_t result = 0;
+    for (auto& kvp : lanes_)
+      result = std::max(result, kvp.second.size);
+    return result;
+  }
+
+  size_t queued(caf::stream_slot slot) const noexcept {
+    auto i = lanes_.find(slot);
+    return i != lanes_.end() ? i->second.size : 0;
+  }
+
+  // Moves all elements that arrived since the last call from `buf` to their
+  // lanes and then refills `buf` from the lanes up to `credit`. Only visits
+  // new elements and the ones that fit into the credit.
+  void schedule(lane_state& st, std::vector<T>& buf, size_t credit) {
+    st.scheduled = std::min(st.scheduled, buf.size());
+    // Arrival order is as good as any as long as everything fits.
+    if (st.size == 0 && buf.size() <= credit)
+      return;
+    auto first = buf.begin() + static_cast<std::ptrdiff_t>(st.scheduled);
+    for (auto i = first; i != buf.end(); ++i)
+      st.queues[classify_(*i)].emplace_back(std::move(*i));
+    st.size += static_cast<size_t>(buf.end() - first);
+    buf.erase(first, buf.end());
+    if (buf.size() < credit)
+      st.size -= weighted_interleave(st.queues, weights_,
+                                     credit - buf.size(), buf);
+  }
+
+  void emit_batches_impl(bool force_underfull) {
+    if (this->paths_.empty())
+      return;
+    this->fan_out_flush();
+    auto& states = this->states();
+    for (auto& kvp : this->paths_) {
+      auto& path = kvp.second;
+      // Don't push new data into a closing path.
+      if (path->closing)
+        continue;
+      auto i = states.find(kvp.first);
+      if (i == states.end())
+        continue;
+      auto& buf = i->second.buf;
+      auto& st = lanes_[kvp.first];
+      auto credit = path->open_credit > 0
+                      ? static_cast<size_t>(path->open_credit)
+                      : size_t{0};
+      schedule(st, buf, credit);
+      path->emit_batches(this->self(), buf, force_underfull);
+      st.scheduled = buf.size();
+    }
+  }
+
+  weights_type weights_;
+
+  Classifier classify_;
+
+  std::map<caf::stream_slot, lane_state> lanes_;
+};
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_LANE_DOWNSTREAM_MANAGER_HH
@@ -0,0 +1,189 @@
+#ifndef BROKER_DETAIL_LAZY_VECTOR_HH
+#define BROKER_DETAIL_LAZY_VECTOR_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <caf/stream_deserializer.hpp>
+#include <caf/detail/type_list.hpp>
+
+#include "broker/data.hh"
+
+namespace broker {
+namespace detail {
+
+/// Provides access to the elements of a `vector` in a blob produced by
+/// `to_blob` without deserializing the whole vector. Skipping an element only
+/// walks its tags and sizes, and the lazy vector remembers the offset of each
+/// element it has seen, so that it skips over each element at most once. The
+/// lazy vector does not own the buffer.
+class lazy_vector {
+public:
+  /// Signals an unknown or invalid position.
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+  lazy_vector() : buf_(nullptr), size_(0), elements_(0) {
+    // nop
+  }
+
+  /// Opens the vector starting at `offset` in `buf`.
+  /// @returns `false` if `buf` holds no vector at `offset`.
+  bool open(const char* buf, size_t size, size_t offset = 0) {
+    buf_ = buf;
+    size_ = size;
+    elements_ = 0;
+    offsets_.clear();
+    if (offset >= size)
+      return false;
+    caf::arraybuf<char> sb{const_cast<char*>(buf) + offset, size - offset};
+    caf::stream_deserializer<caf::arraybuf<char>&> source{sb};
+    uint8_t tag;
+    size_t n;
+    if (source(tag) || tag != tag_of<vector>() || source.begin_sequence(n))
+      return false;
+    elements_ = n;
+    offsets_.push_back(position(sb));
+    return true;
+  }
+
+  /// Returns the number of elements in the vector.
+  size_t size() const {
+    return elements_;
+  }
+
+  /// Returns the offset of the `i`-th element or `npos` if `i` is out of
+  /// range or the buffer is malformed.
+  size_t offset(size_t i) {
+    if (i >= elements_)
+      return npos;
+    if (offsets_.size() <= i) {
+      auto first = offsets_.back();
+      caf::arraybuf<char> sb{const_cast<char*>(buf_) + first, size_ - first};
+      caf::stream_deserializer<caf::arraybuf<char>&> source{sb};
+      while (offsets_.size() <= i) {
+        if (!skip(source, sb))
+          return npos;
+        offsets_.push_back(position(sb));
+      }
+    }
+    return offsets_[i];
+  }
+
+  /// Deserializes the `i`-th element into `x`.
+  /// @returns `false` if `i` is out of range or the buffer is malformed.
+  bool get(size_t i, data& x) {
+    auto first = offset(i);
+    if (first == npos)
+      return false;
+    caf::arraybuf<char> sb{const_cast<char*>(buf_) + first, size_ - first};
+    caf::stream_deserializer<caf::arraybuf<char>&> source{sb};
+    return !source(x);
+  }
+
+  /// Deserializes the `i`-th element into `x` without going through `data`.
+  /// @returns `false` if `i` is out of range, the element does not hold a `T`,
+  ///          or the buffer is malformed.
+  template <class T>
+  bool get(size_t i, T& x) {
+    auto first = offset(i);
+    if (first == npos)
+      return false;
+    caf::arraybuf<char> sb{const_cast<char*>(buf_) + first, size_ - first};
+    caf::stream_deserializer<caf::arraybuf<char>&> source{sb};
+    uint8_t tag;
+    return !source(tag) && tag == tag_of<T>() && !source(x);
+  }
+
+private:
+  using source_type = caf::stream_deserializer<caf::arraybuf<char>&>;
+
+  template <class T>
+  static constexpr uint8_t tag_of() {
+    return static_cast<uint8_t>(caf::detail::tl_index_of<data::types, T>::value);
+  }
+
+  // Reads a fixed-size value into a local, which never allocates.
+  template <class T>
+  static bool skip_value(source_type& source) {
+    T x;
+    return !source(x);
+  }
+
+  // Moves past the characters of a string without copying them.
+  static bool skip_string(source_type& source, caf::arraybuf<char>& sb) {
+    size_t n;
+    if (source.begin_sequence(n)
+        || n > static_cast<size_t>(sb.in_avail()))
+      return false;
+    auto off = static_cast<std::streamoff>(n);
+    if (sb.pubseekoff(off, std::ios_base::cur, std::ios_base::in)
+        == std::streampos(std::streamoff(-1)))
+      return false;
+    return !source.end_sequence();
+  }
+
+  // Moves past one serialized `data` by walking its tags and sizes.
+  static bool skip(source_type& source, caf::arraybuf<char>& sb) {
+    uint8_t tag;
+    if (source(tag))
+      return false;
+    switch (tag) {
+      default:
+        return false;
+      case tag_of<none>():
+        return true;
+      case tag_of<boolean>():
+        return skip_value<boolean>(source);
+      case tag_of<count>():
+        return skip_value<count>(source);
+      case tag_of<integer>():
+        return skip_value<integer>(source);
+      case tag_of<real>():
+        return skip_value<real>(source);
+      case tag_of<address>():
+        return skip_value<address>(source);
+      case tag_of<subnet>():
+        return skip_value<subnet>(source);
+      case tag_of<port>():
+        return skip_value<port>(source);
+      case tag_of<timestamp>():
+        return skip_value<timestamp>(source);
+      case tag_of<timespan>():
+        return skip_value<timespan>(source);
+      case tag_of<std::string>():
+      case tag_of<enum_value>():
+        // An enum value consists of its name only.
+        return skip_string(source, sb);
+      case tag_of<set>():
+      case tag_of<vector>():
+      case tag_of<table>(): {
+        size_t n;
+        if (source.begin_sequence(n))
+          return false;
+        auto per_element = tag == tag_of<table>() ? 2u : 1u;
+        for (size_t i = 0; i < n * per_element; ++i)
+          if (!skip(source, sb))
+            return false;
+        return !source.end_sequence();
+      }
+    }
+  }
+
+  size_t position(caf::arraybuf<char>& sb) const {
+    return size_ - static_cast<size_t>(sb.in_avail());
+  }
+
+  const char* buf_;
+  size_t size_;
+  size_t elements_;
+  std::vector<size_t> offsets_;
+};
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_LAZY_VECTOR_HH
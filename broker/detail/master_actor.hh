@@ -1,6 +1,8 @@
 #ifndef BROKER_DETAIL_MASTER_ACTOR_HH
 #define BROKER_DETAIL_MASTER_ACTOR_HH
 
+#include <cstdint>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <caf/actor.hpp>
@@ -11,6 +13,7 @@
 #include "broker/data.hh"
 #include "broker/fwd.hh"
 #include "broker/internal_command.hh"
+#include "broker/store_event.hh"
 #include "broker/topic.hh"
 #include "broker/endpoint.hh"
 
@@ -30,19 +33,46 @@ public:
   /// Creates an uninitialized object.
   master_state();
 
+  /// A command that waits in the coalescing window.
+  struct pending_update {
+    /// The latest command for the key.
+    internal_command cmd;
+
+    /// Number of commands for the key since the last flush.
+    size_t merged;
+  };
+
   /// Initializes the object.
   void init(caf::event_based_actor* ptr, std::string&& nm,
-            backend_pointer&& bp, caf::actor&& parent, endpoint::clock* clock);
+            backend_pointer&& bp, caf::actor&& parent, endpoint::clock* clock,
+            timespan coalesce_window);
 
   /// Sends `x` to all clones.
   void broadcast(internal_command&& x);
 
   template <class T>
   void broadcast_cmd_to_clones(T cmd) {
-    if (!clones.empty())
+    if (clones.empty())
+      return;
+    if (coalesce_window > timespan{0})
+      coalesce(internal_command{std::move(cmd)});
+    else
       broadcast(internal_command{std::move(cmd)});
   }
 
+  /// Holds back `x` until the end of the coalescing window, merging it with
+  /// earlier commands for the same key.
+  void coalesce(internal_command&& x);
+
+  /// Sends all commands from the coalescing window to the clones.
+  void flush();
+
+  /// Publishes a change event for `key` if a subscriber enabled them.
+  void publish_change(store_event::type kind, const data& key, data value);
+
+  /// Publishes the current value of `key` as change event.
+  void publish_change(store_event::type kind, const data& key);
+
   void remind(timespan expiry, const data& key);
 
   void expire(data& key);
@@ -69,12 +99,28 @@ public:
 
   void operator()(clear_command&);
 
+  void operator()(batch_command&);
+
   caf::event_based_actor* self;
 
   std::string id;
 
   topic clones_topic;
 
+  /// Prefix for the topics of change events, followed by the key.
+  topic changes_topic;
+
+  /// Stores whether `change_subscribers` is non-empty.
+  bool publish_changes;
+
+  /// Subscribers for change events. The master stops publishing change
+  /// events once the last one goes down.
+  std::unordered_set<caf::actor_addr> change_subscribers;
+
+  /// Stores whether `clear` publishes a change event. Only one shard of a
+  /// partitioned master announces a clear.
+  bool announce_clear;
+
   backend_pointer backend;
 
   caf::actor core;
@@ -83,13 +129,43 @@ public:
 
   endpoint::clock* clock;
 
+  /// Maximum time a command waits for further commands on the same key
+  /// before going out to the clones. Zero disables coalescing.
+  timespan coalesce_window;
+
+  /// Commands in the coalescing window, indexed by key.
+  std::unordered_map<data, pending_update> pending_updates;
+
+  /// Stores whether a flush of the coalescing window is scheduled.
+  bool flush_scheduled;
+
+  /// Number of commands that entered the coalescing window.
+  uint64_t coalesced_in;
+
+  /// Number of commands that left the coalescing window.
+  uint64_t coalesced_out;
+
+  /// Points to the partitioned master if this master is one of its shards.
+  /// Shards send updates and snapshots through the partitioned master instead
+  /// of publishing them directly.
+  caf::actor router;
+
   static const char* name;
 };
 
 caf::behavior master_actor(caf::stateful_actor<master_state>* self,
                            caf::actor core, std::string id,
                            master_state::backend_pointer backend,
-                           endpoint::clock* clock);
+                           endpoint::clock* clock, timespan coalesce_window);
+
+/// Spawns a master that manages a single shard of a partitioned master.
+caf::behavior master_shard_actor(caf::stateful_actor<master_state>* self,
+                                 caf::actor core, caf::actor router,
+                                 std::string id,
+                                 master_state::backend_pointer backend,
+                                 endpoint::clock* clock,
+                                 timespan coalesce_window,
+                                 bool announce_clear);
 
 } // namespace detail
 } // namespace broker
@@ -17,6 +17,8 @@
 
 #include "broker/network_info.hh"
 
+#include "broker/detail/unix_socket.hh"
+
 namespace broker {
 namespace detail {
 
@@ -42,29 +44,44 @@ public:
       f(*y);
       return;
     }
+    auto on_result = [=](const node_id&, strong_actor_ptr& res,
+                         std::set<std::string>& ifs) mutable {
+      if (!ifs.empty())
+        g(sec::unexpected_actor_messaging_interface);
+      else if (res == nullptr)
+        g(sec::no_actor_published_at_port);
+      else {
+        auto hdl = actor_cast<actor>(std::move(res));
+        hdls_.emplace(x, hdl);
+        addrs_.emplace(hdl, x);
+        f(std::move(hdl));
+      }
+    };
+    auto on_error = [=](error& err) mutable {
+      g(std::move(err));
+    };
+    if (is_unix_socket(x)) {
+      // Unix domain sockets bypass the middleman actor: we connect the socket
+      // ourselves and let the BASP broker perform the handshake. SSL does not
+      // apply to local sockets.
+      CAF_LOG_INFO("initiating connection to" << x.address);
+      auto& sys = self->home_system();
+      auto ptr = unix_socket_connect(sys, unix_socket_path(x));
+      if (!ptr) {
+        g(std::move(ptr.error()));
+        return;
+      }
+      self->request(basp_broker(sys), infinite,
+                    connect_atom::value, std::move(*ptr), uint16_t{0})
+      .then(on_result, on_error);
+      return;
+    }
     CAF_LOG_INFO("initiating connection to" << (x.address + ":" + std::to_string(x.port)) << (use_ssl ? "(SSL)" : "(no SSL)"));
     auto hdl = (use_ssl ? self->home_system().openssl_manager().actor_handle()
                         : self->home_system().middleman().actor_handle());
     self->request(hdl, infinite,
                   connect_atom::value, x.address, x.port)
-    .then(
-      [=](const node_id&, strong_actor_ptr& res,
-          std::set<std::string>& ifs) mutable {
-        if (!ifs.empty())
-          g(sec::unexpected_actor_messaging_interface);
-        else if (res == nullptr)
-          g(sec::no_actor_published_at_port);
-        else {
-          auto hdl = actor_cast<actor>(std::move(res));
-          hdls_.emplace(x, hdl);
-          addrs_.emplace(hdl, x);
-          f(std::move(hdl));
-        }
-      },
-      [=](error& err) mutable {
-        g(std::move(err));
-      }
-    );
+    .then(on_result, on_error);
   }
 
   template <class OnResult, class OnError>
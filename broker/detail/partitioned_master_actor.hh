@@ -0,0 +1,121 @@
+#ifndef BROKER_DETAIL_PARTITIONED_MASTER_ACTOR_HH
+#define BROKER_DETAIL_PARTITIONED_MASTER_ACTOR_HH
+
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+#include <caf/actor.hpp>
+#include <caf/actor_addr.hpp>
+#include <caf/behavior.hpp>
+#include <caf/event_based_actor.hpp>
+#include <caf/stateful_actor.hpp>
+
+#include "broker/data.hh"
+#include "broker/endpoint.hh"
+#include "broker/fwd.hh"
+#include "broker/internal_command.hh"
+#include "broker/snapshot.hh"
+#include "broker/topic.hh"
+
+#include "broker/detail/master_actor.hh"
+
+namespace broker {
+namespace detail {
+
+/// Fronts a master store whose keys are spread over several master shards.
+/// The partitioned master takes the place of a regular master in the core:
+/// it receives all commands for the store, routes each command to the shard
+/// that owns its key, and merges the results of queries that span all keys.
+/// Shards send updates for clones through the partitioned master, which keeps
+/// snapshots consistent with the update stream.
+class partitioned_master_state {
+public:
+  /// Allows us to apply this state as a visitor to internal commands.
+  using result_type = void;
+
+  /// Creates an uninitialized object.
+  partitioned_master_state();
+
+  /// Initializes the object.
+  void init(caf::event_based_actor* ptr, std::string&& nm, caf::actor&& parent,
+            std::vector<caf::actor>&& xs);
+
+  /// Returns the shard responsible for `key`.
+  const caf::actor& shard_of(const data& key) const;
+
+  /// Publishes `x` to all clones.
+  void broadcast(internal_command&& x);
+
+  /// Publishes `x` on behalf of `shard`, deferring it if `shard` already
+  /// contributed to a pending snapshot.
+  void broadcast_from(const caf::actor_addr& shard, internal_command&& x);
+
+  /// Adds the snapshot of a single shard to the pending snapshot.
+  void add_snapshot(const caf::actor_addr& shard, broker::snapshot& ss);
+
+  /// Asks all shards for their contribution to the next pending snapshot.
+  void request_snapshots();
+
+  void command(internal_command& cmd);
+
+  void operator()(none);
+
+  void operator()(put_command&);
+
+  void operator()(put_unique_command&);
+
+  void operator()(erase_command&);
+
+  void operator()(add_command&);
+
+  void operator()(subtract_command&);
+
+  void operator()(snapshot_command&);
+
+  void operator()(snapshot_sync_command&);
+
+  void operator()(set_command&);
+
+  void operator()(clear_command&);
+
+  void operator()(batch_command&);
+
+  caf::event_based_actor* self;
+
+  std::string id;
+
+  topic clones_topic;
+
+  caf::actor core;
+
+  std::vector<caf::actor> shards;
+
+  /// Snapshot requests in arrival order. Only the first one is in progress.
+  std::deque<snapshot_command> pending_snapshots;
+
+  /// Shards that contributed to the snapshot in progress.
+  std::unordered_set<caf::actor_addr> snapshot_shards;
+
+  /// Merged contents of the snapshot in progress.
+  broker::snapshot snapshot_state;
+
+  /// Updates from shards that already contributed to the snapshot in
+  /// progress. They get published after the snapshot sync point.
+  std::vector<internal_command> deferred;
+
+  static const char* name;
+};
+
+/// Spawns one master shard per backend in `backends` and routes all store
+/// traffic between them and the core. Each shard coalesces its updates for
+/// clones within `coalesce_window`.
+caf::behavior partitioned_master_actor(
+  caf::stateful_actor<partitioned_master_state>* self, caf::actor core,
+  std::string id, std::vector<master_state::backend_pointer> backends,
+  endpoint::clock* clock, timespan coalesce_window);
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_PARTITIONED_MASTER_ACTOR_HH
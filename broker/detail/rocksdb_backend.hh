@@ -10,7 +10,9 @@
 namespace broker {
 namespace detail {
 
-/// A RocksDB storage backend.
+/// A RocksDB storage backend. The members of sets, tables, and vectors live in
+/// a separate column family, which makes inserting, removing, and looking up a
+/// single member independent of the container size.
 class rocksdb_backend : public abstract_backend {
 public:
   /// Constructs a RocksDB backend.
@@ -21,10 +23,25 @@ public:
   ///             the filesystem.
   ///
   /// Optional:
-  ///   - `exact_size_threshold`: a `count` that represents the threshold when
+  ///   - `exact-size-threshold`: a `count` that represents the threshold when
   ///                             to start estimating the nubmer of keys as
   ///                             opposed to linear enumeration.
   ///                             (default = 10,000)
+  ///   - `block-cache-size`: a `count` with the size of the LRU block cache
+  ///                         in bytes shared by all tables; 0 disables the
+  ///                         block cache. (default = 8 MiB)
+  ///   - `bloom-bits-per-key`: a `count` with the number of bits per key in
+  ///                           the bloom filters; 0 disables bloom filters.
+  ///                           (default = 10)
+  ///   - `write-buffer-size`: a `count` with the size of a single memtable in
+  ///                          bytes. (default = RocksDB default)
+  ///   - `compression`: a `std::string`, one of `none`, `snappy`, `zlib`,
+  ///                    `bzip2`, `lz4`, `lz4hc`, or `zstd`.
+  ///                    (default = `snappy`)
+  ///   - `compaction-style`: a `std::string`, one of `level`, `universal`,
+  ///                         or `fifo`. (default = `level`)
+  ///   - `sync`: a `boolean` that causes each write to be flushed to disk
+  ///             before returning. (default = false)
   rocksdb_backend(backend_options opts = backend_options{});
 
   ~rocksdb_backend();
@@ -47,6 +64,8 @@ public:
 
   expected<data> get(const data& key) const override;
 
+  expected<data> get(const data& key, const data& aspect) const override;
+
   expected<bool> exists(const data& key) const override;
 
   expected<uint64_t> size() const override;
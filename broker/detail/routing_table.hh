@@ -0,0 +1,365 @@
+#ifndef BROKER_DETAIL_ROUTING_TABLE_HH
+#define BROKER_DETAIL_ROUTING_TABLE_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <caf/meta/type_name.hpp>
+#include <caf/none.hpp>
+
+#include "broker/filter_type.hh"
+#include "broker/optional.hh"
+#include "broker/topic.hh"
+
+namespace broker {
+namespace detail {
+
+/// Identifies an endpoint in the routing layer.
+using endpoint_id = uint64_t;
+
+/// Propagates the subscriptions of a single endpoint hop by hop.
+struct subscription_announcement {
+  /// The endpoint that subscribed to `filter`.
+  endpoint_id origin;
+
+  /// Version of the subscriptions. Increases with each change at `origin`.
+  uint64_t seq;
+
+  /// Signals that the sender no longer has a route to `origin`.
+  bool withdrawn;
+
+  /// Subscriptions of `origin`.
+  filter_type filter;
+
+  /// All endpoints that relayed this announcement, starting at `origin`.
+  std::vector<endpoint_id> path;
+};
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f,
+                                        subscription_announcement& x) {
+  return f(caf::meta::type_name("subscription_announcement"), x.origin, x.seq,
+           x.withdrawn, x.filter, x.path);
+}
+
+/// Suppresses duplicates of messages that reach an endpoint on more than one
+/// path. Remembers the last `window_size` sequence numbers per origin. Since
+/// all topics of an origin share one counter, messages may arrive well behind
+/// the newest sequence number. Anything older than the window is reported as
+/// `unknown` and should get delivered anyway.
+class duplicate_filter {
+public:
+  /// Number of sequence numbers tracked per origin.
+  static constexpr uint64_t window_size = 4096;
+
+  /// Classifies a sequence number.
+  enum class verdict {
+    /// Arrives for the first time.
+    first,
+    /// Arrived before.
+    duplicate,
+    /// Too old to tell.
+    unknown,
+  };
+
+  /// Classifies `seq` from `origin`.
+  verdict check(endpoint_id origin, uint64_t seq) {
+    auto& w = windows_[origin];
+    if (w.bits.empty())
+      w.bits.resize(window_size / 64);
+    if (seq > w.high) {
+      auto shift = seq - w.high;
+      if (shift >= window_size)
+        std::fill(w.bits.begin(), w.bits.end(), uint64_t{0});
+      else
+        for (auto i = w.high + 1; i < seq; ++i)
+          w.reset(i);
+      w.set(seq);
+      w.high = seq;
+      return verdict::first;
+    }
+    if (w.high - seq >= window_size)
+      return verdict::unknown;
+    if (w.test(seq))
+      return verdict::duplicate;
+    w.set(seq);
+    return verdict::first;
+  }
+
+  /// Returns whether `seq` from `origin` should get delivered, i.e., whether
+  /// it is not a known duplicate.
+  bool first_delivery(endpoint_id origin, uint64_t seq) {
+    return check(origin, seq) != verdict::duplicate;
+  }
+
+  /// Drops the window for `origin`.
+  void erase(endpoint_id origin) {
+    windows_.erase(origin);
+  }
+
+private:
+  struct window {
+    uint64_t high = 0;
+    std::vector<uint64_t> bits;
+
+    static uint64_t mask(uint64_t seq) {
+      return uint64_t{1} << (seq % 64);
+    }
+
+    uint64_t& word(uint64_t seq) {
+      return bits[(seq % window_size) / 64];
+    }
+
+    bool test(uint64_t seq) {
+      return (word(seq) & mask(seq)) != 0;
+    }
+
+    void set(uint64_t seq) {
+      word(seq) |= mask(seq);
+    }
+
+    void reset(uint64_t seq) {
+      word(seq) &= ~mask(seq);
+    }
+  };
+
+  std::unordered_map<endpoint_id, window> windows_;
+};
+
+/// A path-vector routing table for subscriptions. Each endpoint announces its
+/// own filter to its peers, which relay the best route they know for each
+/// origin after appending themselves to the path. Announcements that already
+/// contain the receiving endpoint would form a loop and withdraw the route
+/// over that peer instead. The result is a loop-free next hop per origin, and
+/// the forwarding table for a peer is the union of the filters of all origins
+/// routed over it.
+/// @tparam Peer Handle type for directly connected peers.
+template <class Peer>
+class routing_table {
+public:
+  // -- member types -----------------------------------------------------------
+
+  using announcement = subscription_announcement;
+
+  /// A route to an origin as advertised by a single peer.
+  struct candidate {
+    uint64_t seq;
+    filter_type filter;
+    std::vector<endpoint_id> path;
+  };
+
+  /// All candidates for an origin and the selected route.
+  struct entry {
+    std::map<Peer, candidate> candidates;
+    optional<Peer> best;
+  };
+
+  // -- construction -----------------------------------------------------------
+
+  explicit routing_table(endpoint_id id = 0) : id_(id), seq_(0) {
+    // nop
+  }
+
+  // -- properties -------------------------------------------------------------
+
+  /// Returns the ID of this endpoint.
+  endpoint_id id() const {
+    return id_;
+  }
+
+  /// Sets the ID of this endpoint.
+  void id(endpoint_id x) {
+    id_ = x;
+  }
+
+  /// Returns the number of reachable origins.
+  size_t size() const {
+    return entries_.size();
+  }
+
+  /// Returns the next hop for `origin`, if any.
+  optional<Peer> next_hop(endpoint_id origin) const {
+    auto i = entries_.find(origin);
+    if (i == entries_.end())
+      return caf::none;
+    return i->second.best;
+  }
+
+  // -- announcements ----------------------------------------------------------
+
+  /// Creates an announcement for a new version of our own filter.
+  announcement announce(filter_type filter) {
+    own_filter_ = std::move(filter);
+    ++seq_;
+    return own();
+  }
+
+  /// Returns the announcement for the current version of our own filter.
+  announcement own() const {
+    return {id_, seq_, false, own_filter_, {id_}};
+  }
+
+  /// Returns all announcements a new peer needs to receive, i.e., our own
+  /// filter followed by all selected routes.
+  std::vector<announcement> dump() const {
+    std::vector<announcement> result;
+    result.emplace_back(own());
+    for (auto& kvp : entries_)
+      result.emplace_back(relay(kvp.first, kvp.second));
+    return result;
+  }
+
+  /// Processes an announcement from `from`.
+  /// @returns the announcement for all peers if the selected route changed.
+  optional<announcement> handle(const Peer& from, announcement x) {
+    if (x.origin == id_)
+      return caf::none;
+    auto& e = entries_[x.origin];
+    auto old = relay(x.origin, e);
+    auto loop = std::find(x.path.begin(), x.path.end(), id_) != x.path.end();
+    if (x.withdrawn || loop) {
+      e.candidates.erase(from);
+    } else {
+      auto& c = e.candidates[from];
+      c.seq = x.seq;
+      c.filter = std::move(x.filter);
+      c.path = std::move(x.path);
+    }
+    return select(x.origin, old);
+  }
+
+  /// Removes all routes over `peer`.
+  /// @returns the announcements for all remaining peers.
+  std::vector<announcement> remove_peer(const Peer& peer) {
+    std::vector<announcement> affected;
+    for (auto& kvp : entries_) {
+      auto& e = kvp.second;
+      if (e.candidates.count(peer) > 0) {
+        affected.emplace_back(relay(kvp.first, e));
+        e.candidates.erase(peer);
+      }
+    }
+    std::vector<announcement> result;
+    for (auto& old : affected)
+      if (auto x = select(old.origin, old))
+        result.emplace_back(std::move(*x));
+    return result;
+  }
+
+  /// Returns all peers whose result of `filter_for` changed since the last
+  /// call, i.e., peers that gained or lost a route or whose routes now carry
+  /// a different filter.
+  std::vector<Peer> take_changed_peers() {
+    std::vector<Peer> result(changed_.begin(), changed_.end());
+    changed_.clear();
+    return result;
+  }
+
+  // -- forwarding -------------------------------------------------------------
+
+  /// Returns the union of the filters of all origins routed over `peer`.
+  filter_type filter_for(const Peer& peer) const {
+    filter_type result;
+    for (auto& kvp : entries_) {
+      auto& e = kvp.second;
+      if (e.best && *e.best == peer) {
+        auto& f = e.candidates.at(peer).filter;
+        result.insert(result.end(), f.begin(), f.end());
+      }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+  }
+
+  /// Returns all peers that lead to at least one subscriber of `t`.
+  std::vector<Peer> next_hops(const topic& t) const {
+    std::vector<Peer> result;
+    for (auto& kvp : entries_) {
+      auto& e = kvp.second;
+      if (!e.best)
+        continue;
+      auto& f = e.candidates.at(*e.best).filter;
+      auto pred = [&](const topic& prefix) { return prefix.prefix_of(t); };
+      if (std::any_of(f.begin(), f.end(), pred))
+        result.emplace_back(*e.best);
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+  }
+
+private:
+  // Orders candidates by freshness first and path length second. Comparing
+  // the paths themselves breaks ties deterministically.
+  static bool better(const candidate& x, const candidate& y) {
+    if (x.seq != y.seq)
+      return x.seq > y.seq;
+    if (x.path.size() != y.path.size())
+      return x.path.size() < y.path.size();
+    return x.path < y.path;
+  }
+
+  // Builds the announcement we send to our peers for `origin`.
+  announcement relay(endpoint_id origin, const entry& e) const {
+    if (!e.best)
+      return {origin, 0, true, {}, {}};
+    auto& c = e.candidates.at(*e.best);
+    announcement result{origin, c.seq, false, c.filter, c.path};
+    result.path.emplace_back(id_);
+    return result;
+  }
+
+  // Re-selects the best candidate for `origin` and returns the announcement
+  // for our peers if it differs from `old`.
+  optional<announcement> select(endpoint_id origin, const announcement& old) {
+    auto i = entries_.find(origin);
+    auto& e = i->second;
+    auto old_best = e.best;
+    auto& cs = e.candidates;
+    auto best = cs.end();
+    for (auto j = cs.begin(); j != cs.end(); ++j)
+      if (best == cs.end() || better(j->second, best->second))
+        best = j;
+    if (best == cs.end()) {
+      if (old_best)
+        changed_.emplace(*old_best);
+      entries_.erase(i);
+      if (old.withdrawn)
+        return caf::none;
+      // Lost the last route.
+      return announcement{origin, 0, true, {}, {}};
+    }
+    e.best = best->first;
+    auto result = relay(origin, e);
+    if (old_best != e.best || old.filter != result.filter) {
+      if (old_best)
+        changed_.emplace(*old_best);
+      changed_.emplace(best->first);
+    }
+    if (!old.withdrawn && result.seq == old.seq && result.path == old.path
+        && result.filter == old.filter)
+      return caf::none;
+    return result;
+  }
+
+  endpoint_id id_;
+
+  uint64_t seq_;
+
+  filter_type own_filter_;
+
+  std::unordered_map<endpoint_id, entry> entries_;
+
+  std::set<Peer> changed_;
+};
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_ROUTING_TABLE_HH
@@ -1,9 +1,13 @@
 #ifndef BROKER_DETAIL_SHARED_SUBSCRIBER_QUEUE_HH
 #define BROKER_DETAIL_SHARED_SUBSCRIBER_QUEUE_HH
 
+#include <atomic>
+
 #include <caf/intrusive_ptr.hpp>
 #include <caf/make_counted.hpp>
 
+#include "broker/overflow_policy.hh"
+
 #include "broker/detail/shared_queue.hh"
 
 namespace broker {
@@ -19,6 +23,7 @@ namespace detail {
 /// - the flare is active as long as xs_ has more than one item
 /// - produce() fires the flare when it adds items to xs_ and xs_ was empty
 /// - consume() extinguishes the flare when it removes the last item from xs_
+/// - close() fires the flare if xs_ is empty and the flare then stays active
 template <class ValueType = std::pair<topic, data>>
 class shared_subscriber_queue : public shared_queue<ValueType> {
 public:
@@ -44,7 +49,9 @@ public:
       for (auto& x : this->xs_)
         fun(std::move(x));
       this->xs_.clear();
-      this->fx_.extinguish_one();
+      // A closed queue keeps the flare active to not block readers.
+      if (!closed_)
+        this->fx_.extinguish_one();
     } else {
       auto b = this->xs_.begin();
       auto e = b + static_cast<ptrdiff_t>(n);
@@ -73,6 +80,75 @@ public:
       this->fx_.fire();
     this->xs_.emplace_back(std::move(x));
   }
+
+  // Inserts the range `[i, e)` into the queue without growing it beyond
+  // `max_size` items, dropping items according to `policy`. The `sample`
+  // policy admits every `sample_interval`-th item on overflow. Returns the
+  // number of dropped items.
+  template <class Iter>
+  size_t produce(Iter i, Iter e, size_t max_size, overflow_policy policy,
+                 size_t sample_interval) {
+    guard_type guard{this->mtx_};
+    auto was_empty = this->xs_.empty();
+    size_t dropped = 0;
+    for (; i != e; ++i) {
+      if (this->xs_.size() < max_size) {
+        this->xs_.emplace_back(*i);
+        continue;
+      }
+      switch (policy) {
+        default:
+          this->xs_.emplace_back(*i);
+          continue;
+        case overflow_policy::drop_newest:
+          break;
+        case overflow_policy::sample:
+          if (++sampled_ % sample_interval != 0)
+            break;
+          // fall through
+        case overflow_policy::drop_oldest:
+          if (!this->xs_.empty())
+            this->xs_.pop_front();
+          this->xs_.emplace_back(*i);
+      }
+      ++dropped;
+    }
+    if (was_empty && !this->xs_.empty())
+      this->fx_.fire();
+    dropped_ += dropped;
+    return dropped;
+  }
+
+  // Marks the queue as closed, i.e., the worker produces no more items, and
+  // wakes up all readers.
+  void close() {
+    guard_type guard{this->mtx_};
+    if (closed_)
+      return;
+    closed_ = true;
+    if (this->xs_.empty())
+      this->fx_.fire();
+  }
+
+  // Returns whether the worker closed the queue.
+  bool closed() const {
+    return closed_.load();
+  }
+
+  // Returns the number of items dropped on overflow.
+  size_t dropped() const {
+    return dropped_.load();
+  }
+
+private:
+  // Counts items that arrived while the queue was full.
+  size_t sampled_ = 0;
+
+  // Counts items dropped on overflow.
+  std::atomic<size_t> dropped_{0};
+
+  // Signals that the worker is gone.
+  std::atomic<bool> closed_{false};
 };
 
 template <class ValueType = std::pair<topic, data>>
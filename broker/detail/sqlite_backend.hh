@@ -8,7 +8,9 @@
 namespace broker {
 namespace detail {
 
-/// A SQLite storage backend.
+/// A SQLite storage backend. The members of sets, tables, and vectors live in
+/// a separate table, which makes inserting, removing, and looking up a single
+/// member independent of the container size.
 class sqlite_backend : public abstract_backend {
 public:
   /// Constructs a SQLite backend.
@@ -16,6 +18,18 @@ public:
   /// Required parameters:
   ///   - `path`: a `std::string` representing the location of the database on
   ///             the filesystem.
+  /// Optional parameters:
+  ///   - `journal-mode`: a `std::string`, one of `delete`, `truncate`,
+  ///                     `persist`, `memory`, `wal`, or `off`.
+  ///                     (default = `delete`)
+  ///   - `synchronous`: a `std::string`, one of `off`, `normal`, `full`, or
+  ///                    `extra`. (default = `full`)
+  ///   - `mmap-size`: a `count` with the maximum number of bytes to access via
+  ///                  memory-mapped I/O. (default = 0)
+  ///   - `cache-size`: a `count` or `integer` for the page cache, in pages if
+  ///                   positive and in KiB if negative. (default = -2000)
+  ///   - `busy-timeout`: a `count` with the number of milliseconds to wait for
+  ///                     a locked database. (default = 0)
   sqlite_backend(backend_options opts = backend_options{});
 
   ~sqlite_backend();
@@ -37,6 +51,8 @@ public:
 
   expected<data> get(const data& key) const override;
 
+  expected<data> get(const data& key, const data& aspect) const override;
+
   expected<bool> exists(const data& key) const override;
 
   expected<uint64_t> size() const override;
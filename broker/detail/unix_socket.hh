@@ -0,0 +1,46 @@
+#ifndef BROKER_DETAIL_UNIX_SOCKET_HH
+#define BROKER_DETAIL_UNIX_SOCKET_HH
+
+#include <string>
+
+#include <caf/actor.hpp>
+#include <caf/actor_system.hpp>
+
+#include <caf/io/fwd.hpp>
+
+#include "broker/expected.hh"
+#include "broker/network_info.hh"
+
+namespace broker {
+namespace detail {
+
+/// Returns whether `x` refers to a Unix domain socket.
+bool is_unix_socket(const network_info& x);
+
+/// Returns the path of the Unix domain socket in `x`.
+/// @pre `is_unix_socket(x)`
+std::string unix_socket_path(const network_info& x);
+
+/// Returns the BASP broker of `sys`, which manages all connections between
+/// CAF nodes.
+caf::actor basp_broker(caf::actor_system& sys);
+
+/// Accepts connections at the Unix domain socket `path` and makes `whom`
+/// available to the connecting nodes. Replaces a stale socket file at `path`
+/// but refuses to replace any other kind of file. Removes the socket file
+/// again when the BASP broker closes the doorman.
+/// @pre No other actor is published at a Unix domain socket of `sys`, since
+///      BASP knows all of them under port 0.
+expected<void> unix_socket_publish(caf::actor_system& sys,
+                                   const caf::actor& whom,
+                                   const std::string& path);
+
+/// Connects to the Unix domain socket `path`. The caller passes the result
+/// to the BASP broker via `connect_atom` to perform the CAF handshake.
+expected<caf::io::scribe_ptr> unix_socket_connect(caf::actor_system& sys,
+                                                  const std::string& path);
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_UNIX_SOCKET_HH
@@ -0,0 +1,45 @@
+#ifndef BROKER_DETAIL_WEIGHTED_INTERLEAVE_HH
+#define BROKER_DETAIL_WEIGHTED_INTERLEAVE_HH
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace broker {
+namespace detail {
+
+/// Moves up to `n` elements from the queues in `lanes` to `out` in weighted
+/// round-robin fashion. Each round takes up to `weights[i]` elements from
+/// lane `i`. The order of elements within a lane remains unchanged.
+/// @returns The number of elements moved to `out`.
+template <size_t Lanes, class T>
+size_t weighted_interleave(std::array<std::deque<T>, Lanes>& lanes,
+                           const std::array<size_t, Lanes>& weights, size_t n,
+                           std::vector<T>& out) {
+  size_t available = 0;
+  for (auto& lane : lanes)
+    available += lane.size();
+  auto remaining = std::min(n, available);
+  auto result = remaining;
+  while (remaining > 0) {
+    for (size_t i = 0; i < Lanes && remaining > 0; ++i) {
+      auto& lane = lanes[i];
+      auto k = std::min({std::max(weights[i], size_t{1}), lane.size(),
+                         remaining});
+      for (size_t j = 0; j < k; ++j) {
+        out.emplace_back(std::move(lane.front()));
+        lane.pop_front();
+      }
+      remaining -= k;
+    }
+  }
+  return result;
+}
+
+} // namespace detail
+} // namespace broker
+
+#endif // BROKER_DETAIL_WEIGHTED_INTERLEAVE_HH
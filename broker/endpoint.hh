@@ -27,6 +27,7 @@
 #include "broker/frontend.hh"
 #include "broker/fwd.hh"
 #include "broker/network_info.hh"
+#include "broker/overflow_policy.hh"
 #include "broker/peer_info.hh"
 #include "broker/status.hh"
 #include "broker/store.hh"
@@ -58,9 +59,25 @@ public:
 
     using lock_type = std::unique_lock<mutex_type>;
 
-    using pending_msg_type = std::pair<caf::actor, caf::message>;
-
-    using pending_msgs_map_type = std::multimap<timestamp, pending_msg_type>;
+    /// A message that becomes due once the clock reaches `time`.
+    struct pending_msg_type {
+      timestamp time;
+      uint64_t seq;
+      caf::actor dest;
+      caf::message msg;
+    };
+
+    /// Orders a heap of pending messages by due time, with the earliest
+    /// message at the top. Breaks ties by insertion order to deliver messages
+    /// with the same due time in FIFO order.
+    struct pending_msg_order {
+      bool operator()(const pending_msg_type& x,
+                      const pending_msg_type& y) const noexcept {
+        return x.time != y.time ? x.time > y.time : x.seq > y.seq;
+      }
+    };
+
+    using pending_msgs_heap_type = std::vector<pending_msg_type>;
 
     // --- construction and destruction ----------------------------------------
 
@@ -93,8 +110,13 @@ public:
     /// Guards pending_.
     mutex_type mtx_;
 
-    /// Stores pending messages until they time out.
-    pending_msgs_map_type pending_;
+    /// Stores pending messages until they time out. Organized as binary heap
+    /// with `pending_msg_order`, which allows advance_time to extract all due
+    /// messages without touching the remaining ones.
+    pending_msgs_heap_type pending_;
+
+    /// Assigns insertion order to pending messages.
+    uint64_t next_seq_;
 
     /// Stores number of items in pending_.  We track it separately as
     /// a micro-optimization -- checking pending_.size() would require
@@ -136,6 +158,14 @@ public:
   /// @returns The port the endpoint bound to or 0 on failure.
   uint16_t listen(const std::string& address = {}, uint16_t port = 0);
 
+  /// Listens at a Unix domain socket to accept peers on the same host. The
+  /// endpoint removes a stale socket file at `path` first.
+  /// @param path The file system path of the socket.
+  /// @returns True if the endpoint listens at `path`, false on error or if
+  ///          the endpoint already listens at a Unix domain socket.
+  /// @note Peerings over Unix domain sockets never use SSL.
+  bool listen_unix(const std::string& path);
+
   /// Initiates a peering with a remote endpoint.
   /// @param address The IP address of the remote endpoint.
   /// @param port The TCP port of the remote endpoint.
@@ -158,6 +188,35 @@ public:
   void peer_nosync(const std::string& address, uint16_t port,
             timeout::seconds retry = timeout::seconds(10));
 
+  /// Called by `peer_many` whenever one of its peering attempts completes.
+  /// @param x The address of the remote endpoint.
+  /// @param err Default-constructed if the peering succeeded.
+  /// @param completed The number of completed attempts, including this one.
+  using peer_progress_function
+    = std::function<void(const network_info& x, const caf::error& err,
+                         size_t completed)>;
+
+  /// Initiates peerings with all endpoints in `xs` at once and blocks until
+  /// each attempt succeeded or failed once. Unlike calling `peer` in a loop,
+  /// connection setup and handshakes for all peers run concurrently.
+  /// @param xs The addresses of the remote endpoints. A non-zero `retry`
+  ///           field does not delay the result. Instead, the endpoint keeps
+  ///           retrying a failed peering in the background, like
+  ///           `peer_nosync` does.
+  /// @param f Optional callback for reporting progress. Runs in the calling
+  ///          thread in the order in which the attempts complete.
+  /// @returns The number of successful peerings.
+  size_t peer_many(std::vector<network_info> xs,
+                   peer_progress_function f = nullptr);
+
+  /// Initiates a peering with an endpoint listening at the Unix domain
+  /// socket `path`. Equivalent to calling `peer` with the address
+  /// `unix://<path>` and port 0.
+  bool peer_unix(const std::string& path,
+                 timeout::seconds retry = timeout::seconds(10)) {
+    return peer(detail::unix_socket_scheme + path, 0, retry);
+  }
+
   /// Shuts down a peering with a remote endpoint.
   /// @param address The IP address of the remote endpoint.
   /// @param port The TCP port of the remote endpoint.
@@ -175,6 +234,11 @@ public:
   ///       indicating sucess or failure.
   void unpeer_nosync(const std::string& address, uint16_t port);
 
+  /// Shuts down a peering over the Unix domain socket `path`.
+  bool unpeer_unix(const std::string& path) {
+    return unpeer(detail::unix_socket_scheme + path, 0);
+  }
+
   /// Retrieves a list of all known peers.
   /// @returns A pointer to the list
   std::vector<peer_info> peers() const;
@@ -255,7 +319,11 @@ public:
   // --- subscribing data ------------------------------------------------------
 
   /// Returns a subscriber connected to this endpoint for the topics `ts`.
-  subscriber make_subscriber(std::vector<topic> ts, size_t max_qsize = 20u);
+  /// @param max_qsize Maximum number of buffered messages.
+  /// @param policy Selects what happens to messages that arrive while the
+  ///               subscriber has `max_qsize` messages buffered.
+  subscriber make_subscriber(std::vector<topic> ts, size_t max_qsize = 20u,
+                             overflow_policy policy = overflow_policy::block);
 
   /// Starts a background worker from the given set of function that consumes
   /// incoming messages. The worker will run in the background, but `init` is
@@ -331,11 +399,24 @@ public:
   ///                                 explicitly acknowledged by the master.
   ///                                 A negative/zero value here indicates to
   ///                                 never buffer commands.
+  /// @param write_coalesce_interval The maximum amount of time (seconds) that
+  ///                                the clone holds back local mutations in
+  ///                                order to merge mutations of the same key
+  ///                                (e.g., repeated increments) before
+  ///                                sending them to the master in a single
+  ///                                batch.  A zero value here indicates to
+  ///                                send each mutation right away.
+  /// @param write_coalesce_size The number of pending local mutations at
+  ///                            which the clone sends them to the master
+  ///                            without waiting for the end of the
+  ///                            `write_coalesce_interval`.
   /// @returns A handle to the frontend representing the clone, or an error if
   ///          a master *name* could not be found.
   expected<store> attach_clone(std::string name, double resync_interval=10.0,
                                double stale_interval=300.0,
-                               double mutation_buffer_interval=120.0);
+                               double mutation_buffer_interval=120.0,
+                               double write_coalesce_interval=0.0,
+                               size_t write_coalesce_size=1000);
 
   /// Queries whether the endpoint waits for masters and slaves on shutdown.
   inline bool await_stores_on_shutdown() const {
@@ -392,6 +473,7 @@ private:
   std::vector<caf::actor> children_;
   bool destroyed_;
   clock* clock_;
+  std::string unix_socket_path_;
 };
 
 } // namespace broker
@@ -3,6 +3,7 @@
 
 #include <utility>
 #include <unordered_map>
+#include <vector>
 
 #include <caf/actor.hpp>
 #include <caf/variant.hpp>
@@ -120,12 +121,24 @@ typename Inspector::result_type inspect(Inspector& f, clear_command&) {
   return f(caf::meta::type_name("clear"));
 }
 
+/// Bundles several commands into a single message. Receivers apply the
+/// commands in order.
+struct batch_command {
+  std::vector<internal_command> commands;
+};
+
+template <class Inspector>
+typename Inspector::result_type inspect(Inspector& f, batch_command& x) {
+  return f(caf::meta::type_name("batch"), x.commands);
+}
+
 class internal_command {
 public:
   using variant_type
     = caf::variant<none, put_command, put_unique_command, erase_command,
                    add_command, subtract_command, snapshot_command,
-                   snapshot_sync_command, set_command, clear_command>;
+                   snapshot_sync_command, set_command, clear_command,
+                   batch_command>;
 
   variant_type content;
 
@@ -148,6 +161,10 @@ typename Inspector::result_type inspect(Inspector& f, internal_command& x) {
   return f(caf::meta::type_name("internal_command"), x.content);
 }
 
+/// Returns the key that `x` operates on or `nullptr` if `x` does not operate
+/// on a single key.
+const data* command_key(const internal_command& x);
+
 } // namespace broker
 
 #endif // BROKER_INTERNAL_COMMAND_HH
@@ -8,8 +8,17 @@
 #include "broker/detail/operators.hh"
 
 namespace broker {
+namespace detail {
 
-/// Represents an IP address and TCP port combination.
+/// Prefix that marks the address of a `network_info` as the path of a Unix
+/// domain socket. The port of such an address is always 0.
+constexpr const char unix_socket_scheme[] = "unix://";
+
+} // namespace detail
+
+/// Represents an IP address and TCP port combination. An address of the form
+/// `unix://<path>` instead refers to a Unix domain socket, in which case the
+/// port is 0.
 struct network_info : detail::totally_ordered<network_info> {
   network_info() = default;
   network_info(std::string addr, uint16_t port,
@@ -35,6 +44,9 @@ typename Inspector::result_type inspect(Inspector& f, network_info& info) {
 /// @relates network_info
 inline std::string to_string(const network_info& info) {
   using std::to_string;
+  if (info.address.compare(0, sizeof(detail::unix_socket_scheme) - 1,
+                           detail::unix_socket_scheme) == 0)
+    return info.address;
   return info.address + ':' + to_string(info.port);
 }
 
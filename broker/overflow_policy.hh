@@ -0,0 +1,30 @@
+#ifndef BROKER_OVERFLOW_POLICY_HH
+#define BROKER_OVERFLOW_POLICY_HH
+
+#include <cstdint>
+
+namespace broker {
+
+/// Configures how a subscriber deals with messages that arrive while its
+/// queue is full.
+enum class overflow_policy : uint8_t {
+  /// Stops receiving until the user consumes messages. Eventually slows down
+  /// the endpoint and all of its peers.
+  block,
+  /// Drops the oldest messages in the queue to make room for new ones.
+  drop_oldest,
+  /// Drops new messages until the user consumes messages.
+  drop_newest,
+  /// Admits only every n-th new message, replacing the oldest message in the
+  /// queue, and drops all others until the user consumes messages.
+  sample,
+  /// Disconnects the subscriber from the endpoint once the queue is full.
+  disconnect,
+};
+
+/// @relates overflow_policy
+const char* to_string(overflow_policy x);
+
+} // namespace broker
+
+#endif // BROKER_OVERFLOW_POLICY_HH
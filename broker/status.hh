@@ -32,6 +32,8 @@ enum class sc : uint8_t {
   peer_removed,
   /// Lost connection to peer.
   peer_lost,
+  /// A subscriber dropped messages or disconnected after falling behind.
+  subscriber_overflow,
 };
 
 /// @relates sc
@@ -44,7 +46,10 @@ class status : detail::equality_comparable<status, status>,
 
 public:
   template <sc S>
-  static detail::enable_if_t<S == sc::unspecified, status>
+  static detail::enable_if_t<
+    S == sc::unspecified || S == sc::subscriber_overflow,
+    status
+  >
   make(std::string msg) {
     status s;
     s.code_ = S;
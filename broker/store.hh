@@ -17,7 +17,10 @@
 #include "broker/optional.hh"
 #include "broker/error.hh"
 #include "broker/expected.hh"
+#include "broker/overflow_policy.hh"
 #include "broker/status.hh"
+#include "broker/store_event.hh"
+#include "broker/subscriber.hh"
 #include "broker/timeout.hh"
 
 namespace broker {
@@ -136,6 +139,21 @@ public:
     return frontend_;
   }
 
+  /// Returns a subscriber that receives a change event for each modification
+  /// of a key starting with `prefix`. Each message carries a `data` that
+  /// `store_event::make` turns into a ::store_event. The master publishes
+  /// change events only while at least one such subscriber exists, i.e.,
+  /// earlier modifications remain invisible to the subscriber. A `clear`
+  /// results in a single event of kind `clear` regardless of `prefix`.
+  /// @param prefix Only report keys that start with this string. Non-string
+  ///               keys match against their string representation.
+  /// @param max_qsize Maximum number of buffered events.
+  /// @param policy Selects what happens to events that arrive while the
+  ///               subscriber has `max_qsize` events buffered.
+  expected<subscriber>
+  subscribe_changes(const std::string& prefix = {}, size_t max_qsize = 20u,
+                    overflow_policy policy = overflow_policy::block) const;
+
   // --- modifiers -----------------------------------------------------------
 
   /// Inserts or updates a value.
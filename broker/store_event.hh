@@ -0,0 +1,62 @@
+#ifndef BROKER_STORE_EVENT_HH
+#define BROKER_STORE_EVENT_HH
+
+#include <cstdint>
+#include <string>
+
+#include "broker/data.hh"
+#include "broker/optional.hh"
+
+namespace broker {
+
+/// A change to a single key of a data store, as delivered to subscribers
+/// created via `store::subscribe_changes`.
+struct store_event {
+  /// Describes what happened to the key.
+  enum class type : uint8_t {
+    /// The key got a new value via `put` or `put_unique`.
+    put,
+    /// The key was removed via `erase`.
+    erase,
+    /// The key was removed because its expiry elapsed.
+    expire,
+    /// The value of the key was modified in place, e.g., via `increment`,
+    /// `insert_into` or `remove_from`.
+    add,
+    /// All keys were removed via `clear`. The event carries `nil` as key.
+    clear,
+  };
+
+  /// The kind of change.
+  type kind;
+
+  /// The affected key.
+  data key;
+
+  /// The value after the change, or `nil` if the key no longer exists.
+  data value;
+
+  /// Converts the event into its wire representation, i.e., a vector of the
+  /// form `[kind, key, value]` with `kind` as string.
+  data to_data() const;
+
+  /// Parses an event from its wire representation.
+  /// @returns The event or `nil` if `x` is not a valid change event.
+  static optional<store_event> make(const data& x);
+};
+
+/// @relates store_event
+const char* to_string(store_event::type x);
+
+/// @relates store_event
+bool convert(const std::string& str, store_event::type& x);
+
+/// @relates store_event
+bool operator==(const store_event& x, const store_event& y);
+
+/// @relates store_event
+std::string to_string(const store_event& x);
+
+} // namespace broker
+
+#endif // BROKER_STORE_EVENT_HH
@@ -7,6 +7,7 @@
 
 #include "broker/data.hh"
 #include "broker/fwd.hh"
+#include "broker/overflow_policy.hh"
 #include "broker/topic.hh"
 #include "broker/subscriber_base.hh"
 
@@ -21,6 +22,8 @@ public:
 
   friend class endpoint;
 
+  friend class store;
+
   // --- nested types ----------------------------------------------------------
 
   using super = subscriber_base<std::pair<topic, data>>;
@@ -35,6 +38,9 @@ public:
 
   size_t rate() const;
 
+  /// Returns how many messages the subscriber dropped on overflow.
+  size_t dropped() const;
+
   inline const caf::actor& worker() const {
     return worker_;
   }
@@ -51,11 +57,16 @@ protected:
 
 private:
   // -- force users to use `endpoint::make_status_subscriber` -------------------
-  subscriber(endpoint& ep, std::vector<topic> ts, size_t max_qsize);
+  subscriber(endpoint& ep, std::vector<topic> ts, size_t max_qsize,
+             overflow_policy policy);
+
+  /// Subscribes directly at `core`, which does not need to belong to an
+  /// endpoint in scope.
+  subscriber(caf::actor core, std::vector<topic> ts, size_t max_qsize,
+             overflow_policy policy);
 
   caf::actor worker_;
   std::vector<topic> filter_;
-  endpoint& ep_;
 };
 
 } // namespace broker
@@ -67,16 +67,20 @@ public:
 
   /// Pulls a single value out of the stream. Blocks the current thread until
   /// at least one value becomes available.
+  /// @returns A default-constructed value if the subscriber is `closed` and
+  ///          has no values left.
   value_type get() {
     auto tmp = get(1);
-    BROKER_ASSERT(tmp.size() == 1);
+    if (tmp.empty())
+      return value_type{};
     auto x = std::move(tmp.front());
     CAF_LOG_INFO("received" << x);
     return x;
   }
 
   /// Pulls a single value out of the stream. Blocks the current thread until
-  /// at least one value becomes available or a timeout occurred.
+  /// at least one value becomes available, a timeout occurred, or the queue
+  /// is closed and empty.
   caf::optional<value_type> get(duration timeout) {
     auto tmp = get(1, timeout);
     if (tmp.size() == 1) {
@@ -89,8 +93,8 @@ public:
 
   /// Pulls `num` values out of the stream. Blocks the current thread until
   /// `num` elements are available or a timeout occurs. Returns a partially
-  /// filled or empty vector on timeout, otherwise a vector containing exactly
-  /// `num` elements.
+  /// filled or empty vector on timeout or once the queue is closed and empty,
+  /// otherwise a vector containing exactly `num` elements.
   std::vector<value_type> get(size_t num,
                               duration timeout = infinite) {
     std::vector<value_type> result;
@@ -103,6 +107,8 @@ public:
         queue_->wait_on_flare();
       else if (!queue_->wait_on_flare_abs(t0))
         return result;
+      // Checking before consuming guarantees that we saw all values.
+      auto closed = queue_->closed();
       size_t prev_size = 0;
       queue_->consume(num - result.size(), &prev_size, [&](value_type&& x) {
         CAF_LOG_INFO("received" << x);
@@ -110,7 +116,7 @@ public:
       });
       if (prev_size >= static_cast<size_t>(max_qsize_))
         became_not_full();
-      if (result.size() == num) {
+      if (result.size() == num || closed) {
         return result;
       }
     }
@@ -136,6 +142,13 @@ public:
     return queue_->buffer_size();
   }
 
+  /// Returns whether the subscriber no longer receives values, e.g., because
+  /// its overflow policy disconnected it. Values that arrived earlier remain
+  /// available.
+  bool closed() const {
+    return queue_->closed();
+  }
+
   /// Returns a file handle for integrating this publisher into a `select` or
   /// `poll` loop.
   int fd() const {
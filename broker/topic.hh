@@ -85,8 +85,12 @@ namespace topics {
 const topic reserved = topic{topic::reserved};
 const topic master = topic{"data"} / "master";
 const topic clone = topic{"data"} / "clone";
+const topic changes = topic{"data"} / "changes";
+const topic cleared = topic{"data"} / "cleared";
 const topic master_suffix = reserved / master;
 const topic clone_suffix = reserved / clone;
+const topic changes_suffix = reserved / changes;
+const topic cleared_suffix = reserved / cleared;
 
 } // namespace topics
 } // namespace broker
@@ -1,15 +1,19 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <iostream>
 #include <iterator>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -34,6 +38,8 @@
 #include "broker/subscriber.hh"
 #include "broker/topic.hh"
 
+#include "broker/detail/hdr_histogram.hh"
+
 using std::string;
 
 using broker::count;
@@ -138,6 +144,12 @@ timespan default_rendezvous_retry = std::chrono::milliseconds(250);
 
 size_t default_ping_count = 100;
 
+double default_ping_rate = 0;
+
+timespan default_drain_timeout = std::chrono::seconds(5);
+
+size_t default_num_relays = 3;
+
 // -- atom constants -----------------------------------------------------------
 
 using ping_atom = atom_constant<atom("ping")>;
@@ -150,6 +162,20 @@ using blocking_atom = atom_constant<atom("blocking")>;
 
 using stream_atom = atom_constant<atom("stream")>;
 
+using chain_atom = atom_constant<atom("chain")>;
+
+using star_atom = atom_constant<atom("star")>;
+
+using count_atom = atom_constant<atom("count")>;
+
+using vector_atom = atom_constant<atom("vector")>;
+
+using set_atom = atom_constant<atom("set")>;
+
+using table_atom = atom_constant<atom("table")>;
+
+using record_atom = atom_constant<atom("record")>;
+
 // -- type aliases -------------------------------------------------------------
 
 using uri_list = std::vector<uri>;
@@ -169,10 +195,25 @@ public:
       .add<bool>("verbose,v", "print status and debug output")
       .add<string>("name,N", "set node name in verbose output")
       .add<string>("topic,t", "topic for sending/receiving messages")
-      .add<atom_value>("mode,m", "set mode: 'relay', 'ping', or 'pong'")
+      .add<atom_value>("mode,m",
+                       "set mode: 'relay', 'ping', 'pong', 'chain', or "
+                       "'star'")
       .add<atom_value>("impl,i", "mode: 'ping', 'pong', or 'relay'")
       .add<size_t>("payload-size,s",
-                   "additional number of bytes for the ping message")
+                   "size of the ping payload: bytes for strings, elements "
+                   "for containers")
+      .add<atom_value>("payload-type,T",
+                       "ping payload: 'string' (default), 'count', "
+                       "'vector', 'set', 'table', or 'record'")
+      .add<double>("rate,r",
+                   "send pings at this rate per second without waiting for "
+                   "pongs (default: 0, i.e., one ping at a time)")
+      .add<timespan>("drain-timeout",
+                     "time to wait for outstanding pongs after sending the "
+                     "last ping (default: 5s)")
+      .add<size_t>("relays,R",
+                   "number of relays in chain and star mode (default: 3)")
+      .add<bool>("raw", "print each round-trip time in nanoseconds")
       .add<timespan>("rendezvous-retry",
                      "timeout before repeating the first rendezvous ping "
                      "message (default: 50ms)")
@@ -214,9 +255,7 @@ bool is_ping_msg(const broker::data& x) {
     if (vec->size() == 3) {
       auto& xs = *vec;
       auto str = caf::get_if<string>(&xs[0]);
-      return str && *str == "ping"
-             && caf::holds_alternative<count>(xs[1])
-             && caf::holds_alternative<string>(xs[2]);
+      return str && *str == "ping" && caf::holds_alternative<count>(xs[1]);
     }
   }
   return false;
@@ -246,6 +285,59 @@ broker::data make_ping_msg(count id, size_t payload_size) {
   return broker::vector{"ping", id, string(payload_size, 'x')};
 }
 
+broker::data make_ping_msg(count id, broker::data payload) {
+  return broker::vector{"ping", id, std::move(payload)};
+}
+
+/// Creates a ping payload of given type, where `size` is the number of bytes
+/// for strings and the number of elements otherwise.
+broker::data make_payload(atom_value type, size_t size) {
+  switch (static_cast<uint64_t>(type)) {
+    case count_atom::uint_value():
+      return count{size};
+    case vector_atom::uint_value(): {
+      broker::vector xs;
+      for (count i = 0; i < size; ++i)
+        xs.emplace_back(i);
+      return xs;
+    }
+    case set_atom::uint_value(): {
+      broker::set xs;
+      for (count i = 0; i < size; ++i)
+        xs.emplace(i);
+      return xs;
+    }
+    case table_atom::uint_value(): {
+      broker::table xs;
+      for (count i = 0; i < size; ++i)
+        xs.emplace(i, "value-" + std::to_string(i));
+      return xs;
+    }
+    case record_atom::uint_value(): {
+      // Resembles a connection record of Zeek, padded with `size` bytes.
+      broker::address orig;
+      broker::address resp;
+      convert(string{"10.0.0.1"}, orig);
+      convert(string{"192.168.1.1"}, resp);
+      return broker::vector{
+        broker::vector{orig, broker::port{49152, broker::port::protocol::tcp},
+                       resp, broker::port{443, broker::port::protocol::tcp}},
+        "CHhAvVGS1DHFjwGM9",
+        broker::now(),
+        broker::timespan{std::chrono::milliseconds(42)},
+        count{1024},
+        count{4096},
+        "SF",
+        broker::set{"http", "ssl"},
+        string(size, 'x'),
+      };
+    }
+    default:
+      return string(size, 'x');
+  }
+}
+
+
 broker::data make_pong_msg(count id) {
   return broker::vector{"pong", id};
 }
@@ -272,45 +364,150 @@ void relay_mode(broker::endpoint& ep, broker::topic topic) {
   }
 }
 
-void ping_mode(broker::endpoint& ep, broker::topic topic) {
-  verbose::println("send pings to topic ", topic);
-  std::vector<timespan> xs;
-  auto n = get_or(ep, "num-pings", default_ping_count);
-  auto s = get_or(ep, "payload-size", default_payload_size);
-  if (n == 0) {
-    err::println("send no pings: n = 0");
-    return;
+/// Parameters for sending pings, read from the configuration.
+struct ping_params {
+  size_t num_pings;
+  broker::data payload;
+  double rate;
+  timespan rendezvous_retry;
+  timespan drain_timeout;
+  bool raw;
+
+  explicit ping_params(broker::endpoint& ep)
+    : num_pings(get_or(ep, "num-pings", default_ping_count)),
+      payload(make_payload(get_or(ep, "payload-type", atom("string")),
+                           get_or(ep, "payload-size", default_payload_size))),
+      rate(get_or(ep, "rate", default_ping_rate)),
+      rendezvous_retry(get_or(ep, "rendezvous-retry",
+                              default_rendezvous_retry)),
+      drain_timeout(get_or(ep, "drain-timeout", default_drain_timeout)),
+      raw(get_or(ep, "raw", false)) {
+    // nop
   }
-  auto in = ep.make_subscriber({topic});
-  // Rendezvous between ping and pong. The first ping (id 0) is not part of our
-  // measurement. We repeat this initial message until we receive a pong to
-  // make sure all broker nodes are up and running.
-  bool connected = false;
-  auto retry_timeout = get_or(ep, "rendezvous-retry", default_rendezvous_retry);
+};
+
+/// Round-trip times of a ping run in nanoseconds.
+struct ping_result {
+  broker::detail::hdr_histogram rtt;
+  size_t lost = 0;
+};
+
+/// Repeats the first ping (id 0) until we receive a pong to make sure all
+/// broker nodes are up and running. The first ping is not part of our
+/// measurement.
+void rendezvous(broker::endpoint& ep, broker::subscriber& in,
+                const broker::topic& topic, const ping_params& ps) {
   ep.publish(topic, make_ping_msg(0, 0));
-  while (!connected) {
-    auto x = in.get(caf::duration{retry_timeout});
+  for (;;) {
+    auto x = in.get(caf::duration{ps.rendezvous_retry});
     if (x && is_pong_msg(x->second, 0))
-      connected = true;
-    else
-      ep.publish(topic, make_ping_msg(0, 0));
+      return;
+    ep.publish(topic, make_ping_msg(0, 0));
   }
-  // Measurement.
-  timespan total_time{0};
-  for (count i = 1; i <= n; ++i) {
+}
+
+/// Sends one ping at a time and waits for its pong.
+void closed_loop(broker::endpoint& ep, broker::subscriber& in,
+                 const broker::topic& topic, const ping_params& ps,
+                 ping_result& result) {
+  for (count i = 1; i <= ps.num_pings; ++i) {
     bool done = false;
-    auto t0 = std::chrono::system_clock::now();
-    ep.publish(topic, make_ping_msg(i, s));
+    auto t0 = std::chrono::steady_clock::now();
+    ep.publish(topic, make_ping_msg(i, ps.payload));
     do {
       auto x = in.get();
       done = is_pong_msg(x.second, i);
     } while (!done);
-    auto t1 = std::chrono::system_clock::now();
+    auto t1 = std::chrono::steady_clock::now();
     auto roundtrip = std::chrono::duration_cast<timespan>(t1 - t0);
-    total_time += roundtrip;
-    out::println(roundtrip.count());
+    result.rtt.record(static_cast<uint64_t>(roundtrip.count()));
+    if (ps.raw)
+      out::println(roundtrip.count());
   }
-  verbose::println("AVG: ", total_time / n);
+}
+
+/// Sends pings at a fixed rate from a background thread, regardless of
+/// outstanding pongs. Measures each round trip from the *scheduled* send time
+/// to avoid hiding queueing delays when the sender falls behind.
+void open_loop(broker::endpoint& ep, broker::subscriber& in,
+               const broker::topic& topic, const ping_params& ps,
+               ping_result& result) {
+  using clock_type = std::chrono::steady_clock;
+  auto n = ps.num_pings;
+  std::vector<clock_type::time_point> scheduled(n + 1);
+  auto interval = std::chrono::duration_cast<clock_type::duration>(
+    std::chrono::duration<double>(1. / ps.rate));
+  auto start = clock_type::now();
+  for (count i = 1; i <= n; ++i)
+    scheduled[i] = start + interval * static_cast<int64_t>(i - 1);
+  std::atomic<bool> sender_done{false};
+  std::thread sender{[&] {
+    for (count i = 1; i <= n; ++i) {
+      std::this_thread::sleep_until(scheduled[i]);
+      ep.publish(topic, make_ping_msg(i, ps.payload));
+    }
+    sender_done = true;
+  }};
+  std::vector<bool> received(n + 1);
+  size_t num_received = 0;
+  auto deadline = clock_type::time_point::max();
+  while (num_received < n && clock_type::now() < deadline) {
+    auto x = in.get(caf::duration{ps.rendezvous_retry});
+    if (sender_done && deadline == clock_type::time_point::max())
+      deadline = clock_type::now() + ps.drain_timeout;
+    if (!x || !is_pong_msg(x->second))
+      continue;
+    auto id = msg_id(x->second);
+    if (id == 0 || id > n || received[id])
+      continue;
+    auto roundtrip = std::chrono::duration_cast<timespan>(clock_type::now()
+                                                          - scheduled[id]);
+    received[id] = true;
+    ++num_received;
+    result.rtt.record(static_cast<uint64_t>(roundtrip.count()));
+    if (ps.raw)
+      out::println(roundtrip.count());
+  }
+  sender.join();
+  result.lost = n - num_received;
+}
+
+ping_result run_pings(broker::endpoint& ep, const broker::topic& topic,
+                      const ping_params& ps) {
+  ping_result result;
+  auto in = ep.make_subscriber({topic});
+  rendezvous(ep, in, topic, ps);
+  if (ps.rate > 0)
+    open_loop(ep, in, topic, ps, result);
+  else
+    closed_loop(ep, in, topic, ps, result);
+  return result;
+}
+
+string format_us(double ns) {
+  auto str = std::to_string(ns / 1000.);
+  // Keep two decimal places.
+  return str.substr(0, str.find('.') + 3) + "us";
+}
+
+void print_summary(const string& label, const ping_result& x) {
+  auto& h = x.rtt;
+  auto p = [&](double pct) {
+    return format_us(static_cast<double>(h.percentile(pct)));
+  };
+  out::println(label, ": count=", h.count(), " lost=", x.lost,
+               " mean=", format_us(h.mean()), " p50=", p(50), " p99=", p(99),
+               " p99.9=", p(99.9), " max=", format_us(h.max()));
+}
+
+void ping_mode(broker::endpoint& ep, broker::topic topic) {
+  verbose::println("send pings to topic ", topic);
+  ping_params ps{ep};
+  if (ps.num_pings == 0) {
+    err::println("send no pings: n = 0");
+    return;
+  }
+  print_summary("rtt", run_pings(ep, topic, ps));
 }
 
 void pong_mode(broker::endpoint& ep, broker::topic topic) {
@@ -328,6 +525,85 @@ void pong_mode(broker::endpoint& ep, broker::topic topic) {
   }
 }
 
+/// Runs pings through `num_relays` relays that only forward messages. In a
+/// chain, each relay adds one hop between ping and pong. In a star, a single
+/// hub connects ping, pong, and `num_relays - 1` further leaves that all
+/// forward the topic, i.e., the hub fans out to every leaf.
+ping_result run_topology(atom_value shape, size_t num_relays,
+                         const broker::topic& topic, const ping_params& ps) {
+  using endpoint_ptr = std::unique_ptr<broker::endpoint>;
+  auto make_node = [] {
+    broker::configuration cfg;
+    return endpoint_ptr{new broker::endpoint(std::move(cfg))};
+  };
+  auto connect = [](broker::endpoint& from, broker::endpoint& to) {
+    auto port = to.listen("127.0.0.1", 0);
+    if (port == 0 || !from.peer("127.0.0.1", port))
+      err::println("failed to connect nodes");
+  };
+  auto ping = make_node();
+  auto pong = make_node();
+  std::vector<endpoint_ptr> relays;
+  for (size_t i = 0; i < num_relays; ++i) {
+    relays.emplace_back(make_node());
+    relays.back()->forward({topic});
+  }
+  if (relays.empty()) {
+    connect(*ping, *pong);
+  } else if (shape == atom("chain")) {
+    connect(*ping, *relays.front());
+    for (size_t i = 1; i < relays.size(); ++i)
+      connect(*relays[i - 1], *relays[i]);
+    connect(*relays.back(), *pong);
+  } else {
+    auto& hub = *relays.front();
+    connect(*ping, hub);
+    connect(*pong, hub);
+    for (size_t i = 1; i < relays.size(); ++i)
+      connect(*relays[i], hub);
+  }
+  std::thread responder{[&] { pong_mode(*pong, topic); }};
+  auto result = run_pings(*ping, topic, ps);
+  ping->publish(topic, make_stop_msg());
+  responder.join();
+  return result;
+}
+
+void topology_mode(broker::endpoint& ep, broker::topic topic,
+                   atom_value shape) {
+  ping_params ps{ep};
+  if (ps.num_pings == 0) {
+    err::println("send no pings: n = 0");
+    return;
+  }
+  auto n = get_or(ep, "relays", default_num_relays);
+  verbose::println("measure baseline without relays");
+  auto baseline = run_topology(shape, 0, topic, ps);
+  print_summary("baseline", baseline);
+  verbose::println("measure ", to_string(shape), " with ", n, " relays");
+  auto result = run_topology(shape, n, topic, ps);
+  print_summary(to_string(shape), result);
+  if (n == 0)
+    return;
+  // A chain adds one hop per relay, a star adds only the hub.
+  auto hops = shape == atom("chain") ? static_cast<double>(n) : 1.;
+  auto added = [&](double pct) {
+    auto x = static_cast<double>(result.rtt.percentile(pct));
+    auto y = static_cast<double>(baseline.rtt.percentile(pct));
+    return format_us((x - y) / hops);
+  };
+  out::println("per-hop: p50=", added(50), " p99=", added(99),
+               " p99.9=", added(99.9));
+}
+
+void chain_mode(broker::endpoint& ep, broker::topic topic) {
+  topology_mode(ep, std::move(topic), chain_atom::value);
+}
+
+void star_mode(broker::endpoint& ep, broker::topic topic) {
+  topology_mode(ep, std::move(topic), star_atom::value);
+}
+
 } // namespace <anonymous>
 
 // -- main function ------------------------------------------------------------
@@ -392,6 +668,12 @@ int main(int argc, char** argv) {
     case pong_atom::uint_value():
       f = pong_mode;
       break;
+    case chain_atom::uint_value():
+      f = chain_mode;
+      break;
+    case star_atom::uint_value():
+      f = star_mode;
+      break;
     default:
       err::println("invalid mode: ", mode);
       return EXIT_FAILURE;
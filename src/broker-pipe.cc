@@ -3,23 +3,27 @@
 #include <cstddef>
 #include <cstdint>
 #include <sys/select.h>
+#include <unistd.h>
 #include <utility>
 #include <algorithm>
 #include <chrono>
 #include <exception>
 #include <iterator>
 #include <limits>
+#include <map>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <thread>
 #include <mutex>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated"
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#include <caf/after.hpp>
 #include <caf/atom.hpp>
 #include <caf/behavior.hpp>
 #include <caf/deep_to_string.hpp>
@@ -27,6 +31,8 @@
 #include <caf/event_based_actor.hpp>
 #include <caf/exit_reason.hpp>
 #include <caf/send.hpp>
+#include <caf/stream_deserializer.hpp>
+#include <caf/stream_serializer.hpp>
 #include <caf/config_option_adder.hpp>
 #pragma GCC diagnostic pop
 
@@ -40,6 +46,8 @@
 #include "broker/subscriber.hh"
 #include "broker/topic.hh"
 
+#include "broker/detail/json.hh"
+
 using broker::data;
 using broker::topic;
 
@@ -54,6 +62,10 @@ using blocking_atom = atom_constant<atom("blocking")>;
 using select_atom = atom_constant<atom("select")>;
 using stream_atom = atom_constant<atom("stream")>;
 
+using text_atom = atom_constant<atom("text")>;
+using binary_atom = atom_constant<atom("binary")>;
+using json_atom = atom_constant<atom("json")>;
+
 std::mutex cout_mtx;
 
 using guard_type = std::unique_lock<std::mutex>;
@@ -61,11 +73,265 @@ using guard_type = std::unique_lock<std::mutex>;
 bool rate = false;
 std::atomic<size_t> msg_count{0};
 
+atom_value format = text_atom::value;
+
+// Size of the buffers for reading from STDIN and writing to STDOUT.
+constexpr size_t io_buffer_size = 1024 * 1024;
+
+// Upper bound for binary frames, protecting against corrupted input.
+constexpr size_t max_frame_size = 1024 * 1024 * 1024;
+
+// Maximum time the output of the stream mode may linger in the buffer.
+constexpr auto max_output_delay = std::chrono::milliseconds(100);
+
+using message = std::pair<topic, data>;
+
 void print_line(std::ostream& out, const std::string& line) {
   guard_type guard{cout_mtx};
   out << line << std::endl;
 }
 
+// Reads messages from STDIN in large chunks. Depending on the format, each
+// message is a line of text published under the default topic, a frame with a
+// 32-bit length in network byte order followed by the serialized topic and
+// data, or a line with a JSON object of the form `{"topic": ..., "data":
+// ...}`. The topic is optional for JSON lines.
+class input_reader {
+public:
+  explicit input_reader(std::string default_topic)
+    : default_topic_(std::move(default_topic)),
+      buf_(io_buffer_size),
+      pos_(0),
+      end_(0) {
+    // nop
+  }
+
+  // Reads the next message. Returns `false` at the end of the input or if
+  // the input is malformed.
+  bool read(message& x) {
+    if (format == binary_atom::value)
+      return read_frame(x);
+    std::string line;
+    if (format == json_atom::value) {
+      for (;;) {
+        if (!read_line(line))
+          return false;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+          continue;
+        if (parse_json(line, x))
+          return true;
+        print_line(std::cerr, "*** invalid JSON message: " + line);
+      }
+    }
+    if (!read_line(line))
+      return false;
+    x.first = default_topic_;
+    x.second = std::move(line);
+    return true;
+  }
+
+private:
+  // Appends the next chunk of STDIN to the buffer, growing the buffer if
+  // necessary. Returns `false` at the end of the input.
+  bool fill() {
+    if (pos_ > 0) {
+      std::memmove(buf_.data(), buf_.data() + pos_, end_ - pos_);
+      end_ -= pos_;
+      pos_ = 0;
+    }
+    if (end_ == buf_.size())
+      buf_.resize(buf_.size() * 2);
+    for (;;) {
+      auto n = ::read(STDIN_FILENO, buf_.data() + end_, buf_.size() - end_);
+      if (n > 0) {
+        end_ += static_cast<size_t>(n);
+        return true;
+      }
+      if (n < 0 && errno == EINTR)
+        continue;
+      return false;
+    }
+  }
+
+  bool read_line(std::string& line) {
+    size_t searched = pos_;
+    for (;;) {
+      auto first = buf_.data() + searched;
+      auto nl = static_cast<char*>(std::memchr(first, '\n', end_ - searched));
+      if (nl != nullptr) {
+        line.assign(buf_.data() + pos_, nl);
+        pos_ = static_cast<size_t>(nl - buf_.data()) + 1;
+        return true;
+      }
+      searched = end_ - pos_;
+      if (!fill()) {
+        if (pos_ == end_)
+          return false;
+        // Last line without trailing newline.
+        line.assign(buf_.data() + pos_, buf_.data() + end_);
+        pos_ = end_;
+        return true;
+      }
+    }
+  }
+
+  bool read_frame(message& x) {
+    auto available = [&] { return end_ - pos_; };
+    while (available() < 4)
+      if (!fill())
+        return truncated();
+    auto hdr = reinterpret_cast<const uint8_t*>(buf_.data() + pos_);
+    auto len = (size_t{hdr[0]} << 24) | (size_t{hdr[1]} << 16)
+               | (size_t{hdr[2]} << 8) | size_t{hdr[3]};
+    if (len > max_frame_size) {
+      print_line(std::cerr, "*** frame exceeds maximum size");
+      return false;
+    }
+    while (available() < 4 + len)
+      if (!fill())
+        return truncated();
+    caf::arraybuf<char> sb{buf_.data() + pos_ + 4, len};
+    caf::stream_deserializer<caf::arraybuf<char>&> source{sb};
+    pos_ += 4 + len;
+    if (source(x.first, x.second)) {
+      print_line(std::cerr, "*** invalid frame");
+      return false;
+    }
+    return true;
+  }
+
+  bool truncated() {
+    if (pos_ != end_)
+      print_line(std::cerr, "*** truncated frame at end of input");
+    return false;
+  }
+
+  bool parse_json(const std::string& line, message& x) {
+    using namespace broker::detail;
+    auto first = line.data();
+    auto last = first + line.size();
+    auto has_data = false;
+    x.first = default_topic_;
+    if (!json_consume(first, last, '{'))
+      return false;
+    if (!json_consume(first, last, '}')) {
+      std::string key;
+      do {
+        if (!json_decode_string(first, last, key)
+            || !json_consume(first, last, ':'))
+          return false;
+        if (key == "topic") {
+          std::string str;
+          if (!json_decode_string(first, last, str))
+            return false;
+          x.first = std::move(str);
+        } else if (key == "data") {
+          if (!json_decode(first, last, x.second))
+            return false;
+          has_data = true;
+        } else if (!json_skip(first, last)) {
+          return false;
+        }
+      } while (json_consume(first, last, ','));
+      if (!json_consume(first, last, '}'))
+        return false;
+    }
+    json_skip_whitespace(first, last);
+    return has_data && first == last;
+  }
+
+  topic default_topic_;
+  std::vector<char> buf_;
+  size_t pos_;
+  size_t end_;
+};
+
+// Collects messages in the binary or JSON format and writes them to STDOUT
+// in large chunks.
+class output_writer {
+public:
+  output_writer() : last_flush_(std::chrono::steady_clock::now()) {
+    buf_.reserve(io_buffer_size);
+  }
+
+  void write(message& x) {
+    if (format == binary_atom::value) {
+      auto offset = buf_.size();
+      buf_.append(4, '\0');
+      caf::containerbuf<std::string> sb{buf_};
+      caf::stream_serializer<caf::containerbuf<std::string>&> sink{sb};
+      sink(x.first, x.second);
+      auto len = buf_.size() - offset - 4;
+      for (size_t i = 0; i < 4; ++i)
+        buf_[offset + i] = static_cast<char>((len >> (24 - 8 * i)) & 0xff);
+    } else {
+      buf_ += "{\"topic\":";
+      broker::detail::json_encode_string(buf_, x.first.string());
+      buf_ += ",\"data\":";
+      broker::detail::json_encode(buf_, x.second);
+      buf_ += "}\n";
+    }
+  }
+
+  // Returns whether the buffer exceeds its capacity.
+  bool full() const {
+    return buf_.size() >= io_buffer_size;
+  }
+
+  // Returns whether the buffer exceeds its capacity or holds data for longer
+  // than `max_output_delay`.
+  bool due() const {
+    return full()
+           || (!buf_.empty()
+               && std::chrono::steady_clock::now() - last_flush_
+                  >= max_output_delay);
+  }
+
+  void flush() {
+    last_flush_ = std::chrono::steady_clock::now();
+    size_t written = 0;
+    while (written < buf_.size()) {
+      auto n = ::write(STDOUT_FILENO, buf_.data() + written,
+                       buf_.size() - written);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        print_line(std::cerr, "write() failed, errno: "
+                              + std::to_string(errno));
+        break;
+      }
+      written += static_cast<size_t>(n);
+    }
+    buf_.clear();
+  }
+
+private:
+  std::string buf_;
+  std::chrono::steady_clock::time_point last_flush_;
+};
+
+output_writer writer;
+
+// Guards `writer` when a worker actor and the main thread share it.
+std::mutex writer_mtx;
+
+void print_message(message& x) {
+  if (format == text_atom::value)
+    print_line(std::cout, deep_to_string(x));
+  else
+    writer.write(x);
+}
+
+// Returns a publisher for `t`, creating it on first use.
+broker::publisher& publisher_for(broker::endpoint& ep,
+                                 std::map<std::string, broker::publisher>& xs,
+                                 const topic& t) {
+  auto i = xs.find(t.string());
+  if (i == xs.end())
+    i = xs.emplace(t.string(), ep.make_publisher(t)).first;
+  return i->second;
+}
+
 class config : public broker::configuration {
 public:
   atom_value mode = atom("");
@@ -89,6 +355,8 @@ public:
          "set mode ('publish' or 'subscribe')")
     .add(impl, "impl,i",
          "set mode implementation ('blocking', 'select', or 'stream')")
+    .add(format, "format,f",
+         "set I/O format ('text', 'binary', or 'json')")
     .add(message_cap, "message-cap,c",
          "set a maximum for received/sent messages");
   }
@@ -96,57 +364,54 @@ public:
 
 void publish_mode_blocking(broker::endpoint& ep, const std::string& topic_str,
                            size_t cap) {
-  auto out = ep.make_publisher(topic_str);
-  std::string line;
-  size_t i = 0;
-  while (std::getline(std::cin, line) && i++ < cap) {
-    out.publish(std::move(line));
+  std::map<std::string, broker::publisher> outs;
+  input_reader in{topic_str};
+  message msg;
+  for (size_t i = 0; i < cap && in.read(msg); ++i) {
+    publisher_for(ep, outs, msg.first).publish(std::move(msg.second));
     ++msg_count;
   }
 }
 
 void publish_mode_select(broker::endpoint& ep, const std::string& topic_str,
                          size_t cap) {
-  auto out = ep.make_publisher(topic_str);
-  auto fd = out.fd();
-  std::string line;
+  std::map<std::string, broker::publisher> outs;
+  input_reader in{topic_str};
+  message msg;
   fd_set readset;
-  size_t i = 0;
-  while (i < cap) {
-    FD_ZERO(&readset);
-    FD_SET(fd, &readset);
-    if (select(fd + 1, &readset, NULL, NULL, NULL) <= 0) {
-      print_line(std::cerr, "select() failed, errno: " + std::to_string(errno));
-      return;
+  for (size_t i = 0; i < cap && in.read(msg); ++i) {
+    auto& out = publisher_for(ep, outs, msg.first);
+    if (out.free_capacity() == 0) {
+      auto fd = out.fd();
+      FD_ZERO(&readset);
+      FD_SET(fd, &readset);
+      if (select(fd + 1, &readset, NULL, NULL, NULL) <= 0) {
+        print_line(std::cerr, "select() failed, errno: " + std::to_string(errno));
+        return;
+      }
     }
-    auto num = std::min(cap - i, out.free_capacity());
-    assert(num > 0);
-    for (size_t j = 0; j < num; ++j)
-      if (!std::getline(std::cin, line))
-        return; // Reached end of STDIO.
-      else
-        out.publish(std::move(line));
-    i += num;
-    msg_count += num;
+    out.publish(std::move(msg.second));
+    ++msg_count;
   }
 }
 
 void publish_mode_stream(broker::endpoint& ep, const std::string& topic_str,
                          size_t cap) {
+  input_reader in{topic_str};
   auto worker = ep.publish_all(
     [](size_t& msgs) {
       msgs = 0;
     },
-    [=](size_t& msgs, downstream<std::pair<topic, data>>& out, size_t hint) {
+    [&in, cap](size_t& msgs, downstream<message>& out, size_t hint) {
       auto num = std::min(cap - msgs, hint);
-      std::string line;
+      message msg;
       for (size_t i = 0; i < num; ++i)
-        if (!std::getline(std::cin, line)) {
+        if (!in.read(msg)) {
           // Reached end of STDIO.
           msgs = cap;
           return;
         } else {
-          out.push(std::make_pair(topic_str, std::move(line)));
+          out.push(std::move(msg));
         }
       msgs += num;
       msg_count += num;
@@ -162,12 +427,13 @@ void publish_mode_stream(broker::endpoint& ep, const std::string& topic_str,
 void subscribe_mode_blocking(broker::endpoint& ep, const std::string& topic_str,
                     size_t cap) {
   auto in = ep.make_subscriber({topic_str});
-  std::string line;
   for (size_t i = 0; i < cap; ++i) {
     auto msg = in.get();
     if (!rate)
-      print_line(std::cout, deep_to_string(std::move(msg)));
+      print_message(msg);
     ++msg_count;
+    if (writer.full() || in.available() == 0)
+      writer.flush();
   }
 }
 
@@ -188,8 +454,11 @@ void subscribe_mode_select(broker::endpoint& ep, const std::string& topic_str,
     for (size_t j = 0; j < num; ++j) {
       auto msg = in.get();
       if (!rate)
-        print_line(std::cout, deep_to_string(std::move(msg)));
+        print_message(msg);
+      if (writer.full())
+        writer.flush();
     }
+    writer.flush();
     i += num;
     msg_count += num;
   }
@@ -202,19 +471,39 @@ void subscribe_mode_stream(broker::endpoint& ep, const std::string& topic_str,
     [](size_t& msgs) {
       msgs = 0;
     },
-    [=](size_t& msgs, std::pair<topic, data> x) {
+    [=](size_t& msgs, message x) {
       ++msg_count;
+      guard_type guard{writer_mtx};
       if (!rate)
-        print_line(std::cout, deep_to_string(x));
-      if (++msgs >= cap)
+        print_message(x);
+      if (++msgs >= cap) {
+        writer.flush();
         throw std::runtime_error("Reached cap");
+      }
+      if (writer.full())
+        writer.flush();
     },
     [=](size_t&, const caf::error&) {
       // nop
     }
   );
+  // The worker only runs when messages arrive, so we flush from here after
+  // at most `max_output_delay` when the stream goes idle.
   scoped_actor self{ep.system()};
-  self->wait_for(worker);
+  self->monitor(worker);
+  bool running = true;
+  self->receive_while(running)(
+    [&](const down_msg&) {
+      running = false;
+    },
+    after(max_output_delay) >> [&] {
+      guard_type guard{writer_mtx};
+      if (writer.due())
+        writer.flush();
+    }
+  );
+  guard_type guard{writer_mtx};
+  writer.flush();
 }
 
 behavior event_listener(event_based_actor* self) {
@@ -305,5 +594,6 @@ int main(int argc, char** argv) {
   auto i = std::find(b, std::end(as), std::make_pair(cfg.mode, cfg.impl));
   auto f = fs[std::distance(b, i)];
   f(ep, cfg.topic, cfg.message_cap);
+  writer.flush();
   anon_send_exit(el, exit_reason::user_shutdown);
 }
@@ -22,6 +22,9 @@
 
 #include "broker/configuration.hh"
 
+#include "broker/detail/filter_delta.hh"
+#include "broker/detail/routing_table.hh"
+
 namespace broker {
 
 configuration::configuration(broker_options opts) : options_(std::move(opts)) {
@@ -43,6 +46,9 @@ configuration::configuration(broker_options opts) : options_(std::move(opts)) {
   add_message_type<snapshot>("broker::snapshot");
   add_message_type<internal_command>("broker::internal_command");
   add_message_type<set_command>("broker::set_command");
+  add_message_type<detail::filter_delta>("broker::detail::filter_delta");
+  add_message_type<detail::subscription_announcement>(
+    "broker::detail::subscription_announcement");
   add_message_type<store::stream_type::value_type>(
     "broker::store::stream_type::value_type");
   add_message_type<std::vector<store::stream_type::value_type>>(
@@ -2,6 +2,12 @@
 
 #include "broker/core_actor.hh"
 
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <caf/actor.hpp>
 #include <caf/actor_cast.hpp>
 #include <caf/allowed_unsafe_message_type.hpp>
@@ -38,6 +44,7 @@
 #include "broker/detail/make_backend.hh"
 #include "broker/detail/master_actor.hh"
 #include "broker/detail/master_resolver.hh"
+#include "broker/detail/partitioned_master_actor.hh"
 
 using namespace caf;
 
@@ -61,6 +68,7 @@ result<void> init_peering(caf::stateful_actor<core_state>* self,
   // Create necessary state and send message to remote core.
   st.pending_peers.emplace(remote_core,
                            core_state::pending_peer_state{0, rp});
+  st.handshake_filter_versions[remote_core] = st.filter_version;
   self->send(self * remote_core, atom::peer::value, st.filter, self);
   self->monitor(remote_core);
   return rp;
@@ -112,34 +120,109 @@ core_state::core_state(caf::event_based_actor* ptr)
 void core_state::init(filter_type initial_filter, broker_options opts,
                       endpoint::clock* ep_clock) {
   options = std::move(opts);
-  filter = std::move(initial_filter);
+  filter_type added;
+  filter_type removed;
+  detail::filter_extend(filter, std::move(initial_filter), added, removed);
   cache.set_use_ssl(! options.disable_ssl);
   governor = caf::make_counted<governor_type>(self, this, filter);
+  policy().peers().weights({options.control_lane_weight,
+                            options.store_lane_weight,
+                            options.bulk_lane_weight});
   clock = ep_clock;
+  if (options.routing) {
+    // Node IDs are not unique for endpoints sharing the same process.
+    std::random_device rd;
+    routes.id((detail::endpoint_id{rd()} << 32) | rd());
+    routes.announce(filter);
+  }
 }
 
-void core_state::update_filter_on_peers() {
-  CAF_LOG_TRACE("");
+void core_state::update_filter_on_peers(const detail::filter_delta& x) {
+  CAF_LOG_TRACE(CAF_ARG(x));
+  if (options.routing) {
+    broadcast(routes.announce(filter));
+    return;
+  }
   policy().for_each_peer([&](const actor& hdl) {
-    self->send(hdl, atom::update::value, filter);
+    // Peers that did not announce a filter version yet might not understand
+    // deltas and receive the full filter instead.
+    if (policy().accepts_filter_deltas(hdl))
+      self->send(hdl, atom::update::value, x);
+    else
+      self->send(hdl, atom::update::value, filter);
   });
 }
 
+void core_state::send_filter(const caf::actor& hdl) {
+  CAF_LOG_TRACE(CAF_ARG(hdl));
+  self->send(hdl, atom::update::value,
+             detail::filter_delta{filter_version, true, filter, {}});
+}
+
+void core_state::send_filter_version(const caf::actor& hdl) {
+  CAF_LOG_TRACE(CAF_ARG(hdl));
+  auto i = handshake_filter_versions.find(hdl);
+  if (i != handshake_filter_versions.end() && i->second == filter_version) {
+    // The peer already has this version from the handshake.
+    self->send(hdl, atom::update::value, atom::snapshot::value,
+               filter_version);
+  } else {
+    send_filter(hdl);
+  }
+  if (i != handshake_filter_versions.end())
+    handshake_filter_versions.erase(i);
+}
+
+void core_state::send_routes(const caf::actor& hdl) {
+  CAF_LOG_TRACE(CAF_ARG(hdl));
+  for (auto& x : routes.dump())
+    self->send(hdl, atom::update::value, std::move(x));
+}
+
+void core_state::broadcast(const detail::subscription_announcement& x) {
+  CAF_LOG_TRACE(CAF_ARG(x));
+  policy().for_each_peer([&](const actor& hdl) {
+    self->send(hdl, atom::update::value, x);
+  });
+}
+
+void core_state::handle_announcement(const caf::actor& hdl,
+                                     detail::subscription_announcement x) {
+  CAF_LOG_TRACE(CAF_ARG(hdl) << CAF_ARG(x));
+  if (!policy().has_peer(hdl)) {
+    CAF_LOG_DEBUG("Drop announcement from unknown peer:" << to_string(hdl));
+    return;
+  }
+  auto y = routes.handle(hdl, std::move(x));
+  update_routed_filters();
+  if (y)
+    broadcast(*y);
+}
+
+void core_state::remove_routes(const caf::actor& hdl) {
+  CAF_LOG_TRACE(CAF_ARG(hdl));
+  auto xs = routes.remove_peer(hdl);
+  update_routed_filters();
+  for (auto& x : xs)
+    broadcast(x);
+}
+
+void core_state::update_routed_filters() {
+  // Only peers with a changed set of routes need a new filter.
+  for (auto& hdl : routes.take_changed_peers())
+    if (policy().has_peer(hdl))
+      policy().update_peer(hdl, routes.filter_for(hdl));
+}
+
 void core_state::add_to_filter(filter_type xs) {
   CAF_LOG_TRACE(CAF_ARG(xs));
-  // Get initial size of our filter.
-  auto s0 = filter.size();
-  // Insert new elements then remove duplicates with sort and unique.
-  filter.insert(filter.end(), std::make_move_iterator(xs.begin()),
-                std::make_move_iterator(xs.end()));
-  std::sort(filter.begin(), filter.end());
-  auto e = std::unique(filter.begin(), filter.end());
-  if (e != filter.end())
-    filter.erase(e, filter.end());
-  // Update our peers if we have actually changed our filter.
-  if (s0 != filter.size()) {
+  detail::filter_delta delta{0, false, {}, {}};
+  // Update our peers only if we have actually changed our filter.
+  if (detail::filter_extend(filter, std::move(xs), delta.added,
+                            delta.removed)) {
     CAF_LOG_DEBUG("Changed filter to " << filter);
-    update_filter_on_peers();
+    delta.version = ++filter_version;
+    update_filter_on_peers(delta);
   }
 }
 
@@ -161,46 +244,59 @@ detail::core_policy& core_state::policy() {
   return governor->policy();
 }
 
-static void sync_peer_status(core_state* st, caf::actor new_peer) {
-  auto it = st->peers_awaiting_status_sync.find(new_peer);
-
-  if ( it == st->peers_awaiting_status_sync.end() )
-    return;
-
-  auto& c = it->second;
-  --c;
-
-  if ( c > 0 )
-    return;
-
-  st->peers_awaiting_status_sync.erase(new_peer);
-  st->policy().unblock_peer(std::move(new_peer));
-}
-
 void core_state::sync_with_status_subscribers(caf::actor new_peer) {
-  if ( status_subscribers.empty() ) {
+  if (status_subscribers.empty()) {
     // Just in case it was blocked, then status subscribers got removed
     // before reaching here.
     policy().unblock_peer(new_peer);
     return;
   }
+  // Peers that arrive while the core handles the same burst of messages
+  // share one round. The round starts once the core processed the burst,
+  // i.e., after sending all of their `peer_added` statuses.
+  peers_awaiting_status_sync.emplace_back(std::move(new_peer));
+  if (peers_awaiting_status_sync.size() == 1)
+    self->send(self, atom::sync_point::value, atom::peer::value);
+}
 
-  peers_awaiting_status_sync[new_peer] = status_subscribers.size();
-
-  for ( auto& ss : status_subscribers ) {
+void core_state::start_status_sync_round() {
+  if (peers_awaiting_status_sync.empty())
+    return;
+  // Rounds run independently of each other, so a peer never waits for a
+  // round that started before its `peer_added` status went out.
+  struct round_state {
+    std::vector<caf::actor> peers;
+    size_t pending;
+  };
+  auto round = std::make_shared<round_state>();
+  round->peers.swap(peers_awaiting_status_sync);
+  round->pending = status_subscribers.size();
+  if (round->pending == 0) {
+    finish_status_sync_round(round->peers);
+    return;
+  }
+  for (auto& ss : status_subscribers) {
     auto to = caf::infinite;
     self->request(ss, to, atom::sync_point::value).then(
-      [&, new_peer](atom::sync_point) {
-        sync_peer_status(this, std::move(new_peer));
+      [=](atom::sync_point) {
+        if (--round->pending == 0)
+          finish_status_sync_round(round->peers);
       },
-      [&, ss, new_peer](caf::error& e) {
+      [=](caf::error&) {
         status_subscribers.erase(ss);
-        sync_peer_status(this, std::move(new_peer));
+        if (--round->pending == 0)
+          finish_status_sync_round(round->peers);
       }
     );
   }
 }
 
+void core_state::finish_status_sync_round(
+  const std::vector<caf::actor>& peers) {
+  for (auto& hdl : peers)
+    policy().unblock_peer(hdl);
+}
+
 void core_state::emit_peer_added_status(caf::actor hdl, const char* msg) {
   auto emit = [=](network_info x) {
     BROKER_INFO("status" << sc::peer_added << x);
@@ -234,6 +330,7 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
         i->second.rp.deliver(down.reason);
         st.pending_peers.erase(i);
       }
+      st.handshake_filter_versions.erase(hdl);
       /* TODO: still needed? Already tracked by governor.
       BROKER_INFO("got DOWN from peer" << to_string(down.source));
       auto peers = &self->state.peers;
@@ -279,6 +376,9 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
       rt.try_once(self);
     },
     [=](detail::retry_state& rt) { rt.try_once(self); },
+    [=](atom::sync_point, atom::peer) {
+      self->state.start_status_sync_round();
+    },
     // --- 3-way handshake for establishing peering streams between A and B ----
     // --- A (this node) performs steps #1 and #3; B performs #2 and #4 --------
     // Step #1: - A demands B shall establish a stream back to A
@@ -299,6 +399,7 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
       }
       CAF_LOG_DEBUG("received handshake step #1" << CAF_ARG(peer_hdl)
                     << CAF_ARG(actor{self}));
+      st.handshake_filter_versions[peer_hdl] = st.filter_version;
       // Start CAF stream.
       return st.policy().start_peering<true>(peer_hdl, std::move(peer_ts));
     },
@@ -317,6 +418,10 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
         st.policy().block_peer(peer_hdl);
       st.policy().ack_peering(in, peer_hdl);
       st.policy().start_peering<false>(peer_hdl, std::move(filter));
+      if (st.options.routing)
+        st.send_routes(peer_hdl);
+      else
+        st.send_filter_version(peer_hdl);
       // Emit peer added event.
       st.emit_peer_added_status(peer_hdl, "received handshake from remote core");
       // Send handle to the actor that initiated a peering (if available).
@@ -343,6 +448,10 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
         st.policy().block_peer(peer_hdl);
       st.emit_peer_added_status(peer_hdl, "handshake successful");
       st.policy().ack_peering(in, peer_hdl);
+      if (st.options.routing)
+        st.send_routes(peer_hdl);
+      else
+        st.send_filter_version(peer_hdl);
     },
     // --- asynchronous communication to peers ---------------------------------
     [=](atom::update, filter_type f) {
@@ -353,9 +462,69 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
         CAF_LOG_DEBUG("Received anonymous filter update.");
         return;
       }
+      if (st.options.routing) {
+        CAF_LOG_DEBUG("Ignore filter update in routing mode.");
+        return;
+      }
       if (!st.policy().update_peer(p, std::move(f)))
         CAF_LOG_DEBUG("Cannot update filter of unknown peer:" << to_string(p));
     },
+    [=](atom::update, detail::filter_delta& x) {
+      CAF_LOG_TRACE(CAF_ARG(x));
+      auto& st = self->state;
+      auto p = caf::actor_cast<caf::actor>(self->current_sender());
+      if (p == nullptr) {
+        CAF_LOG_DEBUG("Received anonymous filter update.");
+        return;
+      }
+      if (st.options.routing) {
+        CAF_LOG_DEBUG("Ignore filter update in routing mode.");
+        return;
+      }
+      if (!st.policy().update_peer(p, std::move(x))) {
+        CAF_LOG_DEBUG("Missed a filter update, request snapshot from:"
+                      << to_string(p));
+        self->send(p, atom::update::value, atom::snapshot::value);
+      }
+    },
+    [=](atom::update, atom::snapshot, uint64_t version) {
+      auto& st = self->state;
+      auto p = caf::actor_cast<caf::actor>(self->current_sender());
+      if (p == nullptr) {
+        CAF_LOG_DEBUG("Received anonymous filter version.");
+        return;
+      }
+      if (st.options.routing) {
+        CAF_LOG_DEBUG("Ignore filter version in routing mode.");
+        return;
+      }
+      if (!st.policy().update_peer(p, version))
+        CAF_LOG_DEBUG("Cannot set filter version of unknown peer:"
+                      << to_string(p));
+    },
+    [=](atom::update, atom::snapshot) {
+      auto& st = self->state;
+      auto p = caf::actor_cast<caf::actor>(self->current_sender());
+      if (p == nullptr || !st.policy().has_peer(p)) {
+        CAF_LOG_DEBUG("Drop snapshot request from unknown peer.");
+        return;
+      }
+      st.send_filter(p);
+    },
+    [=](atom::update, detail::subscription_announcement& x) {
+      CAF_LOG_TRACE(CAF_ARG(x));
+      auto& st = self->state;
+      auto p = caf::actor_cast<caf::actor>(self->current_sender());
+      if (p == nullptr) {
+        CAF_LOG_DEBUG("Received anonymous subscription announcement.");
+        return;
+      }
+      if (!st.options.routing) {
+        CAF_LOG_DEBUG("Ignore subscription announcement without routing.");
+        return;
+      }
+      st.handle_announcement(p, std::move(x));
+    },
     // --- communication to local actors: incoming streams and subscriptions ---
     [=](atom::join, filter_type& filter) {
       CAF_LOG_TRACE(CAF_ARG(filter));
@@ -390,6 +559,13 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
       CAF_LOG_TRACE(CAF_ARG(t) << CAF_ARG(x));
       self->state.policy().push(std::move(t), std::move(x));
     },
+    // --- change events go to local subscribers and to peers -----------------
+    [=](atom::publish, atom::changes, topic& t, data& x) {
+      CAF_LOG_TRACE(CAF_ARG(t) << CAF_ARG(x));
+      auto& pol = self->state.policy();
+      pol.local_push(t, x);
+      pol.push(std::move(t), std::move(x));
+    },
     // --- communication to local actors only, i.e., never forward to peers ----
     [=](atom::publish, atom::local, topic& t, data& x) {
       CAF_LOG_TRACE(CAF_ARG(t) << CAF_ARG(x));
@@ -442,12 +618,68 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
         BROKER_WARNING("remote master with same name exists already");
         return ec::master_exists;
       }
-      BROKER_INFO("instantiating backend");
-      auto ptr = detail::make_backend(backend_type, std::move(opts));
-      BROKER_ASSERT(ptr);
-      BROKER_INFO("spawning new master");
-      auto ms = self->spawn<caf::linked + caf::lazy_init>(
-              detail::master_actor, self, name, std::move(ptr), clock);
+      // The option `shards` is not meant for the backend but selects a
+      // partitioned master that spreads the keys over several backends.
+      count num_shards = 1;
+      auto j = opts.find("shards");
+      if (j != opts.end()) {
+        auto n = caf::get_if<count>(&j->second);
+        if (!n || *n == 0) {
+          BROKER_ERROR("option 'shards' requires a positive count");
+          return ec::invalid_data;
+        }
+        num_shards = *n;
+        opts.erase(j);
+      }
+      // Likewise, the option `coalesce` sets the window in which the master
+      // merges updates for clones.
+      timespan coalesce_window{0};
+      auto k = opts.find("coalesce");
+      if (k != opts.end()) {
+        auto w = caf::get_if<timespan>(&k->second);
+        if (!w || *w < timespan{0}) {
+          BROKER_ERROR("option 'coalesce' requires a non-negative timespan");
+          return ec::invalid_data;
+        }
+        coalesce_window = *w;
+        opts.erase(k);
+      }
+      caf::actor ms;
+      if (num_shards > 1) {
+        BROKER_INFO("instantiating" << num_shards << "backends");
+        std::vector<detail::master_state::backend_pointer> backends;
+        backends.reserve(num_shards);
+        for (count i = 0; i < num_shards; ++i) {
+          // Shard i stores its data under `path` with the suffix `.i`.
+          auto shard_opts = opts;
+          auto p = shard_opts.find("path");
+          if (p != shard_opts.end())
+            if (auto path = caf::get_if<std::string>(&p->second))
+              *path += "." + std::to_string(i);
+          auto ptr = detail::make_backend(backend_type, std::move(shard_opts));
+          if (!ptr) {
+            BROKER_ERROR("failed to instantiate backend for shard" << i);
+            return ec::backend_failure;
+          }
+          backends.emplace_back(std::move(ptr));
+        }
+        BROKER_INFO("spawning new partitioned master with" << num_shards
+                    << "shards");
+        ms = self->spawn<caf::linked + caf::lazy_init>(
+          detail::partitioned_master_actor, self, name, std::move(backends),
+          clock, coalesce_window);
+      } else {
+        BROKER_INFO("instantiating backend");
+        auto ptr = detail::make_backend(backend_type, std::move(opts));
+        if (!ptr) {
+          BROKER_ERROR("failed to instantiate backend");
+          return ec::backend_failure;
+        }
+        BROKER_INFO("spawning new master");
+        ms = self->spawn<caf::linked + caf::lazy_init>(
+          detail::master_actor, self, name, std::move(ptr), clock,
+          coalesce_window);
+      }
       st.masters.emplace(name, ms);
       // Initiate stream handshake and add subscriber to the governor.
       using value_type = store::stream_type::value_type;
@@ -467,7 +699,8 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
     },
     [=](atom::store, atom::clone, atom::attach, std::string& name,
         double resync_interval, double stale_interval,
-        double mutation_buffer_interval) -> caf::result<caf::actor> {
+        double mutation_buffer_interval, double write_coalesce_interval,
+        size_t write_coalesce_size) -> caf::result<caf::actor> {
       BROKER_INFO("attaching clone:" << name);
 
       auto i = self->state.masters.find(name);
@@ -488,7 +721,8 @@ caf::behavior core_actor(caf::stateful_actor<core_state>* self,
       BROKER_INFO("spawning new clone");
       auto clone = self->spawn<linked + lazy_init>(
               detail::clone_actor, self, name, resync_interval, stale_interval,
-              mutation_buffer_interval, clock);
+              mutation_buffer_interval, write_coalesce_interval,
+              write_coalesce_size, clock);
       auto cptr = actor_cast<strong_actor_ptr>(clone);
       auto& st = self->state;
       st.clones.emplace(name, clone);
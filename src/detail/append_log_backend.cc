@@ -0,0 +1,777 @@
+#include "broker/logger.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <caf/stream_deserializer.hpp>
+#include <caf/stream_serializer.hpp>
+
+#include "broker/error.hh"
+#include "broker/expected.hh"
+#include "broker/optional.hh"
+
+#include "broker/detail/append_log_backend.hh"
+#include "broker/detail/assert.hh"
+#include "broker/detail/blob.hh"
+#include "broker/detail/filesystem.hh"
+#include "broker/detail/make_unique.hh"
+
+namespace broker {
+namespace detail {
+
+// The backend stores its state in a directory with two files:
+//
+//   - `log`: a file header (magic + file ID) followed by records, each
+//            consisting of a 4-byte payload size, a 4-byte checksum of the
+//            payload and the payload itself.
+//   - `index`: a checkpoint of the in-memory index, tagged with the file ID
+//              of the log and the number of log bytes it covers.
+//
+// A payload starts with the record type. Put records continue with value,
+// expiry and key, erase records with the key only. Placing the value first
+// allows lookups to stop deserializing early.
+//
+// On startup, we load the index checkpoint if its file ID matches the log and
+// then scan all records past the covered range. Scanning stops at the first
+// incomplete or corrupted record and truncates the log at this point, since
+// only a crash during a write can cause it. Compaction and clear() assign a
+// fresh file ID, which invalidates all previous checkpoints.
+namespace {
+
+constexpr char log_magic[] = {'B', 'R', 'O', 'K', 'E', 'R', 'L', '1'};
+
+constexpr char index_magic[] = {'B', 'R', 'O', 'K', 'E', 'R', 'I', '1'};
+
+constexpr size_t file_header_size = sizeof(log_magic) + sizeof(uint64_t);
+
+constexpr size_t record_header_size = 2 * sizeof(uint32_t);
+
+enum record_type : uint8_t {
+  put_record = 1,
+  erase_record = 2,
+};
+
+uint32_t checksum(const char* buf, size_t size) {
+  // FNV-1a, which suffices for detecting torn writes.
+  uint32_t result = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    result ^= static_cast<uint8_t>(buf[i]);
+    result *= 16777619u;
+  }
+  return result;
+}
+
+uint64_t make_file_id() {
+  std::random_device rd;
+  return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+using deserializer = caf::stream_deserializer<caf::arraybuf<char>&>;
+
+template <class... Ts>
+bool deserialize(const char* buf, size_t size, Ts&... xs) {
+  caf::arraybuf<char> sb{const_cast<char*>(buf), size};
+  deserializer source{sb};
+  return !source(xs...);
+}
+
+bool write_all(int fd, const char* buf, size_t size, uint64_t offset) {
+  while (size > 0) {
+    auto n = ::pwrite(fd, buf, size, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    buf += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+bool read_all(int fd, char* buf, size_t size, uint64_t offset) {
+  while (size > 0) {
+    auto n = ::pread(fd, buf, size, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (n == 0)
+      return false;
+    buf += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+std::string make_file_header(uint64_t file_id) {
+  std::string result{log_magic, sizeof(log_magic)};
+  result.append(reinterpret_cast<const char*>(&file_id), sizeof(file_id));
+  return result;
+}
+
+void append_record(std::string& buf, const std::string& payload) {
+  uint32_t header[] = {static_cast<uint32_t>(payload.size()),
+                       checksum(payload.data(), payload.size())};
+  buf.append(reinterpret_cast<const char*>(header), sizeof(header));
+  buf += payload;
+}
+
+} // namespace <anonymous>
+
+struct append_log_backend::impl {
+  struct entry {
+    uint64_t offset;
+    uint32_t size;
+    optional<timestamp> expiry;
+  };
+
+  using index_type = std::unordered_map<data, entry>;
+
+  // -- initialization and teardown --------------------------------------------
+
+  bool open(const std::string& dir) {
+    if (!mkdirs(dir)) {
+      BROKER_ERROR("failed to create database dir:" << dir);
+      return false;
+    }
+    log_path = dir + "/log";
+    index_path = dir + "/index";
+    fd = ::open(log_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      BROKER_ERROR("failed to open log file:" << log_path);
+      return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      BROKER_ERROR("failed to stat log file:" << log_path);
+      return false;
+    }
+    auto file_size = static_cast<uint64_t>(st.st_size);
+    if (file_size == 0) {
+      if (!reset_log())
+        return false;
+      file_size = file_header_size;
+    } else if (!read_file_header(file_size)) {
+      return false;
+    }
+    flushed = file_size;
+    auto start = load_checkpoint(file_size);
+    if (!start)
+      start = file_header_size;
+    return recover(start, file_size);
+  }
+
+  bool read_file_header(uint64_t file_size) {
+    char buf[file_header_size];
+    if (file_size < file_header_size || !read_all(fd, buf, sizeof(buf), 0)
+        || std::memcmp(buf, log_magic, sizeof(log_magic)) != 0) {
+      BROKER_ERROR("not a valid log file:" << log_path);
+      return false;
+    }
+    std::memcpy(&file_id, buf + sizeof(log_magic), sizeof(file_id));
+    return true;
+  }
+
+  // Truncates the log to an empty file with a fresh ID.
+  bool reset_log() {
+    file_id = make_file_id();
+    auto header = make_file_header(file_id);
+    if (::ftruncate(fd, 0) != 0
+        || !write_all(fd, header.data(), header.size(), 0)
+        || ::fsync(fd) != 0) {
+      BROKER_ERROR("failed to initialize log file:" << log_path);
+      return false;
+    }
+    flushed = file_header_size;
+    return true;
+  }
+
+  // Loads the index checkpoint and returns the first log offset it does not
+  // cover, or 0 if no usable checkpoint exists.
+  uint64_t load_checkpoint(uint64_t file_size) {
+    auto ifd = ::open(index_path.c_str(), O_RDONLY);
+    if (ifd < 0)
+      return 0;
+    struct stat st;
+    std::string buf;
+    if (::fstat(ifd, &st) == 0 && st.st_size > 0) {
+      buf.resize(static_cast<size_t>(st.st_size));
+      if (!read_all(ifd, &buf[0], buf.size(), 0))
+        buf.clear();
+    }
+    ::close(ifd);
+    auto prefix = sizeof(index_magic) + sizeof(uint32_t);
+    if (buf.size() < prefix
+        || std::memcmp(buf.data(), index_magic, sizeof(index_magic)) != 0)
+      return 0;
+    uint32_t expected_checksum;
+    std::memcpy(&expected_checksum, buf.data() + sizeof(index_magic),
+                sizeof(expected_checksum));
+    auto payload = buf.data() + prefix;
+    auto payload_size = buf.size() - prefix;
+    if (checksum(payload, payload_size) != expected_checksum)
+      return 0;
+    caf::arraybuf<char> sb{const_cast<char*>(payload), payload_size};
+    deserializer source{sb};
+    uint64_t id;
+    uint64_t covered;
+    uint64_t n;
+    if (source(id, covered, n) || id != file_id || covered > file_size)
+      return 0;
+    index_type tmp;
+    tmp.reserve(n);
+    for (uint64_t i = 0; i < n; ++i) {
+      data key;
+      entry e;
+      if (source(key, e.offset, e.size, e.expiry))
+        return 0;
+      tmp.emplace(std::move(key), std::move(e));
+    }
+    index = std::move(tmp);
+    live_bytes = 0;
+    for (auto& kvp : index)
+      live_bytes += kvp.second.size;
+    BROKER_DEBUG("loaded index checkpoint with" << n << "entries");
+    return covered;
+  }
+
+  // Writes the index to disk. Requires that all records are flushed.
+  bool write_checkpoint() {
+    BROKER_ASSERT(pending.empty());
+    std::string payload;
+    {
+      caf::containerbuf<std::string> sb{payload};
+      caf::stream_serializer<caf::containerbuf<std::string>&> sink{sb};
+      auto n = static_cast<uint64_t>(index.size());
+      sink(file_id, flushed, n);
+      for (auto& kvp : index) {
+        auto& e = kvp.second;
+        sink(const_cast<data&>(kvp.first), e.offset, e.size, e.expiry);
+      }
+    }
+    auto sum = checksum(payload.data(), payload.size());
+    std::string buf{index_magic, sizeof(index_magic)};
+    buf.append(reinterpret_cast<const char*>(&sum), sizeof(sum));
+    buf += payload;
+    auto tmp_path = index_path + ".tmp";
+    auto ifd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (ifd < 0)
+      return false;
+    auto ok = write_all(ifd, buf.data(), buf.size(), 0) && ::fsync(ifd) == 0;
+    ::close(ifd);
+    if (!ok || std::rename(tmp_path.c_str(), index_path.c_str()) != 0) {
+      BROKER_ERROR("failed to write index checkpoint");
+      return false;
+    }
+    return true;
+  }
+
+  // Replays all records in [first, last) and truncates a torn tail.
+  bool recover(uint64_t first, uint64_t last) {
+    if (first == last)
+      return true;
+    auto ptr = ::mmap(nullptr, last, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+      BROKER_ERROR("failed to map log file:" << log_path);
+      return false;
+    }
+    auto base = reinterpret_cast<const char*>(ptr);
+    auto pos = first;
+    size_t num_records = 0;
+    while (pos + record_header_size <= last) {
+      uint32_t header[2];
+      std::memcpy(header, base + pos, sizeof(header));
+      auto payload = base + pos + record_header_size;
+      auto record_size = record_header_size + header[0];
+      if (pos + record_size > last || checksum(payload, header[0]) != header[1])
+        break;
+      uint8_t type;
+      data key;
+      entry e{pos, static_cast<uint32_t>(record_size), {}};
+      if (deserialize(payload, header[0], type)) {
+        if (type == put_record) {
+          data value;
+          if (!deserialize(payload, header[0], type, value, e.expiry, key))
+            break;
+          apply_put(std::move(key), std::move(e));
+        } else if (type == erase_record) {
+          if (!deserialize(payload, header[0], type, key))
+            break;
+          apply_erase(key);
+        } else {
+          break;
+        }
+      } else {
+        break;
+      }
+      pos += record_size;
+      ++num_records;
+    }
+    ::munmap(ptr, last);
+    BROKER_DEBUG("replayed" << num_records << "log records");
+    if (pos != last) {
+      BROKER_WARNING("truncating incomplete or corrupted log tail at" << pos);
+      if (::ftruncate(fd, static_cast<off_t>(pos)) != 0 || ::fsync(fd) != 0) {
+        BROKER_ERROR("failed to truncate log file:" << log_path);
+        return false;
+      }
+      flushed = pos;
+    }
+    return true;
+  }
+
+  void shutdown() {
+    {
+      std::unique_lock<std::mutex> guard{mtx};
+      shutting_down = true;
+    }
+    cv.notify_all();
+    if (worker.joinable())
+      worker.join();
+    if (fd < 0)
+      return;
+    if (flush() && ::fsync(fd) == 0)
+      write_checkpoint();
+    ::close(fd);
+    fd = -1;
+  }
+
+  // -- log and index access (all require holding `mtx`) -----------------------
+
+  bool flush() {
+    if (pending.empty())
+      return true;
+    if (!write_all(fd, pending.data(), pending.size(), flushed)) {
+      BROKER_ERROR("failed to write to log file:" << log_path);
+      return false;
+    }
+    flushed += pending.size();
+    pending.clear();
+    return true;
+  }
+
+  uint64_t end() const {
+    return flushed + pending.size();
+  }
+
+  // Appends a record and returns its offset.
+  expected<uint64_t> append(const std::string& payload) {
+    auto offset = end();
+    append_record(pending, payload);
+    if (sync_interval == timespan{0}) {
+      if (!flush() || ::fsync(fd) != 0)
+        return ec::backend_failure;
+    } else {
+      if (pending.size() >= buffer_size && !flush())
+        return ec::backend_failure;
+      dirty = true;
+    }
+    return offset;
+  }
+
+  bool read(const entry& e, std::string& buf) const {
+    buf.resize(e.size);
+    if (e.offset >= flushed) {
+      auto first = pending.begin() + (e.offset - flushed);
+      std::copy(first, first + e.size, buf.begin());
+      return true;
+    }
+    return read_all(fd, &buf[0], buf.size(), e.offset);
+  }
+
+  expected<data> read_value(const entry& e) const {
+    std::string buf;
+    if (!read(e, buf)) {
+      BROKER_ERROR("failed to read from log file:" << log_path);
+      return ec::backend_failure;
+    }
+    uint8_t type;
+    data value;
+    if (!deserialize(buf.data() + record_header_size,
+                     buf.size() - record_header_size, type, value)
+        || type != put_record)
+      return ec::backend_failure;
+    return value;
+  }
+
+  void apply_put(data key, entry e) {
+    live_bytes += e.size;
+    auto i = index.find(key);
+    if (i == index.end()) {
+      index.emplace(std::move(key), std::move(e));
+    } else {
+      live_bytes -= i->second.size;
+      i->second = std::move(e);
+    }
+  }
+
+  void apply_erase(const data& key) {
+    auto i = index.find(key);
+    if (i != index.end()) {
+      live_bytes -= i->second.size;
+      index.erase(i);
+    }
+  }
+
+  // -- background work --------------------------------------------------------
+
+  bool needs_compaction() const {
+    auto total = end() - file_header_size;
+    return total >= compaction_min_size
+           && static_cast<double>(total - live_bytes)
+                > compaction_ratio * static_cast<double>(total);
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> guard{mtx};
+    auto interval = sync_interval > timespan{0}
+                    ? sync_interval
+                    : timespan{std::chrono::seconds(1)};
+    while (!shutting_down) {
+      cv.wait_for(guard, interval);
+      if (shutting_down)
+        break;
+      // Group commit: all writes since the last iteration share one fsync.
+      if (dirty) {
+        dirty = false;
+        if (flush()) {
+          auto f = fd;
+          guard.unlock();
+          ::fsync(f);
+          guard.lock();
+        }
+      }
+      if (needs_compaction())
+        compact(guard);
+    }
+  }
+
+  // Writes all live records into a new log file and swaps it in. Releases the
+  // lock while copying records that were already on disk when starting.
+  bool compact(std::unique_lock<std::mutex>& guard) {
+    if (compacting)
+      return false;
+    compacting = true;
+    auto result = compact_impl(guard);
+    compacting = false;
+    return result;
+  }
+
+  bool compact_impl(std::unique_lock<std::mutex>& guard) {
+    if (!flush())
+      return false;
+    auto old_fd = fd;
+    auto start_generation = generation;
+    auto end0 = flushed;
+    std::vector<std::pair<data, entry>> live{index.begin(), index.end()};
+    BROKER_DEBUG("compacting log with" << live.size() << "live entries");
+    guard.unlock();
+    std::sort(live.begin(), live.end(),
+              [](const std::pair<data, entry>& x,
+                 const std::pair<data, entry>& y) {
+                return x.second.offset < y.second.offset;
+              });
+    auto tmp_path = log_path + ".compact";
+    auto new_fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (new_fd < 0) {
+      guard.lock();
+      BROKER_ERROR("failed to create compacted log file");
+      return false;
+    }
+    auto abort = [&] {
+      ::close(new_fd);
+      ::unlink(tmp_path.c_str());
+      return false;
+    };
+    auto new_id = make_file_id();
+    auto buf = make_file_header(new_id);
+    uint64_t new_end = 0;
+    std::unordered_map<data, uint64_t> moved;
+    moved.reserve(live.size());
+    std::string record;
+    for (auto& kvp : live) {
+      record.resize(kvp.second.size);
+      if (!read_all(old_fd, &record[0], record.size(), kvp.second.offset)) {
+        guard.lock();
+        return abort();
+      }
+      moved.emplace(std::move(kvp.first), new_end + buf.size());
+      buf += record;
+      if (buf.size() >= buffer_size) {
+        if (!write_all(new_fd, buf.data(), buf.size(), new_end)) {
+          guard.lock();
+          return abort();
+        }
+        new_end += buf.size();
+        buf.clear();
+      }
+    }
+    guard.lock();
+    // Bail out if clear() ran in the meantime or if we failed to write.
+    if (generation != start_generation || !flush()
+        || !write_all(new_fd, buf.data(), buf.size(), new_end))
+      return abort();
+    new_end += buf.size();
+    // Copy all records that were appended while we were copying.
+    auto tail_size = flushed - end0;
+    std::string tail;
+    tail.resize(tail_size);
+    if (tail_size > 0
+        && (!read_all(old_fd, &tail[0], tail_size, end0)
+            || !write_all(new_fd, tail.data(), tail_size, new_end)))
+      return abort();
+    if (::fsync(new_fd) != 0)
+      return abort();
+    // Make sure no checkpoint can refer to the old file from here on.
+    ::unlink(index_path.c_str());
+    if (std::rename(tmp_path.c_str(), log_path.c_str()) != 0)
+      return abort();
+    for (auto& kvp : index) {
+      auto& e = kvp.second;
+      if (e.offset >= end0) {
+        e.offset = e.offset - end0 + new_end;
+      } else {
+        auto i = moved.find(kvp.first);
+        BROKER_ASSERT(i != moved.end());
+        e.offset = i->second;
+      }
+    }
+    ::close(old_fd);
+    fd = new_fd;
+    file_id = new_id;
+    flushed = new_end + tail_size;
+    BROKER_DEBUG("compacted log from" << end0 + tail_size << "to" << flushed
+                 << "bytes");
+    write_checkpoint();
+    return true;
+  }
+
+  // -- member variables -------------------------------------------------------
+
+  std::string log_path;
+  std::string index_path;
+  int fd = -1;
+  uint64_t file_id = 0;
+  uint64_t flushed = 0;
+  uint64_t live_bytes = 0;
+  uint64_t generation = 0;
+  std::string pending;
+  index_type index;
+  timespan sync_interval = std::chrono::milliseconds(50);
+  size_t buffer_size = 64 * 1024;
+  double compaction_ratio = 0.5;
+  uint64_t compaction_min_size = 16 * 1024 * 1024;
+  bool dirty = false;
+  bool compacting = false;
+  bool shutting_down = false;
+  mutable std::mutex mtx;
+  std::condition_variable cv;
+  std::thread worker;
+};
+
+append_log_backend::append_log_backend(backend_options opts)
+  : impl_{std::make_unique<impl>()} {
+  auto i = opts.find("path");
+  if (i == opts.end())
+    return;
+  auto path = caf::get_if<std::string>(&i->second);
+  if (!path)
+    return;
+  i = opts.find("sync-interval");
+  if (i != opts.end()) {
+    if (auto x = caf::get_if<timespan>(&i->second))
+      impl_->sync_interval = *x;
+    else
+      BROKER_ERROR("sync-interval must be of type timespan");
+  }
+  i = opts.find("buffer-size");
+  if (i != opts.end()) {
+    if (auto x = caf::get_if<count>(&i->second))
+      impl_->buffer_size = *x;
+    else
+      BROKER_ERROR("buffer-size must be of type count");
+  }
+  i = opts.find("compaction-ratio");
+  if (i != opts.end()) {
+    if (auto x = caf::get_if<real>(&i->second))
+      impl_->compaction_ratio = *x;
+    else
+      BROKER_ERROR("compaction-ratio must be of type real");
+  }
+  i = opts.find("compaction-min-size");
+  if (i != opts.end()) {
+    if (auto x = caf::get_if<count>(&i->second))
+      impl_->compaction_min_size = *x;
+    else
+      BROKER_ERROR("compaction-min-size must be of type count");
+  }
+  if (!impl_->open(*path)) {
+    if (impl_->fd >= 0)
+      ::close(impl_->fd);
+    impl_->fd = -1;
+    return;
+  }
+  impl_->worker = std::thread{[this] { impl_->run(); }};
+}
+
+append_log_backend::~append_log_backend() {
+  impl_->shutdown();
+}
+
+expected<void> append_log_backend::put(const data& key, data value,
+                                       optional<timestamp> expiry) {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  auto payload = to_blob(static_cast<uint8_t>(put_record), value, expiry, key);
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  auto offset = impl_->append(payload);
+  if (!offset)
+    return offset.error();
+  auto size = static_cast<uint32_t>(record_header_size + payload.size());
+  impl_->apply_put(key, impl::entry{*offset, size, std::move(expiry)});
+  return {};
+}
+
+expected<void> append_log_backend::erase(const data& key) {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  if (impl_->index.count(key) == 0)
+    return {};
+  auto offset = impl_->append(to_blob(static_cast<uint8_t>(erase_record),
+                                      key));
+  if (!offset)
+    return offset.error();
+  impl_->apply_erase(key);
+  return {};
+}
+
+expected<void> append_log_backend::clear() {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  impl_->pending.clear();
+  impl_->index.clear();
+  impl_->live_bytes = 0;
+  impl_->dirty = false;
+  ++impl_->generation;
+  ::unlink(impl_->index_path.c_str());
+  if (!impl_->reset_log())
+    return ec::backend_failure;
+  return {};
+}
+
+expected<bool> append_log_backend::expire(const data& key, timestamp ts) {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  auto i = impl_->index.find(key);
+  if (i == impl_->index.end() || !i->second.expiry || ts < *i->second.expiry)
+    return false;
+  auto offset = impl_->append(to_blob(static_cast<uint8_t>(erase_record),
+                                      key));
+  if (!offset)
+    return offset.error();
+  impl_->apply_erase(key);
+  return true;
+}
+
+expected<data> append_log_backend::get(const data& key) const {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  auto i = impl_->index.find(key);
+  if (i == impl_->index.end())
+    return ec::no_such_key;
+  return impl_->read_value(i->second);
+}
+
+expected<bool> append_log_backend::exists(const data& key) const {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  return impl_->index.count(key) == 1;
+}
+
+expected<uint64_t> append_log_backend::size() const {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  return impl_->index.size();
+}
+
+expected<data> append_log_backend::keys() const {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  set result;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  for (auto& kvp : impl_->index)
+    result.insert(kvp.first);
+  return {std::move(result)};
+}
+
+expected<snapshot> append_log_backend::snapshot() const {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  // Read in file order to keep disk access sequential.
+  std::vector<const impl::index_type::value_type*> entries;
+  entries.reserve(impl_->index.size());
+  for (auto& kvp : impl_->index)
+    entries.emplace_back(&kvp);
+  std::sort(entries.begin(), entries.end(),
+            [](const impl::index_type::value_type* x,
+               const impl::index_type::value_type* y) {
+              return x->second.offset < y->second.offset;
+            });
+  broker::snapshot result;
+  for (auto kvp : entries) {
+    auto value = impl_->read_value(kvp->second);
+    if (!value)
+      return value.error();
+    result.emplace(kvp->first, std::move(*value));
+  }
+  return {std::move(result)};
+}
+
+expected<expirables> append_log_backend::expiries() const {
+  if (impl_->fd < 0)
+    return ec::backend_failure;
+  expirables result;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  for (auto& kvp : impl_->index)
+    if (kvp.second.expiry)
+      result.emplace_back(kvp.first, *kvp.second.expiry);
+  return {std::move(result)};
+}
+
+bool append_log_backend::compact() {
+  if (impl_->fd < 0)
+    return false;
+  std::unique_lock<std::mutex> guard{impl_->mtx};
+  return impl_->compact(guard);
+}
+
+} // namespace detail
+} // namespace broker
@@ -10,10 +10,12 @@
 #include <caf/make_message.hpp>
 #include <caf/system_messages.hpp>
 #include <caf/stateful_actor.hpp>
+#include <caf/group.hpp>
 
 #include "broker/atoms.hh"
 #include "broker/convert.hh"
 #include "broker/data.hh"
+#include "broker/endpoint_info.hh"
 #include "broker/error.hh"
 #include "broker/store.hh"
 #include "broker/topic.hh"
@@ -22,6 +24,7 @@
 #include "broker/detail/clone_actor.hh"
 
 #include <chrono>
+#include <string>
 
 namespace broker {
 namespace detail {
@@ -32,15 +35,105 @@ static double now(endpoint::clock* clock)
   return std::chrono::duration_cast<std::chrono::duration<double>>(d).count();
   }
 
+// Types for which adding two values in advance yields the same result as
+// adding them one after another.
+static bool is_summable(data::type x)
+  {
+  switch ( x ) {
+    case data::type::count:
+    case data::type::integer:
+    case data::type::real:
+    case data::type::timestamp:
+    case data::type::string:
+      return true;
+    default:
+      return false;
+  }
+  }
+
+// Returns the relative expiry of `x` or `nullptr` if `x` has none.
+static caf::optional<timespan>* expiry_of(internal_command& x)
+  {
+  if ( auto put = caf::get_if<put_command>(&x.content) )
+    return &put->expiry;
+
+  if ( auto add = caf::get_if<add_command>(&x.content) )
+    return &add->expiry;
+
+  if ( auto sub = caf::get_if<subtract_command>(&x.content) )
+    return &sub->expiry;
+
+  return nullptr;
+  }
+
+// Folds `x` into `pending`, the latest pending command for the same key.
+// Returns false if both commands must go to the master separately.
+static bool merge(internal_command& pending, internal_command& x)
+  {
+  // The latest put or erase overrides all earlier commands.
+  if ( caf::holds_alternative<put_command>(x.content)
+       || caf::holds_alternative<erase_command>(x.content) )
+    {
+    pending = std::move(x);
+    return true;
+    }
+
+  // Modifications of a pending put result in a put of the new value.
+  if ( auto put = caf::get_if<put_command>(&pending.content) )
+    {
+    if ( auto add = caf::get_if<add_command>(&x.content) )
+      {
+      if ( ! caf::visit(adder{add->value}, put->value) )
+        return false;
+
+      // Like the master, the latest command determines the expiry.
+      put->expiry = add->expiry;
+
+      return true;
+      }
+
+    if ( auto sub = caf::get_if<subtract_command>(&x.content) )
+      {
+      if ( ! caf::visit(remover{sub->value}, put->value) )
+        return false;
+
+      put->expiry = sub->expiry;
+
+      return true;
+      }
+
+    return false;
+    }
+
+  // Consecutive increments or appends add up.
+  auto lhs = caf::get_if<add_command>(&pending.content);
+  auto rhs = caf::get_if<add_command>(&x.content);
+
+  if ( ! lhs || ! rhs || lhs->init_type != rhs->init_type
+       || ! is_summable(lhs->init_type)
+       || lhs->value.get_type() != rhs->value.get_type() )
+    return false;
+
+  if ( ! caf::visit(adder{rhs->value}, lhs->value) )
+    return false;
+
+  lhs->expiry = rhs->expiry;
+
+  return true;
+  }
+
 clone_state::clone_state() : self(nullptr), name(), master_topic(), core(),
   master(), store(), is_stale(), stale_time(), unmutable_time(),
   mutation_buffer(), pending_remote_updates(), awaiting_snapshot(),
-  awaiting_snapshot_sync(), clock() {
+  awaiting_snapshot_sync(), clock(), change_subscribers(),
+  write_coalesce_interval(), write_coalesce_size(), coalesce_buffer(),
+  coalesce_times(), coalesce_index(), flush_scheduled(false) {
   // nop
 }
 
 void clone_state::init(caf::event_based_actor* ptr, std::string&& nm,
-                       caf::actor&& parent, endpoint::clock* ep_clock) {
+                       caf::actor&& parent, endpoint::clock* ep_clock,
+                       double coalesce_interval, size_t coalesce_size) {
 
   self = ptr;
   name = std::move(nm);
@@ -53,12 +146,99 @@ void clone_state::init(caf::event_based_actor* ptr, std::string&& nm,
   clock = ep_clock;
   awaiting_snapshot = true;
   awaiting_snapshot_sync = true;
+  write_coalesce_interval = coalesce_interval;
+  write_coalesce_size = coalesce_size;
 }
 
 void clone_state::forward(internal_command&& x) {
   self->send(core, atom::publish::value, master_topic, std::move(x));
 }
 
+void clone_state::coalesce(internal_command&& x) {
+  if ( caf::holds_alternative<put_unique_command>(x.content) )
+    {
+    // The caller waits for the outcome, so there's no point in holding it.
+    flush();
+    forward(std::move(x));
+    return;
+    }
+
+  if ( caf::holds_alternative<clear_command>(x.content) )
+    {
+    // Clearing the store makes all pending mutations obsolete.
+    coalesce_buffer.clear();
+    coalesce_times.clear();
+    coalesce_index.clear();
+    coalesce_buffer.emplace_back(std::move(x));
+    coalesce_times.emplace_back(clock->now());
+    }
+  else if ( auto key = command_key(x) )
+    {
+    auto i = coalesce_index.find(*key);
+
+    if ( i != coalesce_index.end() && merge(coalesce_buffer[i->second], x) )
+      coalesce_times[i->second] = clock->now();
+    else
+      {
+      coalesce_index[*key] = coalesce_buffer.size();
+      coalesce_buffer.emplace_back(std::move(x));
+      coalesce_times.emplace_back(clock->now());
+      }
+    }
+  else
+    {
+    coalesce_buffer.emplace_back(std::move(x));
+    coalesce_times.emplace_back(clock->now());
+    }
+
+  if ( coalesce_buffer.size() >= write_coalesce_size )
+    {
+    flush();
+    return;
+    }
+
+  if ( flush_scheduled )
+    return;
+
+  flush_scheduled = true;
+  auto si = std::chrono::duration<double>(write_coalesce_interval);
+  auto ts = std::chrono::duration_cast<timespan>(si);
+  auto msg = caf::make_message(atom::tick::value, atom::coalesce::value);
+  clock->send_later(self, ts, std::move(msg));
+}
+
+void clone_state::flush() {
+  if ( coalesce_buffer.empty() )
+    return;
+
+  BROKER_DEBUG("FLUSH" << coalesce_buffer.size() << "commands");
+  coalesce_index.clear();
+
+  // The master computes absolute expiries on arrival, so subtract the time
+  // each command spent waiting here.
+  auto t = clock->now();
+
+  for ( size_t i = 0; i < coalesce_buffer.size(); ++i )
+    {
+    auto expiry = expiry_of(coalesce_buffer[i]);
+
+    if ( ! expiry || ! *expiry )
+      continue;
+
+    auto waited = t - coalesce_times[i];
+    **expiry = **expiry > waited ? **expiry - waited : timespan{0};
+    }
+
+  coalesce_times.clear();
+
+  if ( coalesce_buffer.size() == 1 )
+    forward(std::move(coalesce_buffer.front()));
+  else
+    forward(internal_command{batch_command{std::move(coalesce_buffer)}});
+
+  coalesce_buffer.clear();
+}
+
 void clone_state::command(internal_command& cmd) {
   caf::visit(*this, cmd.content);
 }
@@ -125,6 +305,12 @@ void clone_state::operator()(clear_command&) {
   store.clear();
 }
 
+void clone_state::operator()(batch_command& x) {
+  BROKER_INFO("BATCH of" << x.commands.size() << "commands");
+  for (auto& cmd : x.commands)
+    command(cmd);
+}
+
 data clone_state::keys() const {
   set result;
   for (auto& kvp : store)
@@ -136,17 +322,45 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
                           caf::actor core, std::string name,
                           double resync_interval, double stale_interval,
                           double mutation_buffer_interval,
+                          double write_coalesce_interval,
+                          size_t write_coalesce_size,
                           endpoint::clock* clock) {
   self->monitor(core);
-  self->state.init(self, std::move(name), std::move(core), clock);
+  self->state.init(self, std::move(name), std::move(core), clock,
+                   write_coalesce_interval, write_coalesce_size);
   self->set_down_handler(
     [=](const caf::down_msg& msg) {
       if (msg.source == core) {
         BROKER_INFO("core is down, kill clone as well");
         self->quit(msg.reason);
+      } else if (self->state.change_subscribers.erase(msg.source) > 0) {
+        // The master monitors change subscribers on its own.
+        BROKER_INFO("lost a change subscriber");
       } else {
         BROKER_INFO("lost master");
         self->state.master = nullptr;
+
+        // Coalesced mutations that did not go out yet wait for the next
+        // master like any other mutation. Without a mutation buffer, they
+        // are lost and the application learns about it.
+        if ( mutation_buffer_interval > 0 )
+          for ( auto& cmd : self->state.coalesce_buffer )
+            self->state.mutation_buffer.emplace_back(std::move(cmd));
+        else if ( ! self->state.coalesce_buffer.empty() )
+          {
+          auto desc = "lost master, dropped "
+                      + std::to_string(self->state.coalesce_buffer.size())
+                      + " unsent writes to " + self->state.name;
+          BROKER_WARNING(desc);
+          auto grp = self->system().groups().get_local("broker/errors");
+          self->send(grp, atom::local::value,
+                     make_error(ec::no_such_master,
+                                endpoint_info{self->node(), nil},
+                                std::move(desc)));
+          }
+
+        self->state.coalesce_buffer.clear();
+        self->state.coalesce_index.clear();
         self->state.awaiting_snapshot = true;
         self->state.awaiting_snapshot_sync = true;
         self->state.pending_remote_updates.clear();
@@ -194,7 +408,10 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
       if ( self->state.master )
         {
         // forward all commands to the master
-        self->state.forward(std::move(x));
+        if ( write_coalesce_interval > 0 )
+          self->state.coalesce(std::move(x));
+        else
+          self->state.forward(std::move(x));
         return;
         }
 
@@ -221,6 +438,27 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
     [=](atom::sync_point, caf::actor& who) {
       self->send(who, atom::sync_point::value);
     },
+    [=](atom::tick, atom::coalesce) {
+      self->state.flush_scheduled = false;
+      self->state.flush();
+    },
+    [=](atom::subscribe, atom::changes) {
+      // Change subscribers receive their events through our core.
+      return self->state.core;
+    },
+    [=](atom::subscribe, atom::changes, caf::actor& who) {
+      // Only the master knows about all changes.
+      auto addr = who.address();
+
+      if ( ! self->state.change_subscribers.emplace(addr, who).second )
+        return;
+
+      self->monitor(who);
+
+      if ( self->state.master )
+        self->send(self->state.master, atom::subscribe::value,
+                   atom::changes::value, std::move(who));
+    },
     [=](atom::master, atom::resolve) {
       if ( self->state.master )
         return;
@@ -244,6 +482,10 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
       self->state.unmutable_time = -1.0;
       self->monitor(self->state.master);
 
+      for ( auto& kvp : self->state.change_subscribers )
+        self->send(self->state.master, atom::subscribe::value,
+                   atom::changes::value, kvp.second);
+
       for ( auto& cmd : self->state.mutation_buffer )
         self->state.forward(std::move(cmd));
 
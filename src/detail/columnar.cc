@@ -0,0 +1,310 @@
+#include "broker/detail/columnar.hh"
+
+#include <cstring>
+#include <utility>
+
+namespace broker {
+namespace detail {
+
+namespace {
+
+void put_varint(std::string& buf, uint64_t x) {
+  while (x > 0x7f) {
+    buf.push_back(static_cast<char>((x & 0x7f) | 0x80));
+    x >>= 7;
+  }
+  buf.push_back(static_cast<char>(x));
+}
+
+bool get_varint(const char*& first, const char* last, uint64_t& x) {
+  x = 0;
+  for (int shift = 0; first != last && shift < 64; shift += 7) {
+    auto byte = static_cast<uint8_t>(*first++);
+    x |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+uint64_t zigzag(int64_t x) {
+  return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+}
+
+int64_t unzigzag(uint64_t x) {
+  return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1);
+}
+
+void put_fixed(std::string& buf, uint64_t x, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    buf.push_back(static_cast<char>((x >> (8 * i)) & 0xff));
+}
+
+bool get_fixed(const char*& first, const char* last, uint64_t& x, size_t n) {
+  if (static_cast<size_t>(last - first) < n)
+    return false;
+  x = 0;
+  for (size_t i = 0; i < n; ++i)
+    x |= static_cast<uint64_t>(static_cast<uint8_t>(*first++)) << (8 * i);
+  return true;
+}
+
+void put_string(std::string& buf, const std::string& x) {
+  put_varint(buf, x.size());
+  buf += x;
+}
+
+bool get_string(const char*& first, const char* last, std::string& x) {
+  uint64_t n;
+  if (!get_varint(first, last, n) || static_cast<uint64_t>(last - first) < n)
+    return false;
+  x.assign(first, static_cast<size_t>(n));
+  first += n;
+  return true;
+}
+
+void put_address(std::string& buf, const address& x) {
+  auto& bytes = x.bytes();
+  buf.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+bool get_address(const char*& first, const char* last, address& x) {
+  if (last - first < 16)
+    return false;
+  uint32_t bytes[4];
+  std::memcpy(bytes, first, sizeof(bytes));
+  first += 16;
+  x = address{bytes, address::family::ipv6, address::byte_order::network};
+  return true;
+}
+
+} // namespace <anonymous>
+
+column_encoder::column_encoder(data::type type)
+  : type_(type),
+    rows_(0),
+    missing_(0),
+    last_(0) {
+  // nop
+}
+
+bool column_encoder::add(const data& x) {
+  auto t = x.get_type();
+  if (t != type_ && t != data::type::none)
+    return false;
+  if (rows_ % 8 == 0)
+    present_.push_back(0);
+  auto row = rows_++;
+  if (t == data::type::none && type_ != data::type::none) {
+    ++missing_;
+    return true;
+  }
+  present_.back() |= static_cast<char>(1 << (row % 8));
+  switch (type_) {
+    case data::type::boolean:
+      values_.push_back(caf::get<boolean>(x) ? 1 : 0);
+      break;
+    case data::type::count:
+      put_varint(values_, caf::get<count>(x));
+      break;
+    case data::type::integer:
+      put_varint(values_, zigzag(caf::get<integer>(x)));
+      break;
+    case data::type::real: {
+      uint64_t bits;
+      auto y = caf::get<real>(x);
+      std::memcpy(&bits, &y, sizeof(bits));
+      put_fixed(values_, bits, sizeof(bits));
+      break;
+    }
+    case data::type::string:
+      put_string(values_, caf::get<std::string>(x));
+      break;
+    case data::type::enum_value:
+      put_string(values_, caf::get<enum_value>(x).name);
+      break;
+    case data::type::address:
+      put_address(values_, caf::get<address>(x));
+      break;
+    case data::type::subnet: {
+      auto& y = caf::get<subnet>(x);
+      put_address(values_, y.network());
+      values_.push_back(static_cast<char>(y.length()));
+      break;
+    }
+    case data::type::port: {
+      auto& y = caf::get<port>(x);
+      put_varint(values_, y.number());
+      values_.push_back(static_cast<char>(y.type()));
+      break;
+    }
+    case data::type::timestamp: {
+      auto ns = caf::get<timestamp>(x).time_since_epoch().count();
+      put_varint(values_, zigzag(ns - last_));
+      last_ = ns;
+      break;
+    }
+    case data::type::timespan:
+      put_varint(values_, zigzag(caf::get<timespan>(x).count()));
+      break;
+    default:
+      fallback_.emplace_back(x);
+  }
+  return true;
+}
+
+vector column_encoder::finish() {
+  vector result;
+  result.emplace_back(static_cast<count>(type_));
+  if (missing_ > 0)
+    result.emplace_back(std::move(present_));
+  else
+    result.emplace_back(std::string{});
+  if (is_packed_column_type(type_))
+    result.emplace_back(std::move(values_));
+  else
+    result.emplace_back(std::move(fallback_));
+  rows_ = 0;
+  missing_ = 0;
+  present_.clear();
+  values_.clear();
+  fallback_.clear();
+  last_ = 0;
+  return result;
+}
+
+bool is_packed_column_type(data::type t) {
+  switch (t) {
+    case data::type::none:
+    case data::type::set:
+    case data::type::table:
+    case data::type::vector:
+      return false;
+    default:
+      return true;
+  }
+}
+
+bool column_decode(const vector& x, size_t rows, vector& out) {
+  if (x.size() != 3)
+    return false;
+  auto tp = caf::get_if<count>(&x[0]);
+  auto pp = caf::get_if<std::string>(&x[1]);
+  if (!tp || !pp || *tp > static_cast<count>(data::type::vector))
+    return false;
+  auto type = static_cast<data::type>(*tp);
+  auto& present = *pp;
+  if (!present.empty() && present.size() != (rows + 7) / 8)
+    return false;
+  auto is_present = [&](size_t row) {
+    return present.empty()
+           || (static_cast<uint8_t>(present[row / 8]) & (1 << (row % 8))) != 0;
+  };
+  out.clear();
+  out.reserve(rows);
+  if (!is_packed_column_type(type)) {
+    auto vp = caf::get_if<vector>(&x[2]);
+    if (!vp)
+      return false;
+    size_t i = 0;
+    for (size_t row = 0; row < rows; ++row) {
+      if (!is_present(row))
+        out.emplace_back();
+      else if (i < vp->size())
+        out.emplace_back((*vp)[i++]);
+      else
+        return false;
+    }
+    return i == vp->size();
+  }
+  auto sp = caf::get_if<std::string>(&x[2]);
+  if (!sp)
+    return false;
+  auto first = sp->data();
+  auto last = first + sp->size();
+  int64_t prev = 0;
+  for (size_t row = 0; row < rows; ++row) {
+    if (!is_present(row)) {
+      out.emplace_back();
+      continue;
+    }
+    uint64_t n;
+    switch (type) {
+      case data::type::boolean:
+        if (first == last)
+          return false;
+        out.emplace_back(*first++ != 0);
+        break;
+      case data::type::count:
+        if (!get_varint(first, last, n))
+          return false;
+        out.emplace_back(count{n});
+        break;
+      case data::type::integer:
+        if (!get_varint(first, last, n))
+          return false;
+        out.emplace_back(integer{unzigzag(n)});
+        break;
+      case data::type::real: {
+        if (!get_fixed(first, last, n, sizeof(n)))
+          return false;
+        real y;
+        std::memcpy(&y, &n, sizeof(y));
+        out.emplace_back(y);
+        break;
+      }
+      case data::type::string: {
+        std::string y;
+        if (!get_string(first, last, y))
+          return false;
+        out.emplace_back(std::move(y));
+        break;
+      }
+      case data::type::enum_value: {
+        std::string y;
+        if (!get_string(first, last, y))
+          return false;
+        out.emplace_back(enum_value{std::move(y)});
+        break;
+      }
+      case data::type::address: {
+        address y;
+        if (!get_address(first, last, y))
+          return false;
+        out.emplace_back(y);
+        break;
+      }
+      case data::type::subnet: {
+        address y;
+        if (!get_address(first, last, y) || first == last)
+          return false;
+        out.emplace_back(subnet{y, static_cast<uint8_t>(*first++)});
+        break;
+      }
+      case data::type::port: {
+        if (!get_varint(first, last, n) || first == last)
+          return false;
+        auto proto = static_cast<port::protocol>(*first++);
+        out.emplace_back(port{static_cast<port::number_type>(n), proto});
+        break;
+      }
+      case data::type::timestamp:
+        if (!get_varint(first, last, n))
+          return false;
+        prev += unzigzag(n);
+        out.emplace_back(timestamp{timespan{prev}});
+        break;
+      case data::type::timespan:
+        if (!get_varint(first, last, n))
+          return false;
+        out.emplace_back(timespan{unzigzag(n)});
+        break;
+      default:
+        return false;
+    }
+  }
+  return first == last;
+}
+
+} // namespace detail
+} // namespace broker
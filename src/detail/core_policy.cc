@@ -15,6 +15,59 @@ using namespace caf;
 namespace broker {
 namespace detail {
 
+constexpr size_t core_policy::peer_trait::classifier::control_lane;
+
+constexpr size_t core_policy::peer_trait::classifier::store_lane;
+
+constexpr size_t core_policy::peer_trait::classifier::bulk_lane;
+
+constexpr size_t core_policy::peer_trait::classifier::lanes;
+
+size_t core_policy::peer_trait::classifier::weight(size_t lane) {
+  broker_options defaults;
+  switch (lane) {
+    case control_lane:
+      return defaults.control_lane_weight;
+    case store_lane:
+      return defaults.store_lane_weight;
+    default:
+      return defaults.bulk_lane_weight;
+  }
+}
+
+static bool ends_with(const std::string& s, const std::string& ending) {
+  if (ending.size() > s.size())
+    return false;
+  return std::equal(ending.rbegin(), ending.rend(), s.rbegin());
+}
+
+// Other topics may contain the reserved string as well, e.g., change events
+// of data stores, but carry regular data.
+static bool is_control_topic(const topic& x) {
+  auto& str = x.string();
+  return topics::reserved.prefix_of(x)
+         || ends_with(str, topics::master_suffix.string())
+         || ends_with(str, topics::clone_suffix.string());
+}
+
+// Commands that attach a clone to its master and bring it in sync must not
+// wait behind a backlog of updates.
+static bool is_control_command(const internal_command& x) {
+  return caf::holds_alternative<snapshot_command>(x.content)
+         || caf::holds_alternative<snapshot_sync_command>(x.content)
+         || caf::holds_alternative<set_command>(x.content);
+}
+
+size_t core_policy::peer_trait::classifier::
+operator()(const element& x) const {
+  if (x.match_element<internal_command>(1))
+    return is_control_command(x.get_as<internal_command>(1)) ? control_lane
+                                                             : store_lane;
+  if (x.match_element<topic>(0) && is_control_topic(x.get_as<topic>(0)))
+    return control_lane;
+  return bulk_lane;
+}
+
 core_policy::core_policy(caf::detail::stream_distribution_tree<core_policy>* p,
                          core_state* state, filter_type filter)
   : parent_(p),
@@ -75,10 +128,36 @@ void core_policy::unblock_peer(caf::actor peer) {
   blocked_msgs.erase(it);
 }
 
-static bool ends_with(const std::string& s, const std::string& ending) {
-  if (ending.size() > s.size())
+template <class T>
+message core_policy::make_peer_message(topic x, T y) {
+  if (!state_->options.routing)
+    return make_message(std::move(x), std::move(y));
+  // Stamp the message with its origin for detecting duplicates. The first
+  // receiver counts against the TTL, just like without routing.
+  auto ttl = static_cast<core_policy::ttl>(state_->options.ttl);
+  return make_message(std::move(x), std::move(y), ttl, state_->routes.id(),
+                      ++state_->last_seq);
+}
+
+bool core_policy::is_duplicate(const message& msg) {
+  if (msg.size() < 5 || !msg.match_element<endpoint_id>(3)
+      || !msg.match_element<uint64_t>(4))
     return false;
-  return std::equal(ending.rbegin(), ending.rend(), s.rbegin());
+  auto origin = msg.get_as<endpoint_id>(3);
+  if (origin == state_->routes.id())
+    return true;
+  auto seq = msg.get_as<uint64_t>(4);
+  switch (state_->duplicates.check(origin, seq)) {
+    case duplicate_filter::verdict::duplicate:
+      return true;
+    case duplicate_filter::verdict::unknown:
+      // Happens for every late message of a busy origin, hence no warning.
+      CAF_LOG_DEBUG("forward message outside of the duplicate window:"
+                    << CAF_ARG(origin) << CAF_ARG(seq));
+      return false;
+    default:
+      return false;
+  }
 }
 
 void core_policy::handle_batch(stream_slot, const strong_actor_ptr& peer,
@@ -108,6 +187,11 @@ void core_policy::handle_batch(stream_slot, const strong_actor_ptr& peer,
         CAF_LOG_DEBUG("dropped unexpected message type");
         continue;
       }
+      // With routing, messages may reach us on more than one path.
+      if (state_->options.routing && is_duplicate(msg)) {
+        CAF_LOG_DEBUG("dropped a duplicate message");
+        continue;
+      }
       // Extract worker messages.
       if (num_workers > 0 && msg.match_element<data>(1))
         workers().push(msg.get_as<topic>(0), msg.get_as<data>(1));
@@ -140,13 +224,13 @@ void core_policy::handle_batch(stream_slot, const strong_actor_ptr& peer,
   if (xs.match_elements<worker_trait::batch>()) {
     CAF_LOG_DEBUG("forward batch from local workers to peers");
     for (auto& x : xs.get_mutable_as<worker_trait::batch>(0))
-      peers().push(make_message(std::move(x.first), std::move(x.second)));
+      peers().push(make_peer_message(std::move(x.first), std::move(x.second)));
     return;
   }
   if (xs.match_elements<store_trait::batch>()) {
     CAF_LOG_DEBUG("forward batch from local stores to peers");
     for (auto& x : xs.get_mutable_as<store_trait::batch>(0))
-      peers().push(make_message(std::move(x.first), std::move(x.second)));
+      peers().push(make_peer_message(std::move(x.first), std::move(x.second)));
     return;
   }
   CAF_LOG_ERROR("unexpected batch:" << deep_to_string(xs));
@@ -330,6 +414,12 @@ bool core_policy::remove_peer(const actor& hdl, error reason, bool silent,
     peer_removed(hdl);
   else
     peer_lost(hdl);
+  filter_versions_.erase(hdl);
+  snapshot_requests_.erase(hdl);
+  delta_peers_.erase(hdl);
+  state_->handshake_filter_versions.erase(hdl);
+  if (state_->options.routing)
+    state_->remove_routes(hdl);
   state_->cache.remove(hdl);
   if (shutting_down() && peer_to_opath_.empty()) {
     // Shutdown when the last peer stops listening.
@@ -354,6 +444,65 @@ bool core_policy::update_peer(const actor& hdl, filter_type filter) {
   return true;
 }
 
+bool core_policy::update_peer(const actor& hdl, filter_delta x) {
+  CAF_LOG_TRACE(CAF_ARG(hdl) << CAF_ARG(x));
+  auto i = peer_to_opath_.find(hdl);
+  if (i == peer_to_opath_.end()) {
+    // Another snapshot would not help if we cannot apply this one.
+    CAF_LOG_DEBUG("cannot update filter on unknown peer");
+    return x.snapshot;
+  }
+  delta_peers_.emplace(hdl);
+  auto& f = peers().filter(i->second).second;
+  if (x.snapshot) {
+    filter_versions_[hdl] = x.version;
+    snapshot_requests_.erase(hdl);
+    filter_apply(f, std::move(x));
+    return true;
+  }
+  auto j = filter_versions_.find(hdl);
+  if (j == filter_versions_.end()) {
+    // Without a baseline we cannot apply the delta. Ask for a snapshot
+    // unless we did already.
+    if (!snapshot_requests_.emplace(hdl).second) {
+      CAF_LOG_DEBUG("drop filter delta while waiting for a snapshot");
+      return true;
+    }
+    CAF_LOG_DEBUG("received filter delta without a baseline");
+    return false;
+  }
+  if (x.version <= j->second) {
+    CAF_LOG_DEBUG("drop outdated filter delta");
+    return true;
+  }
+  if (x.version != j->second + 1) {
+    CAF_LOG_DEBUG("detected gap in filter versions:" << CAF_ARG(j->second)
+                  << CAF_ARG(x.version));
+    filter_versions_.erase(j);
+    snapshot_requests_.emplace(hdl);
+    return false;
+  }
+  j->second = x.version;
+  filter_apply(f, std::move(x));
+  return true;
+}
+
+bool core_policy::update_peer(const actor& hdl, uint64_t version) {
+  CAF_LOG_TRACE(CAF_ARG(hdl) << CAF_ARG(version));
+  if (peer_to_opath_.count(hdl) == 0) {
+    CAF_LOG_DEBUG("cannot set filter version on unknown peer");
+    return false;
+  }
+  delta_peers_.emplace(hdl);
+  filter_versions_[hdl] = version;
+  snapshot_requests_.erase(hdl);
+  return true;
+}
+
+bool core_policy::accepts_filter_deltas(const actor& hdl) const {
+  return delta_peers_.count(hdl) > 0;
+}
+
 // -- management of worker and storage streams -------------------------------
 
 auto core_policy::add_worker(filter_type filter)
@@ -398,14 +547,14 @@ void core_policy::remote_push(message msg) {
 /// Pushes data to peers and workers.
 void core_policy::push(topic x, data y) {
   CAF_LOG_TRACE(CAF_ARG(x) << CAF_ARG(y));
-  remote_push(make_message(std::move(x), std::move(y)));
+  remote_push(make_peer_message(std::move(x), std::move(y)));
   //local_push(std::move(x), std::move(y));
 }
 
 /// Pushes data to peers and stores.
 void core_policy::push(topic x, internal_command y) {
   CAF_LOG_TRACE(CAF_ARG(x) << CAF_ARG(y));
-  remote_push(make_message(std::move(x), std::move(y)));
+  remote_push(make_peer_message(std::move(x), std::move(y)));
   //local_push(std::move(x), std::move(y));
 }
 
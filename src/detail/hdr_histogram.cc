@@ -0,0 +1,103 @@
+#include "broker/detail/hdr_histogram.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace broker {
+namespace detail {
+
+namespace {
+
+// Each power of two above `sub_buckets` splits into `half_sub_buckets` linear
+// buckets, which bounds the relative error at 1 / half_sub_buckets.
+constexpr size_t sub_bucket_bits = 8;
+
+constexpr uint64_t sub_buckets = uint64_t{1} << sub_bucket_bits;
+
+constexpr uint64_t half_sub_buckets = sub_buckets / 2;
+
+constexpr size_t num_buckets = sub_buckets
+                               + (64 - sub_bucket_bits) * half_sub_buckets;
+
+int most_significant_bit(uint64_t x) {
+  int result = 0;
+  while (x >>= 1)
+    ++result;
+  return result;
+}
+
+} // namespace <anonymous>
+
+hdr_histogram::hdr_histogram()
+  : counts_(num_buckets),
+    count_(0),
+    min_(std::numeric_limits<uint64_t>::max()),
+    max_(0),
+    sum_(0) {
+  // nop
+}
+
+void hdr_histogram::record(uint64_t value) {
+  ++counts_[index_of(value)];
+  ++count_;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+  sum_ += static_cast<double>(value);
+}
+
+void hdr_histogram::merge(const hdr_histogram& other) {
+  for (size_t i = 0; i < num_buckets; ++i)
+    counts_[i] += other.counts_[i];
+  count_ += other.count_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+  sum_ += other.sum_;
+}
+
+void hdr_histogram::reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  min_ = std::numeric_limits<uint64_t>::max();
+  max_ = 0;
+  sum_ = 0;
+}
+
+double hdr_histogram::mean() const {
+  return count_ > 0 ? sum_ / static_cast<double>(count_) : 0.;
+}
+
+uint64_t hdr_histogram::percentile(double p) const {
+  if (count_ == 0)
+    return 0;
+  auto rank = static_cast<uint64_t>(std::ceil(p / 100. * count_));
+  rank = std::max(rank, uint64_t{1});
+  uint64_t seen = 0;
+  for (size_t i = 0; i < num_buckets; ++i) {
+    seen += counts_[i];
+    if (seen >= rank)
+      return std::min(highest_equivalent(i), max_);
+  }
+  return max_;
+}
+
+size_t hdr_histogram::index_of(uint64_t value) {
+  if (value < sub_buckets)
+    return static_cast<size_t>(value);
+  auto shift = most_significant_bit(value) - (sub_bucket_bits - 1);
+  auto mantissa = value >> shift;
+  return static_cast<size_t>(sub_buckets + (shift - 1) * half_sub_buckets
+                             + (mantissa - half_sub_buckets));
+}
+
+uint64_t hdr_histogram::highest_equivalent(size_t index) {
+  if (index < sub_buckets)
+    return index;
+  auto offset = index - sub_buckets;
+  auto shift = offset / half_sub_buckets + 1;
+  auto mantissa = offset % half_sub_buckets + half_sub_buckets;
+  return (mantissa << shift) + ((uint64_t{1} << shift) - 1);
+}
+
+} // namespace detail
+} // namespace broker
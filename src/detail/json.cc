@@ -0,0 +1,670 @@
+#include "broker/detail/json.hh"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "broker/convert.hh"
+
+namespace broker {
+namespace detail {
+
+namespace {
+
+// Indexed by `data::type`.
+const char* type_names[] = {
+  "address",
+  "boolean",
+  "count",
+  "enum-value",
+  "integer",
+  "none",
+  "port",
+  "real",
+  "set",
+  "string",
+  "subnet",
+  "table",
+  "timespan",
+  "timestamp",
+  "vector",
+};
+
+constexpr size_t num_type_names = sizeof(type_names) / sizeof(type_names[0]);
+
+struct encoder {
+  using result_type = void;
+
+  std::string& out;
+
+  void begin(data::type t) {
+    out += "{\"@data-type\":\"";
+    out += type_names[static_cast<size_t>(t)];
+    out += "\",\"data\":";
+  }
+
+  void end() {
+    out += '}';
+  }
+
+  template <class T>
+  void put_string_form(const T& x) {
+    std::string str;
+    convert(x, str);
+    json_encode_string(out, str);
+  }
+
+  void operator()(none) {
+    begin(data::type::none);
+    out += "{}";
+    end();
+  }
+
+  void operator()(boolean x) {
+    begin(data::type::boolean);
+    out += x ? "true" : "false";
+    end();
+  }
+
+  void operator()(count x) {
+    begin(data::type::count);
+    out += std::to_string(x);
+    end();
+  }
+
+  void operator()(integer x) {
+    begin(data::type::integer);
+    out += std::to_string(x);
+    end();
+  }
+
+  void operator()(real x) {
+    begin(data::type::real);
+    if (std::isnan(x)) {
+      out += "\"nan\"";
+    } else if (std::isinf(x)) {
+      out += x > 0 ? "\"inf\"" : "\"-inf\"";
+    } else {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.17g", x);
+      out += buf;
+    }
+    end();
+  }
+
+  void operator()(const std::string& x) {
+    begin(data::type::string);
+    json_encode_string(out, x);
+    end();
+  }
+
+  void operator()(const address& x) {
+    begin(data::type::address);
+    put_string_form(x);
+    end();
+  }
+
+  void operator()(const subnet& x) {
+    begin(data::type::subnet);
+    put_string_form(x);
+    end();
+  }
+
+  void operator()(const port& x) {
+    begin(data::type::port);
+    put_string_form(x);
+    end();
+  }
+
+  void operator()(timestamp x) {
+    begin(data::type::timestamp);
+    out += std::to_string(x.time_since_epoch().count());
+    end();
+  }
+
+  void operator()(timespan x) {
+    begin(data::type::timespan);
+    out += std::to_string(x.count());
+    end();
+  }
+
+  void operator()(const enum_value& x) {
+    begin(data::type::enum_value);
+    json_encode_string(out, x.name);
+    end();
+  }
+
+  void operator()(const set& xs) {
+    begin(data::type::set);
+    out += '[';
+    auto first = true;
+    for (auto& x : xs) {
+      if (!first)
+        out += ',';
+      first = false;
+      caf::visit(*this, x.get_data());
+    }
+    out += ']';
+    end();
+  }
+
+  void operator()(const table& xs) {
+    begin(data::type::table);
+    out += '[';
+    auto first = true;
+    for (auto& x : xs) {
+      if (!first)
+        out += ',';
+      first = false;
+      out += "{\"key\":";
+      caf::visit(*this, x.first.get_data());
+      out += ",\"value\":";
+      caf::visit(*this, x.second.get_data());
+      out += '}';
+    }
+    out += ']';
+    end();
+  }
+
+  void operator()(const vector& xs) {
+    begin(data::type::vector);
+    out += '[';
+    auto first = true;
+    for (auto& x : xs) {
+      if (!first)
+        out += ',';
+      first = false;
+      caf::visit(*this, x.get_data());
+    }
+    out += ']';
+    end();
+  }
+};
+
+void put_utf8(std::string& out, uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xc0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xe0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  } else {
+    out += static_cast<char>(0xf0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (cp & 0x3f));
+  }
+}
+
+bool get_hex4(const char*& first, const char* last, uint32_t& x) {
+  if (last - first < 4)
+    return false;
+  x = 0;
+  for (int i = 0; i < 4; ++i) {
+    auto c = *first++;
+    x <<= 4;
+    if (c >= '0' && c <= '9')
+      x |= static_cast<uint32_t>(c - '0');
+    else if (c >= 'a' && c <= 'f')
+      x |= static_cast<uint32_t>(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F')
+      x |= static_cast<uint32_t>(c - 'A' + 10);
+    else
+      return false;
+  }
+  return true;
+}
+
+bool consume_literal(const char*& first, const char* last, const char* lit) {
+  json_skip_whitespace(first, last);
+  auto n = strlen(lit);
+  if (static_cast<size_t>(last - first) < n || strncmp(first, lit, n) != 0)
+    return false;
+  first += n;
+  return true;
+}
+
+bool get_number_token(const char*& first, const char* last, std::string& tok) {
+  json_skip_whitespace(first, last);
+  auto i = first;
+  while (i != last
+         && ((*i >= '0' && *i <= '9') || *i == '-' || *i == '+' || *i == '.'
+             || *i == 'e' || *i == 'E'))
+    ++i;
+  if (i == first)
+    return false;
+  tok.assign(first, i);
+  first = i;
+  return true;
+}
+
+bool get_count(const char*& first, const char* last, count& x) {
+  std::string tok;
+  if (!get_number_token(first, last, tok)
+      || tok.find_first_not_of("0123456789") != std::string::npos)
+    return false;
+  errno = 0;
+  x = strtoull(tok.c_str(), nullptr, 10);
+  return errno == 0;
+}
+
+bool get_integer(const char*& first, const char* last, integer& x) {
+  std::string tok;
+  if (!get_number_token(first, last, tok))
+    return false;
+  auto digits = tok[0] == '-' ? tok.substr(1) : tok;
+  if (digits.empty()
+      || digits.find_first_not_of("0123456789") != std::string::npos)
+    return false;
+  errno = 0;
+  x = strtoll(tok.c_str(), nullptr, 10);
+  return errno == 0;
+}
+
+bool get_real(const char*& first, const char* last, real& x) {
+  json_skip_whitespace(first, last);
+  if (first != last && *first == '"') {
+    std::string str;
+    if (!json_decode_string(first, last, str))
+      return false;
+    if (str == "nan")
+      x = NAN;
+    else if (str == "inf")
+      x = INFINITY;
+    else if (str == "-inf")
+      x = -INFINITY;
+    else
+      return false;
+    return true;
+  }
+  std::string tok;
+  if (!get_number_token(first, last, tok))
+    return false;
+  char* end;
+  x = strtod(tok.c_str(), &end);
+  return *end == '\0';
+}
+
+template <class T>
+bool get_string_form(const char*& first, const char* last, T& x) {
+  std::string str;
+  return json_decode_string(first, last, str) && convert(str, x);
+}
+
+bool get_subnet(const char*& first, const char* last, subnet& x) {
+  std::string str;
+  if (!json_decode_string(first, last, str))
+    return false;
+  auto slash = str.find('/');
+  if (slash == std::string::npos || slash + 1 == str.size()
+      || str.find_first_not_of("0123456789", slash + 1) != std::string::npos)
+    return false;
+  address addr;
+  if (!convert(str.substr(0, slash), addr))
+    return false;
+  auto len = strtoul(str.c_str() + slash + 1, nullptr, 10);
+  if (len > 128 || (addr.is_v4() && len > 32))
+    return false;
+  x = subnet{addr, static_cast<uint8_t>(len)};
+  return true;
+}
+
+// Calls `f(key, first, last)` for each member of an object, where `f` must
+// consume the value of the member.
+template <class F>
+bool parse_object(const char*& first, const char* last, F f) {
+  if (!json_consume(first, last, '{'))
+    return false;
+  if (json_consume(first, last, '}'))
+    return true;
+  std::string key;
+  for (;;) {
+    if (!json_decode_string(first, last, key) || !json_consume(first, last, ':')
+        || !f(key, first, last))
+      return false;
+    if (json_consume(first, last, ','))
+      continue;
+    return json_consume(first, last, '}');
+  }
+}
+
+// Calls `f(first, last)` for each element of an array, where `f` must
+// consume the element.
+template <class F>
+bool parse_array(const char*& first, const char* last, F f) {
+  if (!json_consume(first, last, '['))
+    return false;
+  if (json_consume(first, last, ']'))
+    return true;
+  for (;;) {
+    if (!f(first, last))
+      return false;
+    if (json_consume(first, last, ','))
+      continue;
+    return json_consume(first, last, ']');
+  }
+}
+
+bool decode_as(data::type type, const char*& first, const char* last,
+               data& x) {
+  switch (type) {
+    case data::type::address: {
+      address y;
+      if (!get_string_form(first, last, y))
+        return false;
+      x = y;
+      return true;
+    }
+    case data::type::boolean:
+      if (consume_literal(first, last, "true"))
+        x = true;
+      else if (consume_literal(first, last, "false"))
+        x = false;
+      else
+        return false;
+      return true;
+    case data::type::count: {
+      count y;
+      if (!get_count(first, last, y))
+        return false;
+      x = y;
+      return true;
+    }
+    case data::type::enum_value: {
+      std::string y;
+      if (!json_decode_string(first, last, y))
+        return false;
+      x = enum_value{std::move(y)};
+      return true;
+    }
+    case data::type::integer: {
+      integer y;
+      if (!get_integer(first, last, y))
+        return false;
+      x = y;
+      return true;
+    }
+    case data::type::none:
+      x = data{};
+      return json_skip(first, last);
+    case data::type::port: {
+      port y;
+      if (!get_string_form(first, last, y))
+        return false;
+      x = y;
+      return true;
+    }
+    case data::type::real: {
+      real y;
+      if (!get_real(first, last, y))
+        return false;
+      x = y;
+      return true;
+    }
+    case data::type::set: {
+      set y;
+      auto element = [&](const char*& pos, const char* end) -> bool {
+        data z;
+        if (!json_decode(pos, end, z))
+          return false;
+        y.insert(std::move(z));
+        return true;
+      };
+      if (!parse_array(first, last, element))
+        return false;
+      x = std::move(y);
+      return true;
+    }
+    case data::type::string: {
+      std::string y;
+      if (!json_decode_string(first, last, y))
+        return false;
+      x = std::move(y);
+      return true;
+    }
+    case data::type::subnet: {
+      subnet y;
+      if (!get_subnet(first, last, y))
+        return false;
+      x = y;
+      return true;
+    }
+    case data::type::table: {
+      table y;
+      auto element = [&](const char*& pos, const char* end) -> bool {
+        data key;
+        data value;
+        auto has_key = false;
+        auto has_value = false;
+        auto entry = [&](const std::string& k, const char*& p,
+                         const char* e) -> bool {
+          if (k == "key")
+            return has_key = json_decode(p, e, key);
+          if (k == "value")
+            return has_value = json_decode(p, e, value);
+          return json_skip(p, e);
+        };
+        if (!parse_object(pos, end, entry) || !has_key || !has_value)
+          return false;
+        y.emplace(std::move(key), std::move(value));
+        return true;
+      };
+      if (!parse_array(first, last, element))
+        return false;
+      x = std::move(y);
+      return true;
+    }
+    case data::type::timespan: {
+      integer y;
+      if (!get_integer(first, last, y))
+        return false;
+      x = timespan{y};
+      return true;
+    }
+    case data::type::timestamp: {
+      integer y;
+      if (!get_integer(first, last, y))
+        return false;
+      x = timestamp{timespan{y}};
+      return true;
+    }
+    case data::type::vector: {
+      vector y;
+      auto element = [&](const char*& pos, const char* end) -> bool {
+        y.emplace_back();
+        return json_decode(pos, end, y.back());
+      };
+      if (!parse_array(first, last, element))
+        return false;
+      x = std::move(y);
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace <anonymous>
+
+void json_encode(std::string& out, const data& x) {
+  encoder f{out};
+  caf::visit(f, x.get_data());
+}
+
+bool json_decode(const char*& first, const char* last, data& x) {
+  std::string type_name;
+  const char* value = nullptr;
+  auto member = [&](const std::string& key, const char*& pos,
+                    const char* end) -> bool {
+    if (key == "@data-type")
+      return json_decode_string(pos, end, type_name);
+    if (key == "data")
+      value = pos;
+    return json_skip(pos, end);
+  };
+  if (!parse_object(first, last, member) || value == nullptr)
+    return false;
+  for (size_t i = 0; i < num_type_names; ++i)
+    if (type_name == type_names[i])
+      return decode_as(static_cast<data::type>(i), value, last, x);
+  return false;
+}
+
+void json_encode_string(std::string& out, const std::string& str) {
+  out += '"';
+  for (auto c : str) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\b':
+        out += "\\b";
+        break;
+      case '\f':
+        out += "\\f";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+          out += buf;
+        } else {
+          // Broker strings may hold arbitrary bytes, which we pass through.
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+bool json_decode_string(const char*& first, const char* last,
+                        std::string& str) {
+  if (!json_consume(first, last, '"'))
+    return false;
+  str.clear();
+  while (first != last) {
+    auto c = *first++;
+    if (c == '"')
+      return true;
+    if (static_cast<unsigned char>(c) < 0x20)
+      return false;
+    if (c != '\\') {
+      str += c;
+      continue;
+    }
+    if (first == last)
+      return false;
+    switch (*first++) {
+      case '"':
+        str += '"';
+        break;
+      case '\\':
+        str += '\\';
+        break;
+      case '/':
+        str += '/';
+        break;
+      case 'b':
+        str += '\b';
+        break;
+      case 'f':
+        str += '\f';
+        break;
+      case 'n':
+        str += '\n';
+        break;
+      case 'r':
+        str += '\r';
+        break;
+      case 't':
+        str += '\t';
+        break;
+      case 'u': {
+        uint32_t cp;
+        if (!get_hex4(first, last, cp))
+          return false;
+        if (cp >= 0xd800 && cp < 0xdc00) {
+          // High surrogate, must be followed by a low surrogate.
+          uint32_t low;
+          if (last - first < 2 || first[0] != '\\' || first[1] != 'u')
+            return false;
+          first += 2;
+          if (!get_hex4(first, last, low) || low < 0xdc00 || low >= 0xe000)
+            return false;
+          cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+        }
+        put_utf8(str, cp);
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+bool json_skip(const char*& first, const char* last) {
+  json_skip_whitespace(first, last);
+  if (first == last)
+    return false;
+  switch (*first) {
+    case '{':
+      return parse_object(first, last,
+                          [](const std::string&, const char*& pos,
+                             const char* end) { return json_skip(pos, end); });
+    case '[':
+      return parse_array(first, last, [](const char*& pos, const char* end) {
+        return json_skip(pos, end);
+      });
+    case '"': {
+      std::string scratch;
+      return json_decode_string(first, last, scratch);
+    }
+    case 't':
+      return consume_literal(first, last, "true");
+    case 'f':
+      return consume_literal(first, last, "false");
+    case 'n':
+      return consume_literal(first, last, "null");
+    default: {
+      std::string tok;
+      return get_number_token(first, last, tok);
+    }
+  }
+}
+
+bool json_consume(const char*& first, const char* last, char c) {
+  json_skip_whitespace(first, last);
+  if (first == last || *first != c)
+    return false;
+  ++first;
+  return true;
+}
+
+void json_skip_whitespace(const char*& first, const char* last) {
+  while (first != last
+         && (*first == ' ' || *first == '\t' || *first == '\n'
+             || *first == '\r'))
+    ++first;
+}
+
+} // namespace detail
+} // namespace broker
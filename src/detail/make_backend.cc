@@ -1,5 +1,6 @@
 #include "broker/config.hh"
 
+#include "broker/detail/append_log_backend.hh"
 #include "broker/detail/die.hh"
 #include "broker/detail/make_backend.hh"
 #include "broker/detail/make_unique.hh"
@@ -23,6 +24,8 @@ std::unique_ptr<detail::abstract_backend> make_backend(backend type,
 #else
       die("not compiled with RocksDB support");
 #endif
+    case append_log:
+      return std::make_unique<append_log_backend>(std::move(opts));
   }
 
   die("invalid backend type");
@@ -1,5 +1,7 @@
 #include "broker/logger.hh" // Needs to come before CAF includes.
 
+#include <vector>
+
 #include <caf/event_based_actor.hpp>
 #include <caf/actor.hpp>
 #include <caf/make_message.hpp>
@@ -31,20 +33,30 @@ static inline optional<timestamp> to_opt_timestamp(timestamp ts,
 
 const char* master_state::name = "master_actor";
 
-master_state::master_state() : self(nullptr), clock(nullptr) {
+master_state::master_state()
+  : self(nullptr),
+    publish_changes(false),
+    announce_clear(true),
+    clock(nullptr),
+    coalesce_window(0),
+    flush_scheduled(false),
+    coalesced_in(0),
+    coalesced_out(0) {
   // nop
 }
 
 void master_state::init(caf::event_based_actor* ptr, std::string&& nm,
                         backend_pointer&& bp, caf::actor&& parent,
-                        endpoint::clock* ep_clock) {
+                        endpoint::clock* ep_clock, timespan window) {
   BROKER_ASSERT(ep_clock != nullptr);
   self = ptr;
   id = std::move(nm);
   clones_topic = id / topics::clone_suffix;
+  changes_topic = id / topics::changes_suffix;
   backend = std::move(bp);
   core = std::move(parent);
   clock = ep_clock;
+  coalesce_window = window;
   auto es = backend->expiries();
   if (!es)
     die("failed to get master expiries while initializing");
@@ -59,9 +71,104 @@ void master_state::init(caf::event_based_actor* ptr, std::string&& nm,
 }
 
 void master_state::broadcast(internal_command&& x) {
+  if (router) {
+    self->send(router, atom::publish::value, std::move(x));
+    return;
+  }
   self->send(core, atom::publish::value, clones_topic, std::move(x));
 }
 
+void master_state::coalesce(internal_command&& x) {
+  ++coalesced_in;
+  auto key = command_key(x);
+  if (key == nullptr) {
+    // Commands without a key must not overtake pending updates, except for
+    // clear, which makes them obsolete.
+    if (caf::holds_alternative<clear_command>(x.content))
+      pending_updates.clear();
+    else
+      flush();
+    ++coalesced_out;
+    broadcast(std::move(x));
+    return;
+  }
+  auto i = pending_updates.find(*key);
+  if (i != pending_updates.end()) {
+    i->second.cmd = std::move(x);
+    ++i->second.merged;
+  } else {
+    auto k = *key;
+    pending_updates.emplace(std::move(k), pending_update{std::move(x), 1});
+  }
+  if (!flush_scheduled) {
+    flush_scheduled = true;
+    auto msg = caf::make_message(atom::tick::value, atom::coalesce::value);
+    clock->send_later(self, coalesce_window, std::move(msg));
+  }
+}
+
+void master_state::flush() {
+  if (pending_updates.empty())
+    return;
+  std::vector<internal_command> xs;
+  xs.reserve(pending_updates.size());
+  for (auto& kvp : pending_updates) {
+    auto& x = kvp.second;
+    auto& content = x.cmd.content;
+    if (x.merged == 1 || caf::holds_alternative<put_command>(content)
+        || caf::holds_alternative<erase_command>(content)) {
+      // The latest put or erase overrides all earlier commands.
+      xs.emplace_back(std::move(x.cmd));
+    } else if (auto y = caf::get_if<put_unique_command>(&content)) {
+      // Clones did not see the earlier commands, hence they must not skip
+      // this update if the key existed before the window.
+      xs.emplace_back(put_command{std::move(y->key), std::move(y->value),
+                                  y->expiry});
+    } else {
+      // Adds and subtracts accumulated in the backend, so we send the result.
+      auto value = backend->get(kvp.first);
+      if (value)
+        xs.emplace_back(put_command{kvp.first, std::move(*value), {}});
+      else if (value.error() == ec::no_such_key)
+        xs.emplace_back(erase_command{kvp.first});
+      else
+        BROKER_ERROR("failed to read coalesced key" << kvp.first);
+    }
+  }
+  pending_updates.clear();
+  coalesced_out += xs.size();
+  BROKER_DEBUG("COALESCE" << coalesced_in << "commands into"
+               << coalesced_out << "updates");
+  if (xs.size() == 1)
+    broadcast(std::move(xs.front()));
+  else if (!xs.empty())
+    broadcast(internal_command{batch_command{std::move(xs)}});
+}
+
+void master_state::publish_change(store_event::type kind, const data& key,
+                                  data value) {
+  if (!publish_changes)
+    return;
+  // Subscribers filter by key prefix, hence string keys go into the topic
+  // verbatim while all other keys use their string representation.
+  auto str = caf::get_if<std::string>(&key);
+  auto t = changes_topic / (str ? *str : to_string(key));
+  auto x = store_event{kind, key, std::move(value)}.to_data();
+  self->send(core, atom::publish::value, atom::changes::value, std::move(t),
+             std::move(x));
+}
+
+void master_state::publish_change(store_event::type kind, const data& key) {
+  if (!publish_changes)
+    return;
+  auto x = backend->get(key);
+  if (!x) {
+    BROKER_WARNING("failed to read new value of" << key);
+    return;
+  }
+  publish_change(kind, key, std::move(*x));
+}
+
 void master_state::remind(timespan expiry, const data& key) {
   auto msg = caf::make_message(atom::expire::value, key);
   clock->send_later(self, expiry, std::move(msg));
@@ -75,6 +182,7 @@ void master_state::expire(data& key) {
   else if (!*result)
     BROKER_WARNING("ignoring stale expiration reminder");
   else {
+    publish_change(store_event::type::expire, key, nil);
     broadcast_cmd_to_clones(erase_command{std::move(key)});
   }
 }
@@ -97,6 +205,7 @@ void master_state::operator()(put_command& x) {
   }
   if (x.expiry)
     remind(*x.expiry, x.key);
+  publish_change(store_event::type::put, x.key, x.value);
   broadcast_cmd_to_clones(std::move(x));
 }
 
@@ -129,6 +238,8 @@ void master_state::operator()(put_unique_command& x) {
   if (x.expiry)
     remind(*x.expiry, x.key);
 
+  publish_change(store_event::type::put, x.key, x.value);
+
   // Note that we could just broadcast a regular "put" command here instead
   // since clones shouldn't have to do their own existence check.
   broadcast_cmd_to_clones(std::move(x));
@@ -141,6 +252,7 @@ void master_state::operator()(erase_command& x) {
     BROKER_WARNING("failed to erase" << x.key);
     return; // TODO: propagate failure? to all clones? as status msg?
   }
+  publish_change(store_event::type::erase, x.key, nil);
   broadcast_cmd_to_clones(std::move(x));
 }
 
@@ -154,6 +266,7 @@ void master_state::operator()(add_command& x) {
   }
   if (x.expiry)
     remind(*x.expiry, x.key);
+  publish_change(store_event::type::add, x.key);
   broadcast_cmd_to_clones(std::move(x));
 }
 
@@ -167,6 +280,7 @@ void master_state::operator()(subtract_command& x) {
   }
   if (x.expiry)
     remind(*x.expiry, x.key);
+  publish_change(store_event::type::add, x.key);
   broadcast_cmd_to_clones(std::move(x));
 }
 
@@ -176,11 +290,20 @@ void master_state::operator()(snapshot_command& x) {
     BROKER_INFO("snapshot command with invalid address received");
     return;
   }
+  // The snapshot includes all pending updates, which therefore must reach
+  // the clones before the sync point.
+  flush();
   auto ss = backend->snapshot();
   if (!ss)
     die("failed to snapshot master");
   self->monitor(x.remote_core);
   clones.emplace(x.remote_core->address(), x.remote_clone);
+  if (router) {
+    // The partitioned master merges the snapshots of all shards and takes
+    // care of the sync point.
+    self->send(router, atom::snapshot::value, std::move(*ss));
+    return;
+  }
 
   // The snapshot gets sent over a different channel than updates,
   // so we send a "sync" point over the update channel that target clone
@@ -216,21 +339,39 @@ void master_state::operator()(clear_command& x) {
   auto res = backend->clear();
   if (!res)
     die("failed to clear master");
+  // A single event tells all change subscribers that every key is gone.
+  if (publish_changes && announce_clear) {
+    auto ev = store_event{store_event::type::clear, nil, nil}.to_data();
+    self->send(core, atom::publish::value, atom::changes::value,
+               id / topics::cleared_suffix, std::move(ev));
+  }
   broadcast_cmd_to_clones(std::move(x));
 }
 
+void master_state::operator()(batch_command& x) {
+  BROKER_INFO("BATCH of" << x.commands.size() << "commands");
+  for (auto& cmd : x.commands)
+    command(cmd);
+}
+
 caf::behavior master_actor(caf::stateful_actor<master_state>* self,
                            caf::actor core, std::string id,
                            master_state::backend_pointer backend,
-                           endpoint::clock* clock) {
+                           endpoint::clock* clock, timespan coalesce_window) {
   self->monitor(core);
   self->state.init(self, std::move(id), std::move(backend),
-                   std::move(core), clock);
+                   std::move(core), clock, coalesce_window);
   self->set_down_handler(
     [=](const caf::down_msg& msg) {
       if (msg.source == core) {
         BROKER_INFO("core is down, kill master as well");
         self->quit(msg.reason);
+      } else if (self->state.change_subscribers.erase(msg.source) > 0) {
+        BROKER_INFO("lost a change subscriber");
+        if (self->state.change_subscribers.empty()) {
+          BROKER_INFO("disable change events");
+          self->state.publish_changes = false;
+        }
       } else {
         BROKER_INFO("lost a clone");
         self->state.clones.erase(msg.source);
@@ -246,9 +387,33 @@ caf::behavior master_actor(caf::stateful_actor<master_state>* self,
     [=](atom::sync_point, caf::actor& who) {
       self->send(who, atom::sync_point::value);
     },
+    [=](atom::sync_point) {
+      return atom::sync_point::value;
+    },
     [=](atom::expire, data& key) {
       self->state.expire(key);
     },
+    [=](atom::tick, atom::coalesce) {
+      self->state.flush_scheduled = false;
+      self->state.flush();
+    },
+    [=](atom::get, atom::coalesce) {
+      auto& st = self->state;
+      return caf::make_message(st.coalesced_in, st.coalesced_out);
+    },
+    [=](atom::subscribe, atom::changes) {
+      // Change subscribers receive their events through our core.
+      return self->state.core;
+    },
+    [=](atom::subscribe, atom::changes, caf::actor& who) {
+      auto& st = self->state;
+      if (!st.change_subscribers.emplace(who.address()).second)
+        return;
+      if (!st.publish_changes)
+        BROKER_INFO("enable change events");
+      st.publish_changes = true;
+      self->monitor(who);
+    },
     [=](atom::get, atom::keys) -> expected<data> {
       auto x = self->state.backend->keys();
       BROKER_INFO("KEYS ->" << x);
@@ -321,5 +486,18 @@ caf::behavior master_actor(caf::stateful_actor<master_state>* self,
   };
 }
 
+caf::behavior master_shard_actor(caf::stateful_actor<master_state>* self,
+                                 caf::actor core, caf::actor router,
+                                 std::string id,
+                                 master_state::backend_pointer backend,
+                                 endpoint::clock* clock,
+                                 timespan coalesce_window,
+                                 bool announce_clear) {
+  self->state.router = std::move(router);
+  self->state.announce_clear = announce_clear;
+  return master_actor(self, std::move(core), std::move(id), std::move(backend),
+                      clock, coalesce_window);
+}
+
 } // namespace detail
 } // namespace broker
@@ -0,0 +1,400 @@
+#include "broker/logger.hh" // Needs to come before CAF includes.
+
+#include <memory>
+#include <utility>
+
+#include <caf/actor.hpp>
+#include <caf/actor_cast.hpp>
+#include <caf/behavior.hpp>
+#include <caf/error.hpp>
+#include <caf/event_based_actor.hpp>
+#include <caf/make_message.hpp>
+#include <caf/response_promise.hpp>
+#include <caf/spawn_options.hpp>
+#include <caf/stateful_actor.hpp>
+#include <caf/system_messages.hpp>
+#include <caf/unit.hpp>
+
+#include "broker/atoms.hh"
+#include "broker/data.hh"
+#include "broker/error.hh"
+#include "broker/store.hh"
+#include "broker/timeout.hh"
+#include "broker/topic.hh"
+
+#include "broker/detail/assert.hh"
+#include "broker/detail/blob.hh"
+#include "broker/detail/master_actor.hh"
+#include "broker/detail/partitioned_master_actor.hh"
+
+namespace broker {
+namespace detail {
+
+namespace {
+
+// Routing must not change between runs, because persistent shards keep their
+// keys across restarts. Hence, we hash the serialized key with FNV-1a instead
+// of relying on std::hash.
+uint64_t stable_hash(const data& key) {
+  auto buf = to_blob(key);
+  uint64_t result = 14695981039346656037ull;
+  for (auto c : buf) {
+    result ^= static_cast<uint8_t>(c);
+    result *= 1099511628211ull;
+  }
+  return result;
+}
+
+// Collects the keys of all shards and calls `f` with either the merged set or
+// the first error.
+template <class F>
+void collect_keys(caf::stateful_actor<partitioned_master_state>* self, F f) {
+  struct state {
+    size_t remaining;
+    set keys;
+    bool failed;
+  };
+  auto st = std::make_shared<state>();
+  st->remaining = self->state.shards.size();
+  st->failed = false;
+  for (auto& shard : self->state.shards) {
+    self->request(shard, caf::infinite, atom::get::value, atom::keys::value)
+    .then(
+      [=](data& xs) mutable {
+        if (st->failed)
+          return;
+        if (auto ks = caf::get_if<set>(&xs))
+          st->keys.insert(ks->begin(), ks->end());
+        if (--st->remaining == 0)
+          f(expected<data>{data{std::move(st->keys)}});
+      },
+      [=](caf::error& e) mutable {
+        if (st->failed)
+          return;
+        st->failed = true;
+        f(expected<data>{std::move(e)});
+      }
+    );
+  }
+}
+
+// Sums up the coalescing statistics of all shards and calls `f` with either
+// the number of commands that entered and left the coalescing windows or the
+// first error. A shard that fails to answer in time counts as an error.
+template <class F>
+void collect_coalesce_stats(
+  caf::stateful_actor<partitioned_master_state>* self, F f) {
+  using result_type = expected<std::pair<count, count>>;
+  struct state {
+    size_t remaining;
+    count in;
+    count out;
+    bool failed;
+  };
+  auto st = std::make_shared<state>();
+  st->remaining = self->state.shards.size();
+  st->in = 0;
+  st->out = 0;
+  st->failed = false;
+  for (auto& shard : self->state.shards) {
+    self->request(shard, timeout::frontend, atom::get::value,
+                  atom::coalesce::value)
+    .then(
+      [=](count in, count out) mutable {
+        if (st->failed)
+          return;
+        st->in += in;
+        st->out += out;
+        if (--st->remaining == 0)
+          f(result_type{std::make_pair(st->in, st->out)});
+      },
+      [=](caf::error& e) mutable {
+        if (st->failed)
+          return;
+        st->failed = true;
+        f(result_type{std::move(e)});
+      }
+    );
+  }
+}
+
+} // namespace <anonymous>
+
+const char* partitioned_master_state::name = "partitioned_master_actor";
+
+partitioned_master_state::partitioned_master_state() : self(nullptr) {
+  // nop
+}
+
+void partitioned_master_state::init(caf::event_based_actor* ptr,
+                                    std::string&& nm, caf::actor&& parent,
+                                    std::vector<caf::actor>&& xs) {
+  self = ptr;
+  id = std::move(nm);
+  clones_topic = id / topics::clone_suffix;
+  core = std::move(parent);
+  shards = std::move(xs);
+}
+
+const caf::actor& partitioned_master_state::shard_of(const data& key) const {
+  return shards[stable_hash(key) % shards.size()];
+}
+
+void partitioned_master_state::broadcast(internal_command&& x) {
+  self->send(core, atom::publish::value, clones_topic, std::move(x));
+}
+
+void partitioned_master_state::broadcast_from(const caf::actor_addr& shard,
+                                              internal_command&& x) {
+  if (snapshot_shards.count(shard) != 0) {
+    deferred.emplace_back(std::move(x));
+    return;
+  }
+  broadcast(std::move(x));
+}
+
+void partitioned_master_state::add_snapshot(const caf::actor_addr& shard,
+                                            broker::snapshot& ss) {
+  if (pending_snapshots.empty() || !snapshot_shards.emplace(shard).second) {
+    BROKER_ERROR("received an unexpected snapshot from a shard");
+    return;
+  }
+  for (auto& kvp : ss)
+    snapshot_state.emplace(std::move(kvp.first), std::move(kvp.second));
+  if (snapshot_shards.size() < shards.size())
+    return;
+  // All shards are in. Everything a shard sent before its snapshot is already
+  // published, so the sync point goes out now, followed by the updates that
+  // arrived after the snapshots.
+  auto clone = std::move(pending_snapshots.front().remote_clone);
+  pending_snapshots.pop_front();
+  broadcast(internal_command{snapshot_sync_command{clone}});
+  for (auto& cmd : deferred)
+    broadcast(std::move(cmd));
+  deferred.clear();
+  snapshot_shards.clear();
+  self->send(clone, set_command{std::move(snapshot_state)});
+  snapshot_state = broker::snapshot{};
+  request_snapshots();
+}
+
+void partitioned_master_state::request_snapshots() {
+  if (pending_snapshots.empty())
+    return;
+  auto& x = pending_snapshots.front();
+  for (auto& shard : shards)
+    self->send(shard, atom::local::value,
+               make_internal_command<snapshot_command>(x.remote_core,
+                                                       x.remote_clone));
+}
+
+void partitioned_master_state::command(internal_command& cmd) {
+  caf::visit(*this, cmd.content);
+}
+
+void partitioned_master_state::operator()(none) {
+  BROKER_INFO("received empty command");
+}
+
+void partitioned_master_state::operator()(put_command& x) {
+  auto& shard = shard_of(x.key);
+  self->send(shard, atom::local::value, internal_command{std::move(x)});
+}
+
+void partitioned_master_state::operator()(put_unique_command& x) {
+  auto& shard = shard_of(x.key);
+  self->send(shard, atom::local::value, internal_command{std::move(x)});
+}
+
+void partitioned_master_state::operator()(erase_command& x) {
+  auto& shard = shard_of(x.key);
+  self->send(shard, atom::local::value, internal_command{std::move(x)});
+}
+
+void partitioned_master_state::operator()(add_command& x) {
+  auto& shard = shard_of(x.key);
+  self->send(shard, atom::local::value, internal_command{std::move(x)});
+}
+
+void partitioned_master_state::operator()(subtract_command& x) {
+  auto& shard = shard_of(x.key);
+  self->send(shard, atom::local::value, internal_command{std::move(x)});
+}
+
+void partitioned_master_state::operator()(snapshot_command& x) {
+  BROKER_INFO("SNAPSHOT from" << to_string(x.remote_core));
+  if (x.remote_core == nullptr || x.remote_clone == nullptr) {
+    BROKER_INFO("snapshot command with invalid address received");
+    return;
+  }
+  pending_snapshots.emplace_back(std::move(x));
+  if (pending_snapshots.size() == 1)
+    request_snapshots();
+}
+
+void partitioned_master_state::operator()(snapshot_sync_command&) {
+  BROKER_ERROR("received a snapshot_sync_command in partitioned master");
+}
+
+void partitioned_master_state::operator()(set_command&) {
+  BROKER_ERROR("received a set_command in partitioned master");
+}
+
+void partitioned_master_state::operator()(clear_command& x) {
+  BROKER_INFO("CLEAR" << x);
+  for (auto& shard : shards)
+    self->send(shard, atom::local::value, internal_command{x});
+}
+
+void partitioned_master_state::operator()(batch_command& x) {
+  for (auto& cmd : x.commands)
+    command(cmd);
+}
+
+caf::behavior partitioned_master_actor(
+  caf::stateful_actor<partitioned_master_state>* self, caf::actor core,
+  std::string id, std::vector<master_state::backend_pointer> backends,
+  endpoint::clock* clock, timespan coalesce_window) {
+  BROKER_ASSERT(!backends.empty());
+  self->monitor(core);
+  std::vector<caf::actor> shards;
+  shards.reserve(backends.size());
+  for (size_t i = 0; i < backends.size(); ++i) {
+    BROKER_ASSERT(backends[i]);
+    shards.emplace_back(self->spawn<caf::linked>(
+      master_shard_actor, core, caf::actor_cast<caf::actor>(self), id,
+      std::move(backends[i]), clock, coalesce_window, i == 0));
+  }
+  self->state.init(self, std::move(id), caf::actor{core}, std::move(shards));
+  self->set_down_handler(
+    [=](const caf::down_msg& msg) {
+      if (msg.source == core) {
+        BROKER_INFO("core is down, kill partitioned master as well");
+        self->quit(msg.reason);
+      }
+    }
+  );
+  return {
+    // --- local communication -------------------------------------------------
+    [=](atom::local, internal_command& x) {
+      // treat locally and remotely received commands in the same way
+      self->state.command(x);
+    },
+    [=](atom::sync_point, caf::actor& who) {
+      // Reply only after every shard has processed all prior messages.
+      auto remaining = std::make_shared<size_t>(self->state.shards.size());
+      for (auto& shard : self->state.shards) {
+        self->request(shard, timeout::frontend, atom::sync_point::value).then(
+          [=](atom::sync_point) {
+            if (--*remaining == 0)
+              self->send(who, atom::sync_point::value);
+          },
+          [=](caf::error& e) {
+            BROKER_ERROR("shard failed to sync:" << e);
+            if (--*remaining == 0)
+              self->send(who, atom::sync_point::value);
+          }
+        );
+      }
+    },
+    [=](atom::get, atom::coalesce) -> caf::result<count, count> {
+      auto rp = self->make_response_promise<count, count>();
+      collect_coalesce_stats(self,
+                             [=](expected<std::pair<count, count>> x) mutable {
+        if (x)
+          rp.deliver(x->first, x->second);
+        else
+          rp.deliver(std::move(x.error()));
+      });
+      return rp;
+    },
+    [=](atom::subscribe, atom::changes) {
+      // Change subscribers receive their events through our core.
+      return self->state.core;
+    },
+    [=](atom::subscribe, atom::changes, const caf::actor& who) {
+      // Shards publish change events for their keys directly.
+      for (auto& shard : self->state.shards)
+        self->send(shard, atom::subscribe::value, atom::changes::value, who);
+    },
+    // --- communication with shards -------------------------------------------
+    [=](atom::publish, internal_command& x) {
+      self->state.broadcast_from(self->current_sender()->address(),
+                                 std::move(x));
+    },
+    [=](atom::snapshot, broker::snapshot& ss) {
+      self->state.add_snapshot(self->current_sender()->address(), ss);
+    },
+    // --- queries -------------------------------------------------------------
+    [=](atom::get, atom::keys) -> caf::result<data> {
+      auto rp = self->make_response_promise<data>();
+      collect_keys(self, [=](expected<data> x) mutable {
+        BROKER_INFO("KEYS ->" << x);
+        if (x)
+          rp.deliver(std::move(*x));
+        else
+          rp.deliver(std::move(x.error()));
+      });
+      return rp;
+    },
+    [=](atom::get, atom::keys, request_id id) {
+      auto who = caf::actor_cast<caf::actor>(self->current_sender());
+      collect_keys(self, [=](expected<data> x) {
+        BROKER_INFO("KEYS" << "with id:" << id << "->" << x);
+        if (x)
+          self->send(who, std::move(*x), id);
+        else
+          self->send(who, std::move(x.error()), id);
+      });
+    },
+    [=](atom::exists, const data& key) {
+      return self->delegate(self->state.shard_of(key), atom::exists::value,
+                            key);
+    },
+    [=](atom::exists, const data& key, request_id id) {
+      return self->delegate(self->state.shard_of(key), atom::exists::value,
+                            key, id);
+    },
+    [=](atom::get, const data& key) {
+      return self->delegate(self->state.shard_of(key), atom::get::value, key);
+    },
+    [=](atom::get, const data& key, const data& aspect) {
+      return self->delegate(self->state.shard_of(key), atom::get::value, key,
+                            aspect);
+    },
+    [=](atom::get, const data& key, request_id id) {
+      return self->delegate(self->state.shard_of(key), atom::get::value, key,
+                            id);
+    },
+    [=](atom::get, const data& key, const data& value, request_id id) {
+      return self->delegate(self->state.shard_of(key), atom::get::value, key,
+                            value, id);
+    },
+    [=](atom::get, atom::name) {
+      return self->state.id;
+    },
+    // --- stream handshake with core ------------------------------------------
+    [=](const store::stream_type& in) {
+      BROKER_DEBUG("received stream handshake from core");
+      self->make_sink(
+        // input stream
+        in,
+        // initialize state
+        [](caf::unit_t&) {
+          // nop
+        },
+        // processing step
+        [=](caf::unit_t&, store::stream_type::value_type y) {
+          self->state.command(y.second);
+        },
+        // cleanup
+        [](caf::unit_t&, const caf::error&) {
+          // nop
+        }
+      );
+    }
+  };
+}
+
+} // namespace detail
+} // namespace broker
@@ -1,5 +1,9 @@
+#include <rocksdb/cache.h>
 #include <rocksdb/db.h>
+#include <rocksdb/filter_policy.h>
 #include <rocksdb/options.h>
+#include <rocksdb/slice_transform.h>
+#include <rocksdb/table.h>
 
 #include "broker/logger.hh"
 
@@ -9,6 +13,7 @@
 #include "broker/detail/assert.hh"
 #include "broker/detail/appliers.hh"
 #include "broker/detail/blob.hh"
+#include "broker/detail/container_elements.hh"
 #include "broker/detail/filesystem.hh"
 #include "broker/detail/make_unique.hh"
 #include "broker/detail/rocksdb_backend.hh"
@@ -16,80 +21,125 @@
 namespace broker {
 namespace detail {
 
-// The data store layout follows the following convention: we use a key-space
-// prefix to emulate different tables:
+// The data store layout uses one column family per table:
 //
-//   - 'm' for meta data
-//   - 'd' for application data
-//   - 'e' for expiration values
+//   - the default column family for meta data
+//   - 'data' for application data
+//   - 'expiry' for expiration values
+//   - 'elements' for the members of sets, tables, and vectors
 //
+// Keys are plain serialized `data` values in the first three column families.
+// Keys in 'elements' consist of the serialized key of the container, prefixed
+// with its length as 4-byte big-endian integer, followed by the member. Earlier
+// versions emulated these tables in the default column family by prepending a
+// one-byte prefix ('m', 'd', or 'e') to each key. Such databases get migrated
+// to the new layout when opening them.
 namespace {
 
-enum class prefix : char {
-  meta = 'm',
-  data = 'd',
-  expiry = 'e',
-};
+constexpr const char* data_cf_name = "data";
+
+constexpr const char* expiry_cf_name = "expiry";
+
+constexpr const char* elements_cf_name = "elements";
+
+constexpr const char* version_key = "broker_version";
+
+constexpr const char* legacy_version_key = "mbroker_version";
+
+// Length of the fixed prefix used for the prefix bloom filters. Serialized
+// keys start with the type tag of the `data` variant, followed by the
+// (variable-length) size for strings or the raw value for numbers, so the
+// first bytes cluster keys of the same type and similar content.
+constexpr size_t bloom_prefix_length = 4;
+
+template <class T>
+bool get_option(const backend_options& opts, const char* key, T& dst) {
+  auto i = opts.find(key);
+  if (i == opts.end())
+    return false;
+  if (auto x = caf::get_if<T>(&i->second)) {
+    dst = *x;
+    return true;
+  }
+  BROKER_ERROR(std::string{key} + " has an invalid type");
+  return false;
+}
+
+bool parse_compression(const std::string& str, rocksdb::CompressionType& x) {
+  if (str == "none")
+    x = rocksdb::kNoCompression;
+  else if (str == "snappy")
+    x = rocksdb::kSnappyCompression;
+  else if (str == "zlib")
+    x = rocksdb::kZlibCompression;
+  else if (str == "bzip2")
+    x = rocksdb::kBZip2Compression;
+  else if (str == "lz4")
+    x = rocksdb::kLZ4Compression;
+  else if (str == "lz4hc")
+    x = rocksdb::kLZ4HCCompression;
+  else if (str == "zstd")
+    x = rocksdb::kZSTD;
+  else
+    return false;
+  return true;
+}
 
-template <prefix P, class T, class... Ts>
-std::string to_key_blob(T&& x, Ts&&... xs) {
-  return to_blob(P, std::forward<T>(x), std::forward<Ts>(xs)...);
+bool parse_compaction_style(const std::string& str,
+                            rocksdb::CompactionStyle& x) {
+  if (str == "level")
+    x = rocksdb::kCompactionStyleLevel;
+  else if (str == "universal")
+    x = rocksdb::kCompactionStyleUniversal;
+  else if (str == "fifo")
+    x = rocksdb::kCompactionStyleFIFO;
+  else
+    return false;
+  return true;
 }
 
-template <prefix P>
-data from_key_blob(const char* data, size_t size) {
-  BROKER_ASSERT(size > 1);
-  BROKER_ASSERT(data[0] == static_cast<char>(P));
-  return from_blob<broker::data>(data + 1, size - 1);
+// Returns the common prefix of all member keys of a container.
+std::string element_prefix(const std::string& key_blob) {
+  std::string result(4, '\0');
+  auto n = static_cast<uint32_t>(key_blob.size());
+  for (auto i = result.size(); i > 0; --i) {
+    result[i - 1] = static_cast<char>(n & 0xFF);
+    n >>= 8;
+  }
+  return result + key_blob;
 }
 
 } // namespace <anonymous>
 
 struct rocksdb_backend::impl {
   template <class Key, class Value>
-  bool put(const Key& key, const Value& value) {
-    if (!db)
-      return false;
-    auto status = db->Put({}, key, value);
-    if (!status.ok()) {
-      BROKER_ERROR("failed put key-value-pair:" << status.ToString());
-      return false;
-    }
-    return true;
+  void stage(rocksdb::WriteBatch& batch, const Key& key, const Value& value,
+             optional<timestamp> expiry) {
+    batch.Put(data_cf, key, value);
+    // Write or clear expiry.
+    if (expiry)
+      batch.Put(expiry_cf, key, to_blob(*expiry));
+    else
+      batch.Delete(expiry_cf, key);
   }
 
-  template <class Key, class Value>
-  bool put(Key& key, const Value& value, optional<timestamp> expiry) {
-    if (!db)
-      return false;
-    rocksdb::WriteBatch batch;
-    batch.Put(key, value);
-    // Write expiry.
-    if (expiry) {
-      BROKER_ASSERT(key.size() > 1);
-      key[0] = static_cast<char>(prefix::expiry); // reuse key blob
-      auto blob = to_blob(*expiry);
-      batch.Put(key, blob);
-    }
-    auto status = db->Write({}, &batch);
+  bool write(rocksdb::WriteBatch& batch) {
+    auto status = db->Write(write_opts, &batch);
     if (!status.ok()) {
-      BROKER_ERROR("failed to put key-value pair:" << status.ToString());
+      BROKER_ERROR("failed to write batch:" << status.ToString());
       return false;
     }
     return true;
   }
 
   template <class Key>
-  expected<std::string> get(const Key& key) {
+  expected<std::string> get(rocksdb::ColumnFamilyHandle* cf, const Key& key) {
     if (!db)
       return ec::backend_failure;
     std::string value;
-    bool exists;
-    if (!db->KeyMayExist({}, key, &value, &exists))
+    if (!db->KeyMayExist(rocksdb::ReadOptions{}, cf, key, &value, nullptr))
       return ec::no_such_key;
-    if (exists)
-      return value;
-    auto status = db->Get(rocksdb::ReadOptions{}, key, &value);
+    auto status = db->Get(rocksdb::ReadOptions{}, cf, key, &value);
     if (status.IsNotFound())
       return ec::no_such_key;
     if (!status.ok()) {
@@ -99,20 +149,18 @@ struct rocksdb_backend::impl {
     return value;
   }
 
-  // This is a rather expensive operation for large values, because the RocksDB
-  // API surprisingly doesn't allow for efficient checking of key existence; a
-  // value is always returned along the way.
+  // Checks for existence without copying the value: the bloom filter answers
+  // most negative lookups and a positive lookup only pins the block that
+  // contains the key.
   template <class Key>
-  expected<bool> exists(const Key& key) {
+  expected<bool> exists(rocksdb::ColumnFamilyHandle* cf, const Key& key) {
     if (!db)
       return ec::backend_failure;
-    bool exists;
-    std::string value; // unused, but can't pass nullptr
-    if (!db->KeyMayExist({}, key, &value, &exists))
+    std::string unused;
+    if (!db->KeyMayExist(rocksdb::ReadOptions{}, cf, key, &unused, nullptr))
       return false;
-    if (exists)
-      return true;
-    auto status = db->Get(rocksdb::ReadOptions{}, key, nullptr);
+    rocksdb::PinnableSlice value;
+    auto status = db->Get(rocksdb::ReadOptions{}, cf, key, &value);
     if (status.IsNotFound())
       return false;
     if (!status.ok()) {
@@ -122,18 +170,248 @@ struct rocksdb_backend::impl {
     return true;
   }
 
-  template <class Key>
-  expected<void> erase(const Key& key) {
-    if (!db)
+  std::unique_ptr<rocksdb::Iterator>
+  iterator(rocksdb::ColumnFamilyHandle* cf) {
+    rocksdb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.total_order_seek = true; // bypass the prefix extractor
+    auto i = std::unique_ptr<rocksdb::Iterator>{db->NewIterator(opts, cf)};
+    i->SeekToFirst();
+    return i;
+  }
+
+  // Visits all members of the container with the given element prefix.
+  template <class F>
+  bool for_each_element(const std::string& prefix, F f) {
+    rocksdb::ReadOptions opts;
+    opts.fill_cache = false;
+    auto i = std::unique_ptr<rocksdb::Iterator>{
+      db->NewIterator(opts, elements_cf)};
+    for (i->Seek(prefix); i->Valid() && i->key().starts_with(prefix);
+         i->Next()) {
+      auto key = i->key();
+      key.remove_prefix(prefix.size());
+      f(key, i->value());
+    }
+    if (!i->status().ok()) {
+      BROKER_ERROR("failed to read elements:" << i->status().ToString());
+      return false;
+    }
+    return true;
+  }
+
+  // Stages the removal of all members of a container.
+  bool erase_elements(rocksdb::WriteBatch& batch, const std::string& prefix) {
+    return for_each_element(prefix, [&](const rocksdb::Slice& member,
+                                        const rocksdb::Slice&) {
+      batch.Delete(elements_cf, prefix + member.ToString());
+    });
+  }
+
+  // Stages the value under `key_blob`, storing containers element-wise.
+  bool stage_value(rocksdb::WriteBatch& batch, const std::string& key_blob,
+                   const data& value, optional<timestamp> expiry,
+                   container_header* out = nullptr) {
+    auto prefix = element_prefix(key_blob);
+    if (!erase_elements(batch, prefix))
+      return false;
+    auto type = value.get_type();
+    if (!stores_elements(type)) {
+      stage(batch, key_blob, to_blob(value), expiry);
+      return true;
+    }
+    container_header hdr{type, 0};
+    if (auto xs = caf::get_if<set>(&value)) {
+      for (auto& x : *xs)
+        batch.Put(elements_cf, prefix + to_blob(x), rocksdb::Slice{});
+      hdr.size = xs->size();
+    } else if (auto xs = caf::get_if<table>(&value)) {
+      for (auto& x : *xs)
+        batch.Put(elements_cf, prefix + to_blob(x.first), to_blob(x.second));
+      hdr.size = xs->size();
+    } else if (auto xs = caf::get_if<vector>(&value)) {
+      for (auto& x : *xs)
+        batch.Put(elements_cf, prefix + position_blob(hdr.size++),
+                  to_blob(x));
+    }
+    stage(batch, key_blob, to_header_blob(hdr), expiry);
+    if (out)
+      *out = hdr;
+    return true;
+  }
+
+  // Assembles a container from its elements.
+  expected<data> load(const std::string& key_blob,
+                      const container_header& hdr) {
+    auto result = data::from_type(hdr.type);
+    auto ok = for_each_element(element_prefix(key_blob),
+                               [&](const rocksdb::Slice& member,
+                                   const rocksdb::Slice& value) {
+      if (auto xs = caf::get_if<set>(&result))
+        xs->emplace(from_blob<data>(member.data(), member.size()));
+      else if (auto xs = caf::get_if<table>(&result))
+        xs->emplace(from_blob<data>(member.data(), member.size()),
+                    from_blob<data>(value.data(), value.size()));
+      else if (auto xs = caf::get_if<vector>(&result))
+        xs->emplace_back(from_blob<data>(value.data(), value.size()));
+    });
+    if (!ok)
       return ec::backend_failure;
-    auto status = db->Delete({}, key);
-    if (!status.ok()) {
-      BROKER_ERROR("failed to delete key:" << status.ToString());
+    return result;
+  }
+
+  // Decodes the raw value under `key_blob`, assembling containers.
+  expected<data> decode(const std::string& key_blob, const char* buf,
+                        size_t size) {
+    if (is_container_header(buf, size))
+      return load(key_blob, container_header_from_blob(buf, size));
+    return from_blob<data>(buf, size);
+  }
+
+  // Retrieves the header of the container under `key_blob`. Converts
+  // containers written by earlier versions as a single value. Returns `none`
+  // for values of other types and stores them in `value`.
+  expected<optional<container_header>> fetch_header(const std::string& key_blob,
+                                                    data& value,
+                                                    optional<timestamp> expiry) {
+    auto blob = get(data_cf, key_blob);
+    if (!blob)
+      return blob.error();
+    if (is_container_header(*blob))
+      return optional<container_header>{container_header_from_blob(*blob)};
+    value = from_blob<data>(*blob);
+    if (!stores_elements(value.get_type()))
+      return optional<container_header>{};
+    rocksdb::WriteBatch batch;
+    container_header hdr;
+    if (!stage_value(batch, key_blob, value, expiry, &hdr) || !write(batch))
       return ec::backend_failure;
+    return optional<container_header>{hdr};
+  }
+
+  // Stages adding `x` to the container under `key_blob`.
+  expected<void> add_element(rocksdb::WriteBatch& batch,
+                             const std::string& key_blob,
+                             container_header& hdr, const data& x) {
+    auto prefix = element_prefix(key_blob);
+    switch (hdr.type) {
+      case data::type::set: {
+        auto member = prefix + to_blob(x);
+        auto found = exists(elements_cf, member);
+        if (!found)
+          return found.error();
+        if (!*found) {
+          batch.Put(elements_cf, member, rocksdb::Slice{});
+          ++hdr.size;
+        }
+        return {};
+      }
+      case data::type::table: {
+        // Data must come as key-value pair to be valid, which we model as
+        // vector of length 2.
+        auto v = caf::get_if<vector>(&x);
+        if (!v)
+          return ec::type_clash;
+        if (v->size() != 2)
+          return ec::invalid_data;
+        auto member = prefix + to_blob(v->front());
+        auto found = exists(elements_cf, member);
+        if (!found)
+          return found.error();
+        batch.Put(elements_cf, member, to_blob(v->back()));
+        if (!*found)
+          ++hdr.size;
+        return {};
+      }
+      default:
+        batch.Put(elements_cf, prefix + position_blob(hdr.size++), to_blob(x));
+        return {};
+    }
+  }
+
+  // Stages removing `x` from the container under `key_blob`.
+  expected<void> remove_element(rocksdb::WriteBatch& batch,
+                                const std::string& key_blob,
+                                container_header& hdr, const data& x) {
+    auto prefix = element_prefix(key_blob);
+    if (hdr.type == data::type::vector) {
+      if (hdr.size > 0)
+        batch.Delete(elements_cf, prefix + position_blob(--hdr.size));
+      return {};
     }
+    auto member = prefix + to_blob(x);
+    auto found = exists(elements_cf, member);
+    if (!found)
+      return found.error();
+    if (*found) {
+      batch.Delete(elements_cf, member);
+      --hdr.size;
+    }
+    return {};
+  }
+
+  // Moves entries from the prefix-based layout into column families.
+  bool migrate_legacy_layout() {
+    std::string unused;
+    auto status = db->Get({}, legacy_version_key, &unused);
+    if (status.IsNotFound())
+      return true;
+    BROKER_INFO("migrating RocksDB store to column family layout");
+    rocksdb::WriteBatch batch;
+    auto i = iterator(db->DefaultColumnFamily());
+    for (; i->Valid(); i->Next()) {
+      auto key = i->key();
+      if (key.empty())
+        continue;
+      rocksdb::Slice suffix{key.data() + 1, key.size() - 1};
+      switch (key[0]) {
+        case 'd':
+          batch.Put(data_cf, suffix, i->value());
+          break;
+        case 'e':
+          batch.Put(expiry_cf, suffix, i->value());
+          break;
+        default:
+          break;
+      }
+      batch.Delete(key);
+    }
+    if (!i->status().ok()) {
+      BROKER_ERROR("failed to read legacy layout:" << i->status().ToString());
+      return false;
+    }
+    status = db->Write(write_opts, &batch);
+    if (!status.ok()) {
+      BROKER_ERROR("failed to migrate legacy layout:" << status.ToString());
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (!db)
+      return;
+    if (data_cf)
+      db->DestroyColumnFamilyHandle(data_cf);
+    if (expiry_cf)
+      db->DestroyColumnFamilyHandle(expiry_cf);
+    if (elements_cf)
+      db->DestroyColumnFamilyHandle(elements_cf);
+    data_cf = nullptr;
+    expiry_cf = nullptr;
+    elements_cf = nullptr;
+    delete db;
+    db = nullptr;
   }
 
   rocksdb::DB* db = nullptr;
+  rocksdb::ColumnFamilyHandle* data_cf = nullptr;
+  rocksdb::ColumnFamilyHandle* expiry_cf = nullptr;
+  rocksdb::ColumnFamilyHandle* elements_cf = nullptr;
+  rocksdb::Options db_opts;
+  rocksdb::ColumnFamilyOptions data_cf_opts;
+  rocksdb::ColumnFamilyOptions expiry_cf_opts;
+  rocksdb::WriteOptions write_opts;
   count exact_size_threshold = 10000;
   std::string path;
 };
@@ -141,22 +419,53 @@ struct rocksdb_backend::impl {
 rocksdb_backend::rocksdb_backend(backend_options opts)
   : impl_{std::make_unique<impl>()} {
   // Parse required options.
-  auto i = opts.find("path");
-  if (i == opts.end())
-    return;
-  auto path = caf::get_if<std::string>(&i->second);
-  if (!path)
+  if (!get_option(opts, "path", impl_->path))
     return;
-  impl_->path = *path;
   // Parse optional options.
-  i = opts.find("exact-size-threshold");
-  if (i != opts.end()) {
-    if (auto exact_size_threshold = caf::get_if<count>(&i->second))
-      impl_->exact_size_threshold = *exact_size_threshold;
-    else
-      BROKER_ERROR("exact-size-threshold must be of type count");
+  get_option(opts, "exact-size-threshold", impl_->exact_size_threshold);
+  count block_cache_size = 8 * 1024 * 1024;
+  get_option(opts, "block-cache-size", block_cache_size);
+  count bloom_bits_per_key = 10;
+  get_option(opts, "bloom-bits-per-key", bloom_bits_per_key);
+  auto& db_opts = impl_->db_opts;
+  db_opts.create_if_missing = true;
+  db_opts.create_missing_column_families = true;
+  count write_buffer_size = 0;
+  if (get_option(opts, "write-buffer-size", write_buffer_size))
+    db_opts.write_buffer_size = write_buffer_size;
+  std::string str;
+  if (get_option(opts, "compression", str)
+      && !parse_compression(str, db_opts.compression))
+    BROKER_ERROR("invalid compression:" << str);
+  if (get_option(opts, "compaction-style", str)
+      && !parse_compaction_style(str, db_opts.compaction_style))
+    BROKER_ERROR("invalid compaction-style:" << str);
+  bool sync = false;
+  if (get_option(opts, "sync", sync))
+    impl_->write_opts.sync = sync;
+  // All column families share one block cache.
+  rocksdb::BlockBasedTableOptions table_opts;
+  if (block_cache_size > 0)
+    table_opts.block_cache = rocksdb::NewLRUCache(block_cache_size);
+  else
+    table_opts.no_block_cache = true;
+  if (bloom_bits_per_key > 0) {
+    auto bits = static_cast<int>(bloom_bits_per_key);
+    table_opts.filter_policy.reset(rocksdb::NewBloomFilterPolicy(bits, false));
+    table_opts.whole_key_filtering = true;
+  }
+  auto table_factory = std::shared_ptr<rocksdb::TableFactory>{
+    rocksdb::NewBlockBasedTableFactory(table_opts)};
+  db_opts.table_factory = table_factory;
+  impl_->data_cf_opts = rocksdb::ColumnFamilyOptions{db_opts};
+  impl_->expiry_cf_opts = rocksdb::ColumnFamilyOptions{db_opts};
+  // Prefix bloom filters in the memtable and SST files of the data table.
+  if (bloom_bits_per_key > 0) {
+    auto& cf_opts = impl_->data_cf_opts;
+    cf_opts.prefix_extractor.reset(
+      rocksdb::NewCappedPrefixTransform(bloom_prefix_length));
+    cf_opts.memtable_prefix_bloom_size_ratio = 0.1;
   }
-
   open_db();
 }
 
@@ -170,20 +479,38 @@ bool rocksdb_backend::open_db() {
     }
   }
 
-  rocksdb::Options rocks_opts;
-  rocks_opts.create_if_missing = true;
-  auto status = rocksdb::DB::Open(rocks_opts, impl_->path.c_str(), &impl_->db);
+  std::vector<rocksdb::ColumnFamilyDescriptor> cfs{
+    {rocksdb::kDefaultColumnFamilyName,
+     rocksdb::ColumnFamilyOptions{impl_->db_opts}},
+    {data_cf_name, impl_->data_cf_opts},
+    {expiry_cf_name, impl_->expiry_cf_opts},
+    {elements_cf_name, rocksdb::ColumnFamilyOptions{impl_->db_opts}},
+  };
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  auto status = rocksdb::DB::Open(impl_->db_opts, impl_->path, cfs, &handles,
+                                  &impl_->db);
   if (!status.ok()) {
     BROKER_ERROR("failed to open DB:" << status.ToString());
     impl_->db = nullptr;
     return false;
   }
+  BROKER_ASSERT(handles.size() == 4);
+  // Open hands us a handle for every column family, including the default
+  // one. We never use the latter, so we release it right away like the
+  // others in close().
+  impl_->db->DestroyColumnFamilyHandle(handles[0]);
+  impl_->data_cf = handles[1];
+  impl_->expiry_cf = handles[2];
+  impl_->elements_cf = handles[3];
+  if (!impl_->migrate_legacy_layout()) {
+    impl_->close();
+    return false;
+  }
   // Check/write the broker version.
-  status = impl_->db->Put({}, "mbroker_version", version::string());
+  status = impl_->db->Put(impl_->write_opts, version_key, version::string());
   if (!status.ok()) {
     BROKER_ERROR("failed to open DB:" << status.ToString());
-    delete impl_->db;
-    impl_->db = nullptr;
+    impl_->close();
     return false;
   }
 
@@ -191,17 +518,16 @@ bool rocksdb_backend::open_db() {
 }
 
 rocksdb_backend::~rocksdb_backend() {
-  if (impl_->db)
-    delete impl_->db;
+  impl_->close();
 }
 
 expected<void> rocksdb_backend::put(const data& key, data value,
                                     optional<timestamp> expiry) {
   if (!impl_->db)
     return ec::backend_failure;
-  auto key_blob = to_key_blob<prefix::data>(key);
-  auto value_blob = to_blob(value);
-  if (!impl_->put(key_blob, value_blob, expiry))
+  rocksdb::WriteBatch batch;
+  if (!impl_->stage_value(batch, to_blob(key), value, expiry)
+      || !impl_->write(batch))
     return ec::backend_failure;
   return {};
 }
@@ -209,36 +535,62 @@ expected<void> rocksdb_backend::put(const data& key, data value,
 expected<void> rocksdb_backend::add(const data& key, const data& value,
                                     data::type init_type,
                                     optional<timestamp> expiry) {
-  auto key_blob = to_key_blob<prefix::data>(key);
-  auto value_blob = impl_->get(key_blob);
-  broker::data v;
-  if (!value_blob) {
-    if (value_blob.error() != ec::no_such_key)
-      return value_blob.error();
-    v = data::from_type(init_type);
+  if (!impl_->db)
+    return ec::backend_failure;
+  auto key_blob = to_blob(key);
+  data v;
+  auto hdr = impl_->fetch_header(key_blob, v, expiry);
+  if (!hdr) {
+    if (hdr.error() != ec::no_such_key)
+      return hdr.error();
+    if (stores_elements(init_type))
+      hdr = optional<container_header>{container_header{init_type, 0}};
+    else
+      v = data::from_type(init_type);
+  }
+  rocksdb::WriteBatch batch;
+  if (hdr && *hdr) {
+    // Only touch the affected element and the container header.
+    auto& x = **hdr;
+    auto result = impl_->add_element(batch, key_blob, x, value);
+    if (!result)
+      return result;
+    impl_->stage(batch, key_blob, to_header_blob(x), expiry);
   } else {
-    v = from_blob<data>(*value_blob);
+    auto result = caf::visit(adder{value}, v);
+    if (!result)
+      return result;
+    impl_->stage(batch, key_blob, to_blob(v), expiry);
   }
-  auto result = caf::visit(adder{value}, v);
-  if (!result)
-    return result;
-  if (!impl_->put(key_blob, to_blob(v), expiry))
+  if (!impl_->write(batch))
     return ec::backend_failure;
   return {};
 }
 
 expected<void> rocksdb_backend::subtract(const data& key, const data& value,
                                          optional<timestamp> expiry) {
-  auto key_blob = to_key_blob<prefix::data>(key);
-  auto value_blob = impl_->get(key_blob);
-  if (!value_blob)
-    return value_blob.error();
-  auto v = from_blob<data>(*value_blob);
-  auto result = caf::visit(remover{value}, v);
-  if (!result)
-    return result;
-  *value_blob = to_blob(v);
-  if (!impl_->put(key_blob, *value_blob, expiry))
+  if (!impl_->db)
+    return ec::backend_failure;
+  auto key_blob = to_blob(key);
+  data v;
+  auto hdr = impl_->fetch_header(key_blob, v, expiry);
+  if (!hdr)
+    return hdr.error();
+  rocksdb::WriteBatch batch;
+  if (*hdr) {
+    // Only touch the affected element and the container header.
+    auto& x = **hdr;
+    auto result = impl_->remove_element(batch, key_blob, x, value);
+    if (!result)
+      return result;
+    impl_->stage(batch, key_blob, to_header_blob(x), expiry);
+  } else {
+    auto result = caf::visit(remover{value}, v);
+    if (!result)
+      return result;
+    impl_->stage(batch, key_blob, to_blob(v), expiry);
+  }
+  if (!impl_->write(batch))
     return ec::backend_failure;
   return {};
 }
@@ -247,25 +599,21 @@ expected<void> rocksdb_backend::erase(const data& key) {
   if (!impl_->db)
     return ec::backend_failure;
   rocksdb::WriteBatch batch;
-  auto key_blob = to_key_blob<prefix::data>(key);
-  batch.Delete(key_blob);
-  key_blob[0] = static_cast<char>(prefix::expiry);
-  batch.Delete(key_blob);
-  auto status = impl_->db->Write({}, &batch);
-  if (!status.ok()) {
-    BROKER_ERROR("failed to delete key:" << status.ToString());
+  auto key_blob = to_blob(key);
+  if (!impl_->erase_elements(batch, element_prefix(key_blob)))
+    return ec::backend_failure;
+  batch.Delete(impl_->data_cf, key_blob);
+  batch.Delete(impl_->expiry_cf, key_blob);
+  if (!impl_->write(batch))
     return ec::backend_failure;
-  }
   return {};
 }
 
 expected<void> rocksdb_backend::clear() {
   if (!impl_->db)
     return ec::backend_failure;
-  std::string path = impl_->path;
-  delete impl_->db;
-  impl_->db = nullptr;
-  auto status = rocksdb::DestroyDB(path.c_str(), rocksdb::Options());
+  impl_->close();
+  auto status = rocksdb::DestroyDB(impl_->path, impl_->db_opts);
   if (!status.ok()) {
     BROKER_ERROR("failed to destroy DB:" << status.ToString());
     return ec::backend_failure;
@@ -278,8 +626,8 @@ expected<void> rocksdb_backend::clear() {
 }
 
 expected<bool> rocksdb_backend::expire(const data& key, timestamp ts) {
-  auto key_blob = to_key_blob<prefix::expiry>(key);
-  auto expiry_blob = impl_->get(key_blob);
+  auto key_blob = to_blob(key);
+  auto expiry_blob = impl_->get(impl_->expiry_cf, key_blob);
   if (!expiry_blob) {
     if (expiry_blob == ec::no_such_key)
       return false;
@@ -289,37 +637,64 @@ expected<bool> rocksdb_backend::expire(const data& key, timestamp ts) {
   if (ts < expiry)
     return false;
   rocksdb::WriteBatch batch;
-  batch.Delete(key_blob);
-  key_blob[0] = static_cast<char>(prefix::data);
-  batch.Delete(key_blob);
-  auto status = impl_->db->Write({}, &batch);
-  if (!status.ok()) {
-    BROKER_ERROR("failed to delete key:" << status.ToString());
+  if (!impl_->erase_elements(batch, element_prefix(key_blob)))
+    return ec::backend_failure;
+  batch.Delete(impl_->expiry_cf, key_blob);
+  batch.Delete(impl_->data_cf, key_blob);
+  if (!impl_->write(batch))
     return ec::backend_failure;
-  }
   return true;
 }
 
 expected<data> rocksdb_backend::get(const data& key) const {
-  auto value_blob = impl_->get(to_key_blob<prefix::data>(key));
+  auto key_blob = to_blob(key);
+  auto value_blob = impl_->get(impl_->data_cf, key_blob);
+  if (!value_blob)
+    return value_blob.error();
+  return impl_->decode(key_blob, value_blob->data(), value_blob->size());
+}
+
+expected<data> rocksdb_backend::get(const data& key,
+                                    const data& aspect) const {
+  auto key_blob = to_blob(key);
+  auto value_blob = impl_->get(impl_->data_cf, key_blob);
   if (!value_blob)
     return value_blob.error();
-  return from_blob<data>(*value_blob);
+  if (!is_container_header(*value_blob))
+    return caf::visit(retriever{aspect}, from_blob<data>(*value_blob));
+  // Look up the single element instead of assembling the container.
+  auto hdr = container_header_from_blob(*value_blob);
+  std::string member;
+  if (hdr.type == data::type::vector) {
+    auto pos = to_position(aspect);
+    if (!pos)
+      return pos.error();
+    if (*pos >= hdr.size)
+      return ec::no_such_key;
+    member = position_blob(*pos);
+  } else {
+    member = to_blob(aspect);
+  }
+  auto element = impl_->get(impl_->elements_cf,
+                            element_prefix(key_blob) + member);
+  if (hdr.type == data::type::set) {
+    if (!element && element.error() != ec::no_such_key)
+      return element.error();
+    return data{static_cast<bool>(element)};
+  }
+  if (!element)
+    return element.error();
+  return from_blob<data>(*element);
 }
 
 expected<data> rocksdb_backend::keys() const {
   if (!impl_->db)
     return ec::backend_failure;
   set result;
-  rocksdb::ReadOptions opts;
-  opts.fill_cache = false;
-  auto i = std::unique_ptr<rocksdb::Iterator>{impl_->db->NewIterator(opts)};
-  static const auto pfx = static_cast<char>(prefix::data);
-  i->Seek(rocksdb::Slice{&pfx, 1}); // initializes iterator
-  while (i->Valid() && i->key()[0] == pfx) {
-    auto key = from_key_blob<prefix::data>(i->key().data(), i->key().size());
+  auto i = impl_->iterator(impl_->data_cf);
+  for (; i->Valid(); i->Next()) {
+    auto key = from_blob<data>(i->key().data(), i->key().size());
     result.insert(std::move(key));
-    i->Next();
   }
   if (!i->status().ok()) {
     BROKER_ERROR("failed to get keys:" << i->status().ToString());
@@ -329,27 +704,22 @@ expected<data> rocksdb_backend::keys() const {
 }
 
 expected<bool> rocksdb_backend::exists(const data& key) const {
-  return impl_->exists(to_key_blob<prefix::data>(key));
+  return impl_->exists(impl_->data_cf, to_blob(key));
 }
 
 expected<uint64_t> rocksdb_backend::size() const {
   if (!impl_->db)
     return ec::backend_failure;
   uint64_t result;
-  if (!impl_->db->GetIntProperty("rocksdb.estimate-num-keys", &result))
+  if (!impl_->db->GetIntProperty(impl_->data_cf, "rocksdb.estimate-num-keys",
+                                 &result))
     return ec::backend_failure;
   if (result > impl_->exact_size_threshold)
     return result;
   result = 0;
-  rocksdb::ReadOptions opts;
-  opts.fill_cache = false;
-  auto i = std::unique_ptr<rocksdb::Iterator>{impl_->db->NewIterator(opts)};
-  static const auto data_prefix = static_cast<char>(prefix::data);
-  i->Seek(rocksdb::Slice{&data_prefix, 1}); // initializes iterator
-  while (i->Valid() && i->key()[0] == data_prefix) {
+  auto i = impl_->iterator(impl_->data_cf);
+  for (; i->Valid(); i->Next())
     ++result;
-    i->Next();
-  }
   if (!i->status().ok()) {
     BROKER_ERROR("failed to compute size:" << i->status().ToString());
     return ec::backend_failure;
@@ -361,16 +731,13 @@ expected<snapshot> rocksdb_backend::snapshot() const {
   if (!impl_->db)
     return ec::backend_failure;
   broker::snapshot result;
-  rocksdb::ReadOptions opts;
-  opts.fill_cache = false;
-  auto i = std::unique_ptr<rocksdb::Iterator>{impl_->db->NewIterator(opts)};
-  static const auto pfx = static_cast<char>(prefix::data);
-  i->Seek(rocksdb::Slice{&pfx, 1}); // initializes iterator
-  while (i->Valid() && i->key()[0] == pfx) {
-    auto key = from_key_blob<prefix::data>(i->key().data(), i->key().size());
-    auto value = from_blob<data>(i->value().data(), i->value().size());
-    result.emplace(std::move(key), std::move(value));
-    i->Next();
+  auto i = impl_->iterator(impl_->data_cf);
+  for (; i->Valid(); i->Next()) {
+    auto key_blob = i->key().ToString();
+    auto value = impl_->decode(key_blob, i->value().data(), i->value().size());
+    if (!value)
+      return value.error();
+    result.emplace(from_blob<data>(key_blob), std::move(*value));
   }
   if (!i->status().ok()) {
     BROKER_ERROR("failed to compute size:" << i->status().ToString());
@@ -383,17 +750,12 @@ expected<expirables> rocksdb_backend::expiries() const {
   if (!impl_->db)
     return ec::backend_failure;
   expirables result;
-  rocksdb::ReadOptions opts;
-  opts.fill_cache = false;
-  auto i = std::unique_ptr<rocksdb::Iterator>{impl_->db->NewIterator(opts)};
-  static const auto pfx = static_cast<char>(prefix::expiry);
-  i->Seek(rocksdb::Slice{&pfx, 1}); // initializes iterator
-  while (i->Valid() && i->key()[0] == pfx) {
-    auto key = from_key_blob<prefix::expiry>(i->key().data(), i->key().size());
+  auto i = impl_->iterator(impl_->expiry_cf);
+  for (; i->Valid(); i->Next()) {
+    auto key = from_blob<data>(i->key().data(), i->key().size());
     auto expiry = from_blob<timestamp>(i->value().data(), i->value().size());
     auto e = expirable(std::move(key), std::move(expiry));
     result.emplace_back(std::move(e));
-    i->Next();
   }
   if (!i->status().ok()) {
     BROKER_ERROR("failed to compute size:" << i->status().ToString());
@@ -3,6 +3,7 @@
 #include <cstdio> // std::snprintf
 #include <utility>
 #include <cstdint>
+#include <initializer_list>
 #include <set>
 #include <string>
 #include <vector>
@@ -16,6 +17,7 @@
 #include "broker/detail/assert.hh"
 #include "broker/detail/appliers.hh"
 #include "broker/detail/blob.hh"
+#include "broker/detail/container_elements.hh"
 #include "broker/detail/filesystem.hh"
 #include "broker/detail/make_unique.hh"
 #include "broker/detail/sqlite_backend.hh"
@@ -30,6 +32,26 @@ auto make_statement_guard = [](sqlite3_stmt* stmt) {
   return caf::detail::make_scope_guard([=] { sqlite3_reset(stmt); });
 };
 
+// Returns `x` if it is one of the accepted values, `nullptr` otherwise. Only
+// values from the list ever end up in a PRAGMA statement.
+const char* select_pragma_value(const std::string& x,
+                                std::initializer_list<const char*> accepted) {
+  for (auto y : accepted)
+    if (x == y)
+      return y;
+  return nullptr;
+}
+
+bool exec_pragma(sqlite3* db, const char* name, const std::string& value) {
+  auto sql = std::string{"pragma "} + name + " = " + value + ";";
+  auto result = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+  if (result != SQLITE_OK) {
+    BROKER_ERROR("failed to execute:" << sql);
+    return false;
+  }
+  return true;
+}
+
 } // namespace <anonymous>
 
 struct sqlite_backend::impl {
@@ -71,6 +93,8 @@ struct sqlite_backend::impl {
       BROKER_ERROR("failed to open database:" << path);
       return false;
     }
+    if (!configure())
+      return false;
     // Create table for store meta data.
     result = sqlite3_exec(db,
                           "create table if not exists "
@@ -89,6 +113,25 @@ struct sqlite_backend::impl {
       BROKER_ERROR("failed to create store table");
       return false;
     }
+    // Create index for expiring entries, which are usually only few.
+    result = sqlite3_exec(db,
+                          "create index if not exists store_expiry "
+                          "on store(expiry) where expiry is not null;",
+                          nullptr, nullptr, nullptr);
+    if (result != SQLITE_OK) {
+      BROKER_ERROR("failed to create expiry index");
+      return false;
+    }
+    // Create table for the members of sets, tables, and vectors.
+    result = sqlite3_exec(db,
+                          "create table if not exists elements"
+                          "(key blob, member blob, value blob,"
+                          " primary key(key, member)) without rowid;",
+                          nullptr, nullptr, nullptr);
+    if (result != SQLITE_OK) {
+      BROKER_ERROR("failed to create elements table");
+      return false;
+    }
     // Store Broker version in meta table.
     char tmp[128];
     std::snprintf(tmp, sizeof(tmp),
@@ -103,7 +146,6 @@ struct sqlite_backend::impl {
     // Prepare statements.
     std::vector<std::pair<sqlite3_stmt**, const char*>> statements{
       {&replace, "replace into store(key, value, expiry) values(?, ?, ?);"},
-      {&update, "update store set value = ?, expiry = ? where key = ?;"},
       {&erase, "delete from store where key = ?;"},
       {&expire, "delete from store where key = ? and expiry <= ?;"},
 
@@ -114,6 +156,18 @@ struct sqlite_backend::impl {
       {&expiries, "select key, expiry from store where expiry is not null;"},
       {&clear, "delete from store;"},
       {&keys, "select key from store;"},
+
+      {&insert_element, "insert or ignore into elements(key, member, value) "
+                        "values(?, ?, ?);"},
+      {&update_element, "update elements set value = ? "
+                        "where key = ? and member = ?;"},
+      {&erase_element, "delete from elements where key = ? and member = ?;"},
+      {&lookup_element, "select value from elements "
+                        "where key = ? and member = ?;"},
+      {&select_elements, "select member, value from elements where key = ? "
+                         "order by member;"},
+      {&erase_elements, "delete from elements where key = ?;"},
+      {&clear_elements, "delete from elements;"},
     };
     auto prepare = [&](sqlite3_stmt** stmt, const char* sql) {
       finalize.push_back(*stmt);
@@ -127,45 +181,307 @@ struct sqlite_backend::impl {
     return true;
   }
 
-  bool modify(const data& key, const data& value,
-              optional<timestamp> expiry) {
-    auto key_blob = to_blob(key);
-    auto value_blob = to_blob(value);
-    auto guard = make_statement_guard(update);
+  // Applies the performance-related options to the freshly opened database.
+  bool configure() {
+    auto i = options.find("journal-mode");
+    if (i != options.end()) {
+      auto str = caf::get_if<std::string>(&i->second);
+      auto mode = str ? select_pragma_value(*str, {"delete", "truncate",
+                                                   "persist", "memory", "wal",
+                                                   "off"})
+                      : nullptr;
+      if (!mode) {
+        BROKER_ERROR("invalid journal-mode");
+        return false;
+      }
+      // Changing the journal mode returns the new mode as a row.
+      auto sql = std::string{"pragma journal_mode = "} + mode + ";";
+      if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr)
+          != SQLITE_OK) {
+        BROKER_ERROR("failed to set journal mode:" << mode);
+        return false;
+      }
+    }
+    i = options.find("synchronous");
+    if (i != options.end()) {
+      auto str = caf::get_if<std::string>(&i->second);
+      auto level = str ? select_pragma_value(*str, {"off", "normal", "full",
+                                                    "extra"})
+                       : nullptr;
+      if (!level) {
+        BROKER_ERROR("invalid synchronous level");
+        return false;
+      }
+      if (!exec_pragma(db, "synchronous", level))
+        return false;
+    }
+    i = options.find("mmap-size");
+    if (i != options.end()) {
+      auto n = caf::get_if<count>(&i->second);
+      if (!n) {
+        BROKER_ERROR("mmap-size must be of type count");
+        return false;
+      }
+      if (!exec_pragma(db, "mmap_size", std::to_string(*n)))
+        return false;
+    }
+    i = options.find("cache-size");
+    if (i != options.end()) {
+      // Positive values denote pages, negative values denote KiB.
+      std::string value;
+      if (auto n = caf::get_if<count>(&i->second))
+        value = std::to_string(*n);
+      else if (auto n = caf::get_if<integer>(&i->second))
+        value = std::to_string(*n);
+      else {
+        BROKER_ERROR("cache-size must be of type count or integer");
+        return false;
+      }
+      if (!exec_pragma(db, "cache_size", value))
+        return false;
+    }
+    i = options.find("busy-timeout");
+    if (i != options.end()) {
+      auto ms = caf::get_if<count>(&i->second);
+      if (!ms) {
+        BROKER_ERROR("busy-timeout must be of type count");
+        return false;
+      }
+      if (sqlite3_busy_timeout(db, static_cast<int>(*ms)) != SQLITE_OK) {
+        BROKER_ERROR("failed to set busy timeout");
+        return false;
+      }
+    }
+    return true;
+  }
 
-    // Bind value.
-    auto result = sqlite3_bind_blob64(update, 1, value_blob.data(),
-                                      value_blob.size(), SQLITE_STATIC);
+  // Binds `xs` as blobs to the parameters of `stmt`, binding null for null
+  // pointers.
+  bool bind(sqlite3_stmt* stmt,
+            std::initializer_list<const std::string*> xs) {
+    auto index = 1;
+    for (auto x : xs) {
+      auto result = x ? sqlite3_bind_blob64(stmt, index, x->data(), x->size(),
+                                            SQLITE_STATIC)
+                      : sqlite3_bind_null(stmt, index);
+      if (result != SQLITE_OK)
+        return false;
+      ++index;
+    }
+    return true;
+  }
 
-    if (result != SQLITE_OK)
-      return false;
+  // Runs a statement that returns no rows.
+  bool exec(sqlite3_stmt* stmt,
+            std::initializer_list<const std::string*> xs) {
+    auto guard = make_statement_guard(stmt);
+    return bind(stmt, xs) && sqlite3_step(stmt) == SQLITE_DONE;
+  }
 
-    if (expiry) {
-      // Bind expiry.
-      auto t = expiry->time_since_epoch().count();
-      result = sqlite3_bind_int64(update, 2, t);
-    } else {
-      result = sqlite3_bind_null(update, 2);
+  // Runs `f` in a transaction that gets rolled back if `f` fails.
+  template <class F>
+  expected<void> atomically(F f) {
+    if (sqlite3_exec(db, "begin;", nullptr, nullptr, nullptr) != SQLITE_OK)
+      return ec::backend_failure;
+    auto result = f();
+    if (!result) {
+      sqlite3_exec(db, "rollback;", nullptr, nullptr, nullptr);
+      return result;
     }
+    if (sqlite3_exec(db, "commit;", nullptr, nullptr, nullptr) != SQLITE_OK)
+      return ec::backend_failure;
+    return result;
+  }
+
+  // Retrieves the raw value under `key_blob`.
+  expected<std::string> lookup_blob(const std::string& key_blob) {
+    auto guard = make_statement_guard(lookup);
+    if (!bind(lookup, {&key_blob}))
+      return ec::backend_failure;
+    auto result = sqlite3_step(lookup);
+    if (result == SQLITE_DONE)
+      return ec::no_such_key;
+    if (result != SQLITE_ROW)
+      return ec::backend_failure;
+    auto buf = reinterpret_cast<const char*>(sqlite3_column_blob(lookup, 0));
+    return std::string(buf, sqlite3_column_bytes(lookup, 0));
+  }
 
-    if (result != SQLITE_OK)
+  // Writes the raw value under `key_blob`.
+  bool write_blob(const std::string& key_blob, const std::string& value_blob,
+                  optional<timestamp> expiry) {
+    auto guard = make_statement_guard(replace);
+    if (!bind(replace, {&key_blob, &value_blob}))
       return false;
+    auto result = expiry
+                    ? sqlite3_bind_int64(replace, 3,
+                                         expiry->time_since_epoch().count())
+                    : sqlite3_bind_null(replace, 3);
+    return result == SQLITE_OK && sqlite3_step(replace) == SQLITE_DONE;
+  }
 
-    // Bind key.
-    result = sqlite3_bind_blob64(update, 3, key_blob.data(),
-                                 key_blob.size(), SQLITE_STATIC);
+  // Replaces the value under `key_blob`, storing containers element-wise.
+  expected<void> store(const std::string& key_blob, const data& value,
+                       optional<timestamp> expiry,
+                       container_header* out = nullptr) {
+    if (!exec(erase_elements, {&key_blob}))
+      return ec::backend_failure;
+    auto type = value.get_type();
+    if (!stores_elements(type)) {
+      if (!write_blob(key_blob, to_blob(value), expiry))
+        return ec::backend_failure;
+      return {};
+    }
+    container_header hdr{type, 0};
+    auto insert = [&](const std::string& member, const std::string* element) {
+      if (!exec(insert_element, {&key_blob, &member, element}))
+        return false;
+      ++hdr.size;
+      return true;
+    };
+    if (auto xs = caf::get_if<set>(&value)) {
+      for (auto& x : *xs)
+        if (!insert(to_blob(x), nullptr))
+          return ec::backend_failure;
+    } else if (auto xs = caf::get_if<table>(&value)) {
+      for (auto& x : *xs) {
+        auto element = to_blob(x.second);
+        if (!insert(to_blob(x.first), &element))
+          return ec::backend_failure;
+      }
+    } else if (auto xs = caf::get_if<vector>(&value)) {
+      for (auto& x : *xs) {
+        auto element = to_blob(x);
+        if (!insert(position_blob(hdr.size), &element))
+          return ec::backend_failure;
+      }
+    }
+    if (!write_blob(key_blob, to_header_blob(hdr), expiry))
+      return ec::backend_failure;
+    if (out)
+      *out = hdr;
+    return {};
+  }
 
-    if (result != SQLITE_OK)
-      return false;
+  // Assembles a container from its elements.
+  expected<data> load(const std::string& key_blob,
+                      const container_header& hdr) {
+    auto guard = make_statement_guard(select_elements);
+    if (!bind(select_elements, {&key_blob}))
+      return ec::backend_failure;
+    auto result = data::from_type(hdr.type);
+    auto member = [&] {
+      return from_blob<data>(sqlite3_column_blob(select_elements, 0),
+                             sqlite3_column_bytes(select_elements, 0));
+    };
+    auto value = [&] {
+      return from_blob<data>(sqlite3_column_blob(select_elements, 1),
+                             sqlite3_column_bytes(select_elements, 1));
+    };
+    auto rc = SQLITE_DONE;
+    while ((rc = sqlite3_step(select_elements)) == SQLITE_ROW) {
+      if (auto xs = caf::get_if<set>(&result))
+        xs->emplace(member());
+      else if (auto xs = caf::get_if<table>(&result))
+        xs->emplace(member(), value());
+      else if (auto xs = caf::get_if<vector>(&result))
+        xs->emplace_back(value());
+    }
+    if (rc != SQLITE_DONE)
+      return ec::backend_failure;
+    return result;
+  }
+
+  // Decodes the raw value under `key_blob`, assembling containers.
+  expected<data> decode(const std::string& key_blob, const char* buf,
+                        size_t size) {
+    if (is_container_header(buf, size))
+      return load(key_blob, container_header_from_blob(buf, size));
+    return from_blob<data>(buf, size);
+  }
+
+  // Retrieves the header of the container under `key_blob`. Converts
+  // containers written by earlier versions as a single value. Returns `none`
+  // for values of other types and stores them in `value`.
+  expected<optional<container_header>> fetch_header(const std::string& key_blob,
+                                                    data& value,
+                                                    optional<timestamp> expiry) {
+    auto blob = lookup_blob(key_blob);
+    if (!blob)
+      return blob.error();
+    if (is_container_header(*blob))
+      return optional<container_header>{container_header_from_blob(*blob)};
+    value = from_blob<data>(*blob);
+    if (!stores_elements(value.get_type()))
+      return optional<container_header>{};
+    container_header hdr;
+    auto result = store(key_blob, value, expiry, &hdr);
+    if (!result)
+      return result.error();
+    return optional<container_header>{hdr};
+  }
+
+  // Adds `x` to the container under `key_blob`.
+  expected<void> add_element(const std::string& key_blob,
+                             container_header& hdr, const data& x) {
+    switch (hdr.type) {
+      case data::type::set: {
+        auto member = to_blob(x);
+        if (!exec(insert_element, {&key_blob, &member, nullptr}))
+          return ec::backend_failure;
+        hdr.size += sqlite3_changes(db);
+        return {};
+      }
+      case data::type::table: {
+        // Data must come as key-value pair to be valid, which we model as
+        // vector of length 2.
+        auto v = caf::get_if<vector>(&x);
+        if (!v)
+          return ec::type_clash;
+        if (v->size() != 2)
+          return ec::invalid_data;
+        auto member = to_blob(v->front());
+        auto value = to_blob(v->back());
+        if (!exec(insert_element, {&key_blob, &member, &value}))
+          return ec::backend_failure;
+        if (sqlite3_changes(db) == 1) {
+          ++hdr.size;
+          return {};
+        }
+        if (!exec(update_element, {&value, &key_blob, &member}))
+          return ec::backend_failure;
+        return {};
+      }
+      default: {
+        auto member = position_blob(hdr.size);
+        auto value = to_blob(x);
+        if (!exec(insert_element, {&key_blob, &member, &value}))
+          return ec::backend_failure;
+        ++hdr.size;
+        return {};
+      }
+    }
+  }
 
-    // Execute statement.
-    return sqlite3_step(update) == SQLITE_DONE;
+  // Removes `x` from the container under `key_blob`.
+  expected<void> remove_element(const std::string& key_blob,
+                                container_header& hdr, const data& x) {
+    std::string member;
+    if (hdr.type != data::type::vector)
+      member = to_blob(x);
+    else if (hdr.size > 0)
+      member = position_blob(hdr.size - 1);
+    else
+      return {};
+    if (!exec(erase_element, {&key_blob, &member}))
+      return ec::backend_failure;
+    hdr.size -= sqlite3_changes(db);
+    return {};
   }
 
   backend_options options;
   sqlite3* db = nullptr;
   sqlite3_stmt* replace = nullptr;
-  sqlite3_stmt* update = nullptr;
   sqlite3_stmt* erase = nullptr;
   sqlite3_stmt* expire = nullptr;
   sqlite3_stmt* lookup = nullptr;
@@ -175,6 +491,13 @@ struct sqlite_backend::impl {
   sqlite3_stmt* expiries = nullptr;
   sqlite3_stmt* clear = nullptr;
   sqlite3_stmt* keys = nullptr;
+  sqlite3_stmt* insert_element = nullptr;
+  sqlite3_stmt* update_element = nullptr;
+  sqlite3_stmt* erase_element = nullptr;
+  sqlite3_stmt* lookup_element = nullptr;
+  sqlite3_stmt* select_elements = nullptr;
+  sqlite3_stmt* erase_elements = nullptr;
+  sqlite3_stmt* clear_elements = nullptr;
   std::vector<sqlite3_stmt*> finalize;
 };
 
@@ -190,127 +513,172 @@ expected<void> sqlite_backend::put(const data& key, data value,
                                    optional<timestamp> expiry) {
   if (!impl_->db)
     return ec::backend_failure;
-  auto guard = make_statement_guard(impl_->replace);
-  // Bind key.
   auto key_blob = to_blob(key);
-  auto result = sqlite3_bind_blob64(impl_->replace, 1, key_blob.data(),
-                                    key_blob.size(), SQLITE_STATIC);
-  if (result != SQLITE_OK)
-    return ec::backend_failure;
-  // Bind value.
-  auto value_blob = to_blob(value);
-  result = sqlite3_bind_blob64(impl_->replace, 2, value_blob.data(),
-                               value_blob.size(), SQLITE_STATIC);
-  if (result != SQLITE_OK)
-    return ec::backend_failure;
-  if (expiry)
-    result = sqlite3_bind_int64(impl_->replace, 3,
-                                expiry->time_since_epoch().count());
-  else
-    result = sqlite3_bind_null(impl_->replace, 3);
-  if (result != SQLITE_OK)
-    return ec::backend_failure;
-  // Execute statement.
-  if (sqlite3_step(impl_->replace) != SQLITE_DONE)
-    return ec::backend_failure;
-  return {};
+  return impl_->atomically([&] {
+    return impl_->store(key_blob, value, expiry);
+  });
 }
 
 expected<void> sqlite_backend::add(const data& key, const data& value,
                                    data::type init_type,
                                    optional<timestamp> expiry) {
-  auto v = get(key);
-  data vv;
-  if (!v) {
-    if (v.error() != ec::no_such_key)
-      return v.error();
-    vv = data::from_type(init_type);
-  } else {
-    vv = std::move(*v);
-  }
-  auto result = caf::visit(adder{value}, vv);
-  if (!result)
-    return result;
-  return put(key, std::move(vv), expiry);
+  if (!impl_->db)
+    return ec::backend_failure;
+  auto key_blob = to_blob(key);
+  return impl_->atomically([&]() -> expected<void> {
+    data v;
+    auto hdr = impl_->fetch_header(key_blob, v, expiry);
+    if (!hdr) {
+      if (hdr.error() != ec::no_such_key)
+        return hdr.error();
+      if (stores_elements(init_type))
+        hdr = optional<container_header>{container_header{init_type, 0}};
+      else
+        v = data::from_type(init_type);
+    }
+    if (hdr && *hdr) {
+      // Only touch the affected element and the container header.
+      auto& x = **hdr;
+      auto result = impl_->add_element(key_blob, x, value);
+      if (!result)
+        return result;
+      if (!impl_->write_blob(key_blob, to_header_blob(x), expiry))
+        return ec::backend_failure;
+      return {};
+    }
+    auto result = caf::visit(adder{value}, v);
+    if (!result)
+      return result;
+    if (!impl_->write_blob(key_blob, to_blob(v), expiry))
+      return ec::backend_failure;
+    return {};
+  });
 }
 
 expected<void> sqlite_backend::subtract(const data& key, const data& value,
                                         optional<timestamp> expiry) {
-  auto v = get(key);
-  if (!v)
-    return v.error();
-  auto result = caf::visit(remover{value}, *v);
-  if (!result)
-    return result;
-  if (!impl_->modify(key, *v, expiry))
+  if (!impl_->db)
     return ec::backend_failure;
-  return {};
+  auto key_blob = to_blob(key);
+  return impl_->atomically([&]() -> expected<void> {
+    data v;
+    auto hdr = impl_->fetch_header(key_blob, v, expiry);
+    if (!hdr)
+      return hdr.error();
+    if (*hdr) {
+      // Only touch the affected element and the container header.
+      auto& x = **hdr;
+      auto result = impl_->remove_element(key_blob, x, value);
+      if (!result)
+        return result;
+      if (!impl_->write_blob(key_blob, to_header_blob(x), expiry))
+        return ec::backend_failure;
+      return {};
+    }
+    auto result = caf::visit(remover{value}, v);
+    if (!result)
+      return result;
+    if (!impl_->write_blob(key_blob, to_blob(v), expiry))
+      return ec::backend_failure;
+    return {};
+  });
 }
 
 expected<void> sqlite_backend::erase(const data& key) {
   if (!impl_->db)
     return ec::backend_failure;
-  auto guard = make_statement_guard(impl_->erase);
-	auto key_blob = to_blob(key);
-  auto result = sqlite3_bind_blob64(impl_->erase, 1, key_blob.data(),
-                                    key_blob.size(), SQLITE_STATIC);
-  if (result != SQLITE_OK)
-    return ec::backend_failure;
-	result = sqlite3_step(impl_->erase);
-  if (result != SQLITE_DONE)
-    return ec::backend_failure;
-  //if (sqlite3_changes(impl_->db) == 0)
-  //  return ec::no_such_key;
-  return {};
+  auto key_blob = to_blob(key);
+  return impl_->atomically([&]() -> expected<void> {
+    if (!impl_->exec(impl_->erase, {&key_blob})
+        || !impl_->exec(impl_->erase_elements, {&key_blob}))
+      return ec::backend_failure;
+    //if (sqlite3_changes(impl_->db) == 0)
+    //  return ec::no_such_key;
+    return {};
+  });
 }
 
 expected<void> sqlite_backend::clear() {
   if (!impl_->db)
     return ec::backend_failure;
-  auto guard = make_statement_guard(impl_->clear);
-  auto result = sqlite3_step(impl_->clear);
-  if (result != SQLITE_DONE)
-    return ec::backend_failure;
-  return {};
+  return impl_->atomically([&]() -> expected<void> {
+    if (!impl_->exec(impl_->clear, {})
+        || !impl_->exec(impl_->clear_elements, {}))
+      return ec::backend_failure;
+    return {};
+  });
 }
 
 expected<bool> sqlite_backend::expire(const data& key, timestamp ts) {
   if (!impl_->db)
     return ec::backend_failure;
-  auto guard = make_statement_guard(impl_->expire);
-  // Bind key.
-	auto key_blob = to_blob(key);
-  auto result = sqlite3_bind_blob64(impl_->expire, 1, key_blob.data(),
-                                    key_blob.size(), SQLITE_STATIC);
-  if (result != SQLITE_OK)
-    return ec::backend_failure;
-  // Bind expiry.
-  result = sqlite3_bind_int64(impl_->expire, 2, ts.time_since_epoch().count());
-  if (result != SQLITE_OK)
-    return ec::backend_failure;
-  // Execute query.
-	result = sqlite3_step(impl_->expire);
-  if (result != SQLITE_DONE)
-    return ec::backend_failure;
-  return sqlite3_changes(impl_->db) == 1;
+  auto key_blob = to_blob(key);
+  auto expired = false;
+  auto result = impl_->atomically([&]() -> expected<void> {
+    auto guard = make_statement_guard(impl_->expire);
+    // Bind key and expiry.
+    if (!impl_->bind(impl_->expire, {&key_blob})
+        || sqlite3_bind_int64(impl_->expire, 2, ts.time_since_epoch().count())
+             != SQLITE_OK)
+      return ec::backend_failure;
+    // Execute query.
+    if (sqlite3_step(impl_->expire) != SQLITE_DONE)
+      return ec::backend_failure;
+    expired = sqlite3_changes(impl_->db) == 1;
+    if (expired && !impl_->exec(impl_->erase_elements, {&key_blob}))
+      return ec::backend_failure;
+    return {};
+  });
+  if (!result)
+    return result.error();
+  return expired;
 }
 
 expected<data> sqlite_backend::get(const data& key) const {
   if (!impl_->db)
     return ec::backend_failure;
-  auto guard = make_statement_guard(impl_->lookup);
-	auto key_blob = to_blob(key);
-  auto result = sqlite3_bind_blob64(impl_->lookup, 1, key_blob.data(),
-                                    key_blob.size(), SQLITE_STATIC);
-  if (result != SQLITE_OK)
+  auto key_blob = to_blob(key);
+  auto blob = impl_->lookup_blob(key_blob);
+  if (!blob)
+    return blob.error();
+  return impl_->decode(key_blob, blob->data(), blob->size());
+}
+
+expected<data> sqlite_backend::get(const data& key, const data& aspect) const {
+  if (!impl_->db)
     return ec::backend_failure;
-	result = sqlite3_step(impl_->lookup);
-	if (result == SQLITE_DONE)
-	  return ec::no_such_key;
-	if (result != SQLITE_ROW)
+  auto key_blob = to_blob(key);
+  auto blob = impl_->lookup_blob(key_blob);
+  if (!blob)
+    return blob.error();
+  if (!is_container_header(*blob))
+    return caf::visit(retriever{aspect}, from_blob<data>(*blob));
+  // Look up the single element instead of assembling the container.
+  auto hdr = container_header_from_blob(*blob);
+  std::string member;
+  if (hdr.type == data::type::vector) {
+    auto pos = to_position(aspect);
+    if (!pos)
+      return pos.error();
+    if (*pos >= hdr.size)
+      return ec::no_such_key;
+    member = position_blob(*pos);
+  } else {
+    member = to_blob(aspect);
+  }
+  auto stmt = impl_->lookup_element;
+  auto guard = make_statement_guard(stmt);
+  if (!impl_->bind(stmt, {&key_blob, &member}))
+    return ec::backend_failure;
+  auto result = sqlite3_step(stmt);
+  if (result != SQLITE_ROW && result != SQLITE_DONE)
     return ec::backend_failure;
-	return from_blob<data>(sqlite3_column_blob(impl_->lookup, 0),
-                         sqlite3_column_bytes(impl_->lookup, 0));
+  if (hdr.type == data::type::set)
+    return data{result == SQLITE_ROW};
+  if (result == SQLITE_DONE)
+    return ec::no_such_key;
+  return from_blob<data>(sqlite3_column_blob(stmt, 0),
+                         sqlite3_column_bytes(stmt, 0));
 }
 
 expected<data> sqlite_backend::keys() const {
@@ -366,11 +734,18 @@ expected<snapshot> sqlite_backend::snapshot() const {
   broker::snapshot ss;
   auto result = SQLITE_DONE;
   while ((result = sqlite3_step(impl_->snapshot)) == SQLITE_ROW) {
-    auto key = from_blob<data>(sqlite3_column_blob(impl_->snapshot, 0),
-                               sqlite3_column_bytes(impl_->snapshot, 0));
-    auto value = from_blob<data>(sqlite3_column_blob(impl_->snapshot, 1),
-                                 sqlite3_column_bytes(impl_->snapshot, 1));
-    ss.emplace(std::move(key), std::move(value));
+    auto key_buf = sqlite3_column_blob(impl_->snapshot, 0);
+    auto key_size = sqlite3_column_bytes(impl_->snapshot, 0);
+    auto key = from_blob<data>(key_buf, key_size);
+    auto value_buf = sqlite3_column_blob(impl_->snapshot, 1);
+    auto value_size = sqlite3_column_bytes(impl_->snapshot, 1);
+    std::string key_blob(reinterpret_cast<const char*>(key_buf), key_size);
+    auto value = impl_->decode(key_blob,
+                               reinterpret_cast<const char*>(value_buf),
+                               value_size);
+    if (!value)
+      return value.error();
+    ss.emplace(std::move(key), std::move(*value));
   }
   if (result == SQLITE_DONE)
     return {std::move(ss)};
@@ -0,0 +1,238 @@
+#include "broker/logger.hh" // Needs to come before CAF includes.
+
+#include "broker/detail/unix_socket.hh"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <utility>
+
+#include <caf/atom.hpp>
+#include <caf/send.hpp>
+
+#include <caf/io/basp_broker.hpp>
+#include <caf/io/middleman.hpp>
+#include <caf/io/network/default_multiplexer.hpp>
+#include <caf/io/network/doorman_impl.hpp>
+#include <caf/io/network/scribe_impl.hpp>
+
+#include "broker/error.hh"
+
+namespace broker {
+namespace detail {
+
+namespace {
+
+using caf::io::network::default_multiplexer;
+using caf::io::network::native_socket;
+
+// CAF only knows TCP endpoints and asks the socket for its port when
+// performing the BASP handshake. A Unix domain socket has none, so we report
+// its path as address and 0 as port. BASP never assigns port 0 to a TCP
+// doorman, hence the two cannot collide. However, BASP keys published actors
+// by port, so each actor system can only have one Unix domain socket doorman.
+
+class unix_scribe : public caf::io::network::scribe_impl {
+public:
+  unix_scribe(default_multiplexer& mx, native_socket fd, std::string path)
+    : scribe_impl(mx, fd),
+      addr_(unix_socket_scheme + path) {
+    // nop
+  }
+
+  std::string addr() const override {
+    return addr_;
+  }
+
+  uint16_t port() const override {
+    return 0;
+  }
+
+private:
+  std::string addr_;
+};
+
+class unix_doorman : public caf::io::network::doorman_impl {
+public:
+  unix_doorman(default_multiplexer& mx, native_socket fd, std::string path,
+               struct stat file)
+    : doorman_impl(mx, fd),
+      path_(std::move(path)),
+      file_(file) {
+    // nop
+  }
+
+  ~unix_doorman() override {
+    // Leave the file alone if someone else replaced it in the meantime.
+    struct stat st;
+    if (::lstat(path_.c_str(), &st) == 0 && st.st_dev == file_.st_dev
+        && st.st_ino == file_.st_ino)
+      ::unlink(path_.c_str());
+  }
+
+  bool new_connection() override {
+    if (detached())
+      return false;
+    auto& mx = acceptor_.backend();
+    caf::io::scribe_ptr ptr
+      = caf::make_counted<unix_scribe>(mx, acceptor_.accepted_socket(), path_);
+    auto hdl = ptr->hdl();
+    parent()->add_scribe(std::move(ptr));
+    return doorman::new_connection(&mx, hdl);
+  }
+
+  std::string addr() const override {
+    return unix_socket_scheme + path_;
+  }
+
+  uint16_t port() const override {
+    return 0;
+  }
+
+private:
+  std::string path_;
+  struct stat file_;
+};
+
+default_multiplexer& multiplexer(caf::actor_system& sys) {
+  return static_cast<default_multiplexer&>(sys.middleman().backend());
+}
+
+error make_socket_error(const char* what) {
+  return make_error(ec::unspecified, what, std::string{::strerror(errno)});
+}
+
+expected<sockaddr_un> make_address(const std::string& path) {
+  sockaddr_un result;
+  std::memset(&result, 0, sizeof(result));
+  if (path.empty() || path.size() >= sizeof(result.sun_path))
+    return make_error(ec::unspecified, "invalid Unix domain socket path",
+                      path);
+  result.sun_family = AF_UNIX;
+  std::memcpy(result.sun_path, path.c_str(), path.size());
+  return result;
+}
+
+// Returns a non-blocking socket that child processes do not inherit.
+expected<int> make_socket() {
+  auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1)
+    return make_socket_error("socket failed");
+  if (::fcntl(fd, F_SETFD, FD_CLOEXEC) == -1
+      || ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK) == -1) {
+    auto err = make_socket_error("fcntl failed");
+    ::close(fd);
+    return err;
+  }
+  return fd;
+}
+
+// Removes a stale socket file at `path`, but no other kind of file and no
+// socket that still accepts connections.
+expected<void> remove_stale_socket(const std::string& path,
+                                   const sockaddr_un& addr) {
+  struct stat st;
+  if (::lstat(path.c_str(), &st) == -1) {
+    if (errno == ENOENT)
+      return {};
+    return make_socket_error("lstat failed");
+  }
+  if (!S_ISSOCK(st.st_mode))
+    return make_error(ec::unspecified, "refusing to replace a file that is "
+                                       "not a Unix domain socket", path);
+  // Only a refused connection tells us that nobody listens on the socket.
+  auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1)
+    return make_socket_error("socket failed");
+  auto res = ::connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                       sizeof(addr));
+  auto err = errno;
+  ::close(fd);
+  if (res == 0 || err == EAGAIN)
+    return make_error(ec::unspecified, "address in use", path);
+  if (err != ECONNREFUSED) {
+    errno = err;
+    return make_socket_error("cannot probe Unix domain socket");
+  }
+  if (::unlink(path.c_str()) == -1)
+    return make_socket_error("unlink failed");
+  return {};
+}
+
+} // namespace <anonymous>
+
+bool is_unix_socket(const network_info& x) {
+  return x.address.compare(0, sizeof(unix_socket_scheme) - 1,
+                           unix_socket_scheme) == 0;
+}
+
+std::string unix_socket_path(const network_info& x) {
+  return x.address.substr(sizeof(unix_socket_scheme) - 1);
+}
+
+caf::actor basp_broker(caf::actor_system& sys) {
+  return sys.middleman().named_broker<caf::io::basp_broker>(caf::atom("BASP"));
+}
+
+expected<void> unix_socket_publish(caf::actor_system& sys,
+                                   const caf::actor& whom,
+                                   const std::string& path) {
+  auto addr = make_address(path);
+  if (!addr)
+    return std::move(addr.error());
+  auto removed = remove_stale_socket(path, *addr);
+  if (!removed)
+    return std::move(removed.error());
+  auto fd = make_socket();
+  if (!fd)
+    return std::move(fd.error());
+  if (::bind(*fd, reinterpret_cast<sockaddr*>(&*addr), sizeof(*addr)) == -1) {
+    auto err = make_socket_error("cannot bind Unix domain socket");
+    ::close(*fd);
+    return err;
+  }
+  struct stat file;
+  if (::listen(*fd, SOMAXCONN) == -1 || ::lstat(path.c_str(), &file) == -1) {
+    auto err = make_socket_error("cannot listen on Unix domain socket");
+    ::close(*fd);
+    ::unlink(path.c_str());
+    return err;
+  }
+  BROKER_DEBUG("listening on Unix domain socket" << path);
+  caf::io::doorman_ptr ptr
+    = caf::make_counted<unix_doorman>(multiplexer(sys), *fd, path, file);
+  caf::anon_send(basp_broker(sys), caf::publish_atom::value, std::move(ptr),
+                 uint16_t{0}, caf::actor_cast<caf::strong_actor_ptr>(whom),
+                 std::set<std::string>{});
+  return {};
+}
+
+expected<caf::io::scribe_ptr> unix_socket_connect(caf::actor_system& sys,
+                                                  const std::string& path) {
+  auto addr = make_address(path);
+  if (!addr)
+    return std::move(addr.error());
+  auto fd = make_socket();
+  if (!fd)
+    return std::move(fd.error());
+  // Connecting to a local socket never returns EINPROGRESS. A full backlog
+  // surfaces as EAGAIN instead, which we treat like a refused connection.
+  if (::connect(*fd, reinterpret_cast<sockaddr*>(&*addr), sizeof(*addr))
+      == -1) {
+    auto err = make_socket_error("cannot connect to Unix domain socket");
+    ::close(*fd);
+    return err;
+  }
+  caf::io::scribe_ptr result
+    = caf::make_counted<unix_scribe>(multiplexer(sys), *fd, path);
+  return result;
+}
+
+} // namespace detail
+} // namespace broker
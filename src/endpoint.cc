@@ -1,5 +1,6 @@
 #include "broker/logger.hh" // Must come before any CAF include.
 
+#include <algorithm>
 #include <unordered_set>
 
 #include <caf/config.hpp>
@@ -24,6 +25,7 @@
 #include "broker/timeout.hh"
 
 #include "broker/detail/die.hh"
+#include "broker/detail/unix_socket.hh"
 
 namespace broker {
 
@@ -35,6 +37,7 @@ endpoint::clock::clock(caf::actor_system* sys, bool use_real_time)
     time_since_epoch_(),
     mtx_(),
     pending_(),
+    next_seq_(0),
     pending_count_() {
   // nop
 }
@@ -55,44 +58,52 @@ void endpoint::clock::advance_time(timestamp t) {
   if (pending_count_ == 0)
     return;
 
+  // Move all due messages out of the heap while holding the lock, but send
+  // them only after releasing it to not block concurrent send_later calls.
+  // Note: this function is performance-sensitive in the case of Bro reading
+  // pcaps and it's important to not allocate anything unless at least one
+  // message is due.
+  pending_msgs_heap_type due;
   lock_type guard{mtx_};
+  pending_msg_order order;
+  while (!pending_.empty() && pending_.front().time <= t) {
+    std::pop_heap(pending_.begin(), pending_.end(), order);
+    due.emplace_back(std::move(pending_.back()));
+    pending_.pop_back();
+  }
+  pending_count_ = pending_.size();
+  guard.unlock();
 
-  auto it = pending_.begin();
-
-  if (it->first > t)
+  if (due.empty())
     return;
 
-  // Note: this function is performance-sensitive in the case of Bro
-  // reading pcaps and it's important to not construct this set unless
-  // it's actually going to be used.
   std::unordered_set<caf::actor> sync_with_actors;
-
-  while (it != pending_.end() && it->first <= t) {
-    auto& pm = it->second;
-    caf::anon_send(pm.first, std::move(pm.second));
-    sync_with_actors.emplace(pm.first);
-    it = pending_.erase(it);
-    --pending_count_;
+  for (auto& pm : due) {
+    caf::anon_send(pm.dest, std::move(pm.msg));
+    sync_with_actors.emplace(pm.dest);
   }
 
-  guard.unlock();
-
+  // Put a sync point into the mailbox of each affected actor at once and then
+  // wait for all of them, which takes a single round trip instead of one per
+  // actor. A single timeout bounds the wait for the entire batch.
   caf::scoped_actor self{*sys_};
-  for (auto& who : sync_with_actors) {
+  for (auto& who : sync_with_actors)
     self->send(who, atom::sync_point::value, self);
-    self->delayed_send(self, timeout::frontend, atom::tick::value);
-    self->receive(
-      [&](atom::sync_point) {
-        // nop
-      },
-      [&](atom::tick) {
-        CAF_LOG_DEBUG("advance_time actor syncing timed out");
-      },
-      [&](caf::error& e) {
-        CAF_LOG_DEBUG("advance_time actor syncing failed");
-      }
-    );
-  }
+  self->delayed_send(self, timeout::frontend, atom::tick::value);
+  auto outstanding = sync_with_actors.size();
+  self->receive_while([&] { return outstanding > 0; })(
+    [&](atom::sync_point) {
+      --outstanding;
+    },
+    [&](atom::tick) {
+      CAF_LOG_DEBUG("advance_time actor syncing timed out");
+      outstanding = 0;
+    },
+    [&](caf::error& e) {
+      CAF_LOG_DEBUG("advance_time actor syncing failed");
+      --outstanding;
+    }
+  );
 }
 
 void endpoint::clock::send_later(caf::actor dest, timespan after,
@@ -108,7 +119,9 @@ void endpoint::clock::send_later(caf::actor dest, timespan after,
   }
   lock_type guard{mtx_};
   auto t = this->now() + after;
-  pending_.emplace(t, pending_msg_type{std::move(dest), std::move(msg)});
+  pending_.push_back(pending_msg_type{t, next_seq_++, std::move(dest),
+                                      std::move(msg)});
+  std::push_heap(pending_.begin(), pending_.end(), pending_msg_order{});
   ++pending_count_;
 }
 
@@ -176,6 +189,22 @@ uint16_t endpoint::listen(const std::string& address, uint16_t port) {
   return res ? *res : 0;
 }
 
+bool endpoint::listen_unix(const std::string& path) {
+  BROKER_INFO("listening on Unix domain socket" << path);
+  if (!unix_socket_path_.empty()) {
+    BROKER_ERROR("cannot listen on" << path << ": already listening on"
+                 << unix_socket_path_);
+    return false;
+  }
+  auto res = detail::unix_socket_publish(system_, core(), path);
+  if (!res) {
+    BROKER_ERROR("cannot listen on" << path << ":" << to_string(res.error()));
+    return false;
+  }
+  unix_socket_path_ = path;
+  return true;
+}
+
 bool endpoint::peer(const std::string& address, uint16_t port,
                     timeout::seconds retry) {
   CAF_LOG_TRACE(CAF_ARG(address) << CAF_ARG(port) << CAF_ARG(retry));
@@ -203,6 +232,56 @@ void endpoint::peer_nosync(const std::string& address, uint16_t port,
   caf::anon_send(core(), atom::peer::value, network_info{address, port, retry});
 }
 
+size_t endpoint::peer_many(std::vector<network_info> xs,
+                           peer_progress_function f) {
+  BROKER_INFO("starting to peer with" << xs.size() << "endpoints");
+  if (xs.empty())
+    return 0;
+  caf::scoped_actor self{system_};
+  // A helper issues all requests at once and reports each result as soon as
+  // it arrives, which allows us to report progress in completion order.
+  auto listener = caf::actor{self};
+  auto core_hdl = core_;
+  auto targets = xs;
+  system_.spawn([=](caf::event_based_actor* helper) {
+    for (size_t i = 0; i < targets.size(); ++i) {
+      // Each attempt reports after its first failure. The core then keeps
+      // retrying in the background, just like `peer_nosync` does.
+      auto x = targets[i];
+      auto retry = x.retry;
+      x.retry = timeout::seconds(0);
+      helper->request(core_hdl, caf::infinite, atom::peer::value, x)
+      .then(
+        [=](const caf::actor&) {
+          helper->send(listener, atom::peer::value, i, caf::error{});
+        },
+        [=](caf::error& err) mutable {
+          if (retry.count() > 0) {
+            x.retry = retry;
+            helper->delayed_send(core_hdl, retry, atom::peer::value,
+                                 atom::retry::value, x);
+          }
+          helper->send(listener, atom::peer::value, i, std::move(err));
+        }
+      );
+    }
+  });
+  size_t completed = 0;
+  size_t succeeded = 0;
+  self->receive_for(completed, xs.size())(
+    [&](atom::peer, size_t i, caf::error& err) {
+      if (!err)
+        ++succeeded;
+      else
+        CAF_LOG_DEBUG("Cannot peer to" << xs[i].address << "on port"
+                      << xs[i].port << ":" << err);
+      if (f)
+        f(xs[i], err, completed + 1);
+    }
+  );
+  return succeeded;
+}
+
 bool endpoint::unpeer(const std::string& address, uint16_t port) {
   CAF_LOG_TRACE(CAF_ARG(address) << CAF_ARG(port));
   BROKER_INFO("stopping to peer with" << address << ":" << port << "[synchronous]");
@@ -295,8 +374,9 @@ status_subscriber endpoint::make_status_subscriber(bool receive_statuses) {
   return result;
 }
 
-subscriber endpoint::make_subscriber(std::vector<topic> ts, size_t max_qsize) {
-  subscriber result{*this, std::move(ts), max_qsize};
+subscriber endpoint::make_subscriber(std::vector<topic> ts, size_t max_qsize,
+                                     overflow_policy policy) {
+  subscriber result{*this, std::move(ts), max_qsize, policy};
   children_.emplace_back(result.worker());
   return result;
 }
@@ -339,13 +419,16 @@ expected<store> endpoint::attach_master(std::string name, backend type,
 expected<store> endpoint::attach_clone(std::string name,
                                        double resync_interval,
                                        double stale_interval,
-                                       double mutation_buffer_interval) {
+                                       double mutation_buffer_interval,
+                                       double write_coalesce_interval,
+                                       size_t write_coalesce_size) {
   BROKER_INFO("attaching clone store" << name);
   expected<store> res{ec::unspecified};
   caf::scoped_actor self{core()->home_system()};
   self->request(core(), caf::infinite, atom::store::value, atom::clone::value,
                 atom::attach::value, name, resync_interval, stale_interval,
-                mutation_buffer_interval).receive(
+                mutation_buffer_interval, write_coalesce_interval,
+                write_coalesce_size).receive(
     [&](caf::actor& clone) {
       res = store{std::move(clone), std::move(name)};
     },
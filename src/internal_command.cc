@@ -6,4 +6,18 @@ internal_command::internal_command(variant_type x) : content(std::move(x)) {
   // nop
 }
 
+const data* command_key(const internal_command& x) {
+  if (auto y = caf::get_if<put_command>(&x.content))
+    return &y->key;
+  if (auto y = caf::get_if<put_unique_command>(&x.content))
+    return &y->key;
+  if (auto y = caf::get_if<erase_command>(&x.content))
+    return &y->key;
+  if (auto y = caf::get_if<add_command>(&x.content))
+    return &y->key;
+  if (auto y = caf::get_if<subtract_command>(&x.content))
+    return &y->key;
+  return nullptr;
+}
+
 } // namespace broker
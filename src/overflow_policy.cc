@@ -0,0 +1,25 @@
+#include "broker/overflow_policy.hh"
+
+#include "broker/detail/assert.hh"
+
+namespace broker {
+
+const char* to_string(overflow_policy x) {
+  switch (x) {
+    default:
+      BROKER_ASSERT(!"missing to_string implementation");
+      return "<unknown>";
+    case overflow_policy::block:
+      return "block";
+    case overflow_policy::drop_oldest:
+      return "drop_oldest";
+    case overflow_policy::drop_newest:
+      return "drop_newest";
+    case overflow_policy::sample:
+      return "sample";
+    case overflow_policy::disconnect:
+      return "disconnect";
+  }
+}
+
+} // namespace broker
@@ -17,6 +17,8 @@ const char* to_string(sc code) {
       return "peer_removed";
     case sc::peer_lost:
       return "peer_lost";
+    case sc::subscriber_overflow:
+      return "subscriber_overflow";
   }
 }
 
@@ -31,6 +33,7 @@ const std::string* status::message() const {
     default:
       return nullptr;
     case sc::unspecified:
+    case sc::subscriber_overflow:
       return context_.empty() ? nullptr : &context_.get_as<std::string>(0);
     case sc::peer_added:
     case sc::peer_removed:
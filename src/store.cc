@@ -13,6 +13,7 @@
 #include "broker/store.hh"
 #include "broker/expected.hh"
 #include "broker/internal_command.hh"
+#include "broker/topic.hh"
 #include "broker/detail/flare_actor.hh"
 
 using namespace broker::detail;
@@ -126,6 +127,25 @@ expected<data> store::keys() const {
   return request<data>(atom::get::value, atom::keys::value);
 }
 
+expected<subscriber> store::subscribe_changes(const std::string& prefix,
+                                              size_t max_qsize,
+                                              overflow_policy policy) const {
+  // The frontend tells us which core delivers its change events.
+  auto core = request<caf::actor>(atom::subscribe::value, atom::changes::value);
+  if (!core)
+    return std::move(core.error());
+  // Subscribe first to not miss events between enabling and subscribing.
+  // A clear affects every key and thus goes to all change subscribers.
+  auto t = name_ / topics::changes_suffix / prefix;
+  auto c = name_ / topics::cleared_suffix;
+  subscriber result(std::move(*core), {std::move(t), std::move(c)}, max_qsize,
+                    policy);
+  // The master publishes change events for as long as the worker lives.
+  anon_send(frontend_, atom::subscribe::value, atom::changes::value,
+            result.worker());
+  return {std::move(result)};
+}
+
 void store::put(data key, data value, optional<timespan> expiry) const {
   anon_send(frontend_, atom::local::value,
             make_internal_command<put_command>(
@@ -0,0 +1,76 @@
+#include "broker/store_event.hh"
+
+#include "broker/detail/assert.hh"
+
+namespace broker {
+
+data store_event::to_data() const {
+  return vector{std::string{to_string(kind)}, key, value};
+}
+
+optional<store_event> store_event::make(const data& x) {
+  auto xs = caf::get_if<vector>(&x);
+  if (!xs || xs->size() != 3)
+    return nil;
+  auto str = caf::get_if<std::string>(&(*xs)[0]);
+  if (!str)
+    return nil;
+  store_event result;
+  if (!convert(*str, result.kind))
+    return nil;
+  result.key = (*xs)[1];
+  result.value = (*xs)[2];
+  return result;
+}
+
+const char* to_string(store_event::type x) {
+  switch (x) {
+    default:
+      BROKER_ASSERT(!"missing to_string implementation");
+      return "<unknown>";
+    case store_event::type::put:
+      return "put";
+    case store_event::type::erase:
+      return "erase";
+    case store_event::type::expire:
+      return "expire";
+    case store_event::type::add:
+      return "add";
+    case store_event::type::clear:
+      return "clear";
+  }
+}
+
+bool convert(const std::string& str, store_event::type& x) {
+  if (str == "put")
+    x = store_event::type::put;
+  else if (str == "erase")
+    x = store_event::type::erase;
+  else if (str == "expire")
+    x = store_event::type::expire;
+  else if (str == "add")
+    x = store_event::type::add;
+  else if (str == "clear")
+    x = store_event::type::clear;
+  else
+    return false;
+  return true;
+}
+
+bool operator==(const store_event& x, const store_event& y) {
+  return x.kind == y.kind && x.key == y.key && x.value == y.value;
+}
+
+std::string to_string(const store_event& x) {
+  std::string result = to_string(x.kind);
+  result += '(';
+  result += to_string(x.key);
+  if (!is<none>(x.value)) {
+    result += ", ";
+    result += to_string(x.value);
+  }
+  result += ')';
+  return result;
+}
+
+} // namespace broker
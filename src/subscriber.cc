@@ -1,7 +1,9 @@
 #include "broker/logger.hh" // Must come before any CAF include.
 #include "broker/subscriber.hh"
 
+#include <algorithm>
 #include <cstddef>
+#include <string>
 #include <utility>
 #include <chrono>
 #include <numeric>
@@ -10,8 +12,11 @@
 #include <caf/send.hpp>
 
 #include "broker/atoms.hh"
+#include "broker/configuration.hh"
 #include "broker/endpoint.hh"
+#include "broker/error.hh"
 #include "broker/filter_type.hh"
+#include "broker/status.hh"
 
 #include "broker/detail/assert.hh"
 
@@ -30,6 +35,12 @@ struct subscriber_worker_state {
 
   bool calculate_rate = true;
 
+  /// Signals that the last batch overflowed the queue.
+  bool overflowing = false;
+
+  /// Number of messages dropped since the queue last accepted a whole batch.
+  size_t lag = 0;
+
   static const char* name;
 
   void tick() {
@@ -60,17 +71,22 @@ public:
   using queue_ptr = detail::shared_subscriber_queue_ptr<>;
 
   subscriber_sink(scheduled_actor* self, subscriber_worker_state* state,
-                  queue_ptr qptr, size_t max_qsize)
+                  queue_ptr qptr, size_t max_qsize, overflow_policy policy,
+                  const broker_options& opts)
     : stream_manager(self),
       super(self),
       state_(state),
       queue_(std::move(qptr)),
-      max_qsize_(max_qsize) {
+      max_qsize_(max_qsize),
+      policy_(policy),
+      sample_interval_(std::max(opts.subscriber_sample_interval, size_t{1})),
+      disconnect_lag_(opts.subscriber_disconnect_lag) {
     // nop
   }
 
   bool congested() const noexcept override {
-    return queue_->buffer_size() >= max_qsize_;
+    return policy_ == overflow_policy::block
+           && queue_->buffer_size() >= max_qsize_;
   }
 
 protected:
@@ -81,29 +97,81 @@ protected:
       auto& xs = x.xs.get_mutable_as<vec_type>(0);
       auto xs_size = xs.size();
       state_->counter += xs_size;
-      queue_->produce(xs_size, std::make_move_iterator(xs.begin()),
-                      std::make_move_iterator(xs.end()));
+      if (policy_ == overflow_policy::block) {
+        queue_->produce(xs_size, std::make_move_iterator(xs.begin()),
+                        std::make_move_iterator(xs.end()));
+        return;
+      }
+      // Disconnecting drops new messages until reaching the lag threshold.
+      auto p = policy_ == overflow_policy::disconnect
+               ? overflow_policy::drop_newest
+               : policy_;
+      auto dropped = queue_->produce(std::make_move_iterator(xs.begin()),
+                                     std::make_move_iterator(xs.end()),
+                                     max_qsize_, p, sample_interval_);
+      if (dropped == 0) {
+        state_->overflowing = false;
+        state_->lag = 0;
+        return;
+      }
+      state_->lag += dropped;
+      if (policy_ == overflow_policy::disconnect
+          && state_->lag > disconnect_lag_) {
+        report("disconnected subscriber after it fell "
+               + std::to_string(state_->lag) + " messages behind");
+        // Readers must not wait for messages that never come.
+        queue_->close();
+        self()->quit(make_error(ec::unspecified,
+                                "subscriber exceeded its queue size"));
+        return;
+      }
+      if (!state_->overflowing) {
+        state_->overflowing = true;
+        report("subscriber started to drop messages with policy "
+               + std::string{to_string(policy_)});
+      }
+      return;
     }
     CAF_LOG_ERROR("received unexpected batch type (dropped)");
   }
 
 private:
+  void report(std::string msg) {
+    BROKER_WARNING(msg);
+    auto grp = self()->system().groups().get_local("broker/statuses");
+    self()->send(grp, atom::local::value,
+                 make_status<sc::subscriber_overflow>(std::move(msg)));
+  }
+
   subscriber_worker_state* state_;
   queue_ptr queue_;
   size_t max_qsize_;
+  overflow_policy policy_;
+  size_t sample_interval_;
+  size_t disconnect_lag_;
 };
 
+// Returns the Broker options of `sys` or the defaults if `sys` does not use a
+// Broker configuration.
+broker_options options_of(caf::actor_system& sys) {
+  if (auto cfg = dynamic_cast<const configuration*>(&sys.config()))
+    return cfg->options();
+  return {};
+}
+
 behavior subscriber_worker(stateful_actor<subscriber_worker_state>* self,
-                           endpoint* ep,
+                           caf::actor core,
                            detail::shared_subscriber_queue_ptr<> qptr,
-                           std::vector<topic> ts, size_t max_qsize) {
-  self->send(self * ep->core(), atom::join::value, std::move(ts));
+                           std::vector<topic> ts, size_t max_qsize,
+                           overflow_policy policy) {
+  self->send(self * core, atom::join::value, std::move(ts));
   self->set_default_handler(skip);
   return {
     [=](const endpoint::stream_type& in) {
       BROKER_ASSERT(qptr != nullptr);
       auto mgr = make_counted<subscriber_sink>(self, &self->state, qptr,
-                                               max_qsize);
+                                               max_qsize, policy,
+                                               options_of(self->system()));
       auto slot = mgr->add_unchecked_inbound_path(in);
       if (slot == invalid_stream_slot) {
         BROKER_WARNING("failed to init stream to subscriber_worker");
@@ -122,10 +190,10 @@ behavior subscriber_worker(stateful_actor<subscriber_worker_state>* self,
           // manager.
         },
         [=](atom::join a0, atom::update a1, filter_type& f) {
-          self->send(ep->core(), a0, a1, slot_at_sender, std::move(f));
+          self->send(core, a0, a1, slot_at_sender, std::move(f));
         },
         [=](atom::join a0, atom::update a1, filter_type& f, caf::actor& who) {
-          self->send(ep->core(), a0, a1, slot_at_sender, std::move(f),
+          self->send(core, a0, a1, slot_at_sender, std::move(f),
                      std::move(who));
         },
         [=](atom::tick) {
@@ -152,11 +220,19 @@ behavior subscriber_worker(stateful_actor<subscriber_worker_state>* self,
 
 } // namespace <anonymous>
 
-subscriber::subscriber(endpoint& e, std::vector<topic> ts, size_t max_qsize)
-  : super(max_qsize), ep_(e) {
+subscriber::subscriber(endpoint& e, std::vector<topic> ts, size_t max_qsize,
+                       overflow_policy policy)
+  : subscriber(e.core(), std::move(ts), max_qsize, policy) {
+  // nop
+}
+
+subscriber::subscriber(caf::actor core, std::vector<topic> ts,
+                       size_t max_qsize, overflow_policy policy)
+  : super(max_qsize) {
   BROKER_INFO("creating subscriber for topic(s)" << ts);
-  worker_ = ep_.system().spawn(subscriber_worker, &ep_, queue_, std::move(ts),
-                               max_qsize);
+  auto& sys = core->home_system();
+  worker_ = sys.spawn(subscriber_worker, std::move(core), queue_,
+                      std::move(ts), max_qsize, policy);
 }
 
 subscriber::~subscriber() {
@@ -167,6 +243,10 @@ size_t subscriber::rate() const {
   return queue_->rate();
 }
 
+size_t subscriber::dropped() const {
+  return queue_->dropped();
+}
+
 void subscriber::add_topic(topic x, bool block) {
   BROKER_INFO("adding topic" << x << "to subscriber");
   auto e = filter_.end();
@@ -174,7 +254,7 @@ void subscriber::add_topic(topic x, bool block) {
   if (i == e) {
     filter_.emplace_back(std::move(x));
     if (block) {
-      caf::scoped_actor self{ep_.system()};
+      caf::scoped_actor self{worker_->home_system()};
       self->send(worker_, atom::join::value, atom::update::value, filter_, self);
       self->receive([&](bool){});
     } else {
@@ -190,7 +270,7 @@ void subscriber::remove_topic(topic x, bool block) {
   if (i != filter_.end()) {
     filter_.erase(i);
     if (block) {
-      caf::scoped_actor self{ep_.system()};
+      caf::scoped_actor self{worker_->home_system()};
       self->send(worker_, atom::join::value, atom::update::value, filter_, self);
       self->receive([&](bool){});
     } else {
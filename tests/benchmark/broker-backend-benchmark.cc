@@ -0,0 +1,236 @@
+#include <getopt.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "broker/backend.hh"
+#include "broker/backend_options.hh"
+#include "broker/config.hh"
+#include "broker/data.hh"
+#include "broker/time.hh"
+
+#include "broker/detail/abstract_backend.hh"
+#include "broker/detail/filesystem.hh"
+#include "broker/detail/make_backend.hh"
+
+// Measures the raw throughput of data store backends, i.e., without any actor
+// or network overhead. Each run performs the following phases on a fresh
+// backend and reports the achieved operations per second:
+//
+//   - put:    insert all keys (every other key with an expiry)
+//   - get:    look up all keys
+//   - exists: check all keys plus the same number of missing keys
+//   - expire: expire all keys that have an expiry
+//
+// With --sqlite-modes, the benchmark instead measures the sustained write rate
+// of the SQLite backend for each combination of journal mode and synchronous
+// level.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+size_t num_keys = 100000;
+size_t value_size = 64;
+std::string path = "/tmp/broker-backend-benchmark";
+backend_options extra_options;
+int sqlite_modes = 0;
+
+struct option long_options[] = {
+  {"num-keys",   required_argument, 0, 'n'},
+  {"value-size", required_argument, 0, 's'},
+  {"path",       required_argument, 0, 'p'},
+  {"option",     required_argument, 0, 'o'},
+  {"sqlite-modes", no_argument,     &sqlite_modes, 1},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>] [memory|sqlite|rocksdb|append_log ...]\n"
+    "\n"
+    "   --num-keys <n>             (default: 100000)\n"
+    "   --value-size <bytes>       (default: 64)\n"
+    "   --path <prefix>            (default: /tmp/broker-backend-benchmark)\n"
+    "   --option <key>=<value>     extra backend option, may be repeated\n"
+    "   --sqlite-modes             compare SQLite journal/synchronous modes\n"
+    "\n"
+    "Numeric option values are passed as count, 'T'/'F' as boolean and\n"
+    "everything else as string.\n"
+    "\n";
+  exit(1);
+}
+
+data parse_option_value(const std::string& str) {
+  if (str == "T")
+    return true;
+  if (str == "F")
+    return false;
+  char* end = nullptr;
+  auto x = strtoull(str.c_str(), &end, 10);
+  if (!str.empty() && *end == '\0')
+    return count{x};
+  return str;
+}
+
+std::vector<data> make_keys(size_t n, size_t offset) {
+  std::vector<data> result;
+  result.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    result.emplace_back("key-" + std::to_string(offset + i));
+  std::shuffle(result.begin(), result.end(), std::minstd_rand{42});
+  return result;
+}
+
+template <class F>
+void measure(const char* backend_name, const char* op, size_t n, F f) {
+  auto t0 = clock_type::now();
+  f();
+  auto t1 = clock_type::now();
+  auto secs = std::chrono::duration<double>(t1 - t0).count();
+  std::cout << backend_name << '\t' << op << '\t' << n << '\t' << secs << '\t'
+            << static_cast<uint64_t>(n / secs) << " ops/s" << std::endl;
+}
+
+std::unique_ptr<detail::abstract_backend>
+make_fresh_backend(backend type, backend_options opts,
+                   const std::string& db_path) {
+  detail::remove_all(db_path);
+  detail::remove_all(db_path + "-wal");
+  detail::remove_all(db_path + "-shm");
+  opts["path"] = db_path;
+  return detail::make_backend(type, std::move(opts));
+}
+
+void run(backend type, const char* name) {
+  auto db_path = path + "." + name;
+  auto be = make_fresh_backend(type, extra_options, db_path);
+  auto keys = make_keys(num_keys, 0);
+  auto missing = make_keys(num_keys, num_keys);
+  data value = std::string(value_size, 'x');
+  // Place all expiries in the past to have expire() remove the entries.
+  auto expiry = broker::now() - std::chrono::seconds(1);
+  measure(name, "put", keys.size(), [&] {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      optional<timestamp> et;
+      if (i % 2 == 0)
+        et = expiry;
+      if (!be->put(keys[i], value, et))
+        std::cerr << "put failed" << std::endl;
+    }
+  });
+  measure(name, "get", keys.size(), [&] {
+    for (auto& key : keys)
+      if (!be->get(key))
+        std::cerr << "get failed" << std::endl;
+  });
+  measure(name, "exists", keys.size() + missing.size(), [&] {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      be->exists(keys[i]);
+      be->exists(missing[i]);
+    }
+  });
+  measure(name, "expire", keys.size(), [&] {
+    auto t = broker::now();
+    for (auto& key : keys)
+      be->expire(key, t);
+  });
+  be.reset();
+  detail::remove_all(db_path);
+}
+
+void run_sqlite_modes() {
+  auto db_path = path + ".sqlite";
+  data value = std::string(value_size, 'x');
+  auto keys = make_keys(num_keys, 0);
+  for (auto journal : {"delete", "truncate", "memory", "wal"}) {
+    for (auto sync : {"off", "normal", "full"}) {
+      auto opts = extra_options;
+      opts["journal-mode"] = journal;
+      opts["synchronous"] = sync;
+      auto be = make_fresh_backend(sqlite, std::move(opts), db_path);
+      auto label = std::string{"sqlite["} + journal + "," + sync + "]";
+      measure(label.c_str(), "put", keys.size(), [&] {
+        for (auto& key : keys)
+          if (!be->put(key, value))
+            std::cerr << "put failed" << std::endl;
+      });
+    }
+  }
+  detail::remove_all(db_path);
+  detail::remove_all(db_path + "-wal");
+  detail::remove_all(db_path + "-shm");
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  int option_index = 0;
+  for (;;) {
+    auto c = getopt_long(argc, argv, "", long_options, &option_index);
+    if (c == -1)
+      break;
+    switch (c) {
+      case 0:
+        // Flag
+        break;
+      case 'n':
+        num_keys = strtoull(optarg, nullptr, 10);
+        break;
+      case 's':
+        value_size = strtoull(optarg, nullptr, 10);
+        break;
+      case 'p':
+        path = optarg;
+        break;
+      case 'o': {
+        std::string kvp = optarg;
+        auto eq = kvp.find('=');
+        if (eq == std::string::npos)
+          usage();
+        extra_options[kvp.substr(0, eq)] = parse_option_value(kvp.substr(eq + 1));
+        break;
+      }
+      default:
+        usage();
+    }
+  }
+  std::vector<std::string> names{argv + optind, argv + argc};
+  if (names.empty()) {
+    names = {"memory", "sqlite", "append_log"};
+#ifdef BROKER_HAVE_ROCKSDB
+    names.emplace_back("rocksdb");
+#endif
+  }
+  std::cout << "backend\top\tn\tseconds\trate" << std::endl;
+  if (sqlite_modes) {
+    run_sqlite_modes();
+    return 0;
+  }
+  for (auto& name : names) {
+    if (name == "memory")
+      run(memory, "memory");
+    else if (name == "sqlite")
+      run(sqlite, "sqlite");
+    else if (name == "rocksdb")
+      run(rocksdb, "rocksdb");
+    else if (name == "append_log")
+      run(append_log, "append_log");
+    else
+      usage();
+  }
+  return 0;
+}
@@ -1,10 +1,63 @@
 # ping.py
+#
+# Usage: broker-benchmark.py <event>
+#        broker-benchmark.py local [<num-messages> [<batch-size>]]
+#
+# The first form sends events to a broker-benchmark instance listening on
+# port 9999. The second form measures how fast Python receives messages from
+# a second endpoint in the same process, once one message per get() and once
+# in batches with get(n).
 
 import sys
+import threading
 import time
 
 import broker
 
+def runLocal(num, batch):
+    def publish(ep, n):
+        p = ep.make_publisher("/benchmark/local")
+        msg = [1, "test", broker.Count(2), 3.0, ["a", "b", "c"]]
+        for i in range(n):
+            p.publish(msg)
+
+    def run(mode, n, receive):
+        ep1 = broker.Endpoint()
+        ep2 = broker.Endpoint()
+        s = ep1.make_subscriber("/benchmark/local")
+        port = ep1.listen("127.0.0.1", 0)
+        ep2.peer("127.0.0.1", port, 1.0)
+        t = threading.Thread(target=publish, args=(ep2, n))
+        start = time.time()
+        t.start()
+        received = receive(s, n)
+        elapsed = time.time() - start
+        t.join()
+        print("{}: {} msgs in {:.2f}s, {:.2f} msgs/s".format(
+            mode, received, elapsed, received / elapsed))
+        ep1.shutdown()
+        ep2.shutdown()
+
+    def receiveSingle(s, n):
+        for i in range(n):
+            s.get()
+        return n
+
+    def receiveBatch(s, n):
+        received = 0
+        while received < n:
+            received += len(s.get(min(batch, n - received)))
+        return received
+
+    run("get()", num, receiveSingle)
+    run("get({})".format(batch), num, receiveBatch)
+
+if len(sys.argv) > 1 and sys.argv[1] == "local":
+    num = int(sys.argv[2]) if len(sys.argv) > 2 else 100000
+    batch = int(sys.argv[3]) if len(sys.argv) > 3 else 100
+    runLocal(num, batch)
+    sys.exit(0)
+
 event = int(sys.argv[1])
 
 total_sent_ev1 = 0
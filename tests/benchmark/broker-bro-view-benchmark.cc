@@ -0,0 +1,216 @@
+#include <getopt.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "broker/bro.hh"
+#include "broker/data.hh"
+
+#include "broker/detail/blob.hh"
+
+// Compares decoding serialized Bro messages in full against dispatching on
+// views. The messages mimic the traffic of a Zeek cluster: mostly events with
+// a connection record, some log writes, and batches of both. A handler only
+// needs the arguments of a fraction of the events.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+size_t num_messages = 100000;
+size_t handled_percent = 10;
+
+struct option long_options[] = {
+  {"num-messages", required_argument, 0, 'n'},
+  {"handled",      required_argument, 0, 'h'},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>]\n"
+    "\n"
+    "   --num-messages <n>         (default: 100000)\n"
+    "   --handled <percent>        (default: 10)\n"
+    "\n";
+  exit(1);
+}
+
+// -- message mix --------------------------------------------------------------
+
+const char* event_names[] = {
+  "connection_established",
+  "dns_request",
+  "http_header",
+  "ssl_established",
+  "file_new",
+  "smtp_request",
+  "ssh_auth_attempted",
+  "notice",
+  "weird",
+  "known_hosts_add",
+};
+
+constexpr size_t num_event_names = sizeof(event_names) / sizeof(event_names[0]);
+
+data make_conn(size_t i) {
+  address orig;
+  address resp;
+  convert("10.0.0." + std::to_string(i % 250), orig);
+  convert("192.168.1." + std::to_string(i % 200), resp);
+  return vector{
+    vector{orig, port(static_cast<port::number_type>(40000 + i % 20000),
+                      port::protocol::tcp),
+           resp, port(443, port::protocol::tcp)},
+    "C" + std::to_string(i) + "x8Hn1JvnA7c",
+    now(),
+    timespan{std::chrono::milliseconds(i % 5000)},
+    count{i * 17},
+    count{i * 31},
+    "SF",
+    set{"http", "ssl"},
+  };
+}
+
+data make_event(size_t i) {
+  vector args{make_conn(i)};
+  for (size_t j = 0; j < 3 + i % 4; ++j)
+    args.emplace_back("argument-" + std::to_string(j));
+  args.emplace_back(count{i});
+  return bro::Event(event_names[i % num_event_names], std::move(args));
+}
+
+data make_log_write(size_t i) {
+  return bro::LogWrite(enum_value{"Conn::LOG"},
+                       enum_value{"Log::WRITER_ASCII"}, "conn",
+                       std::string(200 + i % 100, 'x'));
+}
+
+data make_message(size_t i) {
+  switch (i % 10) {
+    case 0:
+    case 1:
+      return make_log_write(i);
+    case 2: {
+      vector xs;
+      for (size_t j = 0; j < 8; ++j)
+        xs.emplace_back(make_event(i + j));
+      return bro::Batch(std::move(xs));
+    }
+    default:
+      return make_event(i);
+  }
+}
+
+// -- handlers -----------------------------------------------------------------
+
+bool interested(const std::string& name) {
+  auto n = static_cast<size_t>(name[0]) + name.size();
+  return n % 100 < handled_percent;
+}
+
+size_t handled = 0;
+
+void handle(const vector& args) {
+  handled += args.size();
+}
+
+void dispatch_full(const data& msg) {
+  switch (bro::Message::type(msg)) {
+    case bro::Message::Type::Event: {
+      bro::Event ev(msg);
+      if (interested(ev.name()))
+        handle(ev.args());
+      break;
+    }
+    case bro::Message::Type::Batch: {
+      bro::Batch b(msg);
+      for (auto& x : b.batch())
+        dispatch_full(x);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void dispatch_view(const bro::MessageView& msg) {
+  switch (msg.type()) {
+    case bro::Message::Type::Event: {
+      bro::EventView ev(msg);
+      if (interested(ev.name()))
+        handle(ev.args());
+      break;
+    }
+    case bro::Message::Type::Batch: {
+      bro::BatchView b(msg);
+      for (size_t i = 0; i < b.batch_size(); ++i)
+        dispatch_view(b.message(i));
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void report(const std::string& mode, clock_type::duration elapsed) {
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  auto ns = duration_cast<nanoseconds>(elapsed).count();
+  std::cout << mode << ": " << (ns / 1e6) << "ms, "
+            << (static_cast<double>(ns) / num_messages) << "ns/msg"
+            << std::endl;
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  for (;;) {
+    int c = getopt_long(argc, argv, "", long_options, nullptr);
+    if (c < 0)
+      break;
+    switch (c) {
+      case 'n':
+        num_messages = std::strtoull(optarg, nullptr, 10);
+        break;
+      case 'h':
+        handled_percent = std::strtoull(optarg, nullptr, 10);
+        break;
+      default:
+        usage();
+    }
+  }
+  std::vector<std::string> blobs;
+  blobs.reserve(num_messages);
+  size_t bytes = 0;
+  for (size_t i = 0; i < num_messages; ++i) {
+    blobs.emplace_back(detail::to_blob(make_message(i)));
+    bytes += blobs.back().size();
+  }
+  std::cout << num_messages << " messages, " << bytes << " bytes" << std::endl;
+  auto t0 = clock_type::now();
+  for (auto& blob : blobs)
+    dispatch_full(detail::from_blob<data>(blob));
+  report("full", clock_type::now() - t0);
+  auto full_handled = handled;
+  handled = 0;
+  t0 = clock_type::now();
+  for (auto& blob : blobs)
+    dispatch_view(bro::MessageView{blob});
+  report("view", clock_type::now() - t0);
+  if (handled != full_handled) {
+    std::cerr << "views dispatched " << handled << " arguments, expected "
+              << full_handled << std::endl;
+    return 1;
+  }
+  return 0;
+}
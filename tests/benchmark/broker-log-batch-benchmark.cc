@@ -0,0 +1,198 @@
+#include <getopt.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "broker/bro.hh"
+#include "broker/data.hh"
+
+#include "broker/detail/blob.hh"
+
+// Compares per-record log writes against columnar log batches in terms of
+// bytes on the wire and CPU time for encoding and decoding. The records
+// resemble entries of Zeek's conn.log.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+size_t num_records = 100000;
+size_t batch_size = 100;
+
+struct option long_options[] = {
+  {"num-records", required_argument, 0, 'n'},
+  {"batch-size",  required_argument, 0, 'b'},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>]\n"
+    "\n"
+    "   --num-records <n>          (default: 100000)\n"
+    "   --batch-size <n>           (default: 100)\n"
+    "\n";
+  exit(1);
+}
+
+const std::vector<data::type> schema{
+  data::type::timestamp, // ts
+  data::type::string,    // uid
+  data::type::address,   // id.orig_h
+  data::type::port,      // id.orig_p
+  data::type::address,   // id.resp_h
+  data::type::port,      // id.resp_p
+  data::type::enum_value, // proto
+  data::type::string,    // service
+  data::type::timespan,  // duration
+  data::type::count,     // orig_bytes
+  data::type::count,     // resp_bytes
+  data::type::string,    // conn_state
+  data::type::boolean,   // local_orig
+  data::type::count,     // missed_bytes
+  data::type::string,    // history
+  data::type::count,     // orig_pkts
+  data::type::count,     // resp_pkts
+  data::type::set,       // tunnel_parents
+};
+
+std::vector<vector> make_records() {
+  std::vector<vector> result;
+  result.reserve(num_records);
+  auto t0 = now();
+  const char* services[] = {"http", "dns", "ssl", "ssh"};
+  for (size_t i = 0; i < num_records; ++i) {
+    address orig;
+    address resp;
+    convert("10.0.0." + std::to_string(i % 250), orig);
+    convert("192.168.1." + std::to_string(i % 200), resp);
+    auto has_service = i % 3 != 0;
+    result.push_back(vector{
+      t0 + std::chrono::microseconds(i * 250),
+      "C" + std::to_string(i) + "x8Hn1JvnA7c",
+      orig,
+      port(static_cast<port::number_type>(40000 + i % 20000),
+           port::protocol::tcp),
+      resp,
+      port(443, port::protocol::tcp),
+      enum_value{"tcp"},
+      has_service ? data{services[i % 4]} : data{},
+      timespan{std::chrono::milliseconds(i % 5000)},
+      count{i * 17 % 100000},
+      count{i * 31 % 1000000},
+      "SF",
+      i % 2 == 0,
+      count{0},
+      "ShADadFf",
+      count{10 + i % 50},
+      count{12 + i % 70},
+      set{},
+    });
+  }
+  return result;
+}
+
+void report(const std::string& mode, size_t bytes, clock_type::duration enc,
+            clock_type::duration dec) {
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  auto per_record = [](clock_type::duration x) {
+    return static_cast<double>(duration_cast<nanoseconds>(x).count())
+           / num_records;
+  };
+  std::cout << mode << ": " << bytes << " bytes ("
+            << (static_cast<double>(bytes) / num_records) << " per record), "
+            << "encode " << per_record(enc) << "ns/record, "
+            << "decode " << per_record(dec) << "ns/record" << std::endl;
+}
+
+void run_log_writes(const std::vector<vector>& records) {
+  std::vector<std::string> blobs;
+  blobs.reserve(records.size());
+  size_t bytes = 0;
+  auto t0 = clock_type::now();
+  for (auto& x : records) {
+    blobs.emplace_back(detail::to_blob(data{
+      bro::LogWrite(enum_value{"Conn::LOG"}, enum_value{"Log::WRITER_ASCII"},
+                    "conn", x)}));
+    bytes += blobs.back().size();
+  }
+  auto t1 = clock_type::now();
+  size_t fields = 0;
+  for (auto& blob : blobs) {
+    bro::LogWrite msg{detail::from_blob<data>(blob)};
+    fields += caf::get<vector>(msg.serial_data()).size();
+  }
+  auto t2 = clock_type::now();
+  if (fields != records.size() * schema.size())
+    std::cerr << "decoded " << fields << " fields" << std::endl;
+  report("log-write", bytes, t1 - t0, t2 - t1);
+}
+
+void run_log_batches(const std::vector<vector>& records) {
+  std::vector<std::string> blobs;
+  size_t bytes = 0;
+  auto t0 = clock_type::now();
+  bro::LogBatchBuilder builder{enum_value{"Conn::LOG"},
+                               enum_value{"Log::WRITER_ASCII"}, "conn",
+                               schema};
+  for (auto& x : records) {
+    builder.add(x);
+    if (builder.num_records() == batch_size) {
+      blobs.emplace_back(detail::to_blob(data{builder.build()}));
+      bytes += blobs.back().size();
+    }
+  }
+  if (builder.num_records() > 0) {
+    blobs.emplace_back(detail::to_blob(data{builder.build()}));
+    bytes += blobs.back().size();
+  }
+  auto t1 = clock_type::now();
+  size_t fields = 0;
+  std::vector<vector> decoded;
+  for (auto& blob : blobs) {
+    bro::LogBatch msg{detail::from_blob<data>(blob)};
+    msg.records(decoded);
+    for (auto& x : decoded)
+      fields += x.size();
+  }
+  auto t2 = clock_type::now();
+  if (fields != records.size() * schema.size())
+    std::cerr << "decoded " << fields << " fields" << std::endl;
+  report("log-batch", bytes, t1 - t0, t2 - t1);
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  for (;;) {
+    int c = getopt_long(argc, argv, "", long_options, nullptr);
+    if (c < 0)
+      break;
+    switch (c) {
+      case 'n':
+        num_records = std::strtoull(optarg, nullptr, 10);
+        break;
+      case 'b':
+        batch_size = std::strtoull(optarg, nullptr, 10);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (num_records == 0 || batch_size == 0)
+    usage();
+  auto records = make_records();
+  run_log_writes(records);
+  run_log_batches(records);
+  return 0;
+}
@@ -0,0 +1,477 @@
+#include <getopt.h>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "broker/address.hh"
+#include "broker/backend.hh"
+#include "broker/backend_options.hh"
+#include "broker/config.hh"
+#include "broker/data.hh"
+#include "broker/port.hh"
+#include "broker/time.hh"
+#include "broker/topic.hh"
+#include "broker/version.hh"
+
+#include "broker/detail/abstract_backend.hh"
+#include "broker/detail/appliers.hh"
+#include "broker/detail/blob.hh"
+#include "broker/detail/filesystem.hh"
+#include "broker/detail/flare.hh"
+#include "broker/detail/make_backend.hh"
+#include "broker/detail/prefix_matcher.hh"
+#include "broker/detail/radix_tree.hh"
+#include "broker/detail/shared_publisher_queue.hh"
+#include "broker/detail/shared_subscriber_queue.hh"
+
+// Measures individual hot-path components of the library in isolation. Each
+// benchmark repeats a batch of operations until it ran for at least
+// --min-time and then reports the mean time per operation. The output is
+// either CSV (the default) or one JSON object per line, which makes it easy
+// to track results across releases.
+//
+// Benchmarks have hierarchical names such as "blob/to/conn-record" and
+// --filter selects all benchmarks whose name contains the given string.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+std::string filter;
+std::string format = "csv";
+std::string path = "/tmp/broker-micro-benchmark";
+double min_time = 0.5;
+size_t num_keys = 10000;
+int list_only = 0;
+
+struct option long_options[] = {
+  {"filter",   required_argument, 0, 'f'},
+  {"format",   required_argument, 0, 'F'},
+  {"min-time", required_argument, 0, 't'},
+  {"num-keys", required_argument, 0, 'n'},
+  {"path",     required_argument, 0, 'p'},
+  {"list",     no_argument,       &list_only, 1},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>]\n"
+    "\n"
+    "   --filter <str>             only run benchmarks containing str\n"
+    "   --format <csv|json>        output format (default: csv)\n"
+    "   --min-time <seconds>       run time per benchmark (default: 0.5)\n"
+    "   --num-keys <n>             keys for radix tree and backends\n"
+    "                              (default: 10000)\n"
+    "   --path <prefix>            database path prefix for backends\n"
+    "                              (default: /tmp/broker-micro-benchmark)\n"
+    "   --list                     print the benchmark names and exit\n"
+    "\n";
+  exit(1);
+}
+
+// Keeps the compiler from optimizing away the computation of `x`.
+template <class T>
+void keep(const T& x) {
+  asm volatile("" : : "g"(&x) : "memory");
+}
+
+/// A named benchmark. Each call to `run` performs `batch` operations. The
+/// optional `setup` runs once before the first measurement, which keeps
+/// expensive preparations out of runs that --filter deselects.
+struct benchmark {
+  std::string name;
+  size_t batch;
+  std::function<void()> run;
+  std::function<void()> setup;
+};
+
+std::vector<benchmark> benchmarks;
+
+void add(std::string name, size_t batch, std::function<void()> f,
+         std::function<void()> setup = nullptr) {
+  benchmarks.push_back(benchmark{std::move(name), batch, std::move(f),
+                                 std::move(setup)});
+}
+
+// -- data distributions -------------------------------------------------------
+
+std::minstd_rand rng{42};
+
+address make_address(uint32_t x) {
+  return address{&x, address::family::ipv4, address::byte_order::host};
+}
+
+// A record as Bro sends it for a conn.log entry.
+data make_conn_record(size_t i) {
+  return vector{
+    broker::now(),
+    "C" + std::to_string(1000000 + i),
+    make_address(0x0a000000 + static_cast<uint32_t>(i % 256)),
+    port{static_cast<port::number_type>(1024 + i % 60000), port::protocol::tcp},
+    make_address(0xc0a80001),
+    port{443, port::protocol::tcp},
+    enum_value{"tcp"},
+    "ssl",
+    timespan{std::chrono::milliseconds(i % 5000)},
+    count{i * 17 % 100000},
+    count{i * 31 % 1000000},
+    "SF",
+    true,
+    nil,
+    set{"ShADadFf", "dt"},
+  };
+}
+
+// A mix of values that resembles the arguments of typical Bro events.
+std::vector<std::pair<std::string, data>> make_samples() {
+  std::vector<std::pair<std::string, data>> result;
+  result.emplace_back("count", count{4711});
+  result.emplace_back("string", std::string{"GET /index.html HTTP/1.1"});
+  result.emplace_back("address", make_address(0x0a000001));
+  result.emplace_back("conn-record", make_conn_record(0));
+  vector batch;
+  for (size_t i = 0; i < 100; ++i)
+    batch.emplace_back(make_conn_record(i));
+  result.emplace_back("conn-batch", std::move(batch));
+  table tbl;
+  for (size_t i = 0; i < 100; ++i)
+    tbl.emplace(make_address(0x0a000000 + static_cast<uint32_t>(i)),
+                count{i});
+  result.emplace_back("table", std::move(tbl));
+  return result;
+}
+
+// Topics of a Bro cluster: events and logs below a few top-level hierarchies.
+std::vector<topic> make_topics(size_t n) {
+  const char* roots[] = {"bro/event", "bro/logs", "bro/cluster/node",
+                         "bro/store", "intel"};
+  const char* leafs[] = {"conn", "dns", "http", "ssl", "files", "x509",
+                         "notice", "weird", "software", "known_hosts"};
+  std::vector<topic> result;
+  result.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto root = roots[rng() % 5];
+    auto leaf = leafs[rng() % 10];
+    auto t = topic{root} / leaf;
+    if (rng() % 4 == 0)
+      t /= "worker-" + std::to_string(rng() % 32);
+    result.emplace_back(std::move(t));
+  }
+  return result;
+}
+
+// A subscription filter as a worker node would install it.
+std::vector<topic> make_filter() {
+  return {"bro/event/conn", "bro/event/dns", "bro/event/http",
+          "bro/cluster/node/worker-1", "bro/store/known_hosts", "intel"};
+}
+
+std::vector<data> make_keys(size_t n) {
+  std::vector<data> result;
+  result.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    result.emplace_back(make_address(0x0a000000 + static_cast<uint32_t>(i)));
+  std::shuffle(result.begin(), result.end(), rng);
+  return result;
+}
+
+// -- benchmarks ---------------------------------------------------------------
+
+void add_blob_benchmarks() {
+  for (auto& sample : make_samples()) {
+    auto x = sample.second;
+    add("blob/to/" + sample.first, 100, [=] {
+      for (size_t i = 0; i < 100; ++i)
+        keep(detail::to_blob(x));
+    });
+    auto buf = detail::to_blob(x);
+    add("blob/from/" + sample.first, 100, [=] {
+      for (size_t i = 0; i < 100; ++i)
+        keep(detail::from_blob<data>(buf));
+    });
+  }
+}
+
+void add_topic_benchmarks() {
+  auto topics = std::make_shared<std::vector<topic>>(make_topics(1000));
+  auto filter = std::make_shared<std::vector<topic>>(make_filter());
+  add("topic/prefix_of", topics->size(), [=] {
+    topic prefix{"bro/event"};
+    for (auto& t : *topics)
+      keep(prefix.prefix_of(t));
+  });
+  add("topic/prefix_matcher", topics->size(), [=] {
+    detail::prefix_matcher f;
+    for (auto& t : *topics)
+      keep(f(*filter, t));
+  });
+}
+
+void add_radix_tree_benchmarks() {
+  using tree_type = detail::radix_tree<size_t>;
+  auto topics = make_topics(num_keys);
+  auto keys = std::make_shared<std::vector<std::string>>();
+  for (size_t i = 0; i < topics.size(); ++i)
+    keys->emplace_back(topics[i].string() + "/" + std::to_string(i));
+  auto tree = std::make_shared<tree_type>();
+  for (size_t i = 0; i < keys->size(); ++i)
+    tree->insert({(*keys)[i], i});
+  add("radix_tree/insert", keys->size(), [=] {
+    tree_type t;
+    for (size_t i = 0; i < keys->size(); ++i)
+      t.insert({(*keys)[i], i});
+    keep(t);
+  });
+  add("radix_tree/find", keys->size(), [=] {
+    for (auto& key : *keys)
+      keep(tree->find(key));
+  });
+  add("radix_tree/prefix_of", keys->size(), [=] {
+    for (auto& key : *keys)
+      keep(tree->prefix_of(key));
+  });
+  auto prefixes = std::make_shared<std::vector<std::string>>();
+  for (auto& t : make_topics(100))
+    prefixes->emplace_back(t.string());
+  add("radix_tree/prefixed_by", prefixes->size(), [=] {
+    for (auto& prefix : *prefixes)
+      for (auto& i : tree->prefixed_by(prefix))
+        keep(i->second);
+  });
+}
+
+void add_queue_benchmarks() {
+  // Publishers hand items over in small chunks, because the queue has the
+  // same capacity as in publisher.cc and blocks the producer when full.
+  constexpr size_t capacity = 30;
+  constexpr size_t chunk = 20;
+  constexpr size_t rounds = 50;
+  auto x = make_conn_record(0);
+  auto pq = detail::make_shared_publisher_queue(capacity);
+  add("queue/publisher", chunk * rounds, [=] {
+    topic t{"bro/logs/conn"};
+    for (size_t r = 0; r < rounds; ++r) {
+      for (size_t i = 0; i < chunk; ++i) {
+        auto y = x;
+        pq->produce(t, std::move(y));
+      }
+      pq->consume(chunk, [](std::pair<topic, data>&& y) { keep(y); });
+    }
+  });
+  auto sq = caf::make_counted<detail::shared_subscriber_queue<>>();
+  auto items = std::make_shared<std::vector<std::pair<topic, data>>>();
+  for (size_t i = 0; i < chunk; ++i)
+    items->emplace_back(topic{"bro/logs/conn"}, x);
+  add("queue/subscriber", chunk * rounds, [=] {
+    for (size_t r = 0; r < rounds; ++r) {
+      sq->produce(items->size(), items->begin(), items->end());
+      sq->consume(chunk, nullptr, [](std::pair<topic, data>&& y) { keep(y); });
+    }
+  });
+}
+
+void add_flare_benchmarks() {
+  auto fx = std::make_shared<detail::flare>();
+  add("flare/fire_extinguish", 100, [=] {
+    for (size_t i = 0; i < 100; ++i) {
+      fx->fire();
+      keep(fx->extinguish());
+    }
+  });
+  add("flare/fire_extinguish_one", 100, [=] {
+    for (size_t i = 0; i < 100; ++i) {
+      fx->fire();
+      keep(fx->extinguish_one());
+    }
+  });
+}
+
+void add_applier_benchmarks() {
+  auto xs = std::make_shared<std::vector<data>>();
+  for (size_t i = 0; i < 1000; ++i)
+    xs->emplace_back(count{i});
+  auto keys = std::make_shared<std::vector<data>>(make_keys(1000));
+  auto pairs = std::make_shared<std::vector<data>>();
+  for (size_t i = 0; i < keys->size(); ++i)
+    pairs->emplace_back(vector{(*keys)[i], count{i}});
+  add("appliers/add/count", xs->size(), [=] {
+    data c = count{0};
+    for (auto& x : *xs)
+      keep(caf::visit(detail::adder{x}, c));
+  });
+  add("appliers/remove/count", xs->size(), [=] {
+    data c = count{0};
+    for (auto& x : *xs)
+      keep(caf::visit(detail::remover{x}, c));
+  });
+  add("appliers/add/set", keys->size(), [=] {
+    data s = set{};
+    for (auto& x : *keys)
+      keep(caf::visit(detail::adder{x}, s));
+  });
+  add("appliers/remove/set", keys->size(), [=] {
+    data s = set(keys->begin(), keys->end());
+    for (auto& x : *keys)
+      keep(caf::visit(detail::remover{x}, s));
+  });
+  add("appliers/add/table", pairs->size(), [=] {
+    data t = table{};
+    for (auto& x : *pairs)
+      keep(caf::visit(detail::adder{x}, t));
+  });
+  add("appliers/remove/table", keys->size(), [=] {
+    table tbl;
+    for (size_t i = 0; i < keys->size(); ++i)
+      tbl.emplace((*keys)[i], count{i});
+    data t = std::move(tbl);
+    for (auto& x : *keys)
+      keep(caf::visit(detail::remover{x}, t));
+  });
+}
+
+void add_backend_benchmarks(backend type, const std::string& name) {
+  struct state {
+    std::unique_ptr<detail::abstract_backend> be;
+    std::vector<data> keys;
+    data value;
+  };
+  auto st = std::make_shared<state>();
+  auto db_path = path + "." + name;
+  auto setup = [=] {
+    if (st->be)
+      return;
+    detail::remove_all(db_path);
+    backend_options opts;
+    opts["path"] = db_path;
+    st->be = detail::make_backend(type, std::move(opts));
+    if (!st->be) {
+      std::cerr << "failed to create " << name << " backend" << std::endl;
+      exit(1);
+    }
+    st->keys = make_keys(num_keys);
+    st->value = make_conn_record(0);
+    for (auto& key : st->keys)
+      st->be->put(key, st->value);
+  };
+  // Overwrite existing keys to measure the steady state of a long-lived store
+  // rather than the growth of an empty one.
+  add("backend/" + name + "/put", num_keys, [=] {
+    for (auto& key : st->keys)
+      if (!st->be->put(key, st->value))
+        std::cerr << "put failed" << std::endl;
+  }, setup);
+  add("backend/" + name + "/get", num_keys, [=] {
+    for (auto& key : st->keys)
+      keep(st->be->get(key));
+  }, setup);
+}
+
+// -- runner -------------------------------------------------------------------
+
+void print_header() {
+  if (format == "csv")
+    std::cout << "name,version,iterations,ns_per_op,ops_per_sec" << std::endl;
+}
+
+void print_result(const benchmark& b, uint64_t iterations, double ns_per_op) {
+  auto rate = ns_per_op > 0 ? static_cast<uint64_t>(1e9 / ns_per_op) : 0;
+  if (format == "json")
+    std::cout << "{\"name\":\"" << b.name << "\",\"version\":\""
+              << version::string() << "\",\"iterations\":" << iterations
+              << ",\"ns_per_op\":" << ns_per_op
+              << ",\"ops_per_sec\":" << rate << '}' << std::endl;
+  else
+    std::cout << b.name << ',' << version::string() << ',' << iterations << ','
+              << ns_per_op << ',' << rate << std::endl;
+}
+
+void run(const benchmark& b) {
+  if (b.setup)
+    b.setup();
+  // Warm up caches and allocators before measuring.
+  b.run();
+  uint64_t runs = 0;
+  auto t0 = clock_type::now();
+  std::chrono::duration<double> elapsed{0};
+  do {
+    b.run();
+    ++runs;
+    elapsed = clock_type::now() - t0;
+  } while (elapsed.count() < min_time);
+  auto iterations = runs * b.batch;
+  print_result(b, iterations, elapsed.count() * 1e9 / iterations);
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  int option_index = 0;
+  for (;;) {
+    auto c = getopt_long(argc, argv, "", long_options, &option_index);
+    if (c == -1)
+      break;
+    switch (c) {
+      case 0:
+        // Flag
+        break;
+      case 'f':
+        filter = optarg;
+        break;
+      case 'F':
+        format = optarg;
+        if (format != "csv" && format != "json")
+          usage();
+        break;
+      case 't':
+        min_time = strtod(optarg, nullptr);
+        break;
+      case 'n':
+        num_keys = strtoull(optarg, nullptr, 10);
+        break;
+      case 'p':
+        path = optarg;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc)
+    usage();
+  add_blob_benchmarks();
+  add_topic_benchmarks();
+  add_radix_tree_benchmarks();
+  add_queue_benchmarks();
+  add_flare_benchmarks();
+  add_applier_benchmarks();
+  add_backend_benchmarks(memory, "memory");
+  add_backend_benchmarks(sqlite, "sqlite");
+#ifdef BROKER_HAVE_ROCKSDB
+  add_backend_benchmarks(rocksdb, "rocksdb");
+#endif
+  if (list_only) {
+    for (auto& b : benchmarks)
+      std::cout << b.name << std::endl;
+    return 0;
+  }
+  print_header();
+  for (auto& b : benchmarks)
+    if (b.name.find(filter) != std::string::npos)
+      run(b);
+  detail::remove_all(path + ".sqlite");
+  detail::remove_all(path + ".rocksdb");
+  return 0;
+}
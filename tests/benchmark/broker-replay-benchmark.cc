@@ -0,0 +1,156 @@
+#include <getopt.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "broker/backend.hh"
+#include "broker/configuration.hh"
+#include "broker/data.hh"
+#include "broker/endpoint.hh"
+#include "broker/store.hh"
+#include "broker/time.hh"
+
+#include "broker/detail/hdr_histogram.hh"
+
+// Simulates replaying a trace with pseudo time, as Bro does when reading a
+// pcap. The benchmark attaches --stores masters to an endpoint that does not
+// use real time, fills each with --keys keys whose expiries spread over the
+// first --spread steps, and then advances the clock --steps times by --step
+// microseconds. Each advance delivers the due expiration messages and waits
+// until all affected stores processed them, so the time per step shows the
+// overhead that expiring keys add to the replay.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+size_t num_stores = 10;
+size_t num_keys = 10000;
+size_t num_steps = 10000;
+size_t spread = 0;
+uint64_t step_us = 1000;
+
+struct option long_options[] = {
+  {"stores", required_argument, 0, 's'},
+  {"keys",   required_argument, 0, 'k'},
+  {"steps",  required_argument, 0, 'n'},
+  {"spread", required_argument, 0, 'S'},
+  {"step",   required_argument, 0, 't'},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>]\n"
+    "\n"
+    "   --stores <n>               number of master stores (default: 10)\n"
+    "   --keys <n>                 keys per store (default: 10000)\n"
+    "   --steps <n>                number of clock advances (default: 10000)\n"
+    "   --spread <n>               expire keys within the first n steps\n"
+    "                              (default: all steps)\n"
+    "   --step <us>                pseudo time per step (default: 1000)\n"
+    "\n";
+  exit(1);
+}
+
+double usecs(uint64_t ns) {
+  return static_cast<double>(ns) / 1000.;
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  int option_index = 0;
+  for (;;) {
+    auto c = getopt_long(argc, argv, "", long_options, &option_index);
+    if (c == -1)
+      break;
+    switch (c) {
+      case 's':
+        num_stores = strtoull(optarg, nullptr, 10);
+        break;
+      case 'k':
+        num_keys = strtoull(optarg, nullptr, 10);
+        break;
+      case 'n':
+        num_steps = strtoull(optarg, nullptr, 10);
+        break;
+      case 'S':
+        spread = strtoull(optarg, nullptr, 10);
+        break;
+      case 't':
+        step_us = strtoull(optarg, nullptr, 10);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc || num_keys == 0 || num_steps == 0)
+    usage();
+  if (spread == 0 || spread > num_steps)
+    spread = num_steps;
+  broker_options opts;
+  opts.use_real_time = false;
+  endpoint ep{configuration{opts}};
+  auto step = timespan{std::chrono::microseconds(step_us)};
+  auto t = timestamp{std::chrono::seconds(1)};
+  ep.advance_time(t);
+  // Fill the stores. Key i expires after 1 + i % spread steps.
+  std::vector<store> stores;
+  data value = std::string(64, 'x');
+  for (size_t s = 0; s < num_stores; ++s) {
+    auto st = ep.attach_master("replay-" + std::to_string(s), memory);
+    if (!st) {
+      std::cerr << "failed to attach master: " << to_string(st.error())
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < num_keys; ++i)
+      st->put(count{i}, value, step * static_cast<int64_t>(1 + i % spread));
+    stores.emplace_back(std::move(*st));
+  }
+  // Wait until all puts arrived, i.e., all expiries are pending.
+  for (auto& st : stores)
+    while (!st.get(count{num_keys - 1}))
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  // Replay.
+  detail::hdr_histogram latency;
+  auto start = clock_type::now();
+  for (size_t i = 0; i < num_steps; ++i) {
+    t += step;
+    auto t0 = clock_type::now();
+    ep.advance_time(t);
+    auto t1 = clock_type::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0);
+    latency.record(static_cast<uint64_t>(ns.count()));
+  }
+  auto secs = std::chrono::duration<double>(clock_type::now() - start).count();
+  // Count the keys that survived, which should be none.
+  size_t remaining = 0;
+  for (auto& st : stores) {
+    auto keys = st.keys();
+    if (keys)
+      if (auto xs = caf::get_if<set>(&*keys))
+        remaining += xs->size();
+  }
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "steps\t" << num_steps << " in " << secs << "s ("
+            << static_cast<uint64_t>(num_steps / secs) << " steps/s)"
+            << std::endl;
+  std::cout << "expired\t" << num_stores * num_keys - remaining << " of "
+            << num_stores * num_keys << " keys" << std::endl;
+  std::cout << "advance_time\tp50=" << usecs(latency.percentile(50))
+            << "us p99=" << usecs(latency.percentile(99))
+            << "us max=" << usecs(latency.max()) << "us" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+#include <getopt.h>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "broker/backend.hh"
+#include "broker/backend_options.hh"
+#include "broker/config.hh"
+#include "broker/data.hh"
+#include "broker/endpoint.hh"
+#include "broker/store.hh"
+
+#include "broker/detail/filesystem.hh"
+
+// Measures how the write throughput of a master store scales with the number
+// of shards. For each shard count, the benchmark attaches a fresh master,
+// issues all puts through the store frontend, and waits until every shard has
+// processed its share by querying the keys of the store, which visits all
+// shards after their pending writes.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+size_t num_keys = 100000;
+size_t value_size = 64;
+std::string path = "/tmp/broker-shard-benchmark";
+std::string backend_name = "sqlite";
+
+struct option long_options[] = {
+  {"num-keys",   required_argument, 0, 'n'},
+  {"value-size", required_argument, 0, 's'},
+  {"path",       required_argument, 0, 'p'},
+  {"backend",    required_argument, 0, 'b'},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>] [<shards> ...]\n"
+    "\n"
+    "   --num-keys <n>             (default: 100000)\n"
+    "   --value-size <bytes>       (default: 64)\n"
+    "   --path <prefix>            (default: /tmp/broker-shard-benchmark)\n"
+    "   --backend <name>           memory|sqlite|rocksdb|append_log\n"
+    "                              (default: sqlite)\n"
+    "\n"
+    "Without arguments, the benchmark runs with 1, 2, 4, and 8 shards.\n"
+    "\n";
+  exit(1);
+}
+
+backend parse_backend(const std::string& name) {
+  if (name == "memory")
+    return memory;
+  if (name == "sqlite")
+    return sqlite;
+  if (name == "rocksdb")
+    return rocksdb;
+  if (name == "append_log")
+    return append_log;
+  usage();
+  return memory; // not reached
+}
+
+void remove_shards(size_t shards) {
+  for (size_t i = 0; i < shards; ++i) {
+    auto p = path + "." + std::to_string(i);
+    detail::remove_all(p);
+    detail::remove_all(p + "-wal");
+    detail::remove_all(p + "-shm");
+  }
+  detail::remove_all(path);
+}
+
+void run(backend type, size_t shards) {
+  remove_shards(shards);
+  endpoint ep;
+  backend_options opts;
+  if (type != memory)
+    opts["path"] = path;
+  if (shards > 1)
+    opts["shards"] = count{shards};
+  auto ds = ep.attach_master("benchmark", type, std::move(opts));
+  if (!ds) {
+    std::cerr << "cannot attach master: " << to_string(ds.error())
+              << std::endl;
+    exit(1);
+  }
+  data value = std::string(value_size, 'x');
+  auto t0 = clock_type::now();
+  for (size_t i = 0; i < num_keys; ++i)
+    ds->put(count{i}, value);
+  auto keys = ds->keys();
+  auto t1 = clock_type::now();
+  if (!keys) {
+    std::cerr << "cannot retrieve keys: " << to_string(keys.error())
+              << std::endl;
+    exit(1);
+  }
+  auto secs = std::chrono::duration<double>(t1 - t0).count();
+  std::cout << backend_name << '\t' << shards << '\t' << num_keys << '\t'
+            << secs << '\t' << static_cast<uint64_t>(num_keys / secs)
+            << " ops/s" << std::endl;
+  ep.shutdown();
+  remove_shards(shards);
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  int option_index = 0;
+  for (;;) {
+    auto c = getopt_long(argc, argv, "", long_options, &option_index);
+    if (c == -1)
+      break;
+    switch (c) {
+      case 'n':
+        num_keys = strtoull(optarg, nullptr, 10);
+        break;
+      case 's':
+        value_size = strtoull(optarg, nullptr, 10);
+        break;
+      case 'p':
+        path = optarg;
+        break;
+      case 'b':
+        backend_name = optarg;
+        break;
+      default:
+        usage();
+    }
+  }
+  auto type = parse_backend(backend_name);
+  std::vector<size_t> shard_counts;
+  for (auto i = optind; i < argc; ++i) {
+    auto n = strtoull(argv[i], nullptr, 10);
+    if (n == 0)
+      usage();
+    shard_counts.emplace_back(n);
+  }
+  if (shard_counts.empty())
+    shard_counts = {1, 2, 4, 8};
+  std::cout << "backend\tshards\tn\tseconds\trate" << std::endl;
+  for (auto n : shard_counts)
+    run(type, n);
+  return 0;
+}
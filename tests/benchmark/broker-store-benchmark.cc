@@ -0,0 +1,520 @@
+#include <getopt.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <caf/scoped_actor.hpp>
+
+#include "broker/atoms.hh"
+#include "broker/backend.hh"
+#include "broker/backend_options.hh"
+#include "broker/config.hh"
+#include "broker/configuration.hh"
+#include "broker/data.hh"
+#include "broker/endpoint.hh"
+#include "broker/store.hh"
+#include "broker/time.hh"
+
+#include "broker/detail/filesystem.hh"
+#include "broker/detail/hdr_histogram.hh"
+
+// Drives a master store and optionally a number of clones through the public
+// `store` API. The master and each clone run in their own endpoint within this
+// process, peered over TCP on the loopback interface or over Unix domain
+// sockets. The benchmark runs in four phases:
+//
+//   1. prefill: put --keys keys into the master
+//   2. attach:  attach each clone and wait until it has the full snapshot
+//   3. run:     --threads workers each issue --ops operations from --mix
+//   4. lag:     write a marker to the master and wait until each clone sees it
+//
+// Workers operate on the master by default or round-robin on the clones with
+// --target=clones. Operations that only send a command (put, increment,
+// insert_into, expire) measure the time to hand off the command, while
+// get, exists and put_unique measure the full round trip. "expire" is a put
+// with a short expiry, which makes the master expire keys during the run.
+// With --coalesce, the master merges updates for clones and the benchmark
+// reports how many commands it merged into how many updates. Likewise,
+// --clone-coalesce makes clones merge local mutations before sending them to
+// the master.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+enum op_type {
+  op_put,
+  op_get,
+  op_exists,
+  op_increment,
+  op_insert_into,
+  op_put_unique,
+  op_expire,
+  num_op_types
+};
+
+const char* op_names[] = {
+  "put", "get", "exists", "increment", "insert_into", "put_unique", "expire",
+};
+
+std::string backend_name = "memory";
+std::string path = "/tmp/broker-store-benchmark";
+std::string transport = "tcp";
+std::string target = "master";
+std::string distribution = "uniform";
+std::string mix = "put=30,get=50,exists=10,increment=5,insert_into=5";
+double zipf_exponent = 0.99;
+size_t num_clones = 0;
+size_t num_keys = 10000;
+size_t value_size = 64;
+size_t num_threads = 1;
+uint64_t num_ops = 100000;
+double timeout_secs = 30;
+uint64_t coalesce_ms = 0;
+uint64_t clone_coalesce_ms = 0;
+
+struct option long_options[] = {
+  {"backend",      required_argument, 0, 'b'},
+  {"path",         required_argument, 0, 'p'},
+  {"clones",       required_argument, 0, 'c'},
+  {"transport",    required_argument, 0, 'T'},
+  {"target",       required_argument, 0, 't'},
+  {"mix",          required_argument, 0, 'm'},
+  {"distribution", required_argument, 0, 'd'},
+  {"zipf",         required_argument, 0, 'z'},
+  {"keys",         required_argument, 0, 'k'},
+  {"value-size",   required_argument, 0, 's'},
+  {"threads",      required_argument, 0, 'j'},
+  {"ops",          required_argument, 0, 'n'},
+  {"timeout",      required_argument, 0, 'o'},
+  {"coalesce",     required_argument, 0, 'C'},
+  {"clone-coalesce", required_argument, 0, 'W'},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>]\n"
+    "\n"
+    "   --backend <memory|sqlite|rocksdb>  master backend (default: memory)\n"
+    "   --path <prefix>            database path (default:\n"
+    "                              /tmp/broker-store-benchmark)\n"
+    "   --clones <n>               number of clones (default: 0)\n"
+    "   --transport <tcp|unix>     peering transport (default: tcp)\n"
+    "   --target <master|clones>   store handles used by the workers\n"
+    "                              (default: master)\n"
+    "   --mix <op>=<weight>,...    operation mix, ops are put, get, exists,\n"
+    "                              increment, insert_into, put_unique, and\n"
+    "                              expire (default:\n"
+    "                              put=30,get=50,exists=10,increment=5,\n"
+    "                              insert_into=5)\n"
+    "   --distribution <uniform|zipf>  key distribution (default: uniform)\n"
+    "   --zipf <s>                 exponent of the zipf distribution\n"
+    "                              (default: 0.99)\n"
+    "   --keys <n>                 size of the key space (default: 10000)\n"
+    "   --value-size <bytes>       (default: 64)\n"
+    "   --threads <n>              concurrent workers (default: 1)\n"
+    "   --ops <n>                  operations per worker (default: 100000)\n"
+    "   --timeout <seconds>        max. wait for clones (default: 30)\n"
+    "   --coalesce <ms>            coalescing window of the master\n"
+    "                              (default: 0, i.e., disabled)\n"
+    "   --clone-coalesce <ms>      write coalescing window of the clones\n"
+    "                              (default: 0, i.e., disabled)\n"
+    "\n";
+  exit(1);
+}
+
+std::vector<double> parse_mix(const std::string& str) {
+  std::vector<double> result(num_op_types, 0.);
+  std::istringstream in{str};
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    auto eq = item.find('=');
+    if (eq == std::string::npos)
+      usage();
+    auto name = item.substr(0, eq);
+    auto i = std::find_if(std::begin(op_names), std::end(op_names),
+                          [&](const char* x) { return name == x; });
+    if (i == std::end(op_names)) {
+      std::cerr << "unknown operation: " << name << std::endl;
+      usage();
+    }
+    result[i - std::begin(op_names)] = strtod(item.c_str() + eq + 1, nullptr);
+  }
+  return result;
+}
+
+// -- key distributions --------------------------------------------------------
+
+/// Draws key indexes from [0, n) either uniformly or following a zipf
+/// distribution, in which the i-th most popular key has a weight of
+/// 1 / (i + 1)^s.
+class key_generator {
+public:
+  key_generator(size_t n, bool zipf, uint32_t seed)
+    : uniform_(0, n - 1),
+      rng_(seed) {
+    if (!zipf)
+      return;
+    cdf_.resize(n);
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sum += 1. / std::pow(static_cast<double>(i + 1), zipf_exponent);
+      cdf_[i] = sum;
+    }
+    for (auto& x : cdf_)
+      x /= sum;
+  }
+
+  size_t operator()() {
+    if (cdf_.empty())
+      return uniform_(rng_);
+    auto x = std::generate_canonical<double, 32>(rng_);
+    auto i = std::lower_bound(cdf_.begin(), cdf_.end(), x);
+    return std::min(static_cast<size_t>(i - cdf_.begin()), cdf_.size() - 1);
+  }
+
+private:
+  std::uniform_int_distribution<size_t> uniform_;
+  std::vector<double> cdf_;
+  std::minstd_rand rng_;
+};
+
+data key_of(const char* prefix, size_t i) {
+  return prefix + std::to_string(i);
+}
+
+// -- setup --------------------------------------------------------------------
+
+backend parse_backend(const std::string& str) {
+  if (str == "memory")
+    return memory;
+  if (str == "sqlite")
+    return sqlite;
+  if (str == "rocksdb")
+    return rocksdb;
+  std::cerr << "invalid backend: " << str << std::endl;
+  usage();
+  return memory;
+}
+
+/// Connects `ep` to the master endpoint, which listens at `port` or at the
+/// Unix domain socket `unix_path`.
+void connect(endpoint& ep, uint16_t port, const std::string& unix_path) {
+  auto ok = transport == "unix" ? ep.peer_unix(unix_path)
+                                : ep.peer("127.0.0.1", port);
+  if (!ok) {
+    std::cerr << "failed to peer with the master endpoint" << std::endl;
+    exit(1);
+  }
+}
+
+/// Polls `pred` until it returns true or the timeout expires.
+/// @returns the elapsed time in seconds or a negative value on timeout.
+template <class Predicate>
+double wait_for(Predicate pred) {
+  auto t0 = clock_type::now();
+  auto timeout = std::chrono::duration<double>(timeout_secs);
+  while (!pred()) {
+    if (clock_type::now() - t0 > timeout)
+      return -1;
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  return std::chrono::duration<double>(clock_type::now() - t0).count();
+}
+
+// -- workload -----------------------------------------------------------------
+
+struct worker_result {
+  worker_result() : latency(num_op_types), errors(0) {
+    // nop
+  }
+
+  std::vector<detail::hdr_histogram> latency;
+  uint64_t errors;
+};
+
+void run_worker(const store& st, const std::vector<double>& weights,
+                uint32_t seed, worker_result& result) {
+  key_generator next_key{num_keys, distribution == "zipf", seed};
+  std::minstd_rand rng{seed};
+  std::discrete_distribution<int> next_op{weights.begin(), weights.end()};
+  data value = std::string(value_size, 'x');
+  auto expiry = timespan{std::chrono::milliseconds(10)};
+  for (uint64_t i = 0; i < num_ops; ++i) {
+    auto op = next_op(rng);
+    auto k = next_key();
+    auto t0 = clock_type::now();
+    switch (op) {
+      case op_put:
+        st.put(key_of("k", k), value);
+        break;
+      case op_get:
+        if (!st.get(key_of("k", k)))
+          ++result.errors;
+        break;
+      case op_exists:
+        if (!st.exists(key_of("k", k)))
+          ++result.errors;
+        break;
+      case op_increment:
+        st.increment(key_of("c", k), count{1});
+        break;
+      case op_insert_into:
+        st.insert_into(key_of("s", k), count{i});
+        break;
+      case op_put_unique:
+        if (!st.put_unique(key_of("u", i), value))
+          ++result.errors;
+        break;
+      case op_expire:
+        st.put(key_of("e", k), value, expiry);
+        break;
+    }
+    auto t1 = clock_type::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0);
+    result.latency[op].record(static_cast<uint64_t>(ns.count()));
+  }
+}
+
+// -- reporting ----------------------------------------------------------------
+
+double usecs(uint64_t ns) {
+  return static_cast<double>(ns) / 1000.;
+}
+
+void print_secs(const char* what, double secs) {
+  std::cout << what << '\t';
+  if (secs < 0)
+    std::cout << "timeout";
+  else
+    std::cout << secs << "s";
+  std::cout << std::endl;
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  int option_index = 0;
+  for (;;) {
+    auto c = getopt_long(argc, argv, "", long_options, &option_index);
+    if (c == -1)
+      break;
+    switch (c) {
+      case 'b':
+        backend_name = optarg;
+        break;
+      case 'p':
+        path = optarg;
+        break;
+      case 'c':
+        num_clones = strtoull(optarg, nullptr, 10);
+        break;
+      case 'T':
+        transport = optarg;
+        break;
+      case 't':
+        target = optarg;
+        break;
+      case 'm':
+        mix = optarg;
+        break;
+      case 'd':
+        distribution = optarg;
+        break;
+      case 'z':
+        zipf_exponent = strtod(optarg, nullptr);
+        break;
+      case 'k':
+        num_keys = strtoull(optarg, nullptr, 10);
+        break;
+      case 's':
+        value_size = strtoull(optarg, nullptr, 10);
+        break;
+      case 'j':
+        num_threads = strtoull(optarg, nullptr, 10);
+        break;
+      case 'n':
+        num_ops = strtoull(optarg, nullptr, 10);
+        break;
+      case 'o':
+        timeout_secs = strtod(optarg, nullptr);
+        break;
+      case 'C':
+        coalesce_ms = strtoull(optarg, nullptr, 10);
+        break;
+      case 'W':
+        clone_coalesce_ms = strtoull(optarg, nullptr, 10);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc || num_keys == 0 || num_threads == 0)
+    usage();
+  if (transport != "tcp" && transport != "unix")
+    usage();
+  if (distribution != "uniform" && distribution != "zipf")
+    usage();
+  if (target != "master" && (target != "clones" || num_clones == 0))
+    usage();
+  auto weights = parse_mix(mix);
+  auto type = parse_backend(backend_name);
+  std::cout << std::fixed << std::setprecision(3);
+  // Start the master.
+  auto db_path = path + "." + backend_name;
+  auto unix_path = path + ".sock";
+  detail::remove_all(db_path);
+  detail::remove_all(unix_path);
+  endpoint master_ep;
+  uint16_t port = 0;
+  if (transport == "unix") {
+    if (!master_ep.listen_unix(unix_path)) {
+      std::cerr << "failed to listen at " << unix_path << std::endl;
+      return EXIT_FAILURE;
+    }
+  } else if ((port = master_ep.listen("127.0.0.1", 0)) == 0) {
+    std::cerr << "failed to listen" << std::endl;
+    return EXIT_FAILURE;
+  }
+  backend_options opts;
+  opts["path"] = db_path;
+  if (coalesce_ms > 0)
+    opts["coalesce"] = timespan{std::chrono::milliseconds(coalesce_ms)};
+  auto master = master_ep.attach_master("benchmark", type, std::move(opts));
+  if (!master) {
+    std::cerr << "failed to attach master: " << to_string(master.error())
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  // Phase 1: prefill.
+  data value = std::string(value_size, 'x');
+  auto last_key = key_of("k", num_keys - 1);
+  auto t0 = clock_type::now();
+  for (size_t i = 0; i < num_keys; ++i)
+    master->put(key_of("k", i), value);
+  auto prefill_secs = wait_for([&] {
+    return static_cast<bool>(master->get(last_key));
+  });
+  if (prefill_secs >= 0)
+    prefill_secs
+      = std::chrono::duration<double>(clock_type::now() - t0).count();
+  std::cout << "backend\t" << backend_name << std::endl;
+  print_secs("prefill", prefill_secs);
+  // Phase 2: attach clones to the populated master.
+  std::vector<std::unique_ptr<endpoint>> clone_eps;
+  std::vector<store> clones;
+  for (size_t i = 0; i < num_clones; ++i) {
+    clone_eps.emplace_back(new endpoint);
+    auto& ep = *clone_eps.back();
+    connect(ep, port, unix_path);
+    auto attach_start = clock_type::now();
+    auto c = ep.attach_clone("benchmark", 10.0, 300.0, 120.0,
+                             clone_coalesce_ms / 1000.);
+    if (!c) {
+      std::cerr << "failed to attach clone: " << to_string(c.error())
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto secs = wait_for([&] { return static_cast<bool>(c->get(last_key)); });
+    if (secs >= 0)
+      secs = std::chrono::duration<double>(clock_type::now()
+                                           - attach_start).count();
+    auto label = "attach-clone-" + std::to_string(i);
+    print_secs(label.c_str(), secs);
+    clones.emplace_back(std::move(*c));
+  }
+  // Phase 3: run the workload.
+  std::vector<worker_result> results(num_threads);
+  std::vector<std::thread> workers;
+  auto run_start = clock_type::now();
+  for (size_t i = 0; i < num_threads; ++i) {
+    auto& st = target == "master" ? *master : clones[i % clones.size()];
+    workers.emplace_back([&, i] {
+      run_worker(st, weights, static_cast<uint32_t>(i + 1), results[i]);
+    });
+  }
+  for (auto& t : workers)
+    t.join();
+  auto run_secs
+    = std::chrono::duration<double>(clock_type::now() - run_start).count();
+  worker_result total;
+  for (auto& r : results) {
+    total.errors += r.errors;
+    for (size_t op = 0; op < num_op_types; ++op)
+      total.latency[op].merge(r.latency[op]);
+  }
+  auto total_ops = num_threads * num_ops;
+  std::cout << "ops\t" << total_ops << " in " << run_secs << "s ("
+            << static_cast<uint64_t>(total_ops / run_secs) << " ops/s, "
+            << total.errors << " errors)" << std::endl;
+  std::cout << std::endl
+            << "op\tn\tops/s\tp50\tp99\tp99.9\tmax (latencies in us)"
+            << std::endl;
+  for (size_t op = 0; op < num_op_types; ++op) {
+    auto& h = total.latency[op];
+    if (h.count() == 0)
+      continue;
+    std::cout << op_names[op] << '\t' << h.count() << '\t'
+              << static_cast<uint64_t>(h.count() / run_secs) << '\t'
+              << usecs(h.percentile(50)) << '\t'
+              << usecs(h.percentile(99)) << '\t'
+              << usecs(h.percentile(99.9)) << '\t' << usecs(h.max())
+              << std::endl;
+  }
+  // Phase 4: measure how far the clones lag behind the master. The master
+  // processes commands in order, so the marker becomes visible at a clone
+  // only after all preceding updates.
+  if (!clones.empty()) {
+    std::cout << std::endl;
+    data marker_key = "marker";
+    data marker_value = broker::now();
+    master->put(marker_key, marker_value);
+    for (size_t i = 0; i < clones.size(); ++i) {
+      auto secs = wait_for([&] {
+        auto x = clones[i].get(marker_key);
+        return x && *x == marker_value;
+      });
+      auto label = "lag-clone-" + std::to_string(i);
+      print_secs(label.c_str(), secs);
+    }
+  }
+  if (coalesce_ms > 0) {
+    caf::scoped_actor self{master_ep.system()};
+    self->request(master->frontend(), caf::infinite, atom::get::value,
+                  atom::coalesce::value).receive(
+      [&](count in, count out) {
+        auto ratio = in > 0 ? 1. - static_cast<double>(out) / in : 0.;
+        std::cout << "coalesce\t" << in << " commands into " << out
+                  << " updates (" << ratio * 100 << "% fewer)" << std::endl;
+      },
+      [&](caf::error& e) {
+        std::cerr << "failed to query coalescing: "
+                  << master_ep.system().render(e) << std::endl;
+      }
+    );
+  }
+  clones.clear();
+  clone_eps.clear();
+  detail::remove_all(db_path);
+  detail::remove_all(unix_path);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,615 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "broker/configuration.hh"
+#include "broker/data.hh"
+#include "broker/endpoint.hh"
+#include "broker/publisher.hh"
+#include "broker/store.hh"
+#include "broker/subscriber.hh"
+#include "broker/time.hh"
+#include "broker/topic.hh"
+
+#include "broker/detail/hdr_histogram.hh"
+
+// Instantiates several endpoints in a single process, peers them according to
+// a configurable topology, and measures how messages travel through it:
+//
+//   - chain: node i peers with node i + 1
+//   - star:  node 0 is the hub, all other nodes peer with it
+//   - mesh:  every node peers with every other node
+//   - tree:  node i peers with its parent (i - 1) / fanout
+//
+// Publisher and subscriber nodes are given as lists of node indices. Every
+// node forwards the benchmark topic, so nodes without a subscriber still relay
+// messages. Publishers first send probes until each subscriber has seen one
+// from each publisher, which makes sure that all subscriptions propagated
+// through the topology before the measurement starts.
+//
+// The benchmark reports end-to-end throughput, duplicate and lost deliveries,
+// latency grouped by the hop distance between publisher and subscriber, and
+// the CPU time of each endpoint. On Linux, the CPU time of an endpoint is the
+// sum over all threads that appeared while constructing it. Peerings use TCP
+// over the loopback interface.
+//
+// Optionally, the benchmark attaches a master store to one node and clones to
+// others. Each clone writes to the store while the publishers run and the
+// benchmark reports how long it takes until all writes are visible at every
+// store handle.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+using node_list = std::vector<size_t>;
+
+std::string topology = "chain";
+size_t num_nodes = 5;
+size_t fanout = 2;
+std::string publishers_arg = "0";
+std::string subscribers_arg = "last";
+std::string clones_arg;
+long master_node = -1;
+uint64_t num_messages = 100000;
+size_t payload_size = 64;
+uint64_t store_writes = 10000;
+size_t num_threads = 0;
+double timeout_secs = 5;
+
+const topic benchmark_topic = "benchmark/topology";
+
+const std::string store_name = "benchmark/topology-store";
+
+struct option long_options[] = {
+  {"topology",     required_argument, 0, 't'},
+  {"nodes",        required_argument, 0, 'n'},
+  {"fanout",       required_argument, 0, 'f'},
+  {"publishers",   required_argument, 0, 'p'},
+  {"subscribers",  required_argument, 0, 's'},
+  {"messages",     required_argument, 0, 'm'},
+  {"payload-size", required_argument, 0, 'P'},
+  {"master",       required_argument, 0, 'M'},
+  {"clones",       required_argument, 0, 'c'},
+  {"store-writes", required_argument, 0, 'w'},
+  {"threads",      required_argument, 0, 'T'},
+  {"timeout",      required_argument, 0, 'o'},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>]\n"
+    "\n"
+    "   --topology <chain|star|mesh|tree>  (default: chain)\n"
+    "   --nodes <n>                number of endpoints (default: 5)\n"
+    "   --fanout <n>               children per node in a tree (default: 2)\n"
+    "   --publishers <nodes>       publishing nodes (default: 0)\n"
+    "   --subscribers <nodes>      subscribing nodes (default: last)\n"
+    "   --messages <n>             messages per publisher (default: 100000)\n"
+    "   --payload-size <bytes>     (default: 64)\n"
+    "   --master <node>            attach a master store to this node\n"
+    "   --clones <nodes>           attach clones of the master to these nodes\n"
+    "   --store-writes <n>         writes per clone (default: 10000)\n"
+    "   --threads <n>              scheduler threads per endpoint\n"
+    "                              (default: CAF default)\n"
+    "   --timeout <seconds>        wait for stragglers (default: 5)\n"
+    "\n"
+    "<nodes> is a comma-separated list of node indices or one of 'all',\n"
+    "'last', and 'none'.\n"
+    "\n";
+  exit(1);
+}
+
+node_list parse_nodes(const std::string& str) {
+  node_list result;
+  if (str == "none" || str.empty())
+    return result;
+  if (str == "all") {
+    for (size_t i = 0; i < num_nodes; ++i)
+      result.push_back(i);
+    return result;
+  }
+  std::istringstream in{str};
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    auto i = item == "last" ? num_nodes - 1
+                            : strtoull(item.c_str(), nullptr, 10);
+    if (i >= num_nodes) {
+      std::cerr << "invalid node index: " << item << std::endl;
+      usage();
+    }
+    result.push_back(i);
+  }
+  return result;
+}
+
+// -- per-thread CPU accounting ------------------------------------------------
+
+std::vector<pid_t> list_threads() {
+  std::vector<pid_t> result;
+  auto dir = opendir("/proc/self/task");
+  if (!dir)
+    return result;
+  while (auto entry = readdir(dir))
+    if (entry->d_name[0] != '.')
+      result.push_back(static_cast<pid_t>(atoi(entry->d_name)));
+  closedir(dir);
+  return result;
+}
+
+// Returns user plus system time of a thread in seconds or 0 if the thread is
+// gone or the platform does not provide /proc.
+double thread_cpu_time(pid_t tid) {
+  std::ifstream in{"/proc/self/task/" + std::to_string(tid) + "/stat"};
+  std::string line;
+  if (!std::getline(in, line))
+    return 0;
+  // The thread name may contain spaces, so we start after its closing paren.
+  auto pos = line.rfind(')');
+  if (pos == std::string::npos)
+    return 0;
+  std::istringstream fields{line.substr(pos + 2)};
+  std::string field;
+  uint64_t utime = 0;
+  uint64_t stime = 0;
+  // Fields 14 and 15 of stat(5), counting from the state as field 3.
+  for (int i = 3; i <= 15 && fields >> field; ++i) {
+    if (i == 14)
+      utime = strtoull(field.c_str(), nullptr, 10);
+    else if (i == 15)
+      stime = strtoull(field.c_str(), nullptr, 10);
+  }
+  return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+// -- topology -----------------------------------------------------------------
+
+struct node {
+  std::unique_ptr<endpoint> ep;
+  uint16_t port = 0;
+  std::vector<pid_t> threads;
+  node_list neighbors;
+  std::string role;
+
+  double cpu_time() const {
+    double result = 0;
+    for (auto tid : threads)
+      result += thread_cpu_time(tid);
+    return result;
+  }
+};
+
+std::vector<std::pair<size_t, size_t>> make_links() {
+  std::vector<std::pair<size_t, size_t>> result;
+  if (topology == "chain") {
+    for (size_t i = 1; i < num_nodes; ++i)
+      result.emplace_back(i - 1, i);
+  } else if (topology == "star") {
+    for (size_t i = 1; i < num_nodes; ++i)
+      result.emplace_back(0, i);
+  } else if (topology == "mesh") {
+    for (size_t i = 0; i < num_nodes; ++i)
+      for (size_t j = i + 1; j < num_nodes; ++j)
+        result.emplace_back(i, j);
+  } else if (topology == "tree") {
+    for (size_t i = 1; i < num_nodes; ++i)
+      result.emplace_back((i - 1) / fanout, i);
+  } else {
+    std::cerr << "invalid topology: " << topology << std::endl;
+    usage();
+  }
+  return result;
+}
+
+// Computes the hop distance from `src` to all other nodes.
+std::vector<size_t> distances(const std::vector<node>& nodes, size_t src) {
+  std::vector<size_t> result(nodes.size(), SIZE_MAX);
+  std::deque<size_t> pending{src};
+  result[src] = 0;
+  while (!pending.empty()) {
+    auto i = pending.front();
+    pending.pop_front();
+    for (auto j : nodes[i].neighbors)
+      if (result[j] == SIZE_MAX) {
+        result[j] = result[i] + 1;
+        pending.push_back(j);
+      }
+  }
+  return result;
+}
+
+std::vector<node> make_nodes() {
+  std::vector<node> result(num_nodes);
+  for (auto& n : result) {
+    auto before = list_threads();
+    configuration cfg;
+    if (num_threads > 0)
+      cfg.scheduler_max_threads = num_threads;
+    n.ep.reset(new endpoint(std::move(cfg)));
+    n.port = n.ep->listen("127.0.0.1", 0);
+    if (n.port == 0) {
+      std::cerr << "failed to listen" << std::endl;
+      exit(1);
+    }
+    n.ep->forward({benchmark_topic, store_name});
+    for (auto tid : list_threads())
+      if (std::find(before.begin(), before.end(), tid) == before.end())
+        n.threads.push_back(tid);
+  }
+  for (auto& link : make_links()) {
+    auto& x = result[link.first];
+    auto& y = result[link.second];
+    if (!y.ep->peer("127.0.0.1", x.port)) {
+      std::cerr << "failed to peer node " << link.second << " with node "
+                << link.first << std::endl;
+      exit(1);
+    }
+    x.neighbors.push_back(link.second);
+    y.neighbors.push_back(link.first);
+  }
+  return result;
+}
+
+// -- messages -----------------------------------------------------------------
+
+// Messages are vectors of the form [kind, publisher, sequence number, send
+// time, payload]. Probes only announce a publisher and carry no payload.
+enum message_kind : count {
+  probe_msg,
+  data_msg,
+};
+
+data make_msg(message_kind kind, size_t pub, uint64_t seq,
+              const std::string& payload) {
+  return vector{count{kind}, count{pub}, count{seq}, broker::now(), payload};
+}
+
+// -- subscribers --------------------------------------------------------------
+
+struct subscriber_state {
+  size_t node_id;
+  std::vector<size_t> hops; // Distance to each publisher.
+  std::vector<std::vector<bool>> seen;
+  std::unique_ptr<std::atomic<bool>[]> ready;
+  std::map<size_t, detail::hdr_histogram> latency;
+  uint64_t unique = 0;
+  uint64_t duplicates = 0;
+  clock_type::time_point last_receive;
+};
+
+void run_subscriber(subscriber& sub, subscriber_state& st,
+                    const std::atomic<bool>& publishers_done) {
+  auto expected = st.seen.size() * num_messages;
+  auto idle_since = clock_type::now();
+  auto handle = [&](const data& msg) {
+    auto xs = caf::get_if<vector>(&msg);
+    if (!xs || xs->size() != 5)
+      return;
+    auto kind = caf::get<count>((*xs)[0]);
+    auto pub = caf::get<count>((*xs)[1]);
+    if (kind == probe_msg) {
+      st.ready[pub] = true;
+      return;
+    }
+    auto seq = caf::get<count>((*xs)[2]);
+    auto sent = caf::get<timestamp>((*xs)[3]);
+    if (st.seen[pub][seq]) {
+      ++st.duplicates;
+      return;
+    }
+    st.seen[pub][seq] = true;
+    ++st.unique;
+    auto latency = std::chrono::duration_cast<timespan>(broker::now() - sent);
+    st.latency[st.hops[pub]].record(static_cast<uint64_t>(latency.count()));
+    st.last_receive = clock_type::now();
+  };
+  auto timeout = std::chrono::duration<double>(timeout_secs);
+  while (st.unique < expected) {
+    auto xs = sub.poll();
+    if (xs.empty()) {
+      auto x = sub.get(caf::duration{std::chrono::milliseconds(50)});
+      if (x)
+        xs.emplace_back(std::move(*x));
+    }
+    if (!xs.empty()) {
+      idle_since = clock_type::now();
+      for (auto& x : xs)
+        handle(x.second);
+    } else if (publishers_done && clock_type::now() - idle_since > timeout) {
+      return;
+    }
+  }
+}
+
+// -- stores -------------------------------------------------------------------
+
+struct store_result {
+  uint64_t writes = 0;
+  double write_secs = 0;
+  double sync_secs = 0;
+  bool synced = false;
+};
+
+// Writes from every clone concurrently and then waits until each store handle
+// sees the last key of every writer.
+store_result run_store_writers(std::vector<store>& clones,
+                               std::vector<store>& all_handles) {
+  store_result result;
+  auto key = [](size_t writer, uint64_t i) {
+    return data{"w" + std::to_string(writer) + "-" + std::to_string(i)};
+  };
+  auto t0 = clock_type::now();
+  std::vector<std::thread> writers;
+  for (size_t w = 0; w < clones.size(); ++w)
+    writers.emplace_back([&, w] {
+      for (uint64_t i = 0; i < store_writes; ++i)
+        clones[w].put(key(w, i), count{i});
+    });
+  for (auto& t : writers)
+    t.join();
+  auto t1 = clock_type::now();
+  result.writes = clones.size() * store_writes;
+  result.write_secs = std::chrono::duration<double>(t1 - t0).count();
+  auto deadline = t1 + std::chrono::duration_cast<clock_type::duration>(
+    std::chrono::duration<double>(timeout_secs));
+  result.synced = true;
+  for (auto& handle : all_handles) {
+    for (size_t w = 0; w < clones.size(); ++w) {
+      while (!handle.get(key(w, store_writes - 1))) {
+        if (clock_type::now() > deadline) {
+          result.synced = false;
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+  result.sync_secs
+    = std::chrono::duration<double>(clock_type::now() - t1).count();
+  return result;
+}
+
+// -- reporting ----------------------------------------------------------------
+
+double usecs(uint64_t ns) {
+  return static_cast<double>(ns) / 1000.;
+}
+
+void print_latencies(const std::map<size_t, detail::hdr_histogram>& hs) {
+  std::cout << "hops\tn\tp50\tp99\tp99.9\tmax\tp50/hop (all in us)"
+            << std::endl;
+  for (auto& kvp : hs) {
+    auto& h = kvp.second;
+    auto hops = std::max(kvp.first, size_t{1});
+    std::cout << kvp.first << '\t' << h.count() << '\t'
+              << usecs(h.percentile(50)) << '\t'
+              << usecs(h.percentile(99)) << '\t'
+              << usecs(h.percentile(99.9)) << '\t' << usecs(h.max()) << '\t'
+              << usecs(h.percentile(50)) / hops << std::endl;
+  }
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  int option_index = 0;
+  for (;;) {
+    auto c = getopt_long(argc, argv, "", long_options, &option_index);
+    if (c == -1)
+      break;
+    switch (c) {
+      case 't':
+        topology = optarg;
+        break;
+      case 'n':
+        num_nodes = strtoull(optarg, nullptr, 10);
+        break;
+      case 'f':
+        fanout = strtoull(optarg, nullptr, 10);
+        break;
+      case 'p':
+        publishers_arg = optarg;
+        break;
+      case 's':
+        subscribers_arg = optarg;
+        break;
+      case 'm':
+        num_messages = strtoull(optarg, nullptr, 10);
+        break;
+      case 'P':
+        payload_size = strtoull(optarg, nullptr, 10);
+        break;
+      case 'M':
+        master_node = strtol(optarg, nullptr, 10);
+        break;
+      case 'c':
+        clones_arg = optarg;
+        break;
+      case 'w':
+        store_writes = strtoull(optarg, nullptr, 10);
+        break;
+      case 'T':
+        num_threads = strtoull(optarg, nullptr, 10);
+        break;
+      case 'o':
+        timeout_secs = strtod(optarg, nullptr);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind != argc || num_nodes == 0 || fanout == 0)
+    usage();
+  if (master_node >= static_cast<long>(num_nodes))
+    usage();
+  auto pubs = parse_nodes(publishers_arg);
+  auto subs = parse_nodes(subscribers_arg);
+  auto clone_nodes = parse_nodes(clones_arg);
+  if (pubs.empty() || subs.empty())
+    usage();
+  // Build the topology.
+  auto nodes = make_nodes();
+  for (auto i : pubs)
+    nodes[i].role += "pub ";
+  for (auto i : subs)
+    nodes[i].role += "sub ";
+  std::cout << "topology: " << topology << " with " << num_nodes
+            << " nodes" << std::endl;
+  // Attach stores.
+  std::vector<store> clones;
+  std::vector<store> store_handles;
+  if (master_node >= 0) {
+    auto& m = nodes[static_cast<size_t>(master_node)];
+    auto res = m.ep->attach_master(store_name, memory);
+    if (!res) {
+      std::cerr << "failed to attach master: " << to_string(res.error())
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    m.role += "master ";
+    store_handles.emplace_back(std::move(*res));
+    for (auto i : clone_nodes) {
+      if (static_cast<long>(i) == master_node)
+        continue;
+      auto c = nodes[i].ep->attach_clone(store_name);
+      if (!c) {
+        std::cerr << "failed to attach clone: " << to_string(c.error())
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      nodes[i].role += "clone ";
+      clones.emplace_back(*c);
+      store_handles.emplace_back(std::move(*c));
+    }
+  }
+  // Start subscribers.
+  std::atomic<bool> publishers_done{false};
+  std::vector<subscriber> subscribers;
+  std::vector<std::unique_ptr<subscriber_state>> states;
+  for (auto i : subs) {
+    subscribers.emplace_back(nodes[i].ep->make_subscriber({benchmark_topic}));
+    std::unique_ptr<subscriber_state> st{new subscriber_state};
+    st->node_id = i;
+    for (auto p : pubs)
+      st->hops.push_back(distances(nodes, p)[i]);
+    st->seen.resize(pubs.size(), std::vector<bool>(num_messages));
+    st->ready.reset(new std::atomic<bool>[pubs.size()]);
+    for (size_t p = 0; p < pubs.size(); ++p)
+      st->ready[p] = false;
+    states.emplace_back(std::move(st));
+  }
+  std::vector<std::thread> sub_threads;
+  for (size_t i = 0; i < subscribers.size(); ++i)
+    sub_threads.emplace_back([&, i] {
+      run_subscriber(subscribers[i], *states[i], publishers_done);
+    });
+  // Send probes until every subscriber has heard from every publisher.
+  auto all_ready = [&] {
+    for (auto& st : states)
+      for (size_t p = 0; p < pubs.size(); ++p)
+        if (!st->ready[p])
+          return false;
+    return true;
+  };
+  auto probe_deadline = clock_type::now() + std::chrono::seconds(30);
+  while (!all_ready()) {
+    if (clock_type::now() > probe_deadline) {
+      std::cerr << "subscriptions did not propagate" << std::endl;
+      return EXIT_FAILURE;
+    }
+    for (size_t p = 0; p < pubs.size(); ++p)
+      nodes[pubs[p]].ep->publish(benchmark_topic,
+                                 make_msg(probe_msg, p, 0, {}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  // Run publishers and store writers.
+  std::vector<double> cpu_before;
+  for (auto& n : nodes)
+    cpu_before.push_back(n.cpu_time());
+  std::string payload(payload_size, 'x');
+  auto t0 = clock_type::now();
+  std::vector<std::thread> pub_threads;
+  for (size_t p = 0; p < pubs.size(); ++p)
+    pub_threads.emplace_back([&, p] {
+      auto out = nodes[pubs[p]].ep->make_publisher(benchmark_topic);
+      for (uint64_t i = 0; i < num_messages; ++i)
+        out.publish(make_msg(data_msg, p, i, payload));
+    });
+  store_result sr;
+  if (!clones.empty())
+    sr = run_store_writers(clones, store_handles);
+  for (auto& t : pub_threads)
+    t.join();
+  auto t1 = clock_type::now();
+  publishers_done = true;
+  for (auto& t : sub_threads)
+    t.join();
+  // Report throughput.
+  auto published = pubs.size() * num_messages;
+  auto expected = subs.size() * published;
+  uint64_t delivered = 0;
+  uint64_t duplicates = 0;
+  auto t2 = t0;
+  std::map<size_t, detail::hdr_histogram> latency;
+  for (auto& st : states) {
+    delivered += st->unique;
+    duplicates += st->duplicates;
+    t2 = std::max(t2, st->last_receive);
+    for (auto& kvp : st->latency)
+      latency[kvp.first].merge(kvp.second);
+  }
+  auto pub_secs = std::chrono::duration<double>(t1 - t0).count();
+  auto total_secs = std::chrono::duration<double>(t2 - t0).count();
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "published: " << published << " msgs in " << pub_secs << "s ("
+            << published / pub_secs << " msgs/s)" << std::endl;
+  std::cout << "delivered: " << delivered << " of " << expected << " msgs in "
+            << total_secs << "s (" << delivered / total_secs << " msgs/s), "
+            << duplicates << " duplicates, " << expected - delivered
+            << " lost" << std::endl;
+  // Report latency.
+  std::cout << std::endl;
+  print_latencies(latency);
+  // Report CPU time.
+  std::cout << std::endl << "node\tthreads\tcpu-secs\tcpu-%\trole" << std::endl;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto secs = nodes[i].cpu_time() - cpu_before[i];
+    std::cout << i << '\t' << nodes[i].threads.size() << '\t' << secs << '\t'
+              << 100. * secs / total_secs << '\t' << nodes[i].role
+              << std::endl;
+  }
+  // Report store synchronization.
+  if (!clones.empty()) {
+    std::cout << std::endl << "store: " << sr.writes << " writes in "
+              << sr.write_secs << "s, ";
+    if (sr.synced)
+      std::cout << "all handles in sync after " << sr.sync_secs << "s";
+    else
+      std::cout << "handles not in sync after " << sr.sync_secs << "s";
+    std::cout << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "broker/configuration.hh"
+#include "broker/data.hh"
+#include "broker/endpoint.hh"
+#include "broker/subscriber.hh"
+#include "broker/topic.hh"
+
+// Compares transports between two processes on the same host. The parent
+// process publishes messages and the child process receives them. The
+// "tcp" and "ssl" modes peer two endpoints over loopback and the "unix" mode
+// peers them over a Unix domain socket. Broker has no shared memory
+// transport, so the Unix domain socket is the fastest same-host path.
+
+using namespace broker;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+size_t num_messages = 1000000;
+size_t payload_size = 64;
+uint16_t port = 9999;
+std::string socket_path;
+
+struct option long_options[] = {
+  {"num-messages", required_argument, 0, 'n'},
+  {"payload-size", required_argument, 0, 's'},
+  {"port",         required_argument, 0, 'p'},
+  {0, 0, 0, 0}
+};
+
+const char* prog = 0;
+
+void usage() {
+  std::cerr <<
+    "Usage: " << prog << " [<options>] [<mode> ...]\n"
+    "\n"
+    "   --num-messages <n>         (default: 1000000)\n"
+    "   --payload-size <bytes>     (default: 64)\n"
+    "   --port <port>              (default: 9999)\n"
+    "\n"
+    "Modes are tcp, ssl, and unix. Without arguments, the benchmark runs all\n"
+    "modes.\n"
+    "\n";
+  exit(1);
+}
+
+using value_type = std::pair<topic, data>;
+
+value_type make_message() {
+  return {"/benchmark/transport", std::string(payload_size, 'x')};
+}
+
+void report(const std::string& mode, clock_type::duration elapsed) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  auto us = duration_cast<microseconds>(elapsed).count();
+  auto secs = us / 1e6;
+  std::cout << mode << ": " << num_messages << " messages in " << secs
+            << "s, " << (num_messages / secs) << " msgs/s, "
+            << (num_messages * payload_size / secs / (1024 * 1024))
+            << " MB/s payload" << std::endl;
+}
+
+// -- peering ------------------------------------------------------------------
+
+int run_peering_receiver(const std::string& mode, int ready_fd) {
+  broker_options opts;
+  opts.disable_ssl = mode != "ssl";
+  endpoint ep{configuration{opts}};
+  auto sub = ep.make_subscriber({"/benchmark"}, 10000);
+  if (mode == "unix") {
+    if (!ep.listen_unix(socket_path)) {
+      std::cerr << "cannot listen on " << socket_path << std::endl;
+      return 1;
+    }
+  } else if (ep.listen("127.0.0.1", port) == 0) {
+    std::cerr << "cannot listen on port " << port << std::endl;
+    return 1;
+  }
+  char c = 1;
+  if (::write(ready_fd, &c, 1) != 1)
+    return 1;
+  sub.get();
+  auto t0 = clock_type::now();
+  size_t received = 1;
+  while (received < num_messages)
+    received += sub.get(num_messages - received).size();
+  report(mode, clock_type::now() - t0);
+  return 0;
+}
+
+int run_peering_sender(const std::string& mode) {
+  broker_options opts;
+  opts.disable_ssl = mode != "ssl";
+  endpoint ep{configuration{opts}};
+  auto ok = mode == "unix" ? ep.peer_unix(socket_path)
+                           : ep.peer("127.0.0.1", port);
+  if (!ok) {
+    std::cerr << "cannot peer with receiver" << std::endl;
+    return 1;
+  }
+  // Give the subscription time to propagate.
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  auto msg = make_message();
+  for (size_t i = 0; i < num_messages; ++i)
+    ep.publish(msg.first, msg.second);
+  return 0;
+}
+
+// -- driver -------------------------------------------------------------------
+
+int run(const std::string& mode) {
+  int fds[2];
+  if (::pipe(fds) != 0) {
+    std::cerr << "cannot create pipe" << std::endl;
+    return 1;
+  }
+  socket_path = "/tmp/broker-transport-benchmark-"
+                + std::to_string(::getpid()) + ".sock";
+  auto pid = ::fork();
+  if (pid == -1) {
+    std::cerr << "cannot fork" << std::endl;
+    return 1;
+  }
+  if (pid == 0) {
+    ::close(fds[0]);
+    exit(run_peering_receiver(mode, fds[1]));
+  }
+  ::close(fds[1]);
+  char c;
+  if (::read(fds[0], &c, 1) != 1) {
+    std::cerr << "receiver failed to start" << std::endl;
+    return 1;
+  }
+  ::close(fds[0]);
+  auto result = run_peering_sender(mode);
+  int status;
+  ::waitpid(pid, &status, 0);
+  return result;
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  prog = argv[0];
+  for (;;) {
+    int c = getopt_long(argc, argv, "", long_options, nullptr);
+    if (c < 0)
+      break;
+    switch (c) {
+      case 'n':
+        num_messages = std::strtoull(optarg, nullptr, 10);
+        break;
+      case 's':
+        payload_size = std::strtoull(optarg, nullptr, 10);
+        break;
+      case 'p':
+        port = static_cast<uint16_t>(std::strtoul(optarg, nullptr, 10));
+        break;
+      default:
+        usage();
+    }
+  }
+  std::vector<std::string> modes;
+  for (auto i = optind; i < argc; ++i)
+    modes.emplace_back(argv[i]);
+  if (modes.empty())
+    modes = {"tcp", "ssl", "unix"};
+  for (auto& mode : modes) {
+    if (mode != "tcp" && mode != "ssl" && mode != "unix")
+      usage();
+    if (run(mode) != 0)
+      return 1;
+  }
+  return 0;
+}
@@ -1,5 +1,7 @@
 #include <cstdint>
 #include <algorithm>
+#include <fstream>
+#include <iterator>
 #include <utility>
 #include <chrono>
 #include <functional>
@@ -15,6 +17,7 @@
 #include "broker/data.hh"
 #include "broker/detail/assert.hh"
 #include "broker/detail/abstract_backend.hh"
+#include "broker/detail/append_log_backend.hh"
 #include "broker/detail/memory_backend.hh"
 #include "broker/detail/rocksdb_backend.hh"
 #include "broker/detail/sqlite_backend.hh"
@@ -57,6 +60,10 @@ public:
     detail::remove_all(path);
     backends_.push_back(detail::make_backend(rocksdb, opts));
 #endif
+    path = base + ".log";
+    paths_.push_back(path);
+    detail::remove_all(path);
+    backends_.push_back(detail::make_backend(append_log, opts));
   }
 
   ~meta_backend() {
@@ -346,4 +353,215 @@ TEST(size/snapshot) {
   CHECK_EQUAL(ss->count("foo"), 1u);
 }
 
+TEST(containers) {
+  MESSAGE("set");
+  auto put = backend->put("s", set{1, 2});
+  REQUIRE(put);
+  auto add = backend->add("s", 3, data::type::set);
+  REQUIRE(add);
+  add = backend->add("s", 1, data::type::set);
+  REQUIRE(add);
+  auto remove = backend->subtract("s", 2);
+  REQUIRE(remove);
+  auto get = backend->get("s");
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data(set{1, 3}));
+  get = backend->get("s", 3);
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data{true});
+  get = backend->get("s", 2);
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data{false});
+  MESSAGE("table");
+  add = backend->add("t", vector{"foo", 1}, data::type::table);
+  REQUIRE(add);
+  add = backend->add("t", vector{"bar", 2}, data::type::table);
+  REQUIRE(add);
+  add = backend->add("t", vector{"foo", 3}, data::type::table);
+  REQUIRE(add);
+  add = backend->add("t", "baz", data::type::table);
+  REQUIRE(!add);
+  CHECK_EQUAL(add, ec::type_clash);
+  get = backend->get("t");
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data(table{{"foo", 3}, {"bar", 2}}));
+  get = backend->get("t", "foo");
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data{3});
+  get = backend->get("t", "baz");
+  REQUIRE(!get);
+  CHECK_EQUAL(get.error(), ec::no_such_key);
+  MESSAGE("vector");
+  put = backend->put("v", vector{1, 2});
+  REQUIRE(put);
+  add = backend->add("v", 3, data::type::vector);
+  REQUIRE(add);
+  get = backend->get("v", count{2});
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data{3});
+  remove = backend->subtract("v", 0);
+  REQUIRE(remove);
+  get = backend->get("v");
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data(vector{1, 2}));
+  get = backend->get("v", count{2});
+  REQUIRE(!get);
+  CHECK_EQUAL(get.error(), ec::no_such_key);
+  MESSAGE("overwrite with a smaller container");
+  put = backend->put("v", vector{4});
+  REQUIRE(put);
+  get = backend->get("v");
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data(vector{4}));
+  auto ss = backend->snapshot();
+  REQUIRE(ss);
+  CHECK_EQUAL(ss->size(), 3u);
+  CHECK_EQUAL((*ss)["v"], data(vector{4}));
+  MESSAGE("erase");
+  auto erase = backend->erase("s");
+  REQUIRE(erase);
+  put = backend->put("s", set{});
+  REQUIRE(put);
+  get = backend->get("s");
+  REQUIRE(get);
+  CHECK_EQUAL(*get, data(set{}));
+}
+
+FIXTURE_SCOPE_END()
+
+namespace {
+
+struct append_log_fixture {
+  static constexpr char dirname[] = "/tmp/broker-unit-test-append-log";
+
+  append_log_fixture() {
+    detail::remove_all(dirname);
+  }
+
+  ~append_log_fixture() {
+    detail::remove_all(dirname);
+  }
+
+  std::unique_ptr<detail::append_log_backend> open() {
+    auto opts = backend_options{{"path", dirname},
+                                {"sync-interval", timespan{0}}};
+    return std::make_unique<detail::append_log_backend>(std::move(opts));
+  }
+
+  std::string log_file() const {
+    return std::string{dirname} + "/log";
+  }
+
+  std::string index_file() const {
+    return std::string{dirname} + "/index";
+  }
+};
+
+constexpr char append_log_fixture::dirname[];
+
+} // namespace <anonymous>
+
+FIXTURE_SCOPE(append_log_tests, append_log_fixture)
+
+TEST(recovery by scanning) {
+  {
+    auto db = open();
+    REQUIRE(db->put("foo", 1));
+    REQUIRE(db->put("bar", vector{1, 2, 3}));
+    REQUIRE(db->put("foo", 2));
+    REQUIRE(db->erase("bar"));
+    REQUIRE(db->put("baz", "qux", broker::now() + std::chrono::hours(1)));
+  }
+  // Simulate a crash: without the checkpoint, we have to scan the log.
+  REQUIRE(detail::remove(index_file()));
+  auto db = open();
+  CHECK_EQUAL(db->get("foo"), data{2});
+  CHECK_EQUAL(db->exists("bar"), false);
+  CHECK_EQUAL(db->get("baz"), data{"qux"});
+  auto es = db->expiries();
+  REQUIRE(es);
+  CHECK_EQUAL(es->size(), 1u);
+  CHECK_EQUAL(db->size(), 2u);
+}
+
+TEST(recovery from checkpoint) {
+  {
+    auto db = open();
+    REQUIRE(db->put("foo", 1));
+    REQUIRE(db->put("bar", 2));
+  }
+  CHECK(detail::exists(index_file()));
+  {
+    // Appends past the checkpoint get replayed on top of it.
+    auto db = open();
+    REQUIRE(db->put("foo", 3));
+    REQUIRE(db->erase("bar"));
+    // Keep the old checkpoint around to mimic a crash.
+    std::ifstream in{index_file(), std::ios::binary};
+    std::string checkpoint{std::istreambuf_iterator<char>{in},
+                           std::istreambuf_iterator<char>{}};
+    in.close();
+    db.reset();
+    std::ofstream out{index_file(), std::ios::binary | std::ios::trunc};
+    out << checkpoint;
+  }
+  auto db = open();
+  CHECK_EQUAL(db->get("foo"), data{3});
+  CHECK_EQUAL(db->exists("bar"), false);
+  CHECK_EQUAL(db->size(), 1u);
+}
+
+TEST(recovery from torn write) {
+  {
+    auto db = open();
+    REQUIRE(db->put("foo", 1));
+    REQUIRE(db->put("bar", 2));
+  }
+  REQUIRE(detail::remove(index_file()));
+  // Chop off the last bytes of the final record.
+  std::ifstream in{log_file(), std::ios::binary};
+  std::string log{std::istreambuf_iterator<char>{in},
+                  std::istreambuf_iterator<char>{}};
+  in.close();
+  REQUIRE(log.size() > 3);
+  log.resize(log.size() - 3);
+  {
+    std::ofstream out{log_file(), std::ios::binary | std::ios::trunc};
+    out << log;
+  }
+  auto db = open();
+  CHECK_EQUAL(db->get("foo"), data{1});
+  CHECK_EQUAL(db->exists("bar"), false);
+  // The log must accept new writes after truncating the torn record.
+  REQUIRE(db->put("bar", 42));
+  db.reset();
+  REQUIRE(detail::remove(index_file()));
+  db = open();
+  CHECK_EQUAL(db->get("bar"), data{42});
+}
+
+TEST(compaction) {
+  {
+    auto db = open();
+    for (int i = 0; i < 100; ++i)
+      REQUIRE(db->put("foo", i));
+    REQUIRE(db->put("bar", "baz"));
+    REQUIRE(db->put("tmp", true));
+    REQUIRE(db->erase("tmp"));
+    std::ifstream before{log_file(), std::ios::binary | std::ios::ate};
+    auto size_before = before.tellg();
+    REQUIRE(db->compact());
+    std::ifstream after{log_file(), std::ios::binary | std::ios::ate};
+    CHECK(after.tellg() < size_before);
+    CHECK_EQUAL(db->get("foo"), data{99});
+    CHECK_EQUAL(db->get("bar"), data{"baz"});
+    REQUIRE(db->put("foo", 100));
+  }
+  REQUIRE(detail::remove(index_file()));
+  auto db = open();
+  CHECK_EQUAL(db->get("foo"), data{100});
+  CHECK_EQUAL(db->get("bar"), data{"baz"});
+  CHECK_EQUAL(db->size(), 2u);
+}
+
 FIXTURE_SCOPE_END()
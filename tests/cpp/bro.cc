@@ -6,6 +6,7 @@
 #include <utility>
 #include "broker/bro.hh"
 #include "broker/data.hh"
+#include "broker/detail/blob.hh"
 
 #define SUITE bro
 #include "test.hpp"
@@ -19,3 +20,111 @@ TEST(event) {
   CHECK_EQUAL(ev2.name(), "test");
   CHECK_EQUAL(ev2.args(), args);
 }
+
+TEST(event_view) {
+  auto args = vector{1, "s", port(42, port::protocol::tcp)};
+  auto blob = detail::to_blob(data{bro::Event("test", vector(args))});
+  bro::EventView ev{blob};
+  REQUIRE(ev.valid());
+  CHECK_EQUAL(ev.version(), bro::ProtocolVersion);
+  CHECK_EQUAL(ev.type(), bro::Message::Type::Event);
+  CHECK_EQUAL(ev.name(), "test");
+  REQUIRE_EQUAL(ev.num_args(), 3u);
+  CHECK_EQUAL(ev.arg(2), args[2]);
+  CHECK_EQUAL(ev.arg(0), args[0]);
+  CHECK_EQUAL(ev.arg(3), data{});
+  CHECK_EQUAL(ev.args(), args);
+  CHECK_EQUAL(ev.materialize().args(), args);
+}
+
+TEST(event_view_skips_all_types) {
+  address addr;
+  convert("10.0.0.1", addr);
+  auto args = vector{nil, true, count{1}, integer{-2}, real{3.5}, "str",
+                     addr, subnet{addr, 24}, port(42, port::protocol::udp),
+                     timestamp{timespan{5}}, timespan{6}, enum_value{"A::B"},
+                     set{1, "x"}, table{{1, vector{2, 3}}, {"y", set{}}},
+                     vector{vector{}, "z"}, "last"};
+  auto blob = detail::to_blob(data{bro::Event("test", vector(args))});
+  bro::EventView ev{blob};
+  REQUIRE(ev.valid());
+  REQUIRE_EQUAL(ev.num_args(), args.size());
+  CHECK_EQUAL(ev.arg(args.size() - 1), args.back());
+  for (size_t i = 0; i < args.size(); ++i)
+    CHECK_EQUAL(ev.arg(i), args[i]);
+  // Truncating the blob invalidates all elements past the cut.
+  blob.resize(blob.size() - 2);
+  bro::EventView truncated{blob};
+  REQUIRE(truncated.valid());
+  CHECK_EQUAL(truncated.arg(args.size() - 1), data{});
+}
+
+TEST(batch_view) {
+  bro::Event e1("e1", vector{1, 2});
+  bro::LogWrite lw(enum_value{"Conn::LOG"}, enum_value{"Log::WRITER_ASCII"},
+                   "conn", "xyz");
+  bro::Event e2("e2", vector{});
+  auto blob = detail::to_blob(data{bro::Batch(vector{e1, lw, e2})});
+  bro::BatchView b{blob};
+  REQUIRE(b.valid());
+  REQUIRE_EQUAL(b.batch_size(), 3u);
+  CHECK_EQUAL(b.message(2).type(), bro::Message::Type::Event);
+  CHECK_EQUAL(bro::EventView{b.message(2)}.name(), "e2");
+  CHECK_EQUAL(bro::EventView{b.message(0)}.args(), e1.args());
+  bro::LogWriteView x{b.message(1)};
+  REQUIRE(x.valid());
+  CHECK_EQUAL(x.stream_id(), lw.stream_id());
+  CHECK_EQUAL(x.writer_id(), lw.writer_id());
+  CHECK_EQUAL(x.path(), lw.path());
+  CHECK_EQUAL(x.serial_data(), lw.serial_data());
+  CHECK(!bro::EventView{b.message(1)}.valid());
+}
+
+TEST(malformed_view) {
+  auto blob = detail::to_blob(data{vector{1, 2}});
+  bro::EventView ev{blob};
+  CHECK(!ev.valid());
+  CHECK_EQUAL(ev.name(), "");
+  CHECK_EQUAL(ev.num_args(), 0u);
+  bro::EventView empty{nullptr, 0};
+  CHECK(!empty.valid());
+  CHECK_EQUAL(empty.type(), bro::Message::Type::Invalid);
+}
+
+TEST(log_batch) {
+  std::vector<data::type> schema{data::type::timestamp, data::type::string,
+                                 data::type::address, data::type::port,
+                                 data::type::count, data::type::set};
+  bro::LogBatchBuilder builder{enum_value{"Conn::LOG"},
+                               enum_value{"Log::WRITER_ASCII"}, "conn",
+                               schema};
+  address orig;
+  convert("10.0.0.1", orig);
+  auto t0 = now();
+  std::vector<vector> records{
+    {t0, "C1", orig, port(80, port::protocol::tcp), count{42}, set{"http"}},
+    {t0 + std::chrono::seconds(1), "C2", orig, nil, count{0}, set{}},
+    {t0 - std::chrono::seconds(5), nil, nil, port(53, port::protocol::udp),
+     nil, nil},
+  };
+  for (auto& x : records)
+    CHECK(builder.add(x));
+  CHECK(!builder.add(vector{1, 2}));
+  CHECK(!builder.add(vector{t0, 1, orig, nil, nil, nil}));
+  CHECK_EQUAL(builder.num_records(), 3u);
+  auto batch = builder.build();
+  CHECK_EQUAL(builder.num_records(), 0u);
+  bro::LogBatch received{detail::from_blob<data>(detail::to_blob(data{batch}))};
+  REQUIRE(received.valid());
+  CHECK_EQUAL(received.type(), bro::Message::Type::LogBatch);
+  CHECK_EQUAL(received.stream_id(), enum_value{"Conn::LOG"});
+  CHECK_EQUAL(received.path(), data{"conn"});
+  CHECK_EQUAL(received.num_records(), 3u);
+  vector ports;
+  REQUIRE(received.column(3, ports));
+  CHECK_EQUAL(ports, (vector{port(80, port::protocol::tcp), nil,
+                             port(53, port::protocol::udp)}));
+  std::vector<vector> decoded;
+  REQUIRE(received.records(decoded));
+  CHECK(decoded == records);
+}
@@ -117,6 +117,25 @@ using fixture = test_coordinator_fixture<config>;
 
 } // namespace <anonymous>
 
+CAF_TEST(lane_classification) {
+  using classifier = core_policy::peer_trait::classifier;
+  classifier f;
+  auto cmd = [](internal_command x) {
+    return make_message(topic{"foo"} / topics::master_suffix, std::move(x));
+  };
+  CAF_CHECK_EQUAL(f(cmd(make_internal_command<put_command>(data{"k"},
+                                                           data{1}))),
+                  classifier::store_lane);
+  CAF_CHECK_EQUAL(f(cmd(make_internal_command<snapshot_command>(actor{},
+                                                                actor{}))),
+                  classifier::control_lane);
+  CAF_CHECK_EQUAL(f(cmd(make_internal_command<snapshot_sync_command>(
+                    actor{}))),
+                  classifier::control_lane);
+  CAF_CHECK_EQUAL(f(make_message(topic{"foo"}, data{42})),
+                  classifier::bulk_lane);
+}
+
 CAF_TEST_FIXTURE_SCOPE(local_tests, fixture)
 
 // Simulates a simple setup with two cores, where data flows from core1 to
@@ -241,6 +260,31 @@ CAF_TEST(local_peers) {
   anon_send_exit(leaf, exit_reason::user_shutdown);
 }
 
+// Checks that peers switch to filter deltas after announcing their filter
+// versions at the end of the handshake.
+CAF_TEST(filter_deltas_after_handshake) {
+  broker_options options;
+  options.disable_ssl = true;
+  auto core1 = sys.spawn(core_actor, filter_type{"a"}, options, nullptr);
+  auto core2 = sys.spawn(core_actor, filter_type{"b"}, options, nullptr);
+  anon_send(core1, atom::no_events::value);
+  anon_send(core2, atom::no_events::value);
+  run();
+  CAF_MESSAGE("run handshake between peers");
+  self->send(core1, atom::peer::value, core2);
+  run();
+  CAF_MESSAGE("core2 sends only the change of its filter");
+  anon_send(core2, atom::subscribe::value, filter_type{"c"});
+  expect((atom::subscribe, filter_type),
+         from(_).to(core2).with(_, filter_type{"c"}));
+  expect((atom::update, detail::filter_delta),
+         from(core2).to(core1).with(_, _));
+  run();
+  CAF_MESSAGE("shutdown core actors");
+  anon_send_exit(core1, exit_reason::user_shutdown);
+  anon_send_exit(core2, exit_reason::user_shutdown);
+}
+
 // Simulates a simple triangle setup where core1 peers with core2, and core2
 // peers with core3. Data flows from core1 to core2 and core3.
 CAF_TEST(triangle_peering) {
@@ -368,6 +412,66 @@ CAF_TEST(triangle_peering) {
   anon_send_exit(core3, exit_reason::user_shutdown);
 }
 
+// Simulates a fully meshed triangle with subscription routing, where data
+// flows from core1 to core2 and core3. Without routing, core2 and core3
+// would forward each message to each other.
+CAF_TEST(routed_triangle) {
+  broker_options options;
+  options.disable_ssl = true;
+  options.routing = true;
+  auto core1 = sys.spawn(core_actor, filter_type{}, options, nullptr);
+  auto core2 = sys.spawn(core_actor, filter_type{}, options, nullptr);
+  auto core3 = sys.spawn(core_actor, filter_type{}, options, nullptr);
+  anon_send(core1, atom::no_events::value);
+  anon_send(core2, atom::no_events::value);
+  anon_send(core3, atom::no_events::value);
+  run();
+  auto leaf2 = sys.spawn(consumer, filter_type{"b"}, core2);
+  auto leaf3 = sys.spawn(consumer, filter_type{"b"}, core3);
+  run();
+  CAF_MESSAGE("connect all cores with each other");
+  anon_send(core1, atom::peer::value, core2);
+  run();
+  anon_send(core2, atom::peer::value, core3);
+  run();
+  anon_send(core3, atom::peer::value, core1);
+  run();
+  CAF_MESSAGE("check that core1 learned the subscriptions of its peers");
+  sched.inline_next_enqueue();
+  self->request(core1, infinite, atom::get::value, atom::peer::value,
+                atom::subscriptions::value).receive(
+    [&](const std::vector<topic>& xs) {
+      CAF_CHECK_EQUAL(xs, std::vector<topic>{"b"});
+    },
+    [&](const error& err) {
+      CAF_FAIL(sys.render(err));
+    }
+  );
+  CAF_MESSAGE("spin up driver on core1");
+  auto d1 = sys.spawn(driver, core1, false);
+  run();
+  using buf = std::vector<element_type>;
+  buf expected{{"b", true}, {"b", false}, {"b", true}, {"b", false}};
+  for (auto& leaf : {leaf2, leaf3}) {
+    sched.inline_next_enqueue();
+    self->request(leaf, infinite, atom::get::value).receive(
+      [&](const buf& xs) {
+        CAF_CHECK_EQUAL(xs, expected);
+      },
+      [&](const error& err) {
+        CAF_FAIL(sys.render(err));
+      }
+    );
+  }
+  CAF_MESSAGE("Shutdown core actors.");
+  anon_send_exit(core1, exit_reason::user_shutdown);
+  anon_send_exit(core2, exit_reason::user_shutdown);
+  anon_send_exit(core3, exit_reason::user_shutdown);
+  anon_send_exit(leaf2, exit_reason::user_shutdown);
+  anon_send_exit(leaf3, exit_reason::user_shutdown);
+  anon_send_exit(d1, exit_reason::user_shutdown);
+}
+
 // Simulates a simple setup where core1 peers with core2 and starts sending
 // data. After receiving a couple of messages, core2 terminates and core3
 // starts peering. Core3 must receive all remaining messages.
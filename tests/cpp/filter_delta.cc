@@ -0,0 +1,74 @@
+#define SUITE filter_delta
+#include "test.hpp"
+
+#include <string>
+
+#include "broker/filter_type.hh"
+#include "broker/topic.hh"
+
+#include "broker/detail/filter_delta.hh"
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+struct fixture {
+  filter_type filter;
+  filter_type added;
+  filter_type removed;
+
+  bool extend(filter_type xs) {
+    added.clear();
+    removed.clear();
+    return filter_extend(filter, std::move(xs), added, removed);
+  }
+};
+
+} // namespace <anonymous>
+
+FIXTURE_SCOPE(filter_delta_tests, fixture)
+
+TEST(prefix subsumption) {
+  CHECK(extend({"zeek/logs", "zeek/events", "foo"}));
+  CHECK_EQUAL(filter, (filter_type{"foo", "zeek/events", "zeek/logs"}));
+  MESSAGE("topics covered by a prefix are no-ops");
+  CHECK(!extend({"zeek/logs/conn", "foo/bar", "foo"}));
+  CHECK(added.empty());
+  CHECK(removed.empty());
+  MESSAGE("a prefix replaces all topics it covers");
+  CHECK(extend({"zeek"}));
+  CHECK_EQUAL(filter, (filter_type{"foo", "zeek"}));
+  CHECK_EQUAL(added, filter_type{"zeek"});
+  CHECK_EQUAL(removed, (filter_type{"zeek/events", "zeek/logs"}));
+  MESSAGE("prefix and covered topic in the same update");
+  CHECK(extend({"bar/baz", "bar"}));
+  CHECK_EQUAL(added, filter_type{"bar"});
+  CHECK(removed.empty());
+  CHECK_EQUAL(filter, (filter_type{"bar", "foo", "zeek"}));
+}
+
+TEST(reserved topics) {
+  auto master = topic{"zeek"} / topics::master_suffix;
+  CHECK(extend({master}));
+  CHECK(extend({"zeek"}));
+  CHECK_EQUAL(filter, (filter_type{"zeek", master}));
+  CHECK(removed.empty());
+  CHECK(!extend({master}));
+}
+
+TEST(applying deltas) {
+  extend({"a", "b/c"});
+  filter_type peer;
+  filter_apply(peer, filter_delta{0, true, filter, {}});
+  CHECK_EQUAL(peer, filter);
+  extend({"b", "d"});
+  filter_apply(peer, filter_delta{1, false, added, removed});
+  CHECK_EQUAL(peer, filter);
+  CHECK_EQUAL(peer, (filter_type{"a", "b", "d"}));
+  MESSAGE("snapshots replace the filter");
+  filter_apply(peer, filter_delta{2, true, {"x"}, {}});
+  CHECK_EQUAL(peer, filter_type{"x"});
+}
+
+FIXTURE_SCOPE_END()
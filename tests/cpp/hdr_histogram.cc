@@ -0,0 +1,62 @@
+#define SUITE hdr_histogram
+#include "test.hpp"
+
+#include <cstdint>
+#include <limits>
+
+#include "broker/detail/hdr_histogram.hh"
+
+using namespace broker::detail;
+
+TEST(empty) {
+  hdr_histogram h;
+  CHECK_EQUAL(h.count(), 0u);
+  CHECK_EQUAL(h.min(), 0u);
+  CHECK_EQUAL(h.max(), 0u);
+  CHECK_EQUAL(h.percentile(50), 0u);
+}
+
+TEST(small_values_are_exact) {
+  hdr_histogram h;
+  for (uint64_t i = 1; i <= 100; ++i)
+    h.record(i);
+  CHECK_EQUAL(h.count(), 100u);
+  CHECK_EQUAL(h.min(), 1u);
+  CHECK_EQUAL(h.max(), 100u);
+  CHECK_EQUAL(h.percentile(50), 50u);
+  CHECK_EQUAL(h.percentile(99), 99u);
+  CHECK_EQUAL(h.percentile(100), 100u);
+  CHECK_EQUAL(h.mean(), 50.5);
+}
+
+TEST(large_values_stay_within_one_percent) {
+  hdr_histogram h;
+  for (uint64_t i = 1; i <= 1000; ++i)
+    h.record(i * 1000003);
+  auto check = [&](double p, uint64_t exact) {
+    auto approx = static_cast<double>(h.percentile(p));
+    CHECK(approx >= exact);
+    CHECK(approx <= exact * 1.01);
+  };
+  check(50, 500 * 1000003);
+  check(99, 990 * 1000003);
+  check(99.9, 999 * 1000003);
+  CHECK_EQUAL(h.percentile(100), 1000u * 1000003);
+  h.record(std::numeric_limits<uint64_t>::max());
+  CHECK_EQUAL(h.max(), std::numeric_limits<uint64_t>::max());
+}
+
+TEST(merge) {
+  hdr_histogram a;
+  hdr_histogram b;
+  a.record(10);
+  b.record(20);
+  b.record(30);
+  a.merge(b);
+  CHECK_EQUAL(a.count(), 3u);
+  CHECK_EQUAL(a.min(), 10u);
+  CHECK_EQUAL(a.max(), 30u);
+  CHECK_EQUAL(a.percentile(50), 20u);
+  a.reset();
+  CHECK_EQUAL(a.count(), 0u);
+}
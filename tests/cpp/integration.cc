@@ -566,3 +566,141 @@ CAF_TEST(connection_retry) {
 
 CAF_TEST_FIXTURE_SCOPE_END()
 
+
+// -- concurrent peering -------------------------------------------------------
+
+namespace {
+
+// A fixture for a hub that peers with several nodes at once.
+struct star_fixture : global_fixture {
+  peer_fixture sun;
+  peer_fixture mercury;
+  peer_fixture venus;
+  peer_fixture earth;
+
+  star_fixture()
+    : sun(this, "sun"),
+      mercury(this, "mercury"),
+      venus(this, "venus"),
+      earth(this, "earth") {
+    // nop
+  }
+
+  std::vector<peer_fixture*> planets() {
+    return {&mercury, &venus, &earth};
+  }
+
+  // Lets each planet listen on its own port and returns their addresses.
+  std::vector<network_info> listen_on_planets() {
+    std::vector<network_info> result;
+    uint16_t port = 4040;
+    for (auto planet : planets()) {
+      MESSAGE("start listening on " << planet->name << ":" << port);
+      planet->mpx.prepare_connection(planet->make_accept_handle(),
+                                     planet->make_connection_handle(),
+                                     sun.mpx, planet->name, port,
+                                     sun.make_connection_handle());
+      planet->sched.after_next_enqueue([&] { exec_loop(); });
+      planet->ep.listen("", port);
+      result.emplace_back(planet->name, port);
+      ++port;
+    }
+    return result;
+  }
+};
+
+using string_list = std::vector<std::string>;
+
+} // namespace <anonymous>
+
+CAF_TEST_FIXTURE_SCOPE(star_use_cases, star_fixture)
+
+CAF_TEST(peer_many) {
+  auto sun_es = sun.ep.make_status_subscriber(true);
+  auto sun_sub = sun.ep.make_subscriber({"bro/events"});
+  sun_sub.set_rate_calculation(false);
+  exec_loop();
+  auto xs = listen_on_planets();
+  MESSAGE("peer the sun with all planets at once");
+  string_list reported;
+  std::vector<size_t> completed;
+  sun.loop_after_next_enqueue();
+  auto n = sun.ep.peer_many(xs, [&](const network_info& x,
+                                    const caf::error& err, size_t i) {
+    CAF_CHECK(!err);
+    reported.emplace_back(x.address);
+    completed.emplace_back(i);
+  });
+  CAF_CHECK_EQUAL(n, xs.size());
+  CAF_CHECK_EQUAL(completed, (std::vector<size_t>{1, 2, 3}));
+  std::sort(reported.begin(), reported.end());
+  CAF_CHECK_EQUAL(reported, (string_list{"earth", "mercury", "venus"}));
+  MESSAGE("assume that all planets are peered with the sun");
+  auto sun_peers = sun.peers();
+  CAF_CHECK_EQUAL(sun_peers.size(), 3u);
+  for (auto& x : sun_peers)
+    CAF_CHECK_EQUAL(x.status, peer_status::peered);
+  for (auto planet : planets()) {
+    auto planet_peers = planet->peers();
+    CAF_REQUIRE_EQUAL(planet_peers.size(), 1u);
+    CAF_CHECK_EQUAL(planet_peers.front().status, peer_status::peered);
+  }
+  MESSAGE("assume exactly one event per peering");
+  CAF_CHECK_EQUAL(event_log(sun_es.poll()),
+                  event_log({sc::peer_added, sc::peer_added, sc::peer_added}));
+  MESSAGE("assume that the status sync rounds unblocked all planets");
+  for (auto planet : planets())
+    planet->publish("bro/events", planet->name);
+  string_list received;
+  for (auto& x : sun_sub.poll())
+    received.emplace_back(caf::get<std::string>(x.second));
+  std::sort(received.begin(), received.end());
+  CAF_CHECK_EQUAL(received, (string_list{"earth", "mercury", "venus"}));
+  MESSAGE("assume that removing the peers follows the additions");
+  for (auto& x : xs) {
+    sun.loop_after_next_enqueue();
+    sun.ep.unpeer(x.address, x.port);
+  }
+  CAF_CHECK_EQUAL(event_log(sun_es.poll()),
+                  event_log({sc::peer_removed, sc::peer_removed,
+                             sc::peer_removed}));
+}
+
+CAF_TEST(peer_many_with_unreachable_node) {
+  auto xs = listen_on_planets();
+  xs.emplace_back("pluto", 4043);
+  string_list failed;
+  size_t calls = 0;
+  sun.loop_after_next_enqueue();
+  auto n = sun.ep.peer_many(xs, [&](const network_info& x,
+                                    const caf::error& err, size_t i) {
+    CAF_CHECK_EQUAL(i, ++calls);
+    if (err)
+      failed.emplace_back(x.address);
+  });
+  CAF_CHECK_EQUAL(n, 3u);
+  CAF_CHECK_EQUAL(calls, 4u);
+  CAF_CHECK_EQUAL(failed, (string_list{"pluto"}));
+  CAF_CHECK_EQUAL(sun.peers().size(), 3u);
+  MESSAGE("retrying an unreachable node does not block peer_many");
+  network_info pluto{"pluto", 4043, timeout::seconds(1)};
+  failed.clear();
+  calls = 0;
+  sun.loop_after_next_enqueue();
+  n = sun.ep.peer_many({pluto}, [&](const network_info& x,
+                                    const caf::error& err, size_t i) {
+    CAF_CHECK_EQUAL(i, ++calls);
+    CAF_CHECK(err);
+    failed.emplace_back(x.address);
+  });
+  CAF_CHECK_EQUAL(n, 0u);
+  CAF_CHECK_EQUAL(calls, 1u);
+  CAF_CHECK_EQUAL(failed, (string_list{"pluto"}));
+  xs.pop_back();
+  for (auto& x : xs) {
+    sun.loop_after_next_enqueue();
+    sun.ep.unpeer(x.address, x.port);
+  }
+}
+
+CAF_TEST_FIXTURE_SCOPE_END()
@@ -0,0 +1,106 @@
+#define SUITE json
+#include "test.hpp"
+
+#include <cmath>
+#include <string>
+
+#include "broker/data.hh"
+
+#include "broker/detail/json.hh"
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+std::string encode(const data& x) {
+  std::string result;
+  json_encode(result, x);
+  return result;
+}
+
+bool decode(const std::string& str, data& x) {
+  auto first = str.data();
+  auto last = first + str.size();
+  return json_decode(first, last, x) && first == last;
+}
+
+data roundtrip(const data& x) {
+  data result;
+  if (!decode(encode(x), result))
+    return data{"<decoding failed>"};
+  return result;
+}
+
+} // namespace <anonymous>
+
+TEST(encoding) {
+  CHECK_EQUAL(encode(count{42}), R"({"@data-type":"count","data":42})");
+  CHECK_EQUAL(encode(integer{-7}), R"({"@data-type":"integer","data":-7})");
+  CHECK_EQUAL(encode(true), R"({"@data-type":"boolean","data":true})");
+  CHECK_EQUAL(encode("a\"b\n"), R"({"@data-type":"string","data":"a\"b\n"})");
+  CHECK_EQUAL(encode(port{80, port::protocol::tcp}),
+              R"({"@data-type":"port","data":"80/tcp"})");
+  CHECK_EQUAL(encode(vector{count{1}, nil}),
+              R"({"@data-type":"vector","data":[)"
+              R"({"@data-type":"count","data":1},)"
+              R"({"@data-type":"none","data":{}}]})");
+}
+
+TEST(roundtrip) {
+  address a;
+  address b;
+  REQUIRE(convert("10.0.0.1", a));
+  REQUIRE(convert("2001:db8::1", b));
+  data xs[] = {
+    nil,
+    true,
+    count{18446744073709551615ull},
+    integer{-9223372036854775807},
+    real{1.5},
+    real{0.1},
+    std::string{"\x01\x7f\xc3\xa4"},
+    a,
+    b,
+    subnet{a, 24},
+    subnet{b, 64},
+    port{53, port::protocol::udp},
+    timestamp{timespan{1514764800123456789}},
+    timespan{-42},
+    enum_value{"Conn::LOG"},
+    set{count{1}, count{2}},
+    table{{"a", count{1}}, {vector{}, set{}}},
+    vector{vector{"nested"}, table{}},
+  };
+  for (auto& x : xs)
+    CHECK_EQUAL(roundtrip(x), x);
+  auto inf = roundtrip(real{INFINITY});
+  auto r = caf::get_if<real>(&inf);
+  REQUIRE(r != nullptr);
+  CHECK(std::isinf(*r));
+}
+
+TEST(decoding) {
+  data x;
+  CHECK(decode(R"( { "data" : 42 , "@data-type" : "count" })", x));
+  CHECK_EQUAL(x, data{count{42}});
+  CHECK(decode(R"({"@data-type":"string","data":"ä😀"})", x));
+  CHECK_EQUAL(x, data{"\xc3\xa4\xf0\x9f\x98\x80"});
+  CHECK(decode(R"({"@data-type":"table","data":[)"
+               R"({"value":{"@data-type":"count","data":2},)"
+               R"("key":{"@data-type":"string","data":"b"}}]})", x));
+  CHECK_EQUAL(x, data{table{{"b", count{2}}}});
+}
+
+TEST(malformed) {
+  data x;
+  CHECK(!decode(R"({"@data-type":"count","data":-1})", x));
+  CHECK(!decode(R"({"@data-type":"integer","data":1.5})", x));
+  CHECK(!decode(R"({"@data-type":"count"})", x));
+  CHECK(!decode(R"({"@data-type":"unknown","data":1})", x));
+  CHECK(!decode(R"({"@data-type":"address","data":"not-an-address"})", x));
+  CHECK(!decode(R"({"@data-type":"subnet","data":"10.0.0.0/33"})", x));
+  CHECK(!decode(R"({"@data-type":"string","data":"unterminated})", x));
+  CHECK(!decode(R"({"@data-type":"vector","data":[1,]})", x));
+  CHECK(!decode("", x));
+}
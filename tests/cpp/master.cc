@@ -13,6 +13,8 @@
 #include "broker/store.hh"
 #include "broker/topic.hh"
 
+#include "broker/detail/clone_actor.hh"
+
 using std::cout;
 using std::endl;
 using std::string;
@@ -61,6 +63,41 @@ CAF_TEST(local_master) {
   anon_send_exit(core, exit_reason::user_shutdown);
 }
 
+CAF_TEST(clone_reports_pending_writes_on_master_loss) {
+  endpoint::clock clock{&sys, false};
+  self->join(sys.groups().get_local("broker/errors"));
+  // The clone coalesces writes for 10s and has no mutation buffer.
+  auto clone = sys.spawn(clone_actor, ep.core(), std::string{"foo"}, 10.0,
+                         300.0, 0.0, 10.0, size_t{1000}, &clock);
+  auto master = sys.spawn([]() -> behavior {
+    return {
+      [](atom::subscribe, atom::changes, actor&) {
+        // nop
+      }
+    };
+  });
+  run();
+  anon_send(clone, atom::master::value, master);
+  run();
+  anon_send(clone, atom::local::value,
+            make_internal_command<put_command>("hello", "world"));
+  run();
+  CAF_MESSAGE("lose the master while the put waits in the coalesce buffer");
+  anon_send_exit(master, exit_reason::user_shutdown);
+  run();
+  self->receive(
+    [](atom::local, const error& x) {
+      CAF_CHECK_EQUAL(x.category(), atom("broker"));
+      CAF_CHECK_EQUAL(x.code(), static_cast<uint8_t>(ec::no_such_master));
+    },
+    after(std::chrono::seconds(0)) >> [] {
+      CAF_FAIL("clone dropped pending writes silently");
+    }
+  );
+  anon_send_exit(clone, exit_reason::user_shutdown);
+  run();
+}
+
 CAF_TEST_FIXTURE_SCOPE_END()
 
 CAF_TEST_FIXTURE_SCOPE(store_master,
@@ -0,0 +1,309 @@
+#define SUITE routing_table
+#include "test.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "broker/filter_type.hh"
+#include "broker/topic.hh"
+
+#include "broker/detail/prefix_matcher.hh"
+#include "broker/detail/routing_table.hh"
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+using table_type = routing_table<size_t>;
+
+// Simulates a network of endpoints connected by reliable, ordered links. The
+// simulation compares the number of transmissions with TTL flooding, i.e.,
+// how endpoints forward messages without routing, to the number of
+// transmissions with subscription routing.
+struct topology {
+  struct node {
+    table_type routes;
+    filter_type filter;
+    duplicate_filter duplicates;
+    std::vector<size_t> peers;
+    size_t deliveries = 0;
+  };
+
+  struct announcement_item {
+    size_t from;
+    size_t to;
+    subscription_announcement x;
+  };
+
+  struct message_item {
+    size_t from;
+    size_t to;
+    uint16_t ttl;
+  };
+
+  std::vector<node> nodes;
+
+  std::deque<announcement_item> pending;
+
+  // Counts transmissions per directed link.
+  std::map<std::pair<size_t, size_t>, size_t> transmissions;
+
+  uint64_t last_seq = 0;
+
+  explicit topology(size_t n) : nodes(n) {
+    for (size_t i = 0; i < n; ++i)
+      nodes[i].routes.id(i + 1);
+  }
+
+  void subscribe(size_t x, filter_type f) {
+    nodes[x].filter = f;
+    auto ann = nodes[x].routes.announce(std::move(f));
+    for (auto p : nodes[x].peers)
+      pending.push_back({x, p, ann});
+  }
+
+  void link(size_t x, size_t y) {
+    nodes[x].peers.emplace_back(y);
+    nodes[y].peers.emplace_back(x);
+    for (auto& ann : nodes[x].routes.dump())
+      pending.push_back({x, y, ann});
+    for (auto& ann : nodes[y].routes.dump())
+      pending.push_back({y, x, ann});
+  }
+
+  void unlink(size_t x, size_t y) {
+    auto drop = [&](size_t a, size_t b) {
+      auto& ps = nodes[a].peers;
+      ps.erase(std::remove(ps.begin(), ps.end(), b), ps.end());
+      for (auto& ann : nodes[a].routes.remove_peer(b))
+        for (auto p : ps)
+          pending.push_back({a, p, ann});
+    };
+    drop(x, y);
+    drop(y, x);
+  }
+
+  // Exchanges announcements until all routing tables are stable.
+  void converge() {
+    while (!pending.empty()) {
+      auto item = std::move(pending.front());
+      pending.pop_front();
+      auto& n = nodes[item.to];
+      if (auto y = n.routes.handle(item.from, std::move(item.x)))
+        for (auto p : n.peers)
+          pending.push_back({item.to, p, *y});
+    }
+  }
+
+  bool matches(const filter_type& f, const topic& t) const {
+    return prefix_matcher{}(f, t);
+  }
+
+  void reset_counters() {
+    transmissions.clear();
+    for (auto& n : nodes)
+      n.deliveries = 0;
+  }
+
+  size_t total_transmissions() const {
+    size_t result = 0;
+    for (auto& kvp : transmissions)
+      result += kvp.second;
+    return result;
+  }
+
+  size_t max_transmissions_per_link() const {
+    size_t result = 0;
+    for (auto& kvp : transmissions)
+      result = std::max(result, kvp.second);
+    return result;
+  }
+
+  // Publishes `t` at `origin` and forwards it to every peer with a matching
+  // filter except the sender until the TTL expires.
+  void flood(size_t origin, const topic& t, uint16_t ttl) {
+    std::deque<message_item> queue;
+    auto forward = [&](size_t at, size_t from, uint16_t ttl) {
+      for (auto p : nodes[at].peers) {
+        if (p != from && matches(nodes[p].filter, t)) {
+          ++transmissions[std::make_pair(at, p)];
+          queue.push_back({at, p, ttl});
+        }
+      }
+    };
+    forward(origin, origin, ttl);
+    while (!queue.empty()) {
+      auto item = queue.front();
+      queue.pop_front();
+      ++nodes[item.to].deliveries;
+      if (--item.ttl > 0)
+        forward(item.to, item.from, item.ttl);
+    }
+  }
+
+  // Publishes `t` at `origin` and forwards it along the routing tables.
+  void route(size_t origin, const topic& t) {
+    auto origin_id = nodes[origin].routes.id();
+    auto seq = ++last_seq;
+    nodes[origin].duplicates.first_delivery(origin_id, seq);
+    std::deque<message_item> queue;
+    auto forward = [&](size_t at, size_t from) {
+      for (auto p : nodes[at].peers) {
+        if (p != from && matches(nodes[at].routes.filter_for(p), t)) {
+          ++transmissions[std::make_pair(at, p)];
+          queue.push_back({at, p, 0});
+        }
+      }
+    };
+    forward(origin, origin);
+    while (!queue.empty()) {
+      auto item = queue.front();
+      queue.pop_front();
+      auto& n = nodes[item.to];
+      if (!n.duplicates.first_delivery(origin_id, seq))
+        continue;
+      if (matches(n.filter, t))
+        ++n.deliveries;
+      forward(item.to, item.from);
+    }
+  }
+};
+
+} // namespace <anonymous>
+
+TEST(duplicate filter) {
+  duplicate_filter f;
+  CHECK(f.first_delivery(1, 1));
+  CHECK(!f.first_delivery(1, 1));
+  CHECK(f.first_delivery(1, 3));
+  CHECK(f.first_delivery(1, 2));
+  CHECK(!f.first_delivery(1, 2));
+  CHECK(f.first_delivery(2, 2));
+  CHECK(f.first_delivery(1, 100));
+  CHECK(!f.first_delivery(1, 3));
+  CHECK(f.first_delivery(1, 99));
+  // Sequence numbers older than the window get delivered anyway.
+  CHECK(f.first_delivery(1, 10000));
+  CHECK(f.check(1, 3) == duplicate_filter::verdict::unknown);
+  CHECK(f.first_delivery(1, 3));
+}
+
+TEST(duplicate filter with late messages) {
+  // All topics of an origin share one counter, so messages may arrive far
+  // behind the newest one.
+  duplicate_filter f;
+  CHECK(f.first_delivery(1, 1000));
+  for (uint64_t seq = 999; seq > 700; --seq)
+    CHECK(f.first_delivery(1, seq));
+  for (uint64_t seq = 701; seq <= 1000; ++seq)
+    CHECK(!f.first_delivery(1, seq));
+  // Jumping ahead keeps whatever remains inside the window.
+  CHECK(f.first_delivery(1, 5000));
+  CHECK(f.first_delivery(1, 4500));
+  CHECK(!f.first_delivery(1, 4500));
+  CHECK(!f.first_delivery(1, 1000));
+  CHECK(f.check(1, 800) == duplicate_filter::verdict::unknown);
+}
+
+TEST(routes in a line) {
+  // 0 - 1 - 2, where only 2 has a subscription.
+  topology net{3};
+  net.link(0, 1);
+  net.link(1, 2);
+  net.subscribe(2, {"foo"});
+  net.converge();
+  auto hop = net.nodes[0].routes.next_hop(3);
+  REQUIRE(hop);
+  CHECK_EQUAL(*hop, 1u);
+  CHECK_EQUAL(net.nodes[0].routes.filter_for(1), filter_type{"foo"});
+  CHECK_EQUAL(net.nodes[0].routes.next_hops("foo/bar"),
+              std::vector<size_t>{1u});
+  CHECK(net.nodes[0].routes.next_hops("bar").empty());
+  MESSAGE("endpoint 1 relays without subscribing itself");
+  net.route(0, "foo/bar");
+  CHECK_EQUAL(net.nodes[2].deliveries, 1u);
+  CHECK_EQUAL(net.total_transmissions(), 2u);
+  MESSAGE("unsubscribing removes the route");
+  net.subscribe(2, {});
+  net.converge();
+  CHECK(net.nodes[0].routes.filter_for(1).empty());
+}
+
+TEST(changed peers) {
+  // 0 - 1 - 2, where only 2 has a subscription.
+  topology net{3};
+  net.link(0, 1);
+  net.link(1, 2);
+  net.subscribe(2, {"foo"});
+  net.converge();
+  auto& routes = net.nodes[1].routes;
+  MESSAGE("both peers announced their own filter");
+  CHECK_EQUAL(routes.take_changed_peers(), (std::vector<size_t>{0u, 2u}));
+  CHECK(routes.take_changed_peers().empty());
+  MESSAGE("a filter change only affects the peer on the route");
+  net.subscribe(2, {"bar"});
+  net.converge();
+  CHECK_EQUAL(routes.take_changed_peers(), std::vector<size_t>{2u});
+  MESSAGE("losing the peer affects it as well");
+  net.unlink(1, 2);
+  net.converge();
+  CHECK_EQUAL(routes.take_changed_peers(), std::vector<size_t>{2u});
+}
+
+TEST(mesh without duplicates) {
+  // Two rings of three endpoints each, connected by three redundant links:
+  //
+  //   0 --- 1 --- 2
+  //   |  \  |  /  |
+  //   3 --- 4 --- 5
+  //
+  topology net{6};
+  for (auto& x : {std::make_pair(0, 1), std::make_pair(1, 2),
+                  std::make_pair(3, 4), std::make_pair(4, 5),
+                  std::make_pair(0, 3), std::make_pair(1, 4),
+                  std::make_pair(2, 5), std::make_pair(0, 4),
+                  std::make_pair(2, 4)})
+    net.link(x.first, x.second);
+  for (size_t i = 0; i < net.nodes.size(); ++i)
+    net.subscribe(i, {"zeek/events"});
+  net.converge();
+  for (auto& n : net.nodes)
+    CHECK_EQUAL(n.routes.size(), net.nodes.size() - 1);
+  MESSAGE("flood with a TTL of 5");
+  net.flood(0, "zeek/events/conn", 5);
+  auto flooded = net.total_transmissions();
+  size_t duplicates = 0;
+  for (size_t i = 1; i < net.nodes.size(); ++i) {
+    CHECK_GREATER_EQUAL(net.nodes[i].deliveries, 1u);
+    duplicates += net.nodes[i].deliveries - 1;
+  }
+  CHECK_GREATER(duplicates, 0u);
+  MESSAGE("route the same message");
+  net.reset_counters();
+  net.route(0, "zeek/events/conn");
+  auto routed = net.total_transmissions();
+  CHECK_EQUAL(net.nodes[0].deliveries, 0u);
+  for (size_t i = 1; i < net.nodes.size(); ++i)
+    CHECK_EQUAL(net.nodes[i].deliveries, 1u);
+  CHECK_EQUAL(net.max_transmissions_per_link(), 1u);
+  CHECK_LESS(routed, flooded);
+  MESSAGE("flooding: " << flooded << " transmissions, " << duplicates
+          << " duplicates; routing: " << routed << " transmissions, saved "
+          << (flooded - routed));
+  MESSAGE("routes heal after losing a link");
+  net.unlink(0, 4);
+  net.unlink(1, 4);
+  net.converge();
+  net.reset_counters();
+  net.route(0, "zeek/events/conn");
+  for (size_t i = 1; i < net.nodes.size(); ++i)
+    CHECK_EQUAL(net.nodes[i].deliveries, 1u);
+  CHECK_EQUAL(net.max_transmissions_per_link(), 1u);
+  CHECK_EQUAL(net.transmissions.count(std::make_pair(size_t{0}, size_t{4})),
+              0u);
+}
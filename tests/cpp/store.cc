@@ -78,6 +78,38 @@ TEST(master operations) {
   REQUIRE_EQUAL(value_of(ds->keys()), data(set{"foo"}));
 }
 
+TEST(partitioned master operations) {
+  endpoint ep;
+  auto opts = backend_options{{"shards", count{4}}};
+  auto ds = ep.attach_master("shardy", memory, std::move(opts));
+  REQUIRE(ds);
+  MESSAGE("put");
+  set all_keys;
+  for (count i = 0; i < 32; ++i) {
+    ds->put(i, i * i);
+    all_keys.emplace(i);
+  }
+  REQUIRE_EQUAL(value_of(ds->get(count{7})), data{count{49}});
+  REQUIRE_EQUAL(error_of(ds->get("bar")), error{ec::no_such_key});
+  REQUIRE_EQUAL(ds->exists(count{31}), true);
+  REQUIRE_EQUAL(ds->exists(count{32}), false);
+  MESSAGE("put_unique");
+  REQUIRE_EQUAL(value_of(ds->put_unique(count{3}, 0u)), data{false});
+  REQUIRE_EQUAL(value_of(ds->put_unique(count{32}, 0u)), data{true});
+  all_keys.emplace(count{32});
+  MESSAGE("increment");
+  ds->increment(count{2}, 1u);
+  REQUIRE_EQUAL(value_of(ds->get(count{2})), data{count{5}});
+  MESSAGE("keys");
+  REQUIRE_EQUAL(value_of(ds->keys()), data{all_keys});
+  MESSAGE("erase");
+  ds->erase(count{5});
+  REQUIRE_EQUAL(error_of(ds->get(count{5})), error{ec::no_such_key});
+  MESSAGE("clear");
+  ds->clear();
+  REQUIRE_EQUAL(value_of(ds->keys()), data{set{}});
+}
+
 TEST(clone operations - same endpoint) {
   endpoint ep;
   auto m = ep.attach_master("vulcan", memory);
@@ -103,6 +135,97 @@ TEST(expiration) {
   CHECK_EQUAL(error_of(m->get("foo")), ec::no_such_key);
 }
 
+TEST(change events) {
+  store_event x{store_event::type::put, "foo", 42};
+  auto y = store_event::make(x.to_data());
+  REQUIRE(y);
+  CHECK_EQUAL(to_string(*y), "put(foo, 42)");
+  CHECK(*y == x);
+  CHECK(!store_event::make(data{42}));
+  CHECK(!store_event::make(vector{"rename", "foo", nil}));
+  CHECK(!store_event::make(vector{"put", "foo"}));
+}
+
+TEST(change subscriptions) {
+  using std::chrono::milliseconds;
+  endpoint ep;
+  auto m = ep.attach_master("watched", memory);
+  REQUIRE(m);
+  auto sub = m->subscribe_changes("foo");
+  REQUIRE(sub);
+  // Give the subscriber time to join the core.
+  std::this_thread::sleep_for(milliseconds(50));
+  m->put("foo1", 1u);
+  m->put("bar", 2u);
+  m->increment("foo1", 2u);
+  m->put("foo2", "x", milliseconds(100));
+  m->erase("foo1");
+  std::vector<store_event> events;
+  for (auto& msg : sub->get(5)) {
+    auto e = store_event::make(msg.second);
+    REQUIRE(e);
+    events.emplace_back(std::move(*e));
+  }
+  using type = store_event::type;
+  REQUIRE_EQUAL(events.size(), 5u);
+  CHECK(events[0] == (store_event{type::put, "foo1", 1u}));
+  CHECK(events[1] == (store_event{type::add, "foo1", 3u}));
+  CHECK(events[2] == (store_event{type::put, "foo2", "x"}));
+  CHECK(events[3] == (store_event{type::erase, "foo1", nil}));
+  CHECK(events[4] == (store_event{type::expire, "foo2", nil}));
+}
+
+TEST(clear emits a single change event) {
+  using std::chrono::milliseconds;
+  endpoint ep;
+  auto opts = backend_options{{"shards", count{4}}};
+  auto m = ep.attach_master("wiped", memory, std::move(opts));
+  REQUIRE(m);
+  auto sub = m->subscribe_changes("foo");
+  REQUIRE(sub);
+  std::this_thread::sleep_for(milliseconds(50));
+  m->put("foo1", 1u);
+  m->put("bar", 2u);
+  // Shards publish independently, so wait for the shard of "foo1" first.
+  REQUIRE_EQUAL(value_of(m->get("foo1")), data{1u});
+  m->clear();
+  std::vector<store_event> events;
+  for (auto& msg : sub->get(2)) {
+    auto e = store_event::make(msg.second);
+    REQUIRE(e);
+    events.emplace_back(std::move(*e));
+  }
+  using type = store_event::type;
+  REQUIRE_EQUAL(events.size(), 2u);
+  CHECK(events[0] == (store_event{type::put, "foo1", 1u}));
+  CHECK(events[1] == (store_event{type::clear, nil, nil}));
+  std::this_thread::sleep_for(milliseconds(50));
+  CHECK(sub->poll().empty());
+}
+
+TEST(change events stop with the last subscriber) {
+  using std::chrono::milliseconds;
+  endpoint ep;
+  auto m = ep.attach_master("watched", memory);
+  REQUIRE(m);
+  // Observes the raw event topic without enabling change events.
+  auto raw = ep.make_subscriber({topic{"watched"} / topics::changes_suffix});
+  {
+    auto sub = m->subscribe_changes();
+    REQUIRE(sub);
+    std::this_thread::sleep_for(milliseconds(50));
+    m->put("foo", 1u);
+    CHECK_EQUAL(sub->get(1).size(), 1u);
+    CHECK_EQUAL(raw.get(1).size(), 1u);
+  }
+  // Give the master time to notice that the subscriber is gone.
+  std::this_thread::sleep_for(milliseconds(50));
+  m->put("foo", 2u);
+  CHECK_EQUAL(value_of(m->get("foo")), data{2u});
+  std::this_thread::sleep_for(milliseconds(50));
+  CHECK(raw.poll().empty());
+}
+
 TEST(proxy) {
   endpoint ep;
   auto m = ep.attach_master("puneta", memory);
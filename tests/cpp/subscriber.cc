@@ -97,6 +97,70 @@ CAF_TEST(blocking_subscriber) {
   anon_send_exit(d1, exit_reason::user_shutdown);
 }
 
+CAF_TEST(dropping_subscriber) {
+  broker_options options;
+  options.disable_ssl = true;
+  auto core1 = sys.spawn(core_actor, filter_type{"a", "b", "c"}, options, nullptr);
+  auto core2 = ep.core();
+  anon_send(core2, atom::subscribe::value, filter_type{"a", "b", "c"});
+  anon_send(core1, atom::no_events::value);
+  anon_send(core2, atom::no_events::value);
+  run();
+  // The subscriber only keeps the three most recent messages.
+  auto sub = ep.make_subscriber(filter_type{"a"}, 3,
+                                overflow_policy::drop_oldest);
+  sub.set_rate_calculation(false);
+  auto leaf = sub.worker();
+  self->send(core1, atom::peer::value, core2);
+  run();
+  auto d1 = sys.spawn(driver, core1);
+  run();
+  using buf = std::vector<value_type>;
+  buf expected{{"a", 3}, {"a", 4}, {"a", 5}};
+  CAF_CHECK_EQUAL(sub.poll(), expected);
+  CAF_CHECK_EQUAL(sub.dropped(), 3u);
+  // Shutdown.
+  CAF_MESSAGE("Shutdown core actors.");
+  anon_send_exit(core1, exit_reason::user_shutdown);
+  anon_send_exit(core2, exit_reason::user_shutdown);
+  anon_send_exit(leaf, exit_reason::user_shutdown);
+  anon_send_exit(d1, exit_reason::user_shutdown);
+}
+
+CAF_TEST(disconnecting_subscriber) {
+  broker_options options;
+  options.disable_ssl = true;
+  auto core1 = sys.spawn(core_actor, filter_type{"a", "b", "c"}, options, nullptr);
+  auto core2 = ep.core();
+  anon_send(core2, atom::subscribe::value, filter_type{"a", "b", "c"});
+  anon_send(core1, atom::no_events::value);
+  anon_send(core2, atom::no_events::value);
+  run();
+  // The six messages on topic "a" overflow the queue.
+  auto sub = ep.make_subscriber(filter_type{"a"}, 3,
+                                overflow_policy::disconnect);
+  sub.set_rate_calculation(false);
+  auto leaf = sub.worker();
+  self->send(core1, atom::peer::value, core2);
+  run();
+  auto d1 = sys.spawn(driver, core1);
+  run();
+  CAF_REQUIRE(sub.closed());
+  CAF_MESSAGE("a closed subscriber hands out its remaining messages");
+  using buf = std::vector<value_type>;
+  buf expected{{"a", 0}, {"a", 1}, {"a", 2}};
+  CAF_CHECK_EQUAL(sub.get(10), expected);
+  CAF_CHECK_EQUAL(sub.get(10), buf{});
+  CAF_MESSAGE("get() on a closed and empty subscriber returns immediately");
+  CAF_CHECK_EQUAL(sub.get(), value_type{});
+  // Shutdown.
+  CAF_MESSAGE("Shutdown core actors.");
+  anon_send_exit(core1, exit_reason::user_shutdown);
+  anon_send_exit(core2, exit_reason::user_shutdown);
+  anon_send_exit(leaf, exit_reason::user_shutdown);
+  anon_send_exit(d1, exit_reason::user_shutdown);
+}
+
 CAF_TEST(nonblocking_subscriber) {
   // Spawn/get/configure core actors.
   broker_options options;
@@ -0,0 +1,82 @@
+#define SUITE weighted_interleave
+#include "test.hpp"
+
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "broker/detail/weighted_interleave.hh"
+
+using namespace broker::detail;
+
+namespace {
+
+// Uses the first character as lane: 'c'ontrol, 's'tore, or 'b'ulk.
+size_t lane_of(const std::string& x) {
+  switch (x[0]) {
+    case 'c':
+      return 0;
+    case 's':
+      return 1;
+    default:
+      return 2;
+  }
+}
+
+using strings = std::vector<std::string>;
+
+using lanes_type = std::array<std::deque<std::string>, 3>;
+
+lanes_type make_lanes(const strings& xs) {
+  lanes_type result;
+  for (auto& x : xs)
+    result[lane_of(x)].emplace_back(x);
+  return result;
+}
+
+const std::array<size_t, 3> weights{{4, 2, 1}};
+
+} // namespace <anonymous>
+
+TEST(single lane) {
+  auto lanes = make_lanes({"b1", "b2", "b3"});
+  strings out;
+  CHECK_EQUAL(weighted_interleave(lanes, weights, 10, out), 3u);
+  CHECK_EQUAL(out, (strings{"b1", "b2", "b3"}));
+  CHECK(lanes[2].empty());
+}
+
+TEST(small lanes overtake bulk traffic) {
+  auto lanes = make_lanes({"b1", "b2", "b3", "b4", "b5", "s1", "b6", "c1",
+                           "s2", "s3"});
+  strings out;
+  CHECK_EQUAL(weighted_interleave(lanes, weights, 10, out), 10u);
+  CHECK_EQUAL(out, (strings{"c1", "s1", "s2", "b1", "s3", "b2", "b3", "b4",
+                            "b5", "b6"}));
+}
+
+TEST(weights share congested paths) {
+  strings xs;
+  for (int i = 0; i < 6; ++i)
+    xs.emplace_back("s" + std::to_string(i));
+  for (int i = 0; i < 6; ++i)
+    xs.emplace_back("b" + std::to_string(i));
+  auto lanes = make_lanes(xs);
+  strings out;
+  CHECK_EQUAL(weighted_interleave(lanes, weights, 12, out), 12u);
+  CHECK_EQUAL(out, (strings{"s0", "s1", "b0", "s2", "s3", "b1", "s4", "s5",
+                            "b2", "b3", "b4", "b5"}));
+}
+
+TEST(credit limits the output) {
+  auto lanes = make_lanes({"b1", "b2", "s1", "s2", "s3", "c1"});
+  strings out;
+  CHECK_EQUAL(weighted_interleave(lanes, weights, 4, out), 4u);
+  CHECK_EQUAL(out, (strings{"c1", "s1", "s2", "b1"}));
+  CHECK_EQUAL(lanes[1].size(), 1u);
+  CHECK_EQUAL(lanes[2].size(), 1u);
+  out.clear();
+  CHECK_EQUAL(weighted_interleave(lanes, weights, 4, out), 2u);
+  CHECK_EQUAL(out, (strings{"s3", "b2"}));
+}
@@ -0,0 +1,95 @@
+
+import asyncio
+import unittest
+
+import broker
+import broker.aio
+
+class TestAsyncIO(unittest.TestCase):
+    def setUp(self):
+        self.loop = asyncio.new_event_loop()
+        asyncio.set_event_loop(self.loop)
+
+    def tearDown(self):
+        asyncio.set_event_loop(None)
+        self.loop.close()
+
+    def run_until_complete(self, coro):
+        return self.loop.run_until_complete(asyncio.wait_for(coro, 10))
+
+    def test_subscriber(self):
+        ep1 = broker.Endpoint()
+        ep2 = broker.Endpoint()
+
+        s1 = broker.aio.Subscriber(ep1.make_subscriber("/test"))
+        port = ep1.listen("127.0.0.1", 0)
+        ep2.peer("127.0.0.1", port, 1.0)
+
+        async def receive():
+            result = []
+
+            async for (t, d) in s1:
+                result.append(d)
+
+                if len(result) == 3:
+                    break
+
+            return result
+
+        async def send():
+            p = broker.aio.Publisher(ep2.make_publisher("/test"))
+
+            for i in range(3):
+                await p.publish(i)
+
+        xs = self.run_until_complete(asyncio.gather(receive(), send()))
+        self.assertEqual(xs[0], [0, 1, 2])
+
+        ep2.publish("/test", "a")
+        ep2.publish("/test", "b")
+        xs = []
+
+        while len(xs) < 2:
+            xs += self.run_until_complete(s1.get(2))
+
+        self.assertEqual([d for (t, d) in xs], ["a", "b"])
+
+        ep1.shutdown()
+        ep2.shutdown()
+
+    def test_status_subscriber(self):
+        ep1 = broker.Endpoint()
+        ep2 = broker.Endpoint()
+
+        es1 = broker.aio.StatusSubscriber(ep1.make_status_subscriber(True))
+        port = ep1.listen("127.0.0.1", 0)
+        ep2.peer("127.0.0.1", port, 1.0)
+
+        st = self.run_until_complete(es1.get())
+        self.assertEqual(st.code(), broker.SC.PeerAdded)
+
+        ep1.shutdown()
+        ep2.shutdown()
+
+    def test_store(self):
+        ep1 = broker.Endpoint()
+        m = broker.aio.Store(ep1.attach_master("test", broker.Backend.Memory))
+        m.put("a", "A")
+        m.put("b", {1, 2})
+
+        async def lookup():
+            return await asyncio.gather(m.get("a"), m.exists("b"), m.get("X"),
+                                        m.get_index_from_value("b", 2),
+                                        m.keys())
+
+        xs = self.run_until_complete(lookup())
+        self.assertEqual(xs, ["A", True, None, True, {"a", "b"}])
+
+        self.assertEqual(self.run_until_complete(m.put_unique("c", "C")), True)
+        self.assertEqual(self.run_until_complete(m.put_unique("c", "D")), False)
+
+        m.close()
+        ep1.shutdown()
+
+if __name__ == '__main__':
+    unittest.main(verbosity=3)
@@ -108,5 +108,25 @@ class TestCommunication(unittest.TestCase):
 
         ep.shutdown()
 
+class TestLogBatch(unittest.TestCase):
+    def test_roundtrip(self):
+        T = broker.Data.Type
+        builder = broker.bro.LogBatchBuilder("Test::LOG", "Log::WRITER_ASCII",
+                                             "test", [T.String, T.Integer, T.Real])
+        records = [["a", 1, 1.5], [None, -2, 2.5], ["c", None, None]]
+
+        for r in records:
+            self.assertTrue(builder.add(r))
+
+        self.assertFalse(builder.add([1, 2, 3]))
+        self.assertEqual(builder.num_records(), 3)
+
+        batch = broker.bro.LogBatch(broker.Data(builder.build()))
+        self.assertTrue(batch.valid())
+        self.assertEqual(batch.path(), "test")
+        self.assertEqual(batch.num_records(), 3)
+        self.assertEqual(batch.column(1), [1, -2, None])
+        self.assertEqual(batch.records(), records)
+
 if __name__ == '__main__':
     unittest.main(verbosity=3)
@@ -4,7 +4,9 @@ from __future__ import unicode_literals
 
 import unittest
 import multiprocessing
+import os
 import sys
+import tempfile
 import time
 import ipaddress
 
@@ -129,6 +131,46 @@ class TestCommunication(unittest.TestCase):
 
         ep1.shutdown()
 
+    def test_unix_socket(self):
+        path = tempfile.mktemp(suffix=".sock")
+        ep1 = broker.Endpoint()
+        ep2 = broker.Endpoint()
+        s1 = ep1.make_subscriber("/test")
+        self.assertTrue(ep1.listen_unix(path))
+        # BASP knows all Unix domain sockets of an endpoint under port 0.
+        self.assertFalse(ep1.listen_unix(path + ".2"))
+        self.assertFalse(os.path.exists(path + ".2"))
+        self.assertTrue(ep2.peer_unix(path, 1.0))
+
+        ep2.publish("/test", ["ping"])
+        (t, d) = s1.get()
+        self.assertEqual(t, "/test")
+        self.assertEqual(d[0], "ping")
+
+        ep1.shutdown()
+        ep2.shutdown()
+        self.assertFalse(os.path.exists(path))
+
+    def test_unix_socket_no_replace(self):
+        with tempfile.NamedTemporaryFile() as f:
+            ep = broker.Endpoint()
+            self.assertFalse(ep.listen_unix(f.name))
+            self.assertTrue(os.path.exists(f.name))
+            ep.shutdown()
+
+    def test_unix_socket_in_use(self):
+        path = tempfile.mktemp(suffix=".sock")
+        ep1 = broker.Endpoint()
+        ep2 = broker.Endpoint()
+        self.assertTrue(ep1.listen_unix(path))
+        # A running endpoint keeps its socket.
+        self.assertFalse(ep2.listen_unix(path))
+        ep3 = broker.Endpoint()
+        self.assertTrue(ep3.peer_unix(path, 1.0))
+        ep3.shutdown()
+        ep2.shutdown()
+        ep1.shutdown()
+
     def test_idle_endpoint(self):
         ep1 = broker.Endpoint()
         es1 = ep1.make_status_subscriber()
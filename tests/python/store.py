@@ -1,11 +1,12 @@
 
+import datetime
 import unittest
 import sys
 import time
 
 import broker
 
-def create_stores():
+def create_stores(opts={}, clone_opts={}):
     ep0 = broker.Endpoint()
     s0 = ep0.make_subscriber("/test")
     p = ep0.listen("127.0.0.1", 0)
@@ -28,9 +29,9 @@ def create_stores():
     s2.get()
     ####
 
-    m = ep0.attach_master("test", broker.Backend.Memory)
-    c1 = ep1.attach_clone("test")
-    c2 = ep2.attach_clone("test")
+    m = ep0.attach_master("test", broker.Backend.Memory, opts)
+    c1 = ep1.attach_clone("test", **clone_opts)
+    c2 = ep2.attach_clone("test", **clone_opts)
 
     return (ep0, ep1, ep2, m, c1, c2)
 
@@ -219,6 +220,84 @@ class TestStore(unittest.TestCase):
         ep1.shutdown()
         ep2.shutdown()
 
+    def test_coalesce(self):
+        opts = {"coalesce": datetime.timedelta(milliseconds=100)}
+        (ep0, ep1, ep2, m, c1, c2) = create_stores(opts)
+
+        m.put("a", "A")
+        m.put("b", "B")
+        time.sleep(.5)
+
+        for i in range(100):
+            m.increment("n", 1)
+            c1.increment("n", 1)
+        m.put("a", "X")
+        m.put("a", "Y")
+        m.erase("b")
+        m.put("b", "Z")
+        m.insert_into("s", 1)
+        m.insert_into("s", 2)
+        m.remove_from("s", 1)
+        m.put("c", "C")
+        m.erase("c")
+        time.sleep(.5)
+
+        def check(x):
+            self.assertEqual(x.get("n"), 200)
+            self.assertEqual(x.get("a"), "Y")
+            self.assertEqual(x.get("b"), "Z")
+            self.assertEqual(x.get("s"), set([2]))
+            self.assertEqual(x.get("c"), None)
+
+        check(m)
+        check(c1)
+        check(c2)
+
+        m.clear()
+        m.put("d", "D")
+        time.sleep(.5)
+        self.assertEqual(c1.keys(), {"d"})
+        self.assertEqual(c2.keys(), {"d"})
+
+        ep1.shutdown()
+        ep2.shutdown()
+
+    def test_coalesce_clones(self):
+        clone_opts = {"write_coalesce_interval": .1, "write_coalesce_size": 50}
+        (ep0, ep1, ep2, m, c1, c2) = create_stores({}, clone_opts)
+
+        for i in range(100):
+            c1.increment("n", 1)
+            c2.increment("n", 2)
+            c1.append("str", "a")
+        c2.put("v", [1])
+        c2.push("v", 2)
+        c2.pop("v")
+        c2.push("v", 3)
+        c1.put("x", 1)
+        c1.erase("x")
+        # The increment comes last and has no expiry, so the key stays.
+        c1.put("e", 1, datetime.timedelta(milliseconds=200))
+        c1.increment("e", 1)
+        self.assertEqual(c2.put_unique("u", "first"), True)
+        self.assertEqual(c2.put_unique("u", "second"), False)
+        time.sleep(.5)
+
+        def check(x):
+            self.assertEqual(x.get("n"), 300)
+            self.assertEqual(x.get("str"), "a" * 100)
+            self.assertEqual(x.get("v"), [1, 3])
+            self.assertEqual(x.get("x"), None)
+            self.assertEqual(x.get("u"), "first")
+            self.assertEqual(x.get("e"), 2)
+
+        check(m)
+        check(c1)
+        check(c2)
+
+        ep1.shutdown()
+        ep2.shutdown()
+
 
 if __name__ == '__main__':
     unittest.main(verbosity=3)